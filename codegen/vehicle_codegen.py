@@ -0,0 +1,339 @@
+"""
+Generates the devices of the vehicles from their schema (codegen/vehicles.json):
+
+    devices.proto     protobuf messages of the device types and of each vehicle
+    devices_gen.h     device classes, included by devices.h
+    devices_gen.cpp   csv, json, readable and protobuf writers of the device classes
+    vehicle_gen.h     devices of each vehicle (X macro) and serializers indexed by Device::index
+    vehicle_gen.cpp
+
+Device types are shared by the vehicles, each vehicle has its own list of devices.
+
+Types marked "custom" are written by hand in devices.h/devices.cpp,
+only their protobuf message is generated.
+
+Usage: vehicle_codegen.py <schema.json> <output folder> [--proto-only]
+"""
+import os
+import sys
+import json
+
+
+HEADER = "// Generated by codegen/vehicle_codegen.py from {}, do not edit\n"
+
+PROTO_TYPES = ["double", "uint32", "bool", "string"]
+# Devices of a vehicle are one bit each in a Device_Set_t (VEHICLE_MAX_DEVICES)
+MAX_DEVICES = 64
+
+
+def fail(message):
+    print("vehicle_codegen: " + message)
+    sys.exit(1)
+
+
+def loadSchema(path):
+    with open(path) as f:
+        schema = json.load(f)
+
+    types = {}
+    for t in schema["types"]:
+        fields = []
+        for field in t["fields"]:
+            # A plain name is a double
+            if isinstance(field, str):
+                field = {"name": field}
+            field.setdefault("type", "double")
+            field.setdefault("count", 1)
+            field.setdefault("json", field["name"])
+            if field["type"] not in PROTO_TYPES:
+                fail("type {} of {}.{} not supported".format(field["type"], t["name"], field["name"]))
+            if field["type"] != "double" and not t.get("custom", False):
+                fail("{}.{}: only custom types can have fields that are not double".format(t["name"], field["name"]))
+            fields.append(field)
+        t["fields"] = fields
+        t.setdefault("custom", False)
+        t.setdefault("members", [])
+        t.setdefault("comment", [])
+        types[t["name"]] = t
+
+    vehicles = schema["vehicles"]
+    names = set()
+    for vehicle in vehicles:
+        if vehicle["name"] in types or vehicle["name"] in names:
+            fail("vehicle name {} used twice".format(vehicle["name"]))
+        names.add(vehicle["name"])
+        vehicle.setdefault("comment", [])
+
+        devices = vehicle["devices"]
+        if len(devices) > MAX_DEVICES:
+            fail("{}: {} devices, at most {}".format(vehicle["name"], len(devices), MAX_DEVICES))
+        ids = set()
+        for device in devices:
+            if device["type"] not in types:
+                fail("unknown type {} of device {}.{}".format(device["type"], vehicle["name"], device["field"]))
+            if device["proto_id"] in ids:
+                fail("{}: proto_id {} used twice".format(vehicle["name"], device["proto_id"]))
+            ids.add(device["proto_id"])
+            # Used by the tools to find the device (report, gps loggers)
+            device.setdefault("role", "")
+
+    return schema, types, vehicles
+
+
+def columnNames(field):
+    if field["count"] == 1:
+        return [field["name"]]
+    return [field["column"] + str(i) for i in range(field["count"])]
+
+
+############################## devices.proto
+
+def protoFile(schema, types, vehicles, source):
+    out = HEADER.format(source)
+    out += 'syntax = "proto3";\n\n'
+    out += "package {};\n\n".format(schema["package"])
+
+    for t in schema["types"]:
+        out += "\n"
+        for line in t["comment"]:
+            out += "// " + line + "\n"
+        out += "message {} {{\n".format(t["name"])
+        out += "\toptional double timestamp = 1;\n"
+        for i, field in enumerate(t["fields"]):
+            if "comment" in field and t["custom"]:
+                out += "\t// {}\n".format(field["comment"])
+            label = "repeated" if field["count"] > 1 else "optional"
+            out += "\t{} {} {} = {};\n".format(label, field["type"], field["name"], i + 2)
+        out += "}\n"
+
+    for vehicle in vehicles:
+        out += "\n\n"
+        for line in vehicle["comment"]:
+            out += "// " + line + "\n"
+        out += "message {} {{\n".format(vehicle["name"])
+        for device in sorted(vehicle["devices"], key=lambda d: d["proto_id"]):
+            out += "\trepeated {} {} = {};\n".format(device["type"], device["field"], device["proto_id"])
+        out += "}\n"
+    return out
+
+
+############################## devices_gen.h
+
+def classDeclaration(t):
+    name = t["name"]
+    out = "class {}: public Device{{\npublic:\n".format(name)
+
+    # Constructor, registers the numeric fields for the sample store
+    scalars = all(field["count"] == 1 for field in t["fields"])
+    if scalars:
+        pointers = ", ".join("&" + field["name"] for field in t["fields"])
+        names = ", ".join('"{}"'.format(field["name"]) for field in t["fields"])
+        out += "\t{}(std::string name): Device(name){{\n".format(name)
+        out += "\t\tset_fields(&timestamp, {{{}}}, {{{}}});\n".format(pointers, names)
+        out += "\t};\n\n"
+    else:
+        out += "\t{}(std::string name): Device(name){{\n".format(name)
+        out += "\t\tstd::vector<double*> fields;\n"
+        out += "\t\tstd::vector<std::string> names;\n"
+        for field in t["fields"]:
+            if field["count"] == 1:
+                out += "\t\tfields.push_back(&{});\n".format(field["name"])
+                out += '\t\tnames.push_back("{}");\n'.format(field["name"])
+            else:
+                out += "\t\tfor(int i = 0; i < {}; i++){{\n".format(field["count"])
+                out += "\t\t\tfields.push_back(&{}[i]);\n".format(field["name"])
+                out += '\t\t\tnames.push_back("{}" + std::to_string(i));\n'.format(field["column"])
+                out += "\t\t}\n"
+        out += "\t\tset_fields(&timestamp, fields, names);\n"
+        out += "\t};\n\n"
+
+    out += "\tvirtual std::string get_header(std::string separator);\n"
+    out += "\tvirtual std::string get_string(std::string separator);\n"
+    out += "\tvirtual Document    get_json  ();\n"
+    out += "\tvirtual std::string   get_readable();\n\n"
+    out += "\tvoid serialize(devices::{}* device);\n\n".format(name)
+
+    out += "\tdouble timestamp = 0.0;\n"
+    for field in t["fields"]:
+        if field["count"] == 1:
+            out += "\tdouble {} = 0.0;".format(field["name"])
+        else:
+            out += "\tdouble {}[{}] = {{}};".format(field["name"], field["count"])
+        if "comment" in field:
+            out += "\t// " + field["comment"]
+        out += "\n"
+    for member in t["members"]:
+        out += "\n"
+        if "comment" in member:
+            out += "\t// {}\n".format(member["comment"])
+        out += "\t{}\n".format(member["declaration"])
+    out += "};\n\n"
+    return out
+
+
+def devicesHeader(schema, types, source):
+    out = HEADER.format(source)
+    out += "// Device classes, included by devices.h after class Device\n"
+    out += "#pragma once\n\n"
+    for t in schema["types"]:
+        if not t["custom"]:
+            out += classDeclaration(t)
+    return out
+
+
+############################## devices_gen.cpp
+
+def banner(name):
+    return "/" * 31 + "\n" + "//  {}\n".format(name.upper()) + "/" * 31 + "\n"
+
+
+def classDefinition(t):
+    name = t["name"]
+    var = name.lower()
+    fields = t["fields"]
+    out = banner(name)
+
+    # CSV header and row, same columns of the sample store
+    out += "std::string {}::get_header(std::string separator)\n{{\n".format(name)
+    out += '\tstd::string header = "";\n'
+    out += '\theader += "timestamp" + separator;\n'
+    for field in fields:
+        if field["count"] == 1:
+            out += '\theader += "{}" + separator;\n'.format(field["name"])
+        else:
+            out += "\tfor(int i = 0; i < {}; i++)\n".format(field["count"])
+            out += '\t\theader += "{}" + std::to_string(i) + separator;\n'.format(field["column"])
+    out += "\treturn header;\n}\n"
+
+    out += "std::string {}::get_string(std::string separator)\n{{\n".format(name)
+    out += '\tstd::string str = "";\n'
+    out += "\tstr += std::to_string(timestamp) + separator;\n"
+    for field in fields:
+        if field["count"] == 1:
+            out += "\tstr += std::to_string({}) + separator;\n".format(field["name"])
+        else:
+            out += "\tfor(int i = 0; i < {}; i++)\n".format(field["count"])
+            out += "\t\tstr += std::to_string({}[i]) + separator;\n".format(field["name"])
+    out += "\treturn str;\n}\n"
+
+    out += "Document {}::get_json()\n{{\n".format(name)
+    out += "\tDocument d;\n\td.SetObject();\n"
+    out += "\tDocument::AllocatorType &alloc = d.GetAllocator();\n"
+    out += '\td.AddMember("timestamp", timestamp, alloc);\n'
+    for field in fields:
+        if field["count"] == 1:
+            out += '\td.AddMember("{}", {}, alloc);\n'.format(field["json"], field["name"])
+        else:
+            out += "\t{\n\t\tValue v;\n\t\tv.SetArray();\n"
+            out += "\t\tfor(int i = 0; i < {}; i++)\n".format(field["count"])
+            out += "\t\t\tv.PushBack({}[i], alloc);\n".format(field["name"])
+            out += '\t\td.AddMember("{}", v, alloc);\n\t}}\n'.format(field["json"])
+    out += "\treturn d;\n}\n"
+
+    out += "void {}::serialize(devices::{}* {})\n{{\n".format(name, name, var)
+    out += "\t{}->set_timestamp(timestamp);\n".format(var)
+    for field in fields:
+        if field["count"] == 1:
+            out += "\t{}->set_{}({});\n".format(var, field["name"], field["name"])
+        else:
+            out += "\t{}->clear_{}();\n".format(var, field["name"])
+            out += "\tfor(int i = 0; i < {}; i++)\n".format(field["count"])
+            out += "\t\t{}->add_{}({}[i]);\n".format(var, field["name"], field["name"])
+    out += "}\n"
+
+    out += "std::string {}::get_readable()\n{{\n".format(name)
+    out += "\tstd::stringstream ss;\n\tss.precision(3);\n"
+    out += '\tss << get_name() << "\\n";\n'
+    out += '\tss << "\\ttimestamp -> \\t" << timestamp << "\\n";\n'
+    for field in fields:
+        if field["count"] == 1:
+            out += '\tss << "\\t{} -> \\t" << {} << "\\n";\n'.format(field["name"], field["name"])
+        else:
+            out += "\tfor(int i = 0; i < {}; i++)\n".format(field["count"])
+            out += '\t\tss << "\\t{}" << i << " -> \\t" << {}[i] << "\\n";\n'.format(field["column"], field["name"])
+    out += "\treturn ss.str();\n}\n\n"
+    return out
+
+
+def devicesSource(schema, types, source):
+    out = HEADER.format(source)
+    out += '#include "devices.h"\n\n'
+    for t in schema["types"]:
+        if not t["custom"]:
+            out += classDefinition(t)
+    return out
+
+
+############################## vehicle_gen.h / vehicle_gen.cpp
+
+def vehicleHeader(schema, vehicles, source):
+    out = HEADER.format(source)
+    out += "#pragma once\n\n"
+    out += '#include "devices.h"\n\n'
+    out += "// Adds the values of the device to its repeated field of the vehicle message\n"
+    out += "typedef void (*Serialize_Device_Fn)(Device* device, Message* proto);\n"
+    for vehicle in vehicles:
+        prefix = vehicle["name"].upper()
+        devices = vehicle["devices"]
+        out += "\n// Devices of {} in the order of its vector of devices (Device::index),\n".format(vehicle["name"])
+        out += "// X(class, member and protobuf field, name, role)\n"
+        out += "#define {}_DEVICES(X) \\\n".format(prefix)
+        for i, device in enumerate(devices):
+            end = " \\\n" if i < len(devices) - 1 else "\n"
+            out += '\tX({}, {}, "{}", "{}"){}'.format(device["type"], device["field"], device["name"], device["role"], end)
+        out += "\n#define {}_DEVICE_COUNT {}\n".format(prefix, len(devices))
+        out += "// Indexed by Device::index, proto is a {}::{}\n".format(schema["package"], vehicle["name"])
+        out += "extern const Serialize_Device_Fn {}_SERIALIZERS[{}_DEVICE_COUNT];\n".format(prefix, prefix)
+    return out
+
+
+def vehicleSource(schema, vehicles, source):
+    out = HEADER.format(source)
+    out += '#include "vehicle_gen.h"\n'
+    for vehicle in vehicles:
+        name = vehicle["name"]
+        prefix = name.upper()
+        message = "{}::{}".format(schema["package"], name)
+        out += "\n"
+        for device in vehicle["devices"]:
+            out += "static void serialize_{}_{}(Device* device, Message* proto){{\n".format(name.lower(), device["field"])
+            out += "\t(({}*)device)->serialize(static_cast<{}*>(proto)->add_{}());\n}}\n".format(device["type"], message, device["field"])
+        out += "\nconst Serialize_Device_Fn {}_SERIALIZERS[{}_DEVICE_COUNT] = {{\n".format(prefix, prefix)
+        for device in vehicle["devices"]:
+            out += "\tserialize_{}_{},\n".format(name.lower(), device["field"])
+        out += "};\n"
+    return out
+
+
+def writeIfChanged(path, content):
+    # Unchanged files keep their time, nothing is rebuilt
+    # (the build runs the generator again only when its stamp is older than the schema)
+    if os.path.exists(path):
+        with open(path) as f:
+            if f.read() == content:
+                return
+    with open(path, "w") as f:
+        f.write(content)
+
+
+if __name__ == "__main__":
+    if len(sys.argv) < 3:
+        print(__doc__)
+        sys.exit(1)
+
+    schema_path = sys.argv[1]
+    out_folder = sys.argv[2]
+    proto_only = "--proto-only" in sys.argv[3:]
+
+    schema, types, vehicles = loadSchema(schema_path)
+    source = os.path.basename(schema_path)
+    os.makedirs(out_folder, exist_ok=True)
+
+    writeIfChanged(os.path.join(out_folder, "devices.proto"), protoFile(schema, types, vehicles, source))
+    if proto_only:
+        sys.exit(0)
+
+    writeIfChanged(os.path.join(out_folder, "devices_gen.h"), devicesHeader(schema, types, source))
+    writeIfChanged(os.path.join(out_folder, "devices_gen.cpp"), devicesSource(schema, types, source))
+    writeIfChanged(os.path.join(out_folder, "vehicle_gen.h"), vehicleHeader(schema, vehicles, source))
+    writeIfChanged(os.path.join(out_folder, "vehicle_gen.cpp"), vehicleSource(schema, vehicles, source))
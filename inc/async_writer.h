@@ -0,0 +1,240 @@
+#ifndef ASYNC_WRITER_H
+#define ASYNC_WRITER_H
+
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <ostream>
+#include <functional>
+#include <stdint.h>
+#include <condition_variable>
+
+using namespace std;
+
+// Files open at the same time in a writer
+#define ASYNC_WRITER_MAX_FILES 64
+// Buffers are allocated and written in multiples of a page
+#define ASYNC_WRITER_ALIGNMENT 4096
+
+enum Async_Fsync_t
+{
+  // The kernel writes the pages when it wants
+  ASYNC_FSYNC_NONE,
+  // When the file is closed
+  ASYNC_FSYNC_CLOSE,
+  // At most every fsync_period_ms, and at close
+  ASYNC_FSYNC_PERIODIC,
+  // After each write
+  ASYNC_FSYNC_ALWAYS,
+};
+
+struct Async_Writer_Config_t
+{
+  // Size of each buffer of a file
+  size_t buffer_size = 1 << 20;
+  // Buffers of each file: one filled by the producer, the others queued or written
+  int buffers = 2;
+  // A buffer not full is written after this time from its first byte
+  int flush_period_ms = 500;
+  Async_Fsync_t fsync = ASYNC_FSYNC_CLOSE;
+  int fsync_period_ms = 1000;
+};
+
+struct Async_Writer_Stats_t
+{
+  uint64_t bytes = 0;
+  uint64_t writes = 0;
+  uint64_t fsyncs = 0;
+  // steady clock of the get_stats call, for rates between two calls (bytes_per_second)
+  int64_t time_ns = 0;
+
+  // Buffers waiting for the writer thread
+  uint32_t queue_depth = 0;
+  uint32_t max_queue_depth = 0;
+
+  // Longest write() and fsync() of the writer thread
+  int64_t worst_write_ns = 0;
+  int64_t worst_fsync_ns = 0;
+
+  // Producers waited for a buffer, the writer thread was behind
+  uint64_t stalls = 0;
+  int64_t worst_stall_ns = 0;
+
+  // write() or fsync() failed, bytes of the failed writes are lost
+  uint64_t errors = 0;
+};
+
+/**
+* Writes files from a background thread, so the threads producing
+* the data (CAN, csv, gps) never wait for the storage.
+*
+* Each file has a few preallocated buffers: producers copy the data in one,
+* when it is full (or after flush_period_ms) it is queued and the producer
+* continues in the next. The writer thread writes each buffer with one write()
+* and fsyncs with the configured policy.
+* A producer waits only if all the buffers of its file are queued.
+*/
+class AsyncWriter
+{
+public:
+  // Called once a closed file is written, fsynced (fsync policy) and closed,
+  // ok is false if a write, fsync or close of the file failed
+  typedef function<void(bool ok)> Closed_Fn;
+
+  AsyncWriter(const Async_Writer_Config_t& config = Async_Writer_Config_t());
+  // Writes and closes all the files
+  ~AsyncWriter();
+
+  void start();
+  /**
+  * Writes all the data, closes the files and stops the thread
+  */
+  void stop();
+  bool is_running(){ return running; }
+  pthread_t get_thread_handle();
+
+  /**
+  * Opens (truncates) a file
+  *
+  * return handle of the file, -1 if it can not be opened
+  */
+  int open(const string& path);
+
+  /**
+  * Copies data in the buffer of the file, thread safe.
+  * Before start (or after stop) full buffers are written by the caller
+  */
+  void write(const int& file, const char* data, size_t size);
+
+  /**
+  * Queues the data buffered for the file
+  */
+  void flush(const int& file);
+
+  /**
+  * Queues the data buffered and closes the file in the writer thread,
+  * the handle can not be used anymore
+  *
+  * @param wait returns after the writer thread wrote the data and closed the file
+  * (fsync with the fsync policy)
+  * @param on_closed called by the writer thread when the file is closed,
+  * without waiting for it (by the caller if the thread is not running)
+  * return false if a write, fsync or close of the file failed (only if waiting)
+  */
+  bool close(const int& file, const bool& wait = false, Closed_Fn on_closed = nullptr);
+
+  /**
+  * Counters since the start, can be called by any thread
+  * (calls do not change the stats of the other callers)
+  */
+  Async_Writer_Stats_t get_stats();
+  /**
+  * return bytes written per second between two get_stats of the same writer
+  */
+  static double bytes_per_second(const Async_Writer_Stats_t& previous, const Async_Writer_Stats_t& current);
+  const Async_Writer_Config_t& get_config(){ return config; }
+
+  /**
+  * return fsync policy by name (none, close, periodic, always), ASYNC_FSYNC_CLOSE if unknown
+  */
+  static Async_Fsync_t fsync_from_string(const string& name);
+
+private:
+  struct Buffer_t
+  {
+    char* data;
+    size_t size;
+  };
+  struct File_t
+  {
+    int fd;
+    mutex mtx;
+    condition_variable free_cv;
+    // Being filled by the producers
+    Buffer_t* active = nullptr;
+    vector<Buffer_t*> free;
+    vector<Buffer_t*> all;
+    int64_t active_since = 0;
+    int64_t last_fsync = 0;
+    // The close job is queued
+    bool closing = false;
+    // A write or fsync failed
+    bool failed = false;
+  };
+  // Result of a close, for the thread waiting for it
+  struct Close_Wait_t
+  {
+    bool closed = false;
+    bool ok = false;
+  };
+  struct Job_t
+  {
+    int file;
+    Buffer_t* buffer;   // nullptr to close the file
+    Close_Wait_t* wait = nullptr;
+    Closed_Fn on_closed = nullptr;
+  };
+
+  void run();
+  // Queues the active buffer of a file, file->mtx held
+  void submit(const int& handle, File_t* file);
+  void write_buffer(File_t* file, Buffer_t* buffer);
+  void close_file(const int& handle, Close_Wait_t* wait, Closed_Fn on_closed);
+  void fsync_file(File_t* file);
+
+  Async_Writer_Config_t config;
+
+  File_t* files[ASYNC_WRITER_MAX_FILES] = {};
+  mutex files_mtx;
+
+  deque<Job_t> queue;
+  mutex queue_mtx;
+  condition_variable queue_cv;
+  // Notified with queue_mtx when a waited close is done
+  condition_variable closed_cv;
+
+  thread* writer_thread = nullptr;
+  atomic<bool> running;
+  bool stopping = false;
+
+  mutex stats_mtx;
+  Async_Writer_Stats_t stats;
+};
+
+/**
+* Output stream on a file of an AsyncWriter, can be used where
+* an fstream was written. flush() does not wait for the storage.
+*/
+class AsyncFile : public ostream
+{
+public:
+  AsyncFile(AsyncWriter* writer, const string& path);
+  // Closes the file
+  ~AsyncFile();
+
+  bool is_open(){ return buffer.file >= 0; }
+  /**
+  * @param wait returns after the data is written and the file closed
+  * @param on_closed see AsyncWriter::close, called with false if the file was not open
+  * return false if writing the file failed (only if waiting)
+  */
+  bool close(const bool& wait = false, AsyncWriter::Closed_Fn on_closed = nullptr);
+
+private:
+  class Buffer : public streambuf
+  {
+  public:
+    AsyncWriter* writer;
+    int file = -1;
+  protected:
+    streamsize xsputn(const char* s, streamsize n) override;
+    int overflow(int c) override;
+    int sync() override;
+  };
+  Buffer buffer;
+};
+
+#endif // ASYNC_WRITER_H
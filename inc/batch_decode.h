@@ -0,0 +1,97 @@
+#ifndef BATCH_DECODE_H
+#define BATCH_DECODE_H
+
+#include <vector>
+#include <stdint.h>
+
+#include "vehicle.h"
+
+using namespace std;
+
+// Frames queued for each id before they are decoded together
+#define BATCH_FRAMES 1024
+
+/**
+* Decodes count IMU payloads (Imu_Frame) into columns, one payload
+* at a time with the decoder of Chimera, payload i is at payloads + i * 8
+*/
+void batch_decode_imu(const uint8_t* payloads, size_t count, double* x, double* y, double* z);
+/**
+* Decodes count temperature payloads (Temperature_Frame) into columns,
+* channel k of payload i is in channels[k][i]
+*/
+void batch_decode_temperature(const uint8_t* payloads, size_t count, double* channels[4]);
+
+// Frames of one device waiting to be decoded, in arrival order
+struct Batch_Queue_t
+{
+  Device* device = nullptr;
+  bool is_imu = false;
+
+  size_t count = 0;
+  double timestamps[BATCH_FRAMES];
+  uint8_t payloads[BATCH_FRAMES * 8];
+  // Decoder arg of each frame: Imu scale or Temperature frame index
+  int args[BATCH_FRAMES];
+  // Set on the last block of a CAN FD frame and on classic frames,
+  // rows are stored at the end of a frame as in parse_message
+  bool frame_end[BATCH_FRAMES];
+  // A row completed by a block of a frame not ended yet (queue flushed when full)
+  bool row_pending = false;
+};
+
+/**
+* Decodes the IMU and temperature frames (also CAN FD) in batches,
+* writing the rows directly in the sample store of the vehicle.
+* Each payload is decoded by the same scalar code of parse_message,
+* the time is saved by queueing the frames of a sensor and appending its rows together.
+* Only the ids whose decoder is marked DECODE_BATCH_IMU or DECODE_BATCH_TEMPERATURE are queued.
+* Values, rows and device state are the same of parse_message + store_samples.
+*
+* Frames of other ids must still be passed to parse_message.
+* Call flush before reading the sample store.
+*/
+class BatchDecoder
+{
+public:
+  BatchDecoder(Vehicle* vehicle);
+  ~BatchDecoder();
+
+  /**
+  * Queues the frame if its id is decoded in batches on its bus
+  *
+  * @param timestamp_ns of the frame
+  * @param bus of the vehicle
+  * @param id CAN id
+  * @param data payload, at least 8 bytes
+  * @param size of the payload
+  * return true if queued, false if it must be decoded by parse_message
+  */
+  bool add(const int64_t& timestamp_ns, const uint8_t& bus, const int& id, const uint8_t data[], const int& size);
+
+  /**
+  * Decodes all the queued frames
+  */
+  void flush();
+
+private:
+  void push(Batch_Queue_t* queue, const double& timestamp, const uint8_t payload[], const int& arg, bool frame_end);
+  void flush(Batch_Queue_t* queue);
+  void flush_imu(Batch_Queue_t* queue);
+  void flush_temperature(Batch_Queue_t* queue);
+
+  Vehicle* vehicle;
+  // Indexed by bus and CAN id, nullptr if not decoded in batches
+  Batch_Queue_t* queues[VEHICLE_MAX_BUSES][CAN_STD_ID_COUNT];
+  // Decoder arg of each id
+  int args[VEHICLE_MAX_BUSES][CAN_STD_ID_COUNT];
+  // One for each device
+  vector<Batch_Queue_t*> device_queues;
+
+  // Columns of batch_decode_imu/temperature and rows assembled for the store
+  vector<double> columns[DEVICE_MAX_FIELDS];
+  vector<double> row_timestamps;
+  vector<double> rows[DEVICE_MAX_FIELDS];
+};
+
+#endif // BATCH_DECODE_H
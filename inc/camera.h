@@ -20,6 +20,7 @@
 
 
 
+#include "utils.h"
 #include "console.h"
 #include "StateMachine/StateMachine.h"
 
@@ -102,6 +103,10 @@ public:
 	// returns the current error
 	CamError GetError();
 
+	// cpus ("0-2") and SCHED_FIFO priority (0 = SCHED_OTHER)
+	// applied to the thread that saves the video
+	void SetSaveThreadPlacement(const string& cpus, int priority);
+
 private:
 	// State enumeration order must match the order of state method entries
 	// in the state map.
@@ -124,6 +129,10 @@ private:
 	mutex mtx;
 	condition_variable event;
 	thread* save_thread = nullptr;
+	// Applied only if set with SetSaveThreadPlacement
+	bool save_thread_placement = false;
+	string save_thread_cpus;
+	int save_thread_priority = 0;
 
 	cv::Mat* img;
 	unsigned char *img_data;
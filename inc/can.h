@@ -3,7 +3,9 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <atomic>
 #include <iostream>
+#include <vector>
 
 #include <unistd.h>
 #include <net/if.h>
@@ -14,7 +16,61 @@
 #include <linux/can.h>
 #include <linux/can/raw.h>
 
+// Kernel receive timestamps
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+
+// Memory mapped capture (PACKET_RX_RING)
+#include <sys/mman.h>
+#include <arpa/inet.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <linux/filter.h>
+
 using namespace std;
+
+enum CanTimestampMode
+{
+  CAN_TS_USERSPACE,   // clock read once per received batch
+  CAN_TS_SOFTWARE,    // SO_TIMESTAMPNS, stamped by the kernel when the frame is queued
+  CAN_TS_HARDWARE     // SO_TIMESTAMPING, stamped by the controller (software stamp as fallback)
+};
+
+// Space for the control messages of a single received frame
+// (timestamp and SO_RXQ_OVFL drop counter)
+#define CAN_RX_CONTROL_LEN (CMSG_SPACE(sizeof(struct scm_timestamping)) + CMSG_SPACE(sizeof(uint32_t)))
+
+// Memory mapped ring: blocks are handed to userspace when full
+// or after CAN_MMAP_BLOCK_TIMEOUT_MS from the first frame
+#define CAN_MMAP_BLOCK_SIZE (1 << 16)
+#define CAN_MMAP_BLOCK_COUNT 64
+#define CAN_MMAP_BLOCK_TIMEOUT_MS 5
+#define CAN_MMAP_FRAME_SIZE 128
+
+// Frame received with receive_mmap, points inside the mapped ring
+struct CAN_Mmap_Frame_t
+{
+  canfd_frame* frame;
+  int64_t timestamp;  // nanoseconds since epoch (kernel software stamp)
+};
+
+struct CAN_Rx_Stat_t
+{
+  uint64_t frames;        // frames received
+  uint64_t batches;       // receive_batch calls that returned frames
+  uint64_t full_batches;  // batches that filled the whole buffer (socket queue is backing up)
+  uint64_t truncated;     // received datagrams that were not a can_frame/canfd_frame, discarded
+  uint64_t fd_frames;     // CAN FD frames received
+  uint64_t drops;         // frames dropped by the kernel because the socket queue was full (SO_RXQ_OVFL)
+};
+
+/**
+ * CAN FD payloads can only be 0~8, 12, 16, 20, 24, 32, 48, 64 bytes long
+ *
+ * return smallest valid FD length that can contain len bytes
+*/
+uint8_t can_fd_valid_len(int len);
+
 class Can{
 public:
   /**
@@ -36,6 +92,7 @@ public:
 
   /**
   * Opens device updating address,
+  * enables the drop counter (SO_RXQ_OVFL)
   *
   * return socket fd
   */
@@ -58,6 +115,12 @@ public:
   */
   const char* get_device();
 
+  /**
+   * Returns the fd where frames are received (to be used with poll/epoll),
+   * the packet socket if the mmap capture is open
+  */
+  int get_socket();
+
   /**
   * Sends an array of bytes
   *
@@ -68,6 +131,29 @@ public:
   */
   int send(int id, char* data, int len);
 
+  /**
+  * Sends a CAN FD frame, enable_fd must be called before
+  *
+  * @param id message id
+  * @param data array of bytes
+  * @param len num of bytes to be sent (0~64), padded with zeros
+  *            to the next valid FD length
+  * @param flags CANFD_BRS (bit rate switch), CANFD_ESI
+  * return success
+  */
+  int send_fd(int id, char* data, int len, uint8_t flags);
+
+  /**
+  * Enables reception and transmission of CAN FD frames (CAN_RAW_FD_FRAMES)
+  * Must be called after open_socket
+  * Classic frames are still received
+  *
+  * return 0 on success, < 0 if the interface does not support it
+  */
+  int enable_fd();
+
+  bool is_fd_enabled();
+
   /**
   * Receive a can frame from device
   *
@@ -76,6 +162,88 @@ public:
   */
   int receive(can_frame* frame);
 
+  /**
+  * Receive up to max frames with a single syscall (recvmmsg)
+  * Blocks until at least one frame is available, then returns
+  * everything already queued in the socket (up to max)
+  * Classic frames have flags = 0, CAN FD frames have CANFD_FDF set in flags.
+  *
+  * @param frames array of at least max elements that will be filled
+  * @param max maximum number of frames to be received
+  * @param timestamps array of at least max elements filled with the
+  *                   receive timestamp of each frame (nanoseconds since epoch),
+  *                   source depends on set_timestamping, can be nullptr
+  * return number of frames received, -1 on error
+  */
+  int receive_batch(canfd_frame* frames, size_t max, int64_t* timestamps);
+
+  /**
+  * Opens the memory mapped capture (AF_PACKET, TPACKET_V3 PACKET_RX_RING)
+  * on the same interface. Frames are then read with receive_mmap,
+  * the raw socket is kept only to send frames (receives nothing)
+  * Must be called after open_socket. Kernel filters (set_filters) are
+  * attached to the capture as classic BPF, set_timestamping does not apply
+  *
+  * @param block_size bytes of each block, multiple of the page size
+  * @param block_count number of blocks in the ring
+  * return packet socket fd, < 0 on error (raw socket still usable)
+  */
+  int open_mmap(int block_size, int block_count);
+
+  bool is_mmap();
+
+  /**
+  * Returns up to max frames of the next block of the mapped ring
+  * without copying them. Does not block (use poll/epoll on get_socket)
+  * The pointers are valid until the next call,
+  * then the block is given back to the kernel
+  *
+  * @param frames array of at least max elements that will be filled
+  * @param max maximum number of frames returned
+  * return number of frames, 0 if no block is ready, -1 if mmap is not open
+  */
+  int receive_mmap(CAN_Mmap_Frame_t* frames, size_t max);
+
+  /**
+  * Selects the source of the timestamps returned by receive_batch
+  * Must be called after open_socket
+  *
+  * @param mode timestamp source
+  * return 0 on success, < 0 if the socket option was refused
+  *        (timestamps fall back to CAN_TS_USERSPACE)
+  */
+  int set_timestamping(CanTimestampMode mode);
+
+  CanTimestampMode get_timestamping();
+
+  /**
+  * Sets the socket receive buffer size (SO_RCVBUF),
+  * SO_RCVBUFFORCE is tried first to exceed rmem_max (needs CAP_NET_ADMIN)
+  * Must be called after open_socket
+  *
+  * @param bytes requested size
+  * return 0 on success
+  */
+  int set_receive_buffer(int bytes);
+
+  /**
+  * Returns the receive buffer size used by the kernel
+  * (double of the requested one, includes bookkeeping), -1 on error
+  */
+  int get_receive_buffer();
+
+  /**
+   * Returns receive counters of receive_batch since the last reset,
+   * can be called from any thread while another one receives.
+   * drops is updated when a frame is received
+  */
+  CAN_Rx_Stat_t get_rx_stat();
+
+  /**
+   * Resets receive counters, can be called from any thread
+  */
+  void reset_rx_stat();
+
   /**
   * Setup filters so select id that can be received
   *
@@ -84,12 +252,76 @@ public:
   */
   int set_filters(can_filter& filter);
 
+  /**
+  * Setup a list of filters (CAN_RAW_FILTER), a frame is received
+  * if it matches at least one of them
+  * An empty list removes all filters (every frame is received)
+  * Applied also to the mmap capture, before or after open_mmap
+  *
+  * @param filters structs filled (id, mask)
+  * return success
+  */
+  int set_filters(const vector<can_filter>& filters);
+
 private:
   int sock;                           // socket fd
-  const char* device;                 // name of device
+  string device;                      // name of device
   sockaddr_can* address;              // address of device
 
   bool opened;
+  bool fd_enabled;
+
+  // recvmmsg buffers, grown on demand
+  vector<mmsghdr> rx_msgs;
+  vector<iovec> rx_iovecs;
+  vector<char> rx_control;
+
+  // Counters since init, written only by the receiving thread and read
+  // by the others (status, stats), each one alone is consistent
+  struct Rx_Counters_t
+  {
+    atomic<uint64_t> frames;
+    atomic<uint64_t> batches;
+    atomic<uint64_t> full_batches;
+    atomic<uint64_t> truncated;
+    atomic<uint64_t> fd_frames;
+    // last value of the kernel drop counter
+    atomic<uint32_t> drops;
+  };
+  Rx_Counters_t rx_count;
+  // Values of rx_count at the last reset_rx_stat
+  Rx_Counters_t rx_base;
+
+  CanTimestampMode ts_mode;
+  // offset from controller clock to system clock (hardware timestamps)
+  int64_t hw_offset;
+  bool hw_offset_valid;
+
+  // kernel drop counter (SO_RXQ_OVFL, or sum of the ring drops), receiving thread only
+  uint32_t drop_counter;
+
+  // Memory mapped capture
+  int mmap_sock;
+  uint8_t* mmap_ring;
+  size_t mmap_block_size;
+  size_t mmap_block_count;
+  size_t mmap_block_index;            // next block to be read
+  tpacket_block_desc* mmap_block;     // block being read, nullptr if none
+  uint8_t* mmap_packet;               // next packet in the block
+  uint32_t mmap_packets_left;
+
+  // Filters of the last set_filters, also attached to the mmap capture
+  vector<can_filter> rx_filters;
+  // Attaches rx_filters to the packet socket as classic BPF (none if empty)
+  int attach_mmap_filters(int fd);
+
+  // Gives the current block back to the kernel, reads the ring drops
+  void release_mmap_block();
+  void close_mmap();
+
+  // Reads the control messages of a frame, updates drop_counter
+  // return timestamp of the frame, 0 if not present
+  int64_t parse_control(msghdr* hdr);
 };
 
 #endif
@@ -0,0 +1,176 @@
+#ifndef CAN_SIGNAL_H
+#define CAN_SIGNAL_H
+
+#include <stdint.h>
+
+/**
+* Signals known at build time declared as types.
+* Position, length, byte order, sign and conversion are template parameters,
+* so extraction compiles to a fixed sequence of loads, shifts and masks
+* with no loops nor branches.
+*
+* Bit positions follow the DBC convention (see dbc.h):
+* - SIGNAL_LE (Intel):    Start is the LSB, bits grow to the next bytes
+* - SIGNAL_BE (Motorola): Start is the MSB (bit 7 of byte 0 is 7),
+*                         bits go to bit 0 and continue from bit 7 of the next byte
+*
+* Example, 16 bits big endian signed at bytes 0-1 divided by 100:
+*   typedef Signal<7, 16, SIGNAL_BE, true, Divide<100>> Gyro_X;
+*   double x = Gyro_X::value(data);
+*/
+
+enum Signal_Order_t
+{
+  SIGNAL_LE,
+  SIGNAL_BE,
+};
+
+//////////////////////// Conversions
+// Raw integer to physical value, each keeps the exact floating point
+// operations of the expression it replaces
+
+// value = raw
+struct Raw_Value
+{
+  static inline double apply(const int64_t& raw)
+  {
+    return double(raw);
+  }
+};
+
+// value = raw / Divisor, in double
+template <int64_t Divisor>
+struct Divide
+{
+  static inline double apply(const int64_t& raw)
+  {
+    return double(raw) / double(Divisor);
+  }
+};
+
+// value = raw / Divisor, in float (as raw / 10.0f)
+template <int64_t Divisor>
+struct Divide_Float
+{
+  static inline double apply(const int64_t& raw)
+  {
+    return float(raw) / float(Divisor);
+  }
+};
+
+// value = raw * K::factor + K::offset
+// K declares static constexpr double factor and offset
+template <class K>
+struct Linear
+{
+  static inline double apply(const int64_t& raw)
+  {
+    return double(raw) * K::factor + K::offset;
+  }
+};
+
+//////////////////////// Signal
+template <int Start, int Length, Signal_Order_t Order = SIGNAL_BE, bool Signed = false, class Conversion = Raw_Value>
+struct Signal
+{
+  static_assert(Length > 0 && Length <= 64, "Signal length must be 1 to 64 bits");
+
+  // Bits numbered from the MSB of byte 0 (big endian) or from the LSB of byte 0 (little endian)
+  static constexpr int msb = Order == SIGNAL_BE ? (Start / 8) * 8 + (7 - Start % 8) : Start + Length - 1;
+  static constexpr int lsb = Order == SIGNAL_BE ? msb + Length - 1 : Start;
+
+  static constexpr int first_byte = Order == SIGNAL_BE ? msb / 8 : lsb / 8;
+  static constexpr int last_byte  = Order == SIGNAL_BE ? lsb / 8 : msb / 8;
+  static constexpr int byte_count = last_byte - first_byte + 1;
+  // Position of the LSB in the integer made by the bytes
+  static constexpr int shift = Order == SIGNAL_BE ? 7 - lsb % 8 : lsb % 8;
+  static constexpr uint64_t mask = Length == 64 ? ~uint64_t(0) : (uint64_t(1) << Length) - 1;
+
+  // Minimum payload size
+  static constexpr int end = last_byte + 1;
+
+  static_assert(byte_count <= 8, "Signal must be contained in 8 consecutive bytes");
+
+  /**
+  * return raw value, sign extended if Signed
+  */
+  static inline int64_t raw(const uint8_t data[])
+  {
+    uint64_t bits = (load<0>(data) >> shift) & mask;
+    if constexpr (Signed && Length < 64)
+      return int64_t(bits << (64 - Length)) >> (64 - Length);
+    else
+      return int64_t(bits);
+  }
+
+  /**
+  * return physical value
+  */
+  static inline double value(const uint8_t data[])
+  {
+    return Conversion::apply(raw(data));
+  }
+
+private:
+  // Bytes first_byte..last_byte as one integer, unrolled at compile time
+  template <int I>
+  static inline uint64_t load(const uint8_t data[])
+  {
+    if constexpr (I == byte_count)
+      return 0;
+    else if constexpr (Order == SIGNAL_BE)
+      return (uint64_t(data[first_byte + I]) << (8 * (byte_count - 1 - I))) | load<I + 1>(data);
+    else
+      return (uint64_t(data[first_byte + I]) << (8 * I)) | load<I + 1>(data);
+  }
+};
+
+//////////////////////// Message
+// Greatest of the values, used for the payload size of a message
+constexpr int signal_max_end()
+{
+  return 0;
+}
+template <class... Ends>
+constexpr int signal_max_end(int first, Ends... ends)
+{
+  int others = signal_max_end(ends...);
+  return first > others ? first : others;
+}
+
+/**
+* Group of signals of one frame, decoded in one pass
+*
+* Example:
+*   typedef Message_Layout<Gyro_X, Gyro_Y, Gyro_Z> Gyro_Frame;
+*   Gyro_Frame::decode(data, gyro->x, gyro->y, gyro->z);
+*/
+template <class... Signals>
+struct Message_Layout
+{
+  static constexpr int count = sizeof...(Signals);
+
+  // Minimum payload size containing all the signals
+  static constexpr int end = signal_max_end(Signals::end...);
+
+  /**
+  * Writes each signal value in the corresponding output
+  */
+  template <class... Outputs>
+  static inline void decode(const uint8_t data[], Outputs&... outputs)
+  {
+    static_assert(sizeof...(Outputs) == count, "One output for each signal");
+    ((outputs = Signals::value(data)), ...);
+  }
+
+  /**
+  * Writes the values in out[0..count)
+  */
+  static inline void decode_array(const uint8_t data[], double out[])
+  {
+    int i = 0;
+    ((out[i++] = Signals::value(data)), ...);
+  }
+};
+
+#endif // CAN_SIGNAL_H
@@ -0,0 +1,588 @@
+#ifndef CANDUMP_H
+#define CANDUMP_H
+
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <fstream>
+#include <stdint.h>
+#include <functional>
+#include <condition_variable>
+
+#include "utils.h"
+
+using namespace std;
+
+/*
+* Binary candump (candump.bin)
+*
+* Candump_Bin_Header_t, the session metadata (the text header of candump.log,
+* metadata_size bytes) and then the frames, one Candump_Record_t each.
+* CAN FD payloads longer than 8 bytes continue in the following records,
+* CANDUMP_RECORD_SIZE payload bytes each (record.extra tells how many).
+* Integers are little endian, as written by the Raspberry and x86.
+*/
+#define CANDUMP_BIN_MAGIC "CANDUMPB"
+#define CANDUMP_BIN_VERSION 1
+
+#define CANDUMP_RECORD_SIZE 24
+// Bus names in the header, a name is a CAN interface (IFNAMSIZ)
+#define CANDUMP_MAX_BUSES 8
+#define CANDUMP_BUS_NAME_SIZE 16
+// Bus of the frames logged without interface name (old text logs)
+#define CANDUMP_NO_BUS 0xFF
+
+// Longest line of candump.log: timestamp, bus name, id with flags, CAN FD flags and 64 bytes
+#define CANDUMP_MAX_LINE 200
+// Text buffered by CandumpTextWriter before writing to the file
+#define CANDUMP_TEXT_BUFFER (1 << 20)
+
+/*
+* Compressed candump (candump.zbin)
+*
+* Same header (magic CANDUMP_ZBIN_MAGIC) and metadata of candump.bin,
+* then the records in blocks, each a Candump_Block_Header_t followed by
+* compressed_size bytes of zlib data. A block holds whole frames and is
+* decoded alone, so a reader seeks to the block of a time reading only it.
+* At the end the index (one Candump_Block_Index_t per block) and
+* Candump_Index_Trailer_t; without them (telemetry stopped by a crash)
+* the reader rebuilds the index from the block headers, up to the last
+* complete block.
+*/
+#define CANDUMP_ZBIN_MAGIC "CANDUMPZ"
+#define CANDUMP_BLOCK_MAGIC "CBLK"
+#define CANDUMP_INDEX_MAGIC "CANDUMPI"
+// Records bytes compressed in a block
+#define CANDUMP_BLOCK_SIZE (64 << 10)
+// A block is closed when its frames span this time, even if not full
+#define CANDUMP_BLOCK_PERIOD_MS 1000
+// zlib level 1 (fastest) ~ 9 (smallest)
+#define CANDUMP_ZLIB_LEVEL 1
+
+/*
+* Segmented candump
+*
+* The log of a run split in files (candump_0000.log, .bin or .zbin), each
+* with the header and the metadata, decoded alone. The manifest lists them
+* with time range, frames and size; it is replaced atomically (written in
+* a temporary file, synced and renamed) when a segment is opened or closed.
+*/
+#define CANDUMP_MANIFEST "candump.manifest.json"
+
+// Record flags, BRS and ESI as in linux/can.h
+#define CANDUMP_FLAG_BRS 0x01
+#define CANDUMP_FLAG_ESI 0x02
+#define CANDUMP_FLAG_FD  0x80
+
+struct Candump_Bin_Header_t
+{
+  char magic[8];
+  uint16_t version;
+  uint16_t record_size;
+  uint16_t bus_count;
+  uint16_t reserved;
+  uint32_t metadata_size;
+  uint32_t reserved2;
+  char buses[CANDUMP_MAX_BUSES][CANDUMP_BUS_NAME_SIZE];
+};
+static_assert(sizeof(Candump_Bin_Header_t) == 152, "candump.bin header layout");
+
+struct Candump_Record_t
+{
+  int64_t timestamp;  // nanoseconds since epoch
+  uint32_t id;        // CAN id as written in the text log
+  uint8_t bus;        // index in the header bus names, CANDUMP_NO_BUS if not logged
+  uint8_t flags;      // CANDUMP_FLAG_*
+  uint8_t len;        // payload bytes
+  uint8_t extra;      // records following with the rest of the payload
+  uint8_t data[8];
+};
+static_assert(sizeof(Candump_Record_t) == CANDUMP_RECORD_SIZE, "candump.bin record layout");
+
+struct Candump_Block_Header_t
+{
+  char magic[4];
+  uint32_t compressed_size;
+  uint32_t raw_size;        // bytes of the records
+  uint32_t frames;
+  int64_t min_timestamp;    // of the frames in the block
+  int64_t max_timestamp;
+};
+static_assert(sizeof(Candump_Block_Header_t) == 32, "candump.zbin block layout");
+
+struct Candump_Block_Index_t
+{
+  uint64_t offset;          // of the block header from the start of the file
+  uint32_t frames;
+  uint32_t reserved;
+  int64_t min_timestamp;
+  int64_t max_timestamp;
+};
+static_assert(sizeof(Candump_Block_Index_t) == 32, "candump.zbin index layout");
+
+struct Candump_Index_Trailer_t
+{
+  char magic[8];
+  uint64_t index_offset;
+  uint32_t blocks;
+  uint32_t reserved;
+};
+static_assert(sizeof(Candump_Index_Trailer_t) == 24, "candump.zbin trailer layout");
+
+enum Candump_Format_t
+{
+  CANDUMP_TEXT,
+  CANDUMP_BINARY,
+  CANDUMP_COMPRESSED,
+};
+
+struct Candump_Segment_t
+{
+  // Name in the folder of the manifest
+  string file;
+  int64_t first_timestamp = 0;
+  int64_t last_timestamp = 0;
+  uint64_t frames = 0;
+  uint64_t bytes = 0;
+  // Closed by the writer, false for the one open when the telemetry crashed or was killed
+  bool complete = false;
+};
+
+struct Candump_Segment_Config_t
+{
+  Candump_Format_t format = CANDUMP_TEXT;
+  // zlib level of CANDUMP_COMPRESSED
+  int level = CANDUMP_ZLIB_LEVEL;
+  // A new segment after these bytes, or this time from its first frame, 0 for no limit.
+  // Both 0: a single file (candump.log, .bin or .zbin) without manifest
+  uint64_t max_bytes = 0;
+  int64_t max_duration_ms = 0;
+};
+
+struct Candump_Block_Stats_t
+{
+  uint64_t frames = 0;
+  uint64_t blocks = 0;
+  uint64_t raw_bytes = 0;
+  // Written in the file, headers and index included
+  uint64_t compressed_bytes = 0;
+  // CPU time of the compression
+  int64_t compress_ns = 0;
+  int64_t worst_block_ns = 0;
+};
+
+/**
+* return records used by a frame of len payload bytes
+*/
+inline int candump_records(const int& len)
+{
+  return len <= 8 ? 1 : 1 + (len - 8 + CANDUMP_RECORD_SIZE - 1) / CANDUMP_RECORD_SIZE;
+}
+
+/**
+* Writes the header of a binary candump
+*
+* @param out stream opened in binary mode
+* @param metadata session header, written back as it is when converting to text
+* @param buses interface names, the index is the bus of the frames (max CANDUMP_MAX_BUSES)
+* return false if there are too many buses or a name is too long
+*/
+bool candump_bin_write_header(ostream& out, const string& metadata, const vector<string>& buses);
+
+/**
+* Writes a frame in a binary candump
+*
+* @param flags CANDUMP_FLAG_*
+* @param len payload bytes (max 64)
+*/
+void candump_bin_write_frame(ostream& out, const int64_t& timestamp, const uint8_t& bus,
+                             const uint32_t& id, const uint8_t& flags, const uint8_t* data, const uint8_t& len);
+
+/**
+* Writes the records of a frame in out, as candump_bin_write_frame
+*
+* @param out at least candump_records(len) * CANDUMP_RECORD_SIZE bytes
+* return bytes written
+*/
+size_t candump_bin_encode_frame(uint8_t* out, const int64_t& timestamp, const uint8_t& bus,
+                                const uint32_t& id, const uint8_t& flags, const uint8_t* data, const uint8_t& len);
+
+/**
+* return true if the file starts with the binary candump magic
+*/
+bool candump_is_binary(const string& path);
+
+/**
+* return true if the file starts with the compressed candump magic
+*/
+bool candump_is_compressed(const string& path);
+
+/**
+* return true if the file is the manifest of a segmented candump
+*/
+bool candump_is_manifest(const string& path);
+
+/**
+* return extension of the files of a format (".log", ".bin", ".zbin")
+*/
+string candump_extension(const Candump_Format_t& format);
+
+/**
+* Reads the segments listed in a manifest
+*
+* @param complete set to false if the writer did not close the log
+* return false if the file can not be read or is not a manifest
+*/
+bool candump_read_manifest(const string& path, vector<Candump_Segment_t>* segments, bool* complete = nullptr);
+
+/**
+* Writes the data of a file (or the entries of a folder) to the storage
+*
+* return false if it can not be opened or synced
+*/
+bool candump_fsync_path(const string& path, const bool& directory);
+
+/**
+* Replaces the manifest atomically: writes path.tmp, syncs it, renames it
+* and syncs the folder, so the rename is on the storage too
+*
+* @param complete the log is closed, no more segments
+* return false if the manifest could not be written
+*/
+bool candump_write_manifest(const string& path, const Candump_Format_t& format,
+                            const vector<Candump_Segment_t>& segments, const bool& complete);
+
+/**
+* Formats the payload of a frame like candump: ID#DATA, CAN FD as ID##<flags>DATA
+*/
+string candump_frame_str(const uint32_t& id, const bool& fd, const uint8_t& flags, const uint8_t* data, const int& len);
+
+/**
+* Formats a frame as a line of candump.log:
+* "(timestamp)\tdevice\tID#DATA\n", "(timestamp) ID#DATA\n" if msg.device is empty
+*
+* @param ns timestamp with nanoseconds instead of microseconds
+*/
+string candump_line(const message& msg, const bool& ns = false);
+
+/**
+* Writes a frame as a line of candump.log, same text of candump_line
+* without allocations: hex digits from a table, timestamp with to_chars
+*
+* @param out at least CANDUMP_MAX_LINE chars
+* @param bus interface name (max CANDUMP_BUS_NAME_SIZE chars), empty for "(timestamp) ID#DATA"
+* return chars written
+*/
+size_t candump_format_line(char* out, const int64_t& timestamp, const string& bus, const uint32_t& id,
+                           const bool& fd, const uint8_t& flags, const uint8_t* data, const int& len);
+
+/**
+* Text candump written through a large buffer: lines are formatted
+* in place and the buffer goes to the stream only when full
+*/
+class CandumpTextWriter
+{
+public:
+  CandumpTextWriter(size_t capacity = CANDUMP_TEXT_BUFFER);
+
+  /**
+  * Sets the stream written by flush, the buffered text of the previous one is dropped
+  */
+  void set_stream(ostream* out);
+
+  void write(const int64_t& timestamp, const string& bus, const uint32_t& id,
+             const bool& fd, const uint8_t& flags, const uint8_t* data, const int& len)
+  {
+    if(buffer.size() - used < CANDUMP_MAX_LINE)
+      flush();
+    const size_t size = candump_format_line(buffer.data() + used, timestamp, bus, id, fd, flags, data, len);
+    used += size;
+    bytes += size;
+  }
+
+  /**
+  * Writes the buffered text in the stream
+  */
+  void flush();
+
+  // Text written since set_stream, buffered included
+  uint64_t get_bytes(){ return bytes; }
+
+private:
+  vector<char> buffer;
+  size_t used = 0;
+  uint64_t bytes = 0;
+  ostream* out = nullptr;
+};
+
+/**
+* Writes a compressed candump (candump.zbin): frames are encoded as
+* binary records in a buffer, compressed with zlib as a block when it
+* is full (or spans CANDUMP_BLOCK_PERIOD_MS) and written in the stream.
+* The compression runs in the thread calling write.
+*/
+class CandumpBlockWriter
+{
+public:
+  /**
+  * @param level zlib compression level (1~9)
+  * @param block_size records bytes of a block
+  */
+  CandumpBlockWriter(int level = CANDUMP_ZLIB_LEVEL, size_t block_size = CANDUMP_BLOCK_SIZE);
+
+  /**
+  * Writes the header of the file in out, the stream is used until close
+  *
+  * return false if there are too many buses or a name is too long
+  */
+  bool open(ostream* out, const string& metadata, const vector<string>& buses);
+
+  void write(const int64_t& timestamp, const uint8_t& bus, const uint32_t& id,
+             const uint8_t& flags, const uint8_t* data, const uint8_t& len);
+
+  /**
+  * Writes the frames buffered as a block
+  */
+  void flush();
+
+  /**
+  * Writes the last block and the index, the stream is not closed
+  */
+  void close();
+
+  bool is_open(){ return out != nullptr; }
+  const Candump_Block_Stats_t& get_stats(){ return stats; }
+
+private:
+  int level;
+  vector<uint8_t> raw;
+  size_t used = 0;
+  vector<char> compressed;
+
+  ostream* out = nullptr;
+  uint64_t offset = 0;
+  vector<Candump_Block_Index_t> index;
+  Candump_Block_Index_t block;
+
+  Candump_Block_Stats_t stats;
+};
+
+/**
+* Writes the candump of a run in one of the formats, split in segments
+* listed in a manifest if a size or time limit is set.
+* A segment is changed before the frame that would exceed a limit.
+*/
+class CandumpSegmentWriter
+{
+public:
+  // Opens a file for writing (fstream, AsyncFile), deleting the stream closes it
+  typedef function<ostream*(const string& path)> Open_File_Fn;
+  // Closes and deletes a stream of Open_File_Fn, done is called once its data is
+  // written in the file, also from another thread (AsyncFile: by its writer thread)
+  typedef function<void(bool written)> File_Closed_Fn;
+  typedef function<void(ostream* out, File_Closed_Fn done)> Close_File_Fn;
+
+  /**
+  * Opens the first segment (or the file) in folder
+  *
+  * @param metadata written at the start of each segment
+  * @param buses interface names, the index is the bus of the frames
+  * @param close_file nullptr flushes and deletes the stream in the calling thread
+  * return false if the first file can not be opened
+  */
+  bool open(const string& folder, const Candump_Segment_Config_t& config, const string& metadata,
+            const vector<string>& buses, Open_File_Fn open_file, Close_File_Fn close_file = nullptr);
+
+  /**
+  * @param bus index in the buses of open
+  * @param flags CANDUMP_FLAG_*
+  */
+  void write(const int64_t& timestamp, const uint8_t& bus, const uint32_t& id,
+             const uint8_t& flags, const uint8_t* data, const uint8_t& len)
+  {
+    if(!opened)
+      return;
+    Candump_Segment_t& segment = current;
+    if(segmented && segment.frames > 0 &&
+       ((config.max_bytes > 0 && segment_bytes() >= config.max_bytes) ||
+        (config.max_duration_ms > 0 && timestamp - segment.first_timestamp >= config.max_duration_ms * 1000000LL)))
+    {
+      rotate();
+      write(timestamp, bus, id, flags, data, len);
+      return;
+    }
+    if(segment.frames == 0)
+      segment.first_timestamp = timestamp;
+    segment.last_timestamp = max(segment.last_timestamp, timestamp);
+    segment.frames ++;
+    // The segment could not be opened
+    if(out == nullptr)
+      return;
+
+    if(config.format == CANDUMP_TEXT)
+      text.write(timestamp, bus < buses.size() ? buses[bus] : no_bus, id, flags & CANDUMP_FLAG_FD, flags, data, len);
+    else if(config.format == CANDUMP_BINARY)
+    {
+      candump_bin_write_frame(*out, timestamp, bus, id, flags, data, len);
+      binary_bytes += candump_records(len) * CANDUMP_RECORD_SIZE;
+    }
+    else
+      blocks.write(timestamp, bus, id, flags, data, len);
+  }
+
+  /**
+  * Closes the last segment, waits for all the segments to be closed
+  * and marks the manifest complete.
+  * Segments are marked complete only once their file is closed and synced,
+  * by the thread closing it (close_file): a rotation does not wait for it
+  */
+  void close();
+
+  bool is_open(){ return opened; }
+  // Of the last log, kept after close (not to be read while open)
+  const vector<Candump_Segment_t>& get_segments(){ return segments; }
+  // Of all the segments, CANDUMP_COMPRESSED
+  Candump_Block_Stats_t get_block_stats();
+  // Segments that could not be opened, written or synced, and manifest writes failed
+  uint64_t get_errors(){ return errors; }
+
+private:
+  // Lists a new segment and opens its file, the manifest is written if write_manifest
+  bool open_segment(const bool& write_manifest);
+  // Ends the current segment, return its stream (nullptr if not open)
+  ostream* end_segment();
+  // Closes the stream of the segment index, it is marked complete when done
+  void close_segment(ostream* segment_out, const size_t& index);
+  // Called when the file of the segment index is written
+  void segment_closed(const size_t& index, const string& file, const bool& written);
+  void rotate();
+  uint64_t segment_bytes();
+
+  Candump_Segment_Config_t config;
+  bool opened = false;
+  bool segmented = false;
+  string folder;
+  string metadata;
+  vector<string> buses;
+  const string no_bus = "";
+  Open_File_Fn open_file;
+  Close_File_Fn close_file;
+
+  ostream* out = nullptr;
+  CandumpTextWriter text;
+  CandumpBlockWriter blocks;
+  uint64_t binary_bytes = 0;
+
+  // Of the open segment, copied in segments when it ends
+  Candump_Segment_t current;
+  // Also updated by the threads closing the segments, with segments_mtx
+  vector<Candump_Segment_t> segments;
+  mutex segments_mtx;
+  // Segments being closed, notified by segment_closed
+  size_t closing = 0;
+  condition_variable closed_cv;
+
+  Candump_Block_Stats_t block_stats;
+  atomic<uint64_t> errors{0};
+};
+
+/**
+* Reads a binary, compressed or text candump one frame at a time.
+* The manifest of a segmented candump is read as one log, a segment
+* after the other.
+* In text logs the lines before the first frame are the metadata,
+* other lines that are not frames are skipped.
+*/
+class CandumpReader
+{
+public:
+  ~CandumpReader();
+
+  /**
+  * @param path candump or manifest of a segmented one
+  * return false if the file (the first segment) can not be opened or the binary header is not valid
+  */
+  bool open(const string& path);
+  void close();
+
+  /**
+  * Reads the next frame, msg.device is the bus name
+  *
+  * return false at the end of the file (or at a truncated record)
+  */
+  bool next(message* msg);
+
+  /**
+  * Moves to the first frame with timestamp >= the given one (nanoseconds),
+  * returned by the next call of next. Segments before the timestamp are
+  * skipped, compressed candumps decode only the blocks from the one of
+  * the timestamp, the others are read from the beginning
+  *
+  * return false if there are no frames after the timestamp
+  */
+  bool seek(const int64_t& timestamp);
+
+  // Records of .bin and .zbin
+  bool is_binary(){ return binary; }
+  bool is_compressed(){ return compressed; }
+  // Blocks of a compressed candump
+  const vector<Candump_Block_Index_t>& get_index(){ return index; }
+  // The index was rebuilt from the block headers, the file was not closed
+  bool is_recovered(){ return recovered; }
+  // Blocks decompressed so far
+  uint64_t get_blocks_read(){ return blocks_read; }
+  // Segments of the manifest, empty for a single file
+  const vector<Candump_Segment_t>& get_segments(){ return segments; }
+  const string& get_metadata(){ return metadata; }
+  // Bus names of the binary header, or seen so far in the text
+  const vector<string>& get_buses(){ return buses; }
+  // Line of the last frame read (text), with the newline
+  const string& get_line(){ return line; }
+  // Text lines after the metadata that are not frames
+  uint64_t get_skipped(){ return skipped; }
+
+private:
+  bool open_file(const string& path);
+  void close_file();
+  // Opens the segment i of the manifest or a following one
+  bool open_segment(size_t i);
+  bool next_text(message* msg);
+  bool next_binary(message* msg);
+  // Record bytes of .bin or of the blocks of .zbin
+  bool read_records(uint8_t* out, const size_t& size);
+  bool load_block(size_t index);
+  void read_index();
+  // Tries a text line as a frame
+  bool parse_line(const string& str, message* msg);
+
+  ifstream in;
+  bool binary = false;
+  bool compressed = false;
+  // Offset of the first frame (record, block or line)
+  uint64_t data_offset = 0;
+  string metadata;
+  vector<string> buses;
+  string line;
+  uint64_t skipped = 0;
+
+  // First frame of a text log, read while looking for the end of the metadata,
+  // or the frame found by seek
+  bool pending = false;
+  message pending_msg;
+
+  vector<Candump_Block_Index_t> index;
+  bool recovered = false;
+  // Next block to decompress, records of the current one
+  size_t next_block = 0;
+  vector<uint8_t> block;
+  size_t block_pos = 0;
+  vector<char> block_data;
+  uint64_t blocks_read = 0;
+
+  vector<Candump_Segment_t> segments;
+  string segments_folder;
+  size_t segment = 0;
+};
+
+#endif // CANDUMP_H
@@ -0,0 +1,128 @@
+#ifndef COLUMN_STORE_H
+#define COLUMN_STORE_H
+
+#include <deque>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <unordered_map>
+
+using namespace std;
+
+// Samples in each chunk of a column
+#define COLUMN_CHUNK_SIZE 512
+
+// Timestamps and values of a column are in separate contiguous arrays
+struct Column_Chunk_t
+{
+  double timestamp[COLUMN_CHUNK_SIZE];
+  double value[COLUMN_CHUNK_SIZE];
+};
+
+struct Column_t
+{
+  string name;
+  deque<Column_Chunk_t*> chunks;
+  // Absolute index of the first sample stored and of the next one
+  uint64_t first;
+  uint64_t end;
+};
+
+/**
+* Columnar store of signal samples (timestamp, value).
+* Each signal is a column addressed by an integer handle, samples are stored
+* in chunks of COLUMN_CHUNK_SIZE so readers get contiguous arrays.
+*
+* Samples are addressed by an absolute index that keeps growing.
+* With max_chunks > 0 each column is a ring: when full the oldest chunk
+* is reused and its samples are lost, first() tells the oldest available.
+*/
+class ColumnStore
+{
+public:
+  /**
+  * @param max_chunks chunks kept for each column, 0 to never discard samples
+  */
+  ColumnStore(size_t max_chunks = 0);
+  ~ColumnStore();
+
+  /**
+  * return handle of a new column, the existing one if the name was already added
+  */
+  int add_column(const string& name);
+
+  /**
+  * return handle of the column, -1 if not found
+  */
+  int find(const string& name) const;
+
+  void push(const int& handle, const double& timestamp, const double& value)
+  {
+    Column_t& column = columns[handle];
+    const size_t offset = column.end % COLUMN_CHUNK_SIZE;
+    if(offset == 0)
+      new_chunk(column);
+    Column_Chunk_t* chunk = column.chunks.back();
+    chunk->timestamp[offset] = timestamp;
+    chunk->value[offset] = value;
+    column.end ++;
+  }
+
+  /**
+  * Pushes count samples copying them in blocks
+  *
+  * @param handle of the column
+  * @param timestamps count values
+  * @param values count values
+  * @param count of samples
+  */
+  void append(const int& handle, const double* timestamps, const double* values, size_t count);
+
+  /**
+  * Gets the samples from index up to the end of its chunk
+  *
+  * @param handle of the column
+  * @param index absolute, between first() and end()
+  * @param timestamps set to the first timestamp
+  * @param values set to the first value
+  * return number of contiguous samples, 0 if index is not stored
+  */
+  size_t span(const int& handle, const uint64_t& index, const double** timestamps, const double** values) const;
+
+  // Absolute index of the oldest sample stored
+  uint64_t first(const int& handle) const
+  {
+    return columns[handle].first;
+  }
+  // Absolute index of the next sample that will be pushed
+  uint64_t end(const int& handle) const
+  {
+    return columns[handle].end;
+  }
+
+  const string& name(const int& handle) const
+  {
+    return columns[handle].name;
+  }
+  size_t size() const
+  {
+    return columns.size();
+  }
+
+  /**
+  * Discards all samples, indexes restart from 0
+  */
+  void clear();
+
+private:
+  void new_chunk(Column_t& column);
+
+  vector<Column_t> columns;
+  unordered_map<string, int> handles;
+
+  size_t max_chunks;
+  // Chunks released by clear, reused before allocating
+  vector<Column_Chunk_t*> free_chunks;
+};
+
+#endif // COLUMN_STORE_H
@@ -0,0 +1,216 @@
+#ifndef DBC_H
+#define DBC_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <string.h>
+#include <unordered_map>
+#include <linux/can.h>
+
+#include "signal_store.h"
+
+using namespace std;
+
+// Number of standard (11 bit) CAN ids
+#define DBC_STD_ID_COUNT 2048
+// Ids in the DBC with this bit set are extended (29 bit)
+#define DBC_EXTENDED_FLAG 0x80000000U
+
+enum Dbc_Value_Type_t
+{
+  DBC_UNSIGNED,
+  DBC_SIGNED,
+  DBC_FLOAT,    // IEEE 754 32 bit (SIG_VALTYPE_ 1)
+  DBC_DOUBLE,   // IEEE 754 64 bit (SIG_VALTYPE_ 2)
+};
+
+/**
+* Precomputed extraction of a signal:
+* the bytes containing it are read as one integer (little or big endian),
+* then shifted and masked.
+*/
+struct Signal_Plan_t
+{
+  uint8_t byte_offset;  // first byte read
+  uint8_t byte_count;   // 1 to 8
+  uint8_t shift;        // position of the LSB in the integer read
+  bool big_endian;      // Motorola byte order
+  uint8_t type;         // Dbc_Value_Type_t
+  uint8_t end;          // byte_offset + byte_count, frames shorter than this skip the signal
+  uint64_t mask;        // length bits
+  uint64_t sign_bit;
+  double factor;
+  double offset;
+};
+
+struct Dbc_Signal_t
+{
+  string name;
+  string unit;
+  int start_bit;
+  int length;
+  bool little_endian;
+  bool is_signed;
+  double factor;
+  double offset;
+  double min;
+  double max;
+
+  bool is_multiplexer;  // M
+  int mux_value;        // mN, -1 if always present
+
+  Signal_Plan_t plan;
+  int handle;           // in the SignalStore
+};
+
+struct Dbc_Message_t
+{
+  uint32_t id;          // without DBC_EXTENDED_FLAG
+  bool extended;
+  string name;
+  int size;
+  vector<Dbc_Signal_t> signals;
+  int mux_signal;       // index in signals, -1 if not multiplexed
+};
+
+/**
+* Extracts the raw value of a signal, sign extended
+*
+* @param plan of the signal
+* @param data payload, at least plan.end bytes
+*/
+inline int64_t dbc_extract_raw(const Signal_Plan_t& plan, const uint8_t data[])
+{
+  const uint8_t* bytes = data + plan.byte_offset;
+  uint64_t raw = 0;
+  if(plan.big_endian)
+  {
+    for(int i = 0; i < plan.byte_count; i++)
+      raw = (raw << 8) | bytes[i];
+  }
+  else
+  {
+    for(int i = plan.byte_count - 1; i >= 0; i--)
+      raw = (raw << 8) | bytes[i];
+  }
+  raw = (raw >> plan.shift) & plan.mask;
+  if(raw & plan.sign_bit)
+    raw |= ~plan.mask;
+  return int64_t(raw);
+}
+
+/**
+* Physical value of a signal from its raw value
+*/
+inline double dbc_raw_to_value(const Signal_Plan_t& plan, const int64_t& raw)
+{
+  double value;
+  if(plan.type == DBC_FLOAT)
+  {
+    uint32_t bits = uint32_t(raw);
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    value = f;
+  }
+  else if(plan.type == DBC_DOUBLE)
+  {
+    uint64_t bits = uint64_t(raw);
+    memcpy(&value, &bits, sizeof(value));
+  }
+  else if(plan.type == DBC_UNSIGNED)
+    value = double(uint64_t(raw));
+  else
+    value = double(raw);
+  return value * plan.factor + plan.offset;
+}
+
+/**
+* CAN database loaded from a DBC file at runtime.
+* Messages (BO_), signals (SG_) with simple multiplexing (M, mN)
+* and value types (SIG_VALTYPE_) are supported, the rest is ignored.
+*
+* Every signal is compiled in a Signal_Plan_t and registered in a
+* SignalStore as "Message.Signal", decoding a frame only writes the store.
+*/
+class Dbc
+{
+public:
+  Dbc();
+
+  /**
+  * Loads a DBC file, can be called more times to merge more files
+  *
+  * @param path of the .dbc file
+  * @param store in which the signals are registered
+  * return number of messages loaded, -1 on error (see get_error)
+  */
+  int load(const string& path, SignalStore* store);
+
+  /**
+  * Decodes a frame in the store of the signals
+  *
+  * @param timestamp_ns of the frame
+  * @param can_id CAN id as in can_frame, with CAN_EFF_FLAG for extended frames
+  * @param data payload
+  * @param size of the payload
+  * return index of the decoded message (see get_message), -1 if the id is not in the database
+  */
+  int decode(const int64_t& timestamp_ns, const uint32_t& can_id, const uint8_t data[], const int& size);
+
+  /**
+  * Standard and extended messages with the same number are different messages
+  *
+  * @param can_id CAN id as in can_frame, with CAN_EFF_FLAG for extended frames
+  * return index of the message with this id, -1 if not in the database
+  */
+  int find(const uint32_t& can_id) const
+  {
+    if(can_id & CAN_EFF_FLAG)
+    {
+      if(extended_index.size() == 0)
+        return -1;
+      auto it = extended_index.find(can_id & CAN_EFF_MASK);
+      return it == extended_index.end() ? -1 : it->second;
+    }
+    // RTR and error frames are not decoded
+    if(can_id < DBC_STD_ID_COUNT)
+      return std_index[can_id];
+    return -1;
+  }
+
+  const Dbc_Message_t& get_message(const int& index) const
+  {
+    return messages[index];
+  }
+  size_t size() const
+  {
+    return messages.size();
+  }
+
+  string get_error() const
+  {
+    return error;
+  }
+
+private:
+  /**
+  * Computes the extraction plan of the signal
+  *
+  * return false if the signal is not in the message payload
+  */
+  bool compile(Dbc_Signal_t* signal, const int& message_size);
+
+  int parse_message_line(const string& line);
+  int parse_signal_line(const string& line, Dbc_Message_t* message);
+  int parse_value_type_line(const string& line);
+
+  vector<Dbc_Message_t> messages;
+  int std_index[DBC_STD_ID_COUNT];
+  unordered_map<uint32_t, int> extended_index;
+
+  SignalStore* store;
+  string error;
+};
+
+#endif // DBC_H
@@ -11,6 +11,8 @@
 #include "rapidjson/writer.h"
 using namespace rapidjson;
 
+#include "frame_assembler.h"
+
 
 #include "devices.pb.h"
 #include <google/protobuf/message.h>
@@ -66,6 +68,56 @@ static std::string BMS_ERRORS[NUM_ERRORS] =
   "ERROR_CAN"
 };
 
+// Events of the State devices, stored as code and arguments.
+// The text is rendered only when displayed (state_event_to_string)
+enum STATE_EVENT_T
+{
+	EVENT_NONE,
+	EVENT_TS_ON,
+	EVENT_TS_OFF,
+	EVENT_REQUEST_TS_ON,
+	EVENT_REQUEST_TO_IDLE,
+	EVENT_REQUEST_TO_RUN,
+	EVENT_REQUEST_TO_SETUP,
+	EVENT_REQUEST_INVERTER_LEFT_ON,
+	EVENT_REQUEST_INVERTER_RIGHT_ON,
+	EVENT_REQUEST_TS_OFF,
+	EVENT_REQUEST_TS_OFF_ERRORS,
+	EVENT_BMS_WARNING,	// arg0 BMS_WARNING_T, arg1 value
+	EVENT_BMS_ERROR,	// arg0 BMS_ERROR_T, arg1 value
+	EVENT_ECU_STATE,	// arg0 ECU_STATE_T, arg1 map
+  NUM_EVENTS
+};
+static const char* STATE_EVENTS[NUM_EVENTS] =
+{
+  "",
+  "TS ON",
+  "TS OFF",
+  "REQUEST TS ON",
+  "REQUEST TO IDLE",
+  "REQUEST TO RUN",
+  "REQUEST TO SETUP",
+  "REQUEST INVERTER LEFT ON",
+  "REQUEST INVERTER RIGHT ON",
+  "REQUEST TS OFF",
+  "REQUEST TS OFF ERRORS",
+  "BMS WARNING",
+  "BMS ERROR",
+  "ECU STATE"
+};
+
+struct State_Event_t
+{
+	uint8_t code = EVENT_NONE;
+	uint8_t arg0 = 0;
+	uint8_t arg1 = 0;
+};
+
+/**
+* Text of the event, for example "WARN_CELL_DROPPING -> 3" or "STATE: RUN Map: 2"
+*/
+std::string state_event_to_string(const State_Event_t& event);
+
 static std::string FIX_STATE[7] =
 {
 	"FIX NOT AVAILABLE OR INVALID",
@@ -84,6 +136,7 @@ static std::string FIX_MODE[3] =
 class Device {
 public:
 	Device(std::string name = "default");
+	virtual ~Device(){}
 
 	int    get_id()  { return id; }
 	std::string get_name(){ return name; }
@@ -102,10 +155,35 @@ public:
 	static std::string get_header(const Descriptor* descriptor, std::string separator);
 
 	std::vector<std::string>   filenames;
-	std::vector<std::fstream*> files;
+	// fstream, or AsyncFile if the vehicle has a writer
+	std::vector<std::ostream*> files;
 
 	long int samples_count = 0;
 	double prev_timestamp = 0.0;
+	// Incremented by the vehicle each time the device is modified
+	uint64_t sequence = 0;
+
+	/**
+	* Devices with numeric fields are stored in columns by the vehicle,
+	* fields are in the same order of get_string and of the protobuf message
+	* return true if the device has numeric fields
+	*/
+	bool has_fields(){ return fields.size() > 0; }
+
+	double* sample_timestamp = nullptr;
+	std::vector<double*> fields;
+	std::vector<std::string> field_names;
+	// Set by the vehicle: column handle of each field, position in its devices
+	// and role used by the tools to find the device ("accel", "gps1"), empty if none
+	std::vector<int> columns;
+	int index = -1;
+	std::string role;
+
+	// Sub-frames of the device, configured by the vehicle for devices sent in more frames
+	FrameAssembler assembler;
+
+protected:
+	void set_fields(double* timestamp, const std::vector<double*>& fields, const std::vector<std::string>& names);
 
 private:
 	int id;
@@ -113,129 +191,10 @@ private:
 	static int instance_count;
 };
 
-class Imu: public Device{
-public:
-	Imu(std::string name): Device(name){};
-
-	virtual std::string get_header(std::string separator);
-	virtual std::string get_string(std::string separator);
-	virtual Document    get_json  ();
-	virtual std::string   get_readable();
-
-	void serialize(devices::Imu* device);
-
-	double timestamp = 0.0;
-	double x = 0.0;
-	double y = 0.0;
-	double z = 0.0;
-	double scale = 0.0;
-};
-
-class Encoder: public Device{
-public:
-	Encoder(std::string name): Device(name){};
-
-	virtual std::string get_header(std::string separator);
-	virtual std::string get_string(std::string separator);
-	virtual Document    get_json  ();
-	virtual std::string   get_readable();
-
-	void serialize(devices::Encoder* device);
-
-	double timestamp = 0.0;
-	double rads = 0.0;
-	double km = 0.0;
-	double rotations = 0.0;
-};
-
-class Steer: public Device{
-public:
-	Steer(std::string name): Device(name){};
-
-	virtual std::string get_header(std::string separator);
-	virtual std::string get_string(std::string separator);
-	virtual Document    get_json  ();
-	virtual std::string   get_readable();
-
-	void serialize(devices::Steer* device);
-
-	double timestamp = 0.0;
-	double angle = 0.0;
-};
-
-class Pedals: public Device{
-public:
-	Pedals(std::string name): Device(name){};
-
-	virtual std::string get_header(std::string separator);
-	virtual std::string get_string(std::string separator);
-	virtual Document    get_json  ();
-	virtual std::string   get_readable();
-
-	void serialize(devices::Pedals* device);
-
-	double timestamp = 0.0;
-	double throttle1 = 0.0;
-	double throttle2 = 0.0;
-	double brake_front = 0.0;
-	double brake_rear = 0.0;
-};
-
-class Inverter: public Device{
-public:
-	Inverter(std::string name): Device(name){};
-
-	virtual std::string get_header(std::string separator);
-	virtual std::string get_string(std::string separator);
-	virtual Document    get_json  ();
-	virtual std::string   get_readable();
-
-	void serialize(devices::Inverter* device);
-
-	double timestamp = 0.0;
-	double temperature = 0.0;
-	double motor_temp = 0.0;
-	double torque = 0.0;
-	double speed = 0.0;
-};
-
-class Bms: public Device{
-public:
-	Bms(std::string name): Device(name){};
-
-	virtual std::string get_header(std::string separator);
-	virtual std::string get_string(std::string separator);
-	virtual Document    get_json  ();
-	virtual std::string   get_readable();
-
-	void serialize(devices::Bms* device);
-
-	double timestamp = 0.0;
-	double temperature = 0.0;
-	double max_temperature = 0.0;
-	double min_temperature = 0.0;
-	double current = 0.0;
-	double voltage = 0.0;
-	double max_voltage = 0.0;
-	double min_voltage = 0.0;
-	double power = 0.0;
-};
-
-class Ecu: public Device{
-public:
-	Ecu(std::string name): Device(name){};
-
-	virtual std::string get_header(std::string separator);
-	virtual std::string get_string(std::string separator);
-	virtual Document    get_json  ();
-	virtual std::string   get_readable();
-
-	void serialize(devices::Ecu* device);
-
-	double timestamp = 0.0;
-	double power_request_left = 0.0;
-	double power_request_right = 0.0;
-};
+// Numeric devices (Imu, Encoder, Steer, Pedals, Inverter, Bms, Ecu, Temperature),
+// generated from codegen/vehicles.json.
+// State and Gps are written by hand ("custom" types of the schema)
+#include "devices_gen.h"
 
 class State: public Device{
 public:
@@ -248,26 +207,16 @@ public:
 
 	void serialize(devices::State* device);
 
-	double timestamp = 0.0;
-	std::string value;
-};
-
-class Temperature: public Device{
-	public:
-	Temperature(std::string name): Device(name){};
-
-	virtual std::string get_header(std::string separator);
-	virtual std::string get_string(std::string separator);
-	virtual Document    get_json  ();
-	virtual std::string   get_readable();
-
-	void serialize(devices::Temperature* device);
+	void set_event(uint8_t code, uint8_t arg0 = 0, uint8_t arg1 = 0){
+		event.code = code;
+		event.arg0 = arg0;
+		event.arg1 = arg1;
+	}
+	// Rendered text of the event
+	std::string get_value(){ return state_event_to_string(event); }
 
 	double timestamp = 0.0;
-	double temps[16];	// 16 channels sensor
-
-	// helper only
-	int msg_count = 0;
+	State_Event_t event;
 };
 
 class Gps: public Device{
@@ -0,0 +1,136 @@
+#ifndef FRAME_ASSEMBLER_H
+#define FRAME_ASSEMBLER_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+using namespace std;
+
+// Sub-frames of a group, one bit each in the received mask
+#define ASSEMBLER_MAX_FRAMES 32
+
+enum Assembler_Mode_t
+{
+  // Every sub-frame updates the device and is a row, the row is partial
+  // while some sub-frame was never received or is older than the timeout (BMS HV, inverters)
+  ASSEMBLER_FRAME,
+  // Sub-frames are staged and the device is updated with the whole group at once:
+  // when all the sub-frames arrived, or as partial when the group is closed
+  // with sub-frames missing (temperatures)
+  ASSEMBLER_GROUP,
+};
+
+// Which sub-frame closes a group not complete (ASSEMBLER_GROUP)
+enum Assembler_Order_t
+{
+  // One already received in the group
+  ASSEMBLER_ANY_ORDER,
+  // Also one with index lower than the previous, sub-frames are sent in order
+  ASSEMBLER_IN_ORDER,
+};
+
+struct Assembler_Config_t
+{
+  // Sub-frames of the group
+  int frames = 1;
+  Assembler_Mode_t mode = ASSEMBLER_FRAME;
+  // Seconds from the first sub-frame of the group (ASSEMBLER_GROUP)
+  // or from the last reception of each sub-frame (ASSEMBLER_FRAME)
+  double timeout = 1.0;
+  Assembler_Order_t order = ASSEMBLER_ANY_ORDER;
+  // Values decoded from each sub-frame (ASSEMBLER_GROUP)
+  int frame_fields = 0;
+};
+
+struct Assembler_Stats_t
+{
+  // Rows with all the sub-frames
+  uint64_t complete = 0;
+  // Rows with sub-frames missing (or expired in ASSEMBLER_FRAME)
+  uint64_t partial = 0;
+
+  // Groups closed by the timeout, or rows with an expired sub-frame
+  uint64_t timeouts = 0;
+  // Groups closed by a sub-frame received twice
+  uint64_t duplicates = 0;
+  // Groups closed by a sub-frame before the previous one (ASSEMBLER_IN_ORDER)
+  uint64_t out_of_order = 0;
+};
+
+/**
+* Assembles the sub-frames (mux values or consecutive ids) of a device.
+* Sub-frames are tracked with a bitmask, so a lost frame is seen
+* instead of mixing two groups.
+* Timeouts are checked when a sub-frame arrives.
+*
+* In ASSEMBLER_GROUP each sub-frame is staged and the whole group is written
+* when it closes: a few ns per frame more than writing the values directly,
+* more with sub-frames out of order (each closes a partial group)
+*/
+class FrameAssembler
+{
+public:
+  /**
+  * Sets the group and the device values written by the assembler
+  *
+  * @param config group
+  * @param timestamp of the device, set to the last sub-frame of each group (ASSEMBLER_GROUP)
+  * @param fields of the device written with a group, config.frames * config.frame_fields (ASSEMBLER_GROUP)
+  * @param partial field of the device, 1.0 if the row has sub-frames missing
+  */
+  void configure(const Assembler_Config_t& config, double* timestamp, const vector<double*>& fields, double* partial);
+
+  /**
+  * Adds a sub-frame
+  *
+  * @param index of the sub-frame in the group
+  * @param timestamp seconds
+  * @param values config.frame_fields decoded values (ASSEMBLER_GROUP)
+  * return true if the device has a new row
+  */
+  bool add(const int& index, const double& timestamp, const double* values = nullptr);
+
+  /**
+  * Drops the group being assembled
+  */
+  void clear();
+
+  bool is_configured(){ return partial != nullptr; }
+  const Assembler_Config_t& get_config(){ return config; }
+  const Assembler_Stats_t& get_stats(){ return stats; }
+  /**
+  * return stats as text, for example "950 complete, 50 partial (95.0%), 10 timeouts, 40 duplicates, 0 out of order"
+  */
+  string get_stats_string();
+
+private:
+  bool add_group(const int& index, const double& timestamp, const double* values);
+  bool add_frame(const int& index, const double& timestamp);
+  // Writes the staged group in the device
+  void emit();
+
+  Assembler_Config_t config;
+  Assembler_Stats_t stats;
+
+  double* timestamp = nullptr;
+  vector<double*> fields;
+  // First field if the fields are consecutive (an array in the device),
+  // written with one copy by emit
+  double* field_array = nullptr;
+  double* partial = nullptr;
+
+  // Mask with all the sub-frames
+  uint32_t full = 0;
+  // Sub-frames of the current group (ASSEMBLER_GROUP), or ever received (ASSEMBLER_FRAME)
+  uint32_t received = 0;
+  int last_index = -1;
+  double group_start = 0.0;
+  double last_timestamp = 0.0;
+  // Values of the group, one block of frame_fields for each sub-frame
+  vector<double> stage;
+  // Last reception of each sub-frame (ASSEMBLER_FRAME)
+  double received_at[ASSEMBLER_MAX_FRAMES] = {};
+};
+
+#endif // FRAME_ASSEMBLER_H
@@ -19,6 +19,7 @@
 #include "utils.h"
 #include "serial.h"
 #include "console.h"
+#include "async_writer.h"
 
 #include "rapidjson/document.h"
 #include "rapidjson/prettywriter.h"
@@ -47,6 +48,8 @@ public:
   void SetCallback(void (*f)(int, string));
   void SetCallback(std::function<void(int, string)> function);
   void SetMode(int mode = 0);
+  // The .log file is written by the thread of writer, nullptr writes it directly
+  void SetWriter(AsyncWriter* writer);
 
   void StartLogging();
   void StopLogging();
@@ -57,6 +60,8 @@ public:
 
   bool IsRunning();
 
+  pthread_t GetThreadHandle();
+
 private:
 
   void Run();
@@ -66,7 +71,9 @@ private:
 
   double GetTimestamp();
 
-  std::ofstream* m_GPS;
+  // ofstream, or AsyncFile with a writer
+  std::ostream* m_GPS;
+  AsyncWriter* m_Writer = nullptr;
   std::ofstream* m_StatFile;
 
   string m_FName;
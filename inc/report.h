@@ -92,6 +92,15 @@ struct Point_ST
   double y;
 };
 
+// Vectors of sensor_data filled with the rows of one device
+struct Report_Columns_t
+{
+  vector<double>* timestamp = nullptr;
+  // One for each device field, nullptr if not plotted
+  vector<vector<double>*> fields;
+  vector<double>* kmh = nullptr;
+};
+
 class Report
 {
 public:
@@ -100,7 +109,17 @@ public:
     instances ++;
   };
 
-  void AddDeviceSample(Chimera* chim, Device* device);
+  /**
+  * Adds the rows of the devices stored in the vehicle since the last read of reader
+  *
+  * @param vehicle with the devices
+  * @param reader id returned by vehicle->add_store_reader
+  */
+  void AddStoredRows(Vehicle* vehicle, const int& reader);
+  /**
+  * Adds one sample of the devices not stored in columns (gps, by role)
+  */
+  void AddDeviceSample(Device* device);
   void Generate(const string& path, const can_stat_json& stat);
   void Clean(int);
   void Filter(const vector<double> &in, vector<double>* out, int window=10);
@@ -120,6 +139,8 @@ private:
   Delta_ST min_voltage_drop;
   Delta_ST total_voltage_drop;
   Delta_ST distance_travelled;
+  int discard_distance_count = 0;
+  int discard_voltage_count = 0;
   
   double lat_0 = -1.0;
   double long_0 = -1.0;
@@ -128,6 +149,10 @@ private:
   static int instances;
   int id;
 private:
+  string SensorName(Device* device);
+  bool IsPlotted(const string& sensor, const string& field);
+  void AddRows(const string& sensor, Report_Columns_t& columns, const Row_Batch_t& batch);
+
   void lla2xyz(const double& lat, const double& lng, const double& alt, const double& lat0, const double& lng0, double&, double&, double&);
 
   string _Odometers(const string& fname);
@@ -0,0 +1,91 @@
+#ifndef SIGNAL_STORE_H
+#define SIGNAL_STORE_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <unordered_map>
+
+using namespace std;
+
+// Value of a signal as it was in the last decoded frame
+struct Signal_Value_t
+{
+  int64_t timestamp;  // nanoseconds
+  int64_t raw;        // sign extended raw bits
+  double  value;      // raw * factor + offset
+  uint32_t count;     // times it was updated
+};
+
+/**
+* Latest values of signals, addressed by integer handles.
+* Signals are added once at startup, while decoding only the
+* preallocated values are written.
+*/
+class SignalStore
+{
+public:
+  /**
+  * Adds a signal, names must be unique
+  *
+  * return handle of the signal, the existing one if the name was already added
+  */
+  int add(const string& name, const string& unit = "")
+  {
+    auto it = handles.find(name);
+    if(it != handles.end())
+      return it->second;
+
+    int handle = values.size();
+    values.push_back({0, 0, 0.0, 0});
+    names.push_back(name);
+    units.push_back(unit);
+    handles.insert({name, handle});
+    return handle;
+  }
+
+  /**
+  * return handle of the signal, -1 if not found
+  */
+  int find(const string& name) const
+  {
+    auto it = handles.find(name);
+    return it == handles.end() ? -1 : it->second;
+  }
+
+  void set(const int& handle, const int64_t& timestamp, const int64_t& raw, const double& value)
+  {
+    Signal_Value_t& v = values[handle];
+    v.timestamp = timestamp;
+    v.raw = raw;
+    v.value = value;
+    v.count ++;
+  }
+
+  const Signal_Value_t& get(const int& handle) const
+  {
+    return values[handle];
+  }
+
+  const string& name(const int& handle) const
+  {
+    return names[handle];
+  }
+  const string& unit(const int& handle) const
+  {
+    return units[handle];
+  }
+
+  size_t size() const
+  {
+    return values.size();
+  }
+
+private:
+  vector<Signal_Value_t> values;
+  vector<string> names;
+  vector<string> units;
+  unordered_map<string, int> handles;
+};
+
+#endif // SIGNAL_STORE_H
@@ -0,0 +1,164 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Lock-free ring buffer for one producer thread and one consumer thread.
+ * The storage is allocated once in the constructor,
+ * push and pop never allocate nor block.
+ *
+ * When the ring is full the items that do not fit are discarded
+ * and counted as overflows.
+*/
+template <class T>
+class SpscRing
+{
+public:
+  /**
+  * @param capacity number of items, rounded up to a power of two
+  */
+  SpscRing(size_t capacity)
+  {
+    size_t size = 1;
+    while(size < capacity)
+      size <<= 1;
+    buffer.resize(size);
+    mask = size - 1;
+
+    head.store(0);
+    tail.store(0);
+    reset_stat();
+  }
+
+  /**
+  * Producer only
+  * Copies count items in the ring
+  *
+  * return number of items pushed, the others are counted as overflow
+  */
+  size_t push(const T* items, size_t count)
+  {
+    size_t h = head.load(std::memory_order_relaxed);
+    size_t t = tail.load(std::memory_order_acquire);
+    size_t used = h - t;
+    size_t space = buffer.size() - used;
+
+    size_t n = count < space ? count : space;
+    for(size_t i = 0; i < n; i++)
+      buffer[(h + i) & mask] = items[i];
+    head.store(h + n, std::memory_order_release);
+
+    if(n < count)
+      overflow_count.fetch_add(count - n, std::memory_order_relaxed);
+    if(used + n > high_water.load(std::memory_order_relaxed))
+      high_water.store(used + n, std::memory_order_relaxed);
+    return n;
+  }
+
+  /**
+  * Producer only
+  * Number of items that can be written in place with slot before publish
+  */
+  size_t free_slots()
+  {
+    return buffer.size() - (head.load(std::memory_order_relaxed) - tail.load(std::memory_order_acquire));
+  }
+
+  /**
+  * Producer only
+  * return the i-th item after the published ones, i must be < free_slots()
+  */
+  T* slot(size_t i)
+  {
+    return &buffer[(head.load(std::memory_order_relaxed) + i) & mask];
+  }
+
+  /**
+  * Producer only
+  * Makes the first count slots visible to the consumer
+  *
+  * @param dropped items that did not fit in the free slots, counted as overflow
+  */
+  void publish(size_t count, size_t dropped = 0)
+  {
+    size_t h = head.load(std::memory_order_relaxed);
+    size_t used = h - tail.load(std::memory_order_acquire) + count;
+    head.store(h + count, std::memory_order_release);
+
+    if(dropped > 0)
+      overflow_count.fetch_add(dropped, std::memory_order_relaxed);
+    if(used > high_water.load(std::memory_order_relaxed))
+      high_water.store(used, std::memory_order_relaxed);
+  }
+
+  /**
+  * Consumer only
+  * Copies at most max items out of the ring
+  *
+  * return number of items popped
+  */
+  size_t pop(T* items, size_t max)
+  {
+    size_t t = tail.load(std::memory_order_relaxed);
+    size_t h = head.load(std::memory_order_acquire);
+    size_t available = h - t;
+
+    size_t n = max < available ? max : available;
+    for(size_t i = 0; i < n; i++)
+      items[i] = buffer[(t + i) & mask];
+    tail.store(t + n, std::memory_order_release);
+    return n;
+  }
+
+  /**
+  * Consumer only
+  * Discards all items in the ring
+  */
+  void clear()
+  {
+    tail.store(head.load(std::memory_order_acquire), std::memory_order_release);
+  }
+
+  size_t size()
+  {
+    return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+  }
+  size_t capacity()
+  {
+    return buffer.size();
+  }
+
+  // Max number of items stored at the same time
+  size_t high_water_mark()
+  {
+    return high_water.load(std::memory_order_relaxed);
+  }
+  // Number of items discarded because the ring was full
+  uint64_t overflows()
+  {
+    return overflow_count.load(std::memory_order_relaxed);
+  }
+  void reset_stat()
+  {
+    high_water.store(0);
+    overflow_count.store(0);
+  }
+
+private:
+  std::vector<T> buffer;
+  size_t mask;
+
+  // head is written by the producer, tail by the consumer,
+  // kept in different cache lines
+  alignas(64) std::atomic<size_t> head;
+  alignas(64) std::atomic<size_t> tail;
+
+  alignas(64) std::atomic<size_t> high_water;
+  std::atomic<uint64_t> overflow_count;
+};
+
+#endif // SPSC_RING_H
@@ -7,11 +7,14 @@
 #include <cstdlib>
 #include <iomanip>
 #include <vector>
+#include <map>
 #include <sstream>
 #include <fstream>
 #include <string.h>
 #include <iostream>
 
+#include <sched.h>
+#include <pthread.h>
 
 #include <filesystem>
 
@@ -21,10 +24,13 @@ using namespace filesystem;
 
 
 struct message {
-  double timestamp;
-  int id;
+  int64_t timestamp;  // nanoseconds
+  string device;      // CAN interface, empty if not in the log
+  int id;             // can_id, extended ids with CAN_EFF_FLAG
   int size;
-  uint8_t data[8];
+  bool fd;            // CAN FD frame (ID##<flags><payload>)
+  uint8_t flags;      // CAN FD flags (BRS, ESI)
+  uint8_t data[64];
 };
 struct gps_message
 {
@@ -41,6 +47,29 @@ void get_lines(string filename, vector<string>* lines);
 */
 double get_timestamp();
 
+/**
+* Gets current timestamp in nanoseconds since epoch
+*/
+int64_t get_timestamp_ns();
+
+/**
+* Converts a nanoseconds timestamp in seconds
+*/
+double ns_to_seconds(const int64_t& timestamp);
+
+/**
+* Parses a timestamp in seconds written as decimal string ("1620742552.534499")
+* without going through floating point
+*
+* return nanoseconds
+*/
+int64_t parse_timestamp_ns(const string& str);
+
+/**
+* Formats a nanoseconds timestamp in seconds with microseconds precision ("1620742552.534499")
+*/
+string timestamp_ns_to_string(const int64_t& timestamp);
+
 vector<string> get_all_files(string path, string extension="*");
 
 vector<string> get_gps_from_files(vector<string> files);
@@ -79,4 +108,39 @@ int empty_fields(const vector<string>& vec, const vector<int>& indeces);
 */
 string get_hex(int num, int zeros);
 
+/**
+* Parses a list of cpus like "0-2,5"
+*
+* @param list cpu list
+* @param set filled with the cpus in the list
+* return false if the list is malformed or empty
+*/
+bool parse_cpu_list(const string& list, cpu_set_t* set);
+
+/**
+* Formats a cpu set as list ("0-2,5")
+*/
+string cpu_list_str(const cpu_set_t& set);
+
+/**
+* Pins a thread to a set of cpus
+*
+* return 0 on success, error number otherwise
+*/
+int set_thread_affinity(pthread_t thread, const cpu_set_t& set);
+
+/**
+* Sets the scheduling of a thread
+*
+* @param priority 1~99 uses SCHED_FIFO (needs CAP_SYS_NICE), 0 uses SCHED_OTHER
+* return 0 on success, error number otherwise
+*/
+int set_thread_priority(pthread_t thread, int priority);
+
+/**
+* Returns affinity and scheduling actually applied to a thread
+* like "cpus 0-3 SCHED_FIFO 50"
+*/
+string thread_placement_str(pthread_t thread);
+
 #endif // UTILS_H
@@ -2,12 +2,16 @@
 #define VEHICLE_H
 
 #include <vector>
+#include <bitset>
 #include <exception>
 #include <unordered_map>
 
 #include "utils.h"
 #include "devices.h"
+#include "vehicle_gen.h"
 #include "ubxparser.h"
+#include "async_writer.h"
+#include "column_store.h"
 #include "devices.pb.h"
 #include <google/protobuf/text_format.h>
 #include <google/protobuf/util/json_util.h>
@@ -15,21 +19,164 @@ using namespace google::protobuf;
 using namespace google::protobuf::util;
 using namespace std;
 
-class Chimera{
+// Number of standard (11 bit) CAN ids
+#define CAN_STD_ID_COUNT 2048
+// CAN buses of a vehicle, each with its own dispatch table: the same id
+// on two buses is two different frames. The bus of a frame is the
+// position of its interface in can_devices (0 for single bus logs)
+#define VEHICLE_MAX_BUSES 4
+// Entries of a mux sub-table, one for each value of the first payload byte
+#define CAN_MUX_COUNT 256
+// Chunks of COLUMN_CHUNK_SIZE samples kept for each column of the sample store,
+// readers must read more often than this or the oldest rows are lost
+#define VEHICLE_STORE_CHUNKS 16
+// Numeric fields of the largest device (Temperature, 16 channels and partial)
+#define DEVICE_MAX_FIELDS 17
+// Devices of a vehicle, one bit each in a Device_Set_t
+#define VEHICLE_MAX_DEVICES 64
+
+// Seconds after which a frame of a device sent in more frames is old,
+// the rows are partial until it is received again (see FrameAssembler)
+#define BMS_HV_FRAMES_TIMEOUT 1.0
+#define INVERTER_FRAMES_TIMEOUT 1.0
+// Seconds from the first frame of a temperature group to its last one
+#define TEMPERATURE_GROUP_TIMEOUT 0.5
+
+// Frames of BMS HV (0xAA mux), index in its assembler
+enum Bms_Hv_Frame_t{
+  BMS_HV_FRAME_VOLTAGE,
+  BMS_HV_FRAME_CURRENT,
+  BMS_HV_FRAME_TEMPERATURE,
+  BMS_HV_FRAME_COUNT
+};
+// Frames of each inverter (0x181, 0x182 mux), filtered and unfiltered speed are the same
+enum Inverter_Frame_t{
+  INVERTER_FRAME_TORQUE,
+  INVERTER_FRAME_TEMPERATURE,
+  INVERTER_FRAME_MOTOR_TEMP,
+  INVERTER_FRAME_SPEED,
+  INVERTER_FRAME_COUNT
+};
+
+// One bit for each device, indexed by Device::index
+typedef bitset<VEHICLE_MAX_DEVICES> Device_Set_t;
+static_assert(CHIMERA_DEVICE_COUNT <= VEHICLE_MAX_DEVICES, "more devices than VEHICLE_MAX_DEVICES in codegen/vehicles.json");
+static_assert(FENICE_DEVICE_COUNT <= VEHICLE_MAX_DEVICES, "more devices than VEHICLE_MAX_DEVICES in codegen/vehicles.json");
+
+class Vehicle;
+struct Decoder_t;
+
+/**
+* Decodes one frame into the device of the decoder
+*
+* @param vehicle containing the devices
+* @param decoder table entry, with device and argument
+* @param timestamp in seconds
+* @param data payload, at least 8 bytes
+* @param size of the payload
+* @param modified the bits of the devices modified are set here
+*/
+typedef void (*Decode_Fn)(Vehicle* vehicle, const Decoder_t& decoder, const double& timestamp, const uint8_t data[], const int& size, Device_Set_t& modified);
+
+// Frames that BatchDecoder can decode in batches, with the layout of vehicle_signals.h
+enum Decode_Batch_t{
+  DECODE_SINGLE,
+  // Imu_Frame into an Imu, arg is the scale
+  DECODE_BATCH_IMU,
+  // Temperature_Frame (CAN FD blocks too) into a Temperature, arg is the frame of the group
+  DECODE_BATCH_TEMPERATURE,
+};
+
+struct Decoder_t{
+  Decode_Fn decode = nullptr;
+  Device* device = nullptr;
+  // Decoder specific (scale, block index, string index...)
+  int arg = 0;
+  Decode_Batch_t batch = DECODE_SINGLE;
+};
+
+// Contiguous rows of one device read from the sample store
+struct Row_Batch_t{
+  size_t count = 0;
+  const double* timestamp = nullptr;
+  // Field j of row i is fields[j][i], fields in the order of the device
+  const double* fields[DEVICE_MAX_FIELDS];
+};
+
+struct Dispatch_Entry_t{
+  // Used when the id has no mux byte
+  Decoder_t frame;
+  // CAN_MUX_COUNT decoders indexed by data[0], nullptr if not multiplexed
+  Decoder_t* mux = nullptr;
+};
+
+/**
+* Devices, dispatch table, sample store and protobuf message of a vehicle.
+* Everything used per frame is here and not virtual, each vehicle
+* (VehicleImpl) only fills the devices and the dispatch table.
+* Tools get a vehicle with new_vehicle and find its devices by role
+*/
+class Vehicle{
 public:
-  Chimera();
-  ~Chimera();
+  virtual ~Vehicle();
+
+  /**
+  * return name of the vehicle, as the protobuf message (Chimera, Fenice)
+  */
+  const string& get_name(){ return name; }
 
   /**
-  * Fills the sensor values basing on ids and payload
+  * return device with this role in codegen/vehicles.json ("accel", "gps1"...), nullptr if none
+  */
+  Device* find_device(const string& role);
+
+  /**
+  * Fills the sensor values basing on bus, ids and payload
+  * The decoder is found in the dispatch table of the bus by id and, for multiplexed ids, by data[0].
+  * The sequence of each modified device is incremented and the device is
+  * marked as changed for every reader (see consume_changes)
   *
-  * @param timestamp value that will be setted to the sensor (can be current timestamp or the one in the logfile)
+  * @param timestamp_ns value in nanoseconds that will be setted to the sensor (can be current timestamp or the one in the logfile)
+  * @param bus of the vehicle the frame was received on
   * @param id integer defining CAN message id
-  * @param data is the message payload
-  * @param size of the payload
-  * return vector containing pointers to devices modified with this message
+  * @param data is the message payload, at least 8 bytes
+  * @param size of the payload (up to 64 for CAN FD)
+  * return devices modified with this message, valid until the next call
   */
-  void parse_message(const double& timestamp, const int &id, const uint8_t data[], const int &size, vector<Device*>&);
+  const Device_Set_t& parse_message(const int64_t& timestamp_ns, const uint8_t& bus, const int &id, const uint8_t data[], const int &size);
+
+  /**
+  * Calls fn(Device*) for each device in the set, in the order of devices
+  */
+  template<class Fn>
+  void for_each_device(const Device_Set_t& set, Fn fn){
+    uint64_t bits = set.to_ullong();
+    while(bits != 0)
+    {
+      fn(devices[__builtin_ctzll(bits)]);
+      bits &= bits - 1;
+    }
+  }
+
+  /**
+  * Returns if parse_message decodes the id on this bus,
+  * used to skip the parsing of frames that would not modify any device
+  *
+  * @param bus of the vehicle
+  * @param id CAN message id (standard, 11 bit)
+  */
+  bool is_known_id(const uint8_t& bus, const int& id){
+    return bus < VEHICLE_MAX_BUSES && id >= 0 && id < CAN_STD_ID_COUNT && known_ids[bus][id];
+  }
+
+  /**
+  * return decoder of the frames with this id on this bus without mux byte, nullptr if none
+  */
+  const Decoder_t* get_decoder(const uint8_t& bus, const int& id){
+    if(!is_known_id(bus, id) || dispatch[bus][id].mux != nullptr || dispatch[bus][id].frame.decode == nullptr)
+      return nullptr;
+    return &dispatch[bus][id].frame;
+  }
 
   int parse_gps(Gps* gps_device, const double& timestamp, string& line);
 
@@ -57,6 +204,12 @@ public:
   */
   void close_files(int index);
 
+  /**
+  * Files opened after this are written by the thread of writer,
+  * nullptr (default) writes them directly
+  */
+  void set_writer(AsyncWriter* writer_){ writer = writer_; }
+
   /**
   * Writes CSV header to the index of the file
   *
@@ -64,13 +217,130 @@ public:
   */
   void write_all_headers(int index);
 
+  /**
+  * Appends the values of the modified devices to the columns of the sample store.
+  * Devices without numeric fields (states, gps) are not stored,
+  * they are still written and serialized one sample at a time
+  *
+  * @param modified as returned by parse_message
+  */
+  void store_samples(const Device_Set_t& modified){
+    for_each_device(modified, [this](Device* device){
+      const double& timestamp = *device->sample_timestamp;
+      for(size_t i = 0; i < device->columns.size(); i++)
+        store.push(device->columns[i], timestamp, *device->fields[i]);
+    });
+  }
+
+  /**
+  * Appends rows decoded outside of parse_message (batch decoders) to the sample store.
+  * The device keeps the values of the last row, its sequence is incremented
+  * by the number of rows and it is marked as changed for every reader
+  *
+  * @param device with numeric fields
+  * @param batch one array for each field of the device
+  */
+  void store_rows(Device* device, const Row_Batch_t& batch);
+
+  /**
+  * Adds a reader of the sample store, every reader gets each stored row once
+  * and has its own set of devices changed since its last consume_changes
+  * return reader id
+  */
+  int add_store_reader();
+  /**
+  * Moves the reader to the end of the store, stored rows are not read
+  * and its changes are cleared
+  */
+  void skip_stored(const int& reader);
+  /**
+  * Lets each reader handle changes at its own pace, without per frame work
+  *
+  * @param reader id returned by add_store_reader
+  * return devices modified since the last call for this reader
+  */
+  Device_Set_t consume_changes(const int& reader){
+    Device_Set_t changes = reader_changes[reader];
+    reader_changes[reader].reset();
+    return changes;
+  }
+  /**
+  * return number of rows overwritten in the store before this reader read them
+  */
+  uint64_t get_lost_rows(const int& reader){
+    return lost_rows[reader];
+  }
+
+  /**
+  * return timestamp of the next row of the device for this reader, -1 if none
+  */
+  double next_stored_timestamp(const int& reader, Device* device);
+
+  /**
+  * Reads the rows of the device stored since the last read of this reader
+  *
+  * @param reader id returned by add_store_reader
+  * @param device must have numeric fields
+  * @param on_batch called with each Row_Batch_t, rows are contiguous in memory
+  * return number of rows read
+  */
+  template<class Fn>
+  size_t read_rows(const int& reader, Device* device, Fn on_batch){
+    if(!device->has_fields())
+      return 0;
+
+    uint64_t& next = reader_cursors[reader][device->index];
+    const int& first_column = device->columns[0];
+    const uint64_t first = store.first(first_column);
+    if(next < first)
+    {
+      lost_rows[reader] += first - next;
+      next = first;
+    }
+
+    // All the columns of a device are pushed together,
+    // so their chunks have the same boundaries
+    const uint64_t end = store.end(first_column);
+    const double* timestamps;
+    Row_Batch_t batch;
+    size_t read = 0;
+    while(next < end)
+    {
+      batch.count = store.span(first_column, next, &batch.timestamp, &batch.fields[0]);
+      for(size_t i = 1; i < device->columns.size(); i++)
+        store.span(device->columns[i], next, &timestamps, &batch.fields[i]);
+      on_batch(batch);
+      next += batch.count;
+      read += batch.count;
+    }
+    return read;
+  }
+
+  /**
+  * Writes the rows stored since the last read in the file index of each device.
+  * Rows are formatted as get_string(",")
+  *
+  * @param reader id returned by add_store_reader
+  * @param index of the files of each device
+  */
+  void write_stored_rows(const int& reader, int index);
+
+  /**
+  * Adds the rows stored since the last read to the serialized object
+  *
+  * @param reader id returned by add_store_reader
+  * @param min_period seconds between two rows of the same device, 0 to keep all
+  */
+  void serialize_stored(const int& reader, const double& min_period = 0.0);
+
   /**
   * Sets all the values in the serialized object
   */
   void serialize();
 
   /*
-  * Serialize only the pointer of the device passed
+  * Serialize only the pointer of the device passed,
+  * uses the generated serializer of its index
   */
   void serialize_device(Device*);
 
@@ -80,7 +350,7 @@ public:
   * @param out serialized string in output
   */
   void serialized_to_string(string *out){
-    chimera_proto->SerializeToString(out);
+    vehicle_proto->SerializeToString(out);
   }
 
   /**
@@ -89,7 +359,7 @@ public:
   * @param outout string
   */
   void serialized_to_text(string *out){
-    TextFormat::PrintToString(*chimera_proto, out);
+    TextFormat::PrintToString(*vehicle_proto, out);
   }
   /**
   * JSON readable string of the serialized object
@@ -97,7 +367,7 @@ public:
   * @param outout string
   */
   void serialized_to_json(string *out){
-    MessageToJsonString(*chimera_proto, out);
+    MessageToJsonString(*vehicle_proto, out);
   }
 
   /**
@@ -105,56 +375,145 @@ public:
   *
   */
   void clear_serialized(){
-    chimera_proto->Clear();
+    vehicle_proto->Clear();
   }
 
-  Imu* accel;
-  Imu* gyro;
+  /**
+  * Vector containing all the devices
+  */
+  vector<Device*> devices;
 
-  Encoder* encoder_left;
-  Encoder* encoder_right;
+  vector<string> proto_names;
+  vector<Message *> proto_messages;
+  unordered_map<string, string> device_headers;
+
+protected:
+  /**
+  * @param name of the vehicle and of its protobuf message
+  * @param proto message of the vehicle, owned by the vehicle
+  * @param serializers generated for the vehicle, indexed by Device::index
+  */
+  Vehicle(const string& name, Message* proto, const Serialize_Device_Fn* serializers);
+
+  /**
+  * Appends a device, in the order of the generated X macro of the vehicle
+  *
+  * @param device owned by the vehicle
+  * @param field of the vehicle message
+  * @param role of the device, can be empty
+  */
+  void add_device(Device* device, const string& field, const string& role);
 
-  Bms* bms_lv;
-  Bms* bms_hv;
+  /**
+  * Decoders added after this are of the frames received on this bus, 0 by default
+  */
+  void set_decoder_bus(const uint8_t& bus){ decoder_bus = bus; }
 
-  Inverter* inverter_left;
-  Inverter* inverter_right;
+  /**
+  * Adds the decoder of all the frames with this id
+  */
+  void add_decoder(const int& id, Decode_Fn decode, Device* device, int arg = 0, Decode_Batch_t batch = DECODE_SINGLE);
+  /**
+  * Adds the decoder of the frames with this id and data[0] == mux
+  */
+  void add_mux_decoder(const int& id, const uint8_t& mux, Decode_Fn decode, Device* device, int arg = 0);
 
-  Pedals* pedal;
-  Steer* steer;
+private:
+  string name;
+  // Writes the csv files if not nullptr
+  AsyncWriter* writer = nullptr;
+  // protobuffer object
+  Message* vehicle_proto;
+  const Serialize_Device_Fn* serializers;
+  // Repeated field of vehicle_proto of each device
+  vector<const FieldDescriptor*> proto_fields;
+  // Message field of each numeric field of each device, used by serialize_stored
+  vector<vector<const FieldDescriptor*>> proto_columns;
 
-  State* ecu_state;
-  State* bms_hv_state;
-  State* steering_wheel_state;
+  // Samples of the devices with numeric fields, one column per field
+  ColumnStore store;
+  // For each reader the next row of each device and the last serialized timestamp
+  vector<vector<uint64_t>> reader_cursors;
+  vector<vector<double>> serialized_timestamps;
+  vector<uint64_t> lost_rows;
+  // For each reader the devices changed since its last consume_changes
+  vector<Device_Set_t> reader_changes;
+  // Returned by parse_message
+  Device_Set_t modified_devices;
 
-  Ecu* ecu;
+  // For each bus one entry for each standard CAN id, filled in the constructor
+  Dispatch_Entry_t dispatch[VEHICLE_MAX_BUSES][CAN_STD_ID_COUNT];
+  // Allocated mux sub-tables
+  vector<Decoder_t*> mux_tables;
+  // Bus of the decoders being added
+  uint8_t decoder_bus = 0;
 
-  Temperature* temp_fl;
-  Temperature* temp_fr;
-  Temperature* temp_rl;
-  Temperature* temp_rr;
+  // For each bus one bit for each standard CAN id decoded by parse_message
+  bitset<CAN_STD_ID_COUNT> known_ids[VEHICLE_MAX_BUSES];
+};
 
-  Gps* gps1;
-  Gps* gps2;
+/**
+* Base of each vehicle, V is the vehicle itself.
+* Decoders are written for V (its members are the devices) and each one
+* is instantiated in a Decode_Fn that casts the vehicle,
+* so parse_message makes one call through the table and no virtual call
+*/
+template<class V>
+class VehicleImpl: public Vehicle{
+public:
+  typedef void (*Fn)(V* vehicle, const Decoder_t& decoder, const double& timestamp, const uint8_t data[], const int& size, Device_Set_t& modified);
 
-  /**
-  * Vector containing all the devices
-  */
-  vector<Device*> devices;
+protected:
+  VehicleImpl(const string& name, Message* proto, const Serialize_Device_Fn* serializers): Vehicle(name, proto, serializers){}
 
-  vector<string> proto_names;
-  vector<Message *> proto_messages;
-  unordered_map<string, string> device_headers;
+  template<Fn decode>
+  void add_decoder(const int& id, Device* device, int arg = 0, Decode_Batch_t batch = DECODE_SINGLE){
+    Vehicle::add_decoder(id, &decode_as<decode>, device, arg, batch);
+  }
+  template<Fn decode>
+  void add_mux_decoder(const int& id, const uint8_t& mux, Device* device, int arg = 0){
+    Vehicle::add_mux_decoder(id, mux, &decode_as<decode>, device, arg);
+  }
 
 private:
-  // protobuffer object
-  devices::Chimera *chimera_proto;
+  template<Fn decode>
+  static void decode_as(Vehicle* vehicle, const Decoder_t& decoder, const double& timestamp, const uint8_t data[], const int& size, Device_Set_t& modified){
+    decode(static_cast<V*>(vehicle), decoder, timestamp, data, size, modified);
+  }
 };
 
-class Fenice{
+class Chimera: public VehicleImpl<Chimera>{
+public:
+  Chimera();
 
+  // One member for each device of Chimera in codegen/vehicles.json
+#define CHIMERA_DEVICE_MEMBER(type, member, name, role) type* member;
+  CHIMERA_DEVICES(CHIMERA_DEVICE_MEMBER)
+#undef CHIMERA_DEVICE_MEMBER
 };
 
+/**
+* Only the GPS for now, the decoders of its CAN frames
+* are added in the constructor as for Chimera
+*/
+class Fenice: public VehicleImpl<Fenice>{
+public:
+  Fenice();
+
+  // One member for each device of Fenice in codegen/vehicles.json
+#define FENICE_DEVICE_MEMBER(type, member, name, role) type* member;
+  FENICE_DEVICES(FENICE_DEVICE_MEMBER)
+#undef FENICE_DEVICE_MEMBER
+};
+
+/**
+* Vehicle selected in the config of the tools
+*
+* @param name of the vehicle, lowercase as in the config ("chimera", "fenice")
+* return new vehicle, nullptr if the name is unknown
+*/
+Vehicle* new_vehicle(const string& name);
+
 
 
 #endif //VEHICLE_H
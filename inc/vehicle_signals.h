@@ -0,0 +1,72 @@
+#ifndef VEHICLE_SIGNALS_H
+#define VEHICLE_SIGNALS_H
+
+#include "can_signal.h"
+
+//////////////////////// Signals
+// Layout of the frames decoded by Chimera (bit positions as in dbc/chimera.dbc)
+
+// 0x4EC, 0x4ED
+typedef Signal< 7, 16, SIGNAL_BE, true, Divide<100>> Imu_X;
+typedef Signal<23, 16, SIGNAL_BE, true, Divide<100>> Imu_Y;
+typedef Signal<39, 16, SIGNAL_BE, true, Divide<100>> Imu_Z;
+typedef Message_Layout<Imu_X, Imu_Y, Imu_Z> Imu_Frame;
+
+// 0xB0
+typedef Signal<15, 8> Throttle_1;
+typedef Signal<23, 8> Throttle_2;
+typedef Message_Layout<Throttle_1, Throttle_2> Throttle_Frame;
+// Brake pressures are split in non consecutive bytes
+typedef Signal<23, 8> Brake_Front_High;
+typedef Signal<39, 8> Brake_Front_Low;
+typedef Signal<47, 8> Brake_Rear_High;
+typedef Signal<63, 8> Brake_Rear_Low;
+
+// 0xC0
+typedef Signal<15, 16, SIGNAL_BE, false, Divide<100>> Steer_Angle;
+
+// 0xD0
+typedef Signal< 7, 24, SIGNAL_BE, false, Divide<10000>> Encoder_Left_Rads;
+typedef Signal<31, 24, SIGNAL_BE, false, Divide<10000>> Encoder_Right_Rads;
+typedef Signal<55, 8> Encoder_Left_Reverse;
+typedef Signal<63, 8> Encoder_Right_Reverse;
+typedef Message_Layout<Encoder_Left_Rads, Encoder_Right_Rads> Encoders_Speed_Frame;
+// 0xD1
+typedef Signal< 7, 24> Encoder_Rotations;
+typedef Signal<31, 24> Encoder_Km;
+
+// 0xAA
+typedef Signal<15, 24, SIGNAL_BE, false, Divide_Float<10000>> Bms_Voltage;
+typedef Signal<39, 16, SIGNAL_BE, false, Divide_Float<10000>> Bms_Max_Voltage;
+typedef Signal<55, 16, SIGNAL_BE, false, Divide_Float<10000>> Bms_Min_Voltage;
+typedef Message_Layout<Bms_Voltage, Bms_Max_Voltage, Bms_Min_Voltage> Bms_Voltage_Frame;
+typedef Signal<15, 16, SIGNAL_BE, false, Divide_Float<10>> Bms_Current;
+typedef Signal<31, 16> Bms_Power;
+typedef Message_Layout<Bms_Current, Bms_Power> Bms_Current_Frame;
+typedef Signal<15, 16, SIGNAL_BE, false, Divide_Float<100>> Bms_Temperature;
+typedef Signal<31, 16, SIGNAL_BE, false, Divide_Float<100>> Bms_Max_Temperature;
+typedef Signal<47, 16, SIGNAL_BE, false, Divide_Float<100>> Bms_Min_Temperature;
+typedef Message_Layout<Bms_Temperature, Bms_Max_Temperature, Bms_Min_Temperature> Bms_Temperature_Frame;
+
+// 0xFF
+typedef Signal< 7, 8, SIGNAL_BE, false, Divide_Float<10>> Bms_Lv_Voltage;
+typedef Signal<23, 8, SIGNAL_BE, false, Divide_Float<5>> Bms_Lv_Temperature;
+typedef Signal<31, 8, SIGNAL_BE, false, Divide_Float<5>> Bms_Lv_Max_Temperature;
+typedef Message_Layout<Bms_Lv_Voltage, Bms_Lv_Temperature, Bms_Lv_Max_Temperature> Bms_Lv_Frame;
+
+// 0x181, 0x182, 0x201, 0x202: 16 bits after the mux byte
+typedef Signal<8, 16, SIGNAL_LE> Inverter_Value;
+
+// 0x5B0 - 0x5BF, 4 channels for each frame
+struct Temperature_Scale
+{
+  static constexpr double factor = 0.1;
+  static constexpr double offset = -100;
+};
+typedef Signal< 7, 16, SIGNAL_BE, false, Linear<Temperature_Scale>> Temperature_0;
+typedef Signal<23, 16, SIGNAL_BE, false, Linear<Temperature_Scale>> Temperature_1;
+typedef Signal<39, 16, SIGNAL_BE, false, Linear<Temperature_Scale>> Temperature_2;
+typedef Signal<55, 16, SIGNAL_BE, false, Linear<Temperature_Scale>> Temperature_3;
+typedef Message_Layout<Temperature_0, Temperature_1, Temperature_2, Temperature_3> Temperature_Frame;
+
+#endif // VEHICLE_SIGNALS_H
@@ -44,6 +44,14 @@ void CheckJson(const csv_parser_config& obj, const json& j)
 		std::cout << "ERROR" << "JSON does not contain key [parse_gps] of type [bool] in object [csv_parser_config]" << std::endl;
 	if(!j.contains("generate_report"))
 		std::cout << "ERROR" << "JSON does not contain key [generate_report] of type [bool] in object [csv_parser_config]" << std::endl;
+	if(!j.contains("dbc_files"))
+		std::cout << "ERROR" << "JSON does not contain key [dbc_files] of type [std::vector] in object [csv_parser_config]" << std::endl;
+	if(!j.contains("vehicle"))
+		std::cout << "ERROR" << "JSON does not contain key [vehicle] of type [std::string] in object [csv_parser_config]" << std::endl;
+	if(!j.contains("time_from"))
+		std::cout << "ERROR" << "JSON does not contain key [time_from] of type [double] in object [csv_parser_config]" << std::endl;
+	if(!j.contains("time_to"))
+		std::cout << "ERROR" << "JSON does not contain key [time_to] of type [double] in object [csv_parser_config]" << std::endl;
 }
 template <>
 void Deserialize(csv_parser_config& obj,const json& j)
@@ -65,6 +73,26 @@ void Deserialize(csv_parser_config& obj,const json& j)
 	{
 		obj.generate_report = j["generate_report"];
 	}
+	if(j.contains("dbc_files"))
+	{
+		obj.dbc_files.clear();
+		for(auto i: j["dbc_files"])
+		{
+				obj.dbc_files .push_back(i);
+		}
+	}
+	if(j.contains("vehicle"))
+	{
+		obj.vehicle = j["vehicle"];
+	}
+	if(j.contains("time_from"))
+	{
+		obj.time_from = j["time_from"];
+	}
+	if(j.contains("time_to"))
+	{
+		obj.time_to = j["time_to"];
+	}
 }
 template <>
 json Serialize(const csv_parser_config& obj) 
@@ -74,6 +102,15 @@ json Serialize(const csv_parser_config& obj)
 	j["parse_candump"] = obj.parse_candump;
 	j["parse_gps"] = obj.parse_gps;
 	j["generate_report"] = obj.generate_report;
+	json dbc_files_json;
+	for(int i = 0; i < obj.dbc_files .size(); i++)
+	{
+		dbc_files_json.push_back(obj.dbc_files [i]);
+	}
+	j["dbc_files"] = dbc_files_json;
+	j["vehicle"] = obj.vehicle;
+	j["time_from"] = obj.time_from;
+	j["time_to"] = obj.time_to;
 	return j;
 }
 template <>
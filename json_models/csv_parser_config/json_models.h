@@ -17,5 +17,9 @@ struct csv_parser_config
 	bool parse_candump;
 	bool parse_gps;
 	bool generate_report;
+	std::vector<std::string> dbc_files;
+	std::string vehicle;
+	double time_from;
+	double time_to;
 };
 
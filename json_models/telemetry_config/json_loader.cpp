@@ -33,11 +33,284 @@ void SaveJson(const T& obj, const std::string& path)
 ////////////////////////////////////////
 
 
+template <>
+void CheckJson(const _can_filters_& obj, const json& j)
+{
+	if(!j.contains("enabled"))
+		std::cout << "ERROR " << "JSON does not contain key [enabled] of type [bool] in object [can_filters]" << std::endl;
+	if(!j.contains("ids"))
+		std::cout << "ERROR " << "JSON does not contain key [ids] of type [std::vector] in object [can_filters]" << std::endl;
+	if(!j.contains("masks"))
+		std::cout << "ERROR " << "JSON does not contain key [masks] of type [std::vector] in object [can_filters]" << std::endl;
+}
+template <>
+void Deserialize(_can_filters_& obj,const json& j)
+{
+	CheckJson<_can_filters_>(obj, j);
+	if(j.contains("enabled"))
+	{
+		obj.enabled = j["enabled"];
+	}
+	if(j.contains("ids"))
+	{
+		obj.ids.clear();
+		for(auto i: j["ids"])
+		{
+				obj.ids .push_back(i);
+		}
+	}
+	if(j.contains("masks"))
+	{
+		obj.masks.clear();
+		for(auto i: j["masks"])
+		{
+				obj.masks .push_back(i);
+		}
+	}
+}
+template <>
+json Serialize(const _can_filters_& obj) 
+{
+	json j;
+	j["enabled"] = obj.enabled;
+	json ids_json;
+	for(int i = 0; i < obj.ids .size(); i++)
+	{
+		ids_json.push_back(obj.ids [i]);
+	}
+	j["ids"] = ids_json;
+	json masks_json;
+	for(int i = 0; i < obj.masks .size(); i++)
+	{
+		masks_json.push_back(obj.masks [i]);
+	}
+	j["masks"] = masks_json;
+	return j;
+}
+template <>
+bool LoadJson(_can_filters_& obj, const std::string& path)
+{
+	std::ifstream f(path);
+	if(!f.is_open())
+		return false;
+	json j;
+	f >> j;
+	f.close();
+	Deserialize<_can_filters_>(obj, j);
+	return true;
+}
+template <>
+void SaveJson(const _can_filters_& obj, const std::string& path)
+{
+	std::ofstream f(path);
+	f << std::setw(4) << Serialize<_can_filters_>(obj);
+	f.close();
+}
+
+
+////////////////////////////////////////
+////////////////////////////////////////
+
+
+template <>
+void CheckJson(const _thread_placement_& obj, const json& j)
+{
+	if(!j.contains("enabled"))
+		std::cout << "ERROR " << "JSON does not contain key [enabled] of type [bool] in object [thread_placement]" << std::endl;
+	if(!j.contains("threads"))
+		std::cout << "ERROR " << "JSON does not contain key [threads] of type [std::vector] in object [thread_placement]" << std::endl;
+	if(!j.contains("cpus"))
+		std::cout << "ERROR " << "JSON does not contain key [cpus] of type [std::vector] in object [thread_placement]" << std::endl;
+	if(!j.contains("priorities"))
+		std::cout << "ERROR " << "JSON does not contain key [priorities] of type [std::vector] in object [thread_placement]" << std::endl;
+}
+template <>
+void Deserialize(_thread_placement_& obj,const json& j)
+{
+	CheckJson<_thread_placement_>(obj, j);
+	if(j.contains("enabled"))
+	{
+		obj.enabled = j["enabled"];
+	}
+	if(j.contains("threads"))
+	{
+		obj.threads.clear();
+		for(auto i: j["threads"])
+		{
+				obj.threads .push_back(i);
+		}
+	}
+	if(j.contains("cpus"))
+	{
+		obj.cpus.clear();
+		for(auto i: j["cpus"])
+		{
+				obj.cpus .push_back(i);
+		}
+	}
+	if(j.contains("priorities"))
+	{
+		obj.priorities.clear();
+		for(auto i: j["priorities"])
+		{
+				obj.priorities .push_back(i);
+		}
+	}
+}
+template <>
+json Serialize(const _thread_placement_& obj) 
+{
+	json j;
+	j["enabled"] = obj.enabled;
+	json threads_json;
+	for(int i = 0; i < obj.threads .size(); i++)
+	{
+		threads_json.push_back(obj.threads [i]);
+	}
+	j["threads"] = threads_json;
+	json cpus_json;
+	for(int i = 0; i < obj.cpus .size(); i++)
+	{
+		cpus_json.push_back(obj.cpus [i]);
+	}
+	j["cpus"] = cpus_json;
+	json priorities_json;
+	for(int i = 0; i < obj.priorities .size(); i++)
+	{
+		priorities_json.push_back(obj.priorities [i]);
+	}
+	j["priorities"] = priorities_json;
+	return j;
+}
+template <>
+bool LoadJson(_thread_placement_& obj, const std::string& path)
+{
+	std::ifstream f(path);
+	if(!f.is_open())
+		return false;
+	json j;
+	f >> j;
+	f.close();
+	Deserialize<_thread_placement_>(obj, j);
+	return true;
+}
+template <>
+void SaveJson(const _thread_placement_& obj, const std::string& path)
+{
+	std::ofstream f(path);
+	f << std::setw(4) << Serialize<_thread_placement_>(obj);
+	f.close();
+}
+
+
+////////////////////////////////////////
+////////////////////////////////////////
+
+
+template <>
+void CheckJson(const _log_writer_& obj, const json& j)
+{
+	if(!j.contains("enabled"))
+		std::cout << "ERROR " << "JSON does not contain key [enabled] of type [bool] in object [log_writer]" << std::endl;
+	if(!j.contains("buffer_kb"))
+		std::cout << "ERROR " << "JSON does not contain key [buffer_kb] of type [int] in object [log_writer]" << std::endl;
+	if(!j.contains("flush_period_ms"))
+		std::cout << "ERROR " << "JSON does not contain key [flush_period_ms] of type [int] in object [log_writer]" << std::endl;
+	if(!j.contains("fsync"))
+		std::cout << "ERROR " << "JSON does not contain key [fsync] of type [std::string] in object [log_writer]" << std::endl;
+	if(!j.contains("fsync_period_ms"))
+		std::cout << "ERROR " << "JSON does not contain key [fsync_period_ms] of type [int] in object [log_writer]" << std::endl;
+}
+template <>
+void Deserialize(_log_writer_& obj,const json& j)
+{
+	CheckJson<_log_writer_>(obj, j);
+	if(j.contains("enabled"))
+	{
+		obj.enabled = j["enabled"];
+	}
+	if(j.contains("buffer_kb"))
+	{
+		obj.buffer_kb = j["buffer_kb"];
+	}
+	if(j.contains("flush_period_ms"))
+	{
+		obj.flush_period_ms = j["flush_period_ms"];
+	}
+	if(j.contains("fsync"))
+	{
+		obj.fsync = j["fsync"];
+	}
+	if(j.contains("fsync_period_ms"))
+	{
+		obj.fsync_period_ms = j["fsync_period_ms"];
+	}
+}
+template <>
+json Serialize(const _log_writer_& obj) 
+{
+	json j;
+	j["enabled"] = obj.enabled;
+	j["buffer_kb"] = obj.buffer_kb;
+	j["flush_period_ms"] = obj.flush_period_ms;
+	j["fsync"] = obj.fsync;
+	j["fsync_period_ms"] = obj.fsync_period_ms;
+	return j;
+}
+template <>
+bool LoadJson(_log_writer_& obj, const std::string& path)
+{
+	std::ifstream f(path);
+	if(!f.is_open())
+		return false;
+	json j;
+	f >> j;
+	f.close();
+	Deserialize<_log_writer_>(obj, j);
+	return true;
+}
+template <>
+void SaveJson(const _log_writer_& obj, const std::string& path)
+{
+	std::ofstream f(path);
+	f << std::setw(4) << Serialize<_log_writer_>(obj);
+	f.close();
+}
+
+
+////////////////////////////////////////
+////////////////////////////////////////
+
+
 template <>
 void CheckJson(const telemetry_config& obj, const json& j)
 {
+	if(!j.contains("vehicle"))
+		std::cout << "ERROR " << "JSON does not contain key [vehicle] of type [std::string] in object [telemetry_config]" << std::endl;
 	if(!j.contains("can_device"))
 		std::cout << "ERROR " << "JSON does not contain key [can_device] of type [std::string] in object [telemetry_config]" << std::endl;
+	if(!j.contains("can_devices"))
+		std::cout << "ERROR " << "JSON does not contain key [can_devices] of type [std::vector] in object [telemetry_config]" << std::endl;
+	if(!j.contains("can_timestamping"))
+		std::cout << "ERROR " << "JSON does not contain key [can_timestamping] of type [std::string] in object [telemetry_config]" << std::endl;
+	if(!j.contains("can_filters"))
+		std::cout << "ERROR " << "JSON does not contain key [can_filters] of type [_can_filters_] in object [telemetry_config]" << std::endl;
+	if(!j.contains("can_rcvbuf_bytes"))
+		std::cout << "ERROR " << "JSON does not contain key [can_rcvbuf_bytes] of type [int] in object [telemetry_config]" << std::endl;
+	if(!j.contains("can_capture"))
+		std::cout << "ERROR " << "JSON does not contain key [can_capture] of type [std::string] in object [telemetry_config]" << std::endl;
+	if(!j.contains("can_log_format"))
+		std::cout << "ERROR " << "JSON does not contain key [can_log_format] of type [std::string] in object [telemetry_config]" << std::endl;
+	if(!j.contains("can_log_level"))
+		std::cout << "ERROR " << "JSON does not contain key [can_log_level] of type [int] in object [telemetry_config]" << std::endl;
+	if(!j.contains("can_log_segment_mb"))
+		std::cout << "ERROR " << "JSON does not contain key [can_log_segment_mb] of type [int] in object [telemetry_config]" << std::endl;
+	if(!j.contains("can_log_segment_s"))
+		std::cout << "ERROR " << "JSON does not contain key [can_log_segment_s] of type [int] in object [telemetry_config]" << std::endl;
+	if(!j.contains("thread_placement"))
+		std::cout << "ERROR " << "JSON does not contain key [thread_placement] of type [_thread_placement_] in object [telemetry_config]" << std::endl;
+	if(!j.contains("log_writer"))
+		std::cout << "ERROR " << "JSON does not contain key [log_writer] of type [_log_writer_] in object [telemetry_config]" << std::endl;
 	if(!j.contains("gps_devices"))
 		std::cout << "ERROR " << "JSON does not contain key [gps_devices] of type [std::vector] in object [telemetry_config]" << std::endl;
 	if(!j.contains("gps_mode"))
@@ -65,10 +338,62 @@ template <>
 void Deserialize(telemetry_config& obj,const json& j)
 {
 	CheckJson<telemetry_config>(obj, j);
+	if(j.contains("vehicle"))
+	{
+		obj.vehicle = j["vehicle"];
+	}
 	if(j.contains("can_device"))
 	{
 		obj.can_device = j["can_device"];
 	}
+	if(j.contains("can_devices"))
+	{
+		obj.can_devices.clear();
+		for(auto i: j["can_devices"])
+		{
+				obj.can_devices .push_back(i);
+		}
+	}
+	if(j.contains("can_timestamping"))
+	{
+		obj.can_timestamping = j["can_timestamping"];
+	}
+	if(j.contains("can_filters"))
+	{
+		Deserialize<_can_filters_>(obj.can_filters, j["can_filters"]);
+	}
+	if(j.contains("can_rcvbuf_bytes"))
+	{
+		obj.can_rcvbuf_bytes = j["can_rcvbuf_bytes"];
+	}
+	if(j.contains("can_capture"))
+	{
+		obj.can_capture = j["can_capture"];
+	}
+	if(j.contains("can_log_format"))
+	{
+		obj.can_log_format = j["can_log_format"];
+	}
+	if(j.contains("can_log_level"))
+	{
+		obj.can_log_level = j["can_log_level"];
+	}
+	if(j.contains("can_log_segment_mb"))
+	{
+		obj.can_log_segment_mb = j["can_log_segment_mb"];
+	}
+	if(j.contains("can_log_segment_s"))
+	{
+		obj.can_log_segment_s = j["can_log_segment_s"];
+	}
+	if(j.contains("thread_placement"))
+	{
+		Deserialize<_thread_placement_>(obj.thread_placement, j["thread_placement"]);
+	}
+	if(j.contains("log_writer"))
+	{
+		Deserialize<_log_writer_>(obj.log_writer, j["log_writer"]);
+	}
 	if(j.contains("gps_devices"))
 	{
 		obj.gps_devices.clear();
@@ -130,7 +455,24 @@ template <>
 json Serialize(const telemetry_config& obj) 
 {
 	json j;
+	j["vehicle"] = obj.vehicle;
 	j["can_device"] = obj.can_device;
+	json can_devices_json;
+	for(int i = 0; i < obj.can_devices .size(); i++)
+	{
+		can_devices_json.push_back(obj.can_devices [i]);
+	}
+	j["can_devices"] = can_devices_json;
+	j["can_timestamping"] = obj.can_timestamping;
+	j["can_filters"] = Serialize<_can_filters_>(obj.can_filters);
+	j["can_rcvbuf_bytes"] = obj.can_rcvbuf_bytes;
+	j["can_capture"] = obj.can_capture;
+	j["can_log_format"] = obj.can_log_format;
+	j["can_log_level"] = obj.can_log_level;
+	j["can_log_segment_mb"] = obj.can_log_segment_mb;
+	j["can_log_segment_s"] = obj.can_log_segment_s;
+	j["thread_placement"] = Serialize<_thread_placement_>(obj.thread_placement);
+	j["log_writer"] = Serialize<_log_writer_>(obj.log_writer);
 	json gps_devices_json;
 	for(int i = 0; i < obj.gps_devices .size(); i++)
 	{
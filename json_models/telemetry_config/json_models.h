@@ -11,9 +11,45 @@
 
 
 
+struct _can_filters_
+{
+	bool enabled;
+	std::vector<int> ids;
+	std::vector<int> masks;
+};
+
+struct _thread_placement_
+{
+	bool enabled;
+	std::vector<std::string> threads;
+	std::vector<std::string> cpus;
+	std::vector<int> priorities;
+};
+
+struct _log_writer_
+{
+	bool enabled;
+	int buffer_kb;
+	int flush_period_ms;
+	std::string fsync;
+	int fsync_period_ms;
+};
+
 struct telemetry_config
 {
+	std::string vehicle;
 	std::string can_device;
+	std::vector<std::string> can_devices;
+	std::string can_timestamping;
+	_can_filters_ can_filters;
+	int can_rcvbuf_bytes;
+	std::string can_capture;
+	std::string can_log_format;
+	int can_log_level;
+	int can_log_segment_mb;
+	int can_log_segment_s;
+	_thread_placement_ thread_placement;
+	_log_writer_ log_writer;
 	std::vector<std::string> gps_devices;
 	std::vector<std::string> gps_mode;
 	std::vector<bool> gps_enabled;
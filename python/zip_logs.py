@@ -23,7 +23,9 @@ def compressFolders(paths, zipPath):
     zf = ZipFile(os.path.join(zipPath, "logs.zip"), "w", compression=ZIP_DEFLATED, compresslevel=5)
 
     for path in tqdm(paths):
-        zf.write(path, path.replace(zipPath, ""))
+        # candump.zbin is already compressed
+        compression = ZIP_STORED if path.endswith(".zbin") else None
+        zf.write(path, path.replace(zipPath, ""), compress_type=compression)
 
     size = sum([zinfo.file_size for zinfo in zf.filelist])
     return float(size)
@@ -48,6 +50,10 @@ if __name__ == "__main__":
         files += findAllFiles(base_path, ".csv")
     if("log" in arg):
         files += findAllFiles(base_path, ".log")
+        files += findAllFiles(base_path, ".zbin")
+        # Segments of a run are listed in its manifest
+        if("json" not in arg):
+            files += findAllFiles(base_path, ".manifest.json")
     if("json" in arg):
         files += findAllFiles(base_path, ".json")
     if("avi" in arg):
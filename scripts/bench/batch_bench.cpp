@@ -0,0 +1,163 @@
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils.h"
+#include "vehicle.h"
+#include "batch_decode.h"
+
+using namespace std;
+
+/**
+* Replays a candump into the sample store of Chimera with parse_message
+* + store_samples and with BatchDecoder, reports ns/frame.
+* The stored rows and the final values of the devices are compared
+* bit by bit with the ones of parse_message.
+*
+* Usage: batch_bench <candump.log> [repeats (20)]
+*/
+
+// Frames between two reads of the store, as the csv tool
+#define BENCH_FLUSH_FRAMES 4096
+
+static int64_t cpu_ns()
+{
+  timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return int64_t(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+// Rows of each device: timestamps followed by the fields, row by row
+typedef vector<vector<double>> Stored_Rows_t;
+
+static void read_store(Chimera* chimera, int reader, Stored_Rows_t* rows, uint64_t* count)
+{
+  for(auto device : chimera->devices)
+  {
+    *count += chimera->read_rows(reader, device, [&](const Row_Batch_t& batch){
+      if(rows == nullptr)
+        return;
+      vector<double>& out = (*rows)[device->index];
+      for(size_t i = 0; i < batch.count; i++)
+      {
+        out.push_back(batch.timestamp[i]);
+        for(size_t j = 0; j < device->fields.size(); j++)
+          out.push_back(batch.fields[j][i]);
+      }
+    });
+  }
+}
+
+// Decodes the log once, with BatchDecoder if batched is set.
+// rows is filled if not nullptr, returns the rows read
+static uint64_t decode(Chimera* chimera, bool batched, const vector<message>& messages, Stored_Rows_t* rows)
+{
+  BatchDecoder batch(chimera);
+  int reader = chimera->add_store_reader();
+  uint64_t count = 0;
+
+  for(size_t i = 0; i < messages.size(); i++)
+  {
+    const message& msg = messages[i];
+    if(!batched || !batch.add(msg.timestamp, 0, msg.id, msg.data, msg.size))
+      chimera->store_samples(chimera->parse_message(msg.timestamp, 0, msg.id, msg.data, msg.size));
+
+    if(i % BENCH_FLUSH_FRAMES == 0)
+    {
+      batch.flush();
+      read_store(chimera, reader, rows, &count);
+    }
+  }
+  batch.flush();
+  read_store(chimera, reader, rows, &count);
+  return count;
+}
+
+// Returns ns/frame
+static double run(bool batched, const vector<message>& messages, int repeats, uint64_t* rows)
+{
+  int64_t elapsed = 0;
+  for(int r = 0; r < repeats; r++)
+  {
+    // A new vehicle for each repeat, decoders start from the same state
+    Chimera chimera;
+    const int64_t start = cpu_ns();
+    *rows = decode(&chimera, batched, messages, nullptr);
+    elapsed += cpu_ns() - start;
+  }
+  return double(elapsed) / (double(messages.size()) * repeats);
+}
+
+// Compares stored rows and devices of the two paths, returns the devices different
+static int compare(const vector<message>& messages)
+{
+  Chimera reference, batched;
+  Stored_Rows_t reference_rows(reference.devices.size());
+  Stored_Rows_t batched_rows(batched.devices.size());
+  decode(&reference, false, messages, &reference_rows);
+  decode(&batched, true, messages, &batched_rows);
+
+  int mismatches = 0;
+  for(size_t i = 0; i < reference.devices.size(); i++)
+  {
+    const vector<double>& a = reference_rows[i];
+    const vector<double>& b = batched_rows[i];
+    // Devices never decoded (gps) are not initialized
+    bool equal = a.size() == b.size() &&
+                 memcmp(a.data(), b.data(), a.size() * sizeof(double)) == 0 &&
+                 reference.devices[i]->sequence == batched.devices[i]->sequence &&
+                 (reference.devices[i]->sequence == 0 ||
+                  reference.devices[i]->get_string(",") == batched.devices[i]->get_string(","));
+    if(!equal)
+    {
+      printf("Mismatch in %s\n", reference.devices[i]->get_name().c_str());
+      mismatches ++;
+    }
+  }
+  return mismatches;
+}
+
+int main(int argc, char** argv)
+{
+  if(argc < 2)
+  {
+    printf("Usage: %s <candump.log> [repeats]\n", argv[0]);
+    return -1;
+  }
+  int repeats = argc > 2 ? atoi(argv[2]) : 20;
+  if(repeats <= 0)
+    repeats = 1;
+
+  vector<string> lines;
+  get_lines(argv[1], &lines);
+
+  vector<message> messages;
+  messages.reserve(lines.size());
+  message msg;
+  for(auto& line : lines)
+    if(parse_message(line, &msg))
+      messages.push_back(msg);
+
+  if(messages.size() == 0)
+  {
+    printf("No CAN frames in %s\n", argv[1]);
+    return -1;
+  }
+  printf("%lu frames, %d repeats\n", messages.size(), repeats);
+
+  uint64_t rows;
+  run(false, messages, 1, &rows);
+  double reference_ns = run(false, messages, repeats, &rows);
+  printf("%-8s %8.1f ns/frame  (%lu rows)\n", "parse", reference_ns, rows);
+
+  int mismatches = compare(messages);
+
+  run(true, messages, 1, &rows);
+  double batch_ns = run(true, messages, repeats, &rows);
+  printf("%-8s %8.1f ns/frame  (%lu rows)  speedup %.2fx  outputs: %s\n",
+         "batch", batch_ns, rows, reference_ns / batch_ns,
+         mismatches == 0 ? "equal" : "DIFFERENT");
+
+  return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,195 @@
+#include <poll.h>
+#include <time.h>
+#include <atomic>
+#include <thread>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "can.h"
+#include "utils.h"
+
+using namespace std;
+
+/**
+* Compares the two receive paths of Can on a (virtual) interface:
+* - socket: CAN_RAW socket read with recvmmsg (receive_batch)
+* - mmap:   TPACKET_V3 ring read in place (receive_mmap)
+*
+* A sender thread writes frames at a fixed rate, the receiver counts them
+* and measures its own CPU time and the delay from kernel timestamp to read.
+*
+* Usage: can_bench [device (vcan0)] [frames per second (20000)] [seconds (5)]
+*/
+
+#define BENCH_BATCH 64
+
+struct Bench_Result_t
+{
+  uint64_t sent;
+  uint64_t received;
+  uint64_t drops;
+  uint64_t batches;
+  double cpu_seconds;       // receiver thread
+  double avg_latency_us;    // kernel timestamp -> userspace
+  double max_latency_us;
+};
+
+static int64_t thread_cpu_ns()
+{
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return int64_t(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+// Sends frames at rate frames/s for seconds, in bursts every millisecond
+static void sender(const char* device, int rate, int seconds, atomic<uint64_t>* sent)
+{
+  sockaddr_can addr;
+  Can can(device, &addr);
+  if(can.open_socket() < 0)
+  {
+    printf("Failed opening sender socket on %s\n", device);
+    return;
+  }
+
+  char data[8];
+  const int64_t period = 1000000;  // 1 ms
+  const int64_t start = get_timestamp_ns();
+  const int64_t end = start + int64_t(seconds) * 1000000000LL;
+  uint64_t count = 0;
+  for(int64_t now = start; now < end; now = get_timestamp_ns())
+  {
+    uint64_t target = uint64_t(double(now - start) * rate / 1e9);
+    while(count < target)
+    {
+      memcpy(data, &count, sizeof(data));
+      if(can.send(0x100 + (count % 0x400), data, 8) < 0)
+      {
+        // vcan has no queue limit, real interfaces may need a pause
+        usleep(100);
+        continue;
+      }
+      count ++;
+    }
+    timespec wait = {0, period};
+    nanosleep(&wait, nullptr);
+  }
+  sent->store(count);
+  can.close_socket();
+}
+
+static Bench_Result_t run(const char* device, bool use_mmap, int rate, int seconds)
+{
+  Bench_Result_t result;
+  memset(&result, 0, sizeof(result));
+
+  sockaddr_can addr;
+  Can can(device, &addr);
+  if(can.open_socket() < 0)
+  {
+    printf("Failed opening %s\n", device);
+    return result;
+  }
+  can.set_timestamping(CAN_TS_SOFTWARE);
+  if(use_mmap && can.open_mmap(CAN_MMAP_BLOCK_SIZE, CAN_MMAP_BLOCK_COUNT) < 0)
+  {
+    printf("Failed opening mmap capture on %s (errno %d)\n", device, errno);
+    can.close_socket();
+    return result;
+  }
+
+  static canfd_frame frames[BENCH_BATCH];
+  static int64_t timestamps[BENCH_BATCH];
+  static CAN_Mmap_Frame_t mapped[BENCH_BATCH];
+  // Frames are consumed (copied) like the telemetry does
+  static canfd_frame copied[BENCH_BATCH];
+
+  atomic<uint64_t> sent(0);
+  thread send_thread(sender, device, rate, seconds, &sent);
+
+  double latency_sum = 0;
+  const int64_t cpu_start = thread_cpu_ns();
+  // Keep reading a bit after the sender is done
+  const int64_t end = get_timestamp_ns() + (int64_t(seconds) + 1) * 1000000000LL;
+
+  pollfd pfd = {can.get_socket(), POLLIN, 0};
+  while(get_timestamp_ns() < end)
+  {
+    if(poll(&pfd, 1, 100) <= 0)
+      continue;
+
+    int count;
+    do
+    {
+      if(use_mmap)
+      {
+        count = can.receive_mmap(mapped, BENCH_BATCH);
+        for(int i = 0; i < count; i++)
+        {
+          const canfd_frame* frame = mapped[i].frame;
+          memcpy(&copied[i], frame, (frame->flags & CANFD_FDF) ? CANFD_MTU : CAN_MTU);
+          timestamps[i] = mapped[i].timestamp;
+        }
+      }
+      else
+      {
+        count = can.receive_batch(frames, BENCH_BATCH, timestamps);
+        for(int i = 0; i < count; i++)
+          copied[i] = frames[i];
+      }
+
+      if(count > 0)
+      {
+        int64_t now = get_timestamp_ns();
+        for(int i = 0; i < count; i++)
+        {
+          double latency = (now - timestamps[i]) / 1000.0;
+          latency_sum += latency;
+          if(latency > result.max_latency_us)
+            result.max_latency_us = latency;
+        }
+        result.received += count;
+      }
+      // The socket returns everything queued at once,
+      // the mapped ring is read block by block
+    } while(use_mmap && count > 0);
+  }
+  result.cpu_seconds = (thread_cpu_ns() - cpu_start) / 1e9;
+
+  send_thread.join();
+  result.sent = sent.load();
+  result.drops = can.get_rx_stat().drops;
+  result.batches = can.get_rx_stat().batches;
+  if(result.received > 0)
+    result.avg_latency_us = latency_sum / result.received;
+
+  can.close_socket();
+  return result;
+}
+
+static void print_result(const char* name, const Bench_Result_t& r)
+{
+  printf("%-8s sent %10lu  received %10lu  drops %8lu  batches %8lu  "
+         "cpu %7.3f s  %7.1f ns/frame  latency avg %8.1f us  max %9.1f us\n",
+         name, r.sent, r.received, r.drops, r.batches,
+         r.cpu_seconds, r.received > 0 ? r.cpu_seconds * 1e9 / r.received : 0.0,
+         r.avg_latency_us, r.max_latency_us);
+}
+
+int main(int argc, char** argv)
+{
+  const char* device = argc > 1 ? argv[1] : "vcan0";
+  int rate = argc > 2 ? atoi(argv[2]) : 20000;
+  int seconds = argc > 3 ? atoi(argv[3]) : 5;
+
+  printf("Device %s, %d frames/s for %d s\n", device, rate, seconds);
+
+  Bench_Result_t socket_result = run(device, false, rate, seconds);
+  print_result("socket", socket_result);
+
+  Bench_Result_t mmap_result = run(device, true, rate, seconds);
+  print_result("mmap", mmap_result);
+
+  return 0;
+}
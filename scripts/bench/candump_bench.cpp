@@ -0,0 +1,236 @@
+#include <new>
+#include <time.h>
+#include <atomic>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "utils.h"
+#include "candump.h"
+
+using namespace std;
+
+/**
+* Formats the frames of a candump as lines of candump.log with the
+* string based path of TelemetrySM::LogCan before the formatter
+* and with CandumpTextWriter, reports ns/frame, MB/s and heap allocations.
+* The text of the two must be byte identical.
+* Then writes the frames as candump.zbin with each zlib level and reports
+* size and CPU time per MB of records to compress and decode them,
+* to choose can_log_level on the target.
+*
+* Usage: candump_bench <candump.log|candump.bin|candump.zbin> [repeats (20)]
+*/
+
+static atomic<uint64_t> allocations(0);
+
+void* operator new(size_t size)
+{
+  allocations.fetch_add(1, memory_order_relaxed);
+  void* p = malloc(size);
+  if(p == nullptr)
+    throw bad_alloc();
+  return p;
+}
+void operator delete(void* p) noexcept
+{
+  free(p);
+}
+void operator delete(void* p, size_t) noexcept
+{
+  free(p);
+}
+
+// Discards the text, only counts it
+class NullBuffer : public streambuf
+{
+public:
+  uint64_t bytes = 0;
+protected:
+  streamsize xsputn(const char*, streamsize n) override
+  {
+    bytes += n;
+    return n;
+  }
+  int overflow(int c) override
+  {
+    bytes ++;
+    return c;
+  }
+};
+
+static int64_t cpu_ns()
+{
+  timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return int64_t(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+// Copy of TelemetrySM::LogCan and CanMessage2Str before the formatter.
+// Kept only as reference for the benchmark, do not update
+static void legacy_log_can(ostream& out, const message& msg)
+{
+  string line = "";
+  line += "(" + timestamp_ns_to_string(msg.timestamp) + ")\t" + msg.device + "\t";
+  string frame = "";
+  frame += get_hex(int(msg.id), 3) + "#";
+  if(msg.fd)
+    frame += "#" + get_hex(int(msg.flags & (CANDUMP_FLAG_BRS | CANDUMP_FLAG_ESI)), 1);
+  for (int i = 0; i < msg.size; i++)
+  {
+    frame += get_hex(int(msg.data[i]), 2);
+  }
+  line += frame;
+  line += "\n";
+
+  out << line;
+}
+
+// text is the writer of the log, allocated when the log is opened
+static void format(ostream& out, bool legacy, const vector<message>& messages, CandumpTextWriter& text)
+{
+  if(legacy)
+  {
+    for(auto& msg : messages)
+      legacy_log_can(out, msg);
+    return;
+  }
+  text.set_stream(&out);
+  for(auto& msg : messages)
+    text.write(msg.timestamp, msg.device, msg.id, msg.fd, msg.flags, msg.data, msg.size);
+  text.flush();
+}
+
+// Returns ns/frame, bytes and allocations of the formatting
+static double run(bool legacy, const vector<message>& messages, int repeats, uint64_t* bytes, uint64_t* allocated)
+{
+  NullBuffer null;
+  ostream out(&null);
+  CandumpTextWriter text;
+
+  int64_t elapsed = 0;
+  uint64_t allocations_start = allocations.load();
+  for(int r = 0; r < repeats; r++)
+  {
+    const int64_t start = cpu_ns();
+    format(out, legacy, messages, text);
+    elapsed += cpu_ns() - start;
+  }
+  *allocated = allocations.load() - allocations_start;
+  *bytes = null.bytes / repeats;
+  return double(elapsed) / (double(messages.size()) * repeats);
+}
+
+static uint8_t bus_index(const vector<string>& buses, const string& device)
+{
+  for(size_t i = 0; i < buses.size(); i++)
+    if(buses[i] == device)
+      return i;
+  return CANDUMP_NO_BUS;
+}
+
+// Compresses the frames with each zlib level in a temporary file and decodes them back
+static bool compression_levels(const vector<message>& messages, const vector<string>& buses)
+{
+  const string path = filesystem::temp_directory_path().string() + "/candump_bench.zbin";
+  bool equal = true;
+  printf("candump.zbin (%d KB blocks), CPU time per MB of records:\n", CANDUMP_BLOCK_SIZE >> 10);
+  for(int level = 1; level <= 9; level++)
+  {
+    ofstream out(path, ios::binary);
+    CandumpBlockWriter writer(level);
+    writer.open(&out, "", buses);
+    for(auto& msg : messages)
+    {
+      uint8_t flags = msg.flags;
+      if(msg.fd)
+        flags |= CANDUMP_FLAG_FD;
+      writer.write(msg.timestamp, bus_index(buses, msg.device), msg.id, flags, msg.data, msg.size);
+    }
+    writer.close();
+    out.close();
+    const Candump_Block_Stats_t stat = writer.get_stats();
+
+    CandumpReader reader;
+    reader.open(path);
+    message msg;
+    size_t frames = 0;
+    const int64_t start = cpu_ns();
+    while(reader.next(&msg))
+    {
+      const message& expected = messages[frames];
+      equal = equal && msg.timestamp == expected.timestamp && msg.id == expected.id && msg.size == expected.size &&
+              memcmp(msg.data, expected.data, msg.size) == 0;
+      frames ++;
+    }
+    const int64_t decode_ns = cpu_ns() - start;
+    equal = equal && frames == messages.size();
+
+    const double mb = stat.raw_bytes / 1e6;
+    printf("level %d  %6.2fx smaller  compress %7.1f ms/MB (%6.1f MB/s, worst block %5.2f ms)  decode %6.1f ms/MB\n",
+           level, double(stat.raw_bytes) / stat.compressed_bytes, stat.compress_ns / 1e6 / mb,
+           mb / (stat.compress_ns / 1e9), stat.worst_block_ns / 1e6, decode_ns / 1e6 / mb);
+  }
+  filesystem::remove(path);
+  printf("decoded frames: %s\n", equal ? "identical" : "DIFFERENT");
+  return equal;
+}
+
+int main(int argc, char** argv)
+{
+  if(argc < 2)
+  {
+    printf("Usage: %s <candump.log|candump.bin> [repeats]\n", argv[0]);
+    return -1;
+  }
+  int repeats = argc > 2 ? atoi(argv[2]) : 20;
+  if(repeats <= 0)
+    repeats = 1;
+
+  CandumpReader reader;
+  if(!reader.open(argv[1]))
+  {
+    printf("Failed reading %s\n", argv[1]);
+    return -1;
+  }
+  vector<message> messages;
+  message msg;
+  while(reader.next(&msg))
+  {
+    // Frames are logged with the bus name
+    if(msg.device == "")
+      msg.device = "can0";
+    messages.push_back(msg);
+  }
+  if(messages.size() == 0)
+  {
+    printf("No CAN frames in %s\n", argv[1]);
+    return -1;
+  }
+  printf("%lu frames, %d repeats\n", messages.size(), repeats);
+
+  CandumpTextWriter writer;
+  ostringstream legacy_text, text;
+  format(legacy_text, true, messages, writer);
+  format(text, false, messages, writer);
+  const bool equal = legacy_text.str() == text.str();
+
+  uint64_t bytes, allocated;
+  run(true, messages, 1, &bytes, &allocated);
+  double legacy_ns = run(true, messages, repeats, &bytes, &allocated);
+  printf("%-8s %8.1f ns/frame  %8.1f MB/s  %.1f allocations/frame\n", "string", legacy_ns,
+         bytes / (legacy_ns * messages.size() / 1e9) / 1e6, double(allocated) / (double(messages.size()) * repeats));
+
+  run(false, messages, 1, &bytes, &allocated);
+  double writer_ns = run(false, messages, repeats, &bytes, &allocated);
+  printf("%-8s %8.1f ns/frame  %8.1f MB/s  %.1f allocations/frame  speedup %.2fx  output: %s\n", "writer", writer_ns,
+         bytes / (writer_ns * messages.size() / 1e9) / 1e6, double(allocated) / (double(messages.size()) * repeats),
+         legacy_ns / writer_ns, equal ? "identical" : "DIFFERENT");
+
+  vector<string> buses = reader.get_buses();
+  if(buses.size() == 0)
+    buses.push_back("can0");
+  const bool decoded = compression_levels(messages, buses);
+
+  return equal && decoded ? 0 : 1;
+}
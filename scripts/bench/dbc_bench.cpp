@@ -0,0 +1,183 @@
+#include <new>
+#include <math.h>
+#include <time.h>
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "dbc.h"
+#include "utils.h"
+#include "vehicle.h"
+
+using namespace std;
+
+/**
+* Replays a candump through the hand written Chimera decoders and through
+* the generic decoder of a DBC loaded at runtime, reports ns/frame of both.
+* Signals defined in both are compared, and the heap allocations made
+* while decoding with the DBC are counted (must be 0).
+*
+* Usage: dbc_bench <file.dbc> <candump.log> [repeats (20)]
+*/
+
+static atomic<uint64_t> allocations(0);
+
+void* operator new(size_t size)
+{
+  allocations.fetch_add(1, memory_order_relaxed);
+  void* p = malloc(size);
+  if(p == nullptr)
+    throw bad_alloc();
+  return p;
+}
+void operator delete(void* p) noexcept
+{
+  free(p);
+}
+void operator delete(void* p, size_t) noexcept
+{
+  free(p);
+}
+
+static int64_t cpu_ns()
+{
+  timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return int64_t(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+struct Check_t
+{
+  string signal;
+  int handle;
+  double* value;
+  // Devices written by the assembler when a group is complete or closed:
+  // compared only after parse_message wrote a complete group
+  Device* group_device = nullptr;
+  double* partial = nullptr;
+};
+
+int main(int argc, char** argv)
+{
+  if(argc < 3)
+  {
+    printf("Usage: %s <file.dbc> <candump.log> [repeats]\n", argv[0]);
+    return -1;
+  }
+  int repeats = argc > 3 ? atoi(argv[3]) : 20;
+  if(repeats <= 0)
+    repeats = 1;
+
+  SignalStore store;
+  Dbc dbc;
+  if(dbc.load(argv[1], &store) < 0)
+  {
+    printf("%s\n", dbc.get_error().c_str());
+    return -1;
+  }
+  printf("DBC: %lu messages, %lu signals\n", dbc.size(), store.size());
+
+  vector<string> lines;
+  get_lines(argv[2], &lines);
+  vector<message> messages;
+  messages.reserve(lines.size());
+  message msg;
+  for(auto& line : lines)
+    if(parse_message(line, &msg))
+      messages.push_back(msg);
+  if(messages.size() == 0)
+  {
+    printf("No CAN frames in %s\n", argv[2]);
+    return -1;
+  }
+  printf("%lu frames, %d repeats\n", messages.size(), repeats);
+
+  Chimera chimera;
+
+  // Signals of dbc/chimera.dbc decoded also by Chimera
+  vector<Check_t> checks = {
+    {"Gyro.X", -1, &chimera.gyro->x}, {"Gyro.Y", -1, &chimera.gyro->y}, {"Gyro.Z", -1, &chimera.gyro->z},
+    {"Accel.X", -1, &chimera.accel->x}, {"Accel.Y", -1, &chimera.accel->y}, {"Accel.Z", -1, &chimera.accel->z},
+    {"BMS_LV.Voltage", -1, &chimera.bms_lv->voltage}, {"BMS_LV.Temperature", -1, &chimera.bms_lv->temperature},
+    {"Temperature_FL_0.Channel_0", -1, &chimera.temp_fl->temps[0], chimera.temp_fl, &chimera.temp_fl->partial},
+    {"Temperature_RR_3.Channel_15", -1, &chimera.temp_rr->temps[15], chimera.temp_rr, &chimera.temp_rr->partial},
+  };
+  for(auto& check : checks)
+    check.handle = store.find(check.signal);
+
+  // CAN FD frames pack the following frames of a group, not described in the DBC:
+  // groups are compared only in logs of classic frames
+  bool classic_log = true;
+  for(auto& m : messages)
+    if(m.size > 8)
+      classic_log = false;
+
+  // Decode once with both and compare
+  uint64_t compared = 0, mismatches = 0;
+  for(auto& m : messages)
+  {
+    Device_Set_t modified;
+    if(chimera.is_known_id(0, m.id))
+      modified = chimera.parse_message(m.timestamp, 0, m.id, m.data, m.size);
+    if(dbc.decode(m.timestamp, m.id, m.data, m.size) < 0)
+      continue;
+    for(auto& check : checks)
+    {
+      if(check.handle < 0)
+        continue;
+      // The DBC decodes each frame, the signals of a group are in the device
+      // (with the last value decoded by the DBC) only when the group is complete
+      if(check.group_device != nullptr)
+      {
+        if(!classic_log || !modified[check.group_device->index] || *check.partial != 0.0)
+          continue;
+      }
+      else if(store.get(check.handle).timestamp != m.timestamp)
+        continue;
+      compared ++;
+      // Chimera divides in float
+      if(fabs(store.get(check.handle).value - *check.value) > 1e-3)
+      {
+        if(mismatches < 10)
+          printf("Mismatch %s: dbc %f chimera %f\n", check.signal.c_str(), store.get(check.handle).value, *check.value);
+        mismatches ++;
+      }
+    }
+  }
+  printf("Compared %lu values, %lu mismatches\n", compared, mismatches);
+
+  // Chimera
+  uint64_t chimera_decoded = 0;
+  int64_t start = cpu_ns();
+  for(int r = 0; r < repeats; r++)
+  {
+    for(auto& m : messages)
+    {
+      if(!chimera.is_known_id(0, m.id))
+        continue;
+      chimera.parse_message(m.timestamp, 0, m.id, m.data, m.size);
+      chimera_decoded ++;
+    }
+  }
+  double chimera_ns = double(cpu_ns() - start) / (double(messages.size()) * repeats);
+
+  // DBC
+  uint64_t dbc_decoded = 0;
+  uint64_t allocations_start = allocations.load();
+  start = cpu_ns();
+  for(int r = 0; r < repeats; r++)
+  {
+    for(auto& m : messages)
+    {
+      if(dbc.decode(m.timestamp, m.id, m.data, m.size) >= 0)
+        dbc_decoded ++;
+    }
+  }
+  double dbc_ns = double(cpu_ns() - start) / (double(messages.size()) * repeats);
+  uint64_t dbc_allocations = allocations.load() - allocations_start;
+
+  printf("%-8s %8.1f ns/frame  (%lu frames decoded)\n", "chimera", chimera_ns, chimera_decoded);
+  printf("%-8s %8.1f ns/frame  (%lu frames decoded, %lu allocations)\n", "dbc", dbc_ns, dbc_decoded, dbc_allocations);
+
+  return (mismatches == 0 && dbc_allocations == 0) ? 0 : 1;
+}
@@ -0,0 +1,711 @@
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils.h"
+#include "vehicle.h"
+
+using namespace std;
+
+/**
+* Replays a candump through the dispatch table of Chimera::parse_message
+* and through the switch it replaced, reports ns/frame of both.
+* The devices modified by each frame are compared to check that the two
+* decoders give the same values (temperatures are assembled by group
+* since the switch was replaced, they are not compared).
+*
+* Usage: decode_bench <candump.log> [repeats (20)]
+*/
+
+// Copy of the switch based Chimera::parse_message before the dispatch table.
+// Kept only as reference for the benchmark, do not update
+// (states are set as event codes, the devices do not store text anymore,
+// the frames of each temperature sensor were counted in the device).
+static int legacy_msg_count[4] = {};
+static void legacy_parse_message(Chimera* c, const int64_t& timestamp_ns, const int &id, const uint8_t data[], const int &size, vector<Device *>& modifiedDevices){
+  modifiedDevices.clear();
+
+  // CAN FD temperature frames pack the classic frames of one sensor
+  // (ID, ID+1, ...) in 8 bytes blocks, 0x5B0 with 32 bytes has all the 16 temps
+  if(size > 8 && id >= 0x5B0 && id <= 0x5BF)
+  {
+    vector<Device *> blockDevices;
+    const int last_id = (id & ~0x3) + 3;
+    for(int block = 0; block * 8 + 8 <= size && id + block <= last_id; block++)
+    {
+      legacy_parse_message(c, timestamp_ns, id + block, data + block * 8, 8, blockDevices);
+      modifiedDevices.insert(modifiedDevices.end(), blockDevices.begin(), blockDevices.end());
+    }
+    return;
+  }
+
+  // Devices store seconds
+  const double timestamp = ns_to_seconds(timestamp_ns);
+
+  switch (id) {
+    case 0x4EC:
+      c->gyro->scale = 245;
+      c->gyro->x = (data[0] << 8) + data[1];
+      c->gyro->y = (data[2] << 8) + data[3];
+      c->gyro->z = (data[4] << 8) + data[5];
+
+      if(c->gyro->x > 32767)
+        c->gyro->x -= 65536;
+      if(c->gyro->y > 32767)
+        c->gyro->y -= 65536;
+      if(c->gyro->z > 32767)
+        c->gyro->z -= 65536;
+
+      c->gyro->x /= 100.0f;
+      c->gyro->y /= 100.0f;
+      c->gyro->z /= 100.0f;
+
+      c->gyro->timestamp = timestamp;
+
+      modifiedDevices.push_back(c->gyro);
+    break;
+    case 0x4ED:
+      c->accel->scale = 8;
+      c->accel->x = (data[0] << 8) + data[1];
+      c->accel->y = (data[2] << 8) + data[3];
+      c->accel->z = (data[4] << 8) + data[5];
+
+      if(c->accel->x > 32767)
+        c->accel->x -= 65536;
+      if(c->accel->y > 32767)
+        c->accel->y -= 65536;
+      if(c->accel->z > 32767)
+        c->accel->z -= 65536;
+
+      c->accel->x /= 100.0f;
+      c->accel->y /= 100.0f;
+      c->accel->z /= 100.0f;
+
+      c->accel->timestamp = timestamp;
+
+      modifiedDevices.push_back(c->accel);
+    break;
+    case 0xB0: // Pedals
+      if(data[0] == 0x01){
+        c->pedal->throttle1 = data[1];
+        c->pedal->throttle2 = data[2];
+
+        c->pedal->timestamp = timestamp;
+
+        modifiedDevices.push_back(c->pedal);
+      }
+      else if(data[0] == 0x02){
+        c->pedal->timestamp = timestamp;
+
+        c->pedal->brake_front = (data[2] << 8) + data[4];
+        c->pedal->brake_rear  = (data[5] << 8) + data[7];
+
+        c->pedal->brake_front /= 500.0f;
+        c->pedal->brake_rear /= 500.0f;
+
+        modifiedDevices.push_back(c->pedal);
+      }
+    break;
+    case 0xC0:
+      if(data[0] == 0x02){
+        c->steer->angle = (data[1] << 8) + data[2];
+
+        c->steer->angle /= 100.0f;
+
+        c->steer->timestamp = timestamp;
+
+        modifiedDevices.push_back(c->steer);
+      }
+    break;
+    case 0xD0:
+      c->encoder_left->rads =  (data[0] << 16) + (data[1] << 8) + data[2];
+      c->encoder_right->rads = (data[3] << 16) + (data[4] << 8) + data[5];
+
+      c->encoder_left->rads /= 10000.0f;
+      c->encoder_right->rads /= 10000.0f;
+      if(data[6] == 1)
+        c->encoder_left->rads *= -1;
+      if(data[7] == 1)
+        c->encoder_right->rads *= -1;
+
+      c->encoder_left->timestamp = timestamp;
+      c->encoder_right->timestamp = timestamp;
+
+      modifiedDevices.push_back(c->encoder_left);
+      modifiedDevices.push_back(c->encoder_right);
+      break;
+    case 0xD1:
+      c->encoder_left->rotations =  (data[0] << 16) + (data[1] << 8) + data[2];
+      c->encoder_left->km = (data[3] << 16) + (data[4] << 8) + data[5];
+      c->encoder_right->rotations =  (data[0] << 16) + (data[1] << 8) + data[2];
+      c->encoder_right->km = (data[3] << 16) + (data[4] << 8) + data[5];
+      // error left data[6]
+      // error right data[6]
+
+      c->encoder_left->timestamp = timestamp;
+      c->encoder_right->timestamp = timestamp;
+
+      // modifiedDevices.push_back(c->encoder_left);
+      // modifiedDevices.push_back(c->encoder_right);
+      break;
+    case 0xAA:
+      if(data[0] == 0x01){
+        c->bms_hv->voltage     = ((data[1] << 16) + (data[2] << 8) + data[3])/10000.0f;
+        c->bms_hv->max_voltage = ((data[4] << 8)  +  data[5]) / 10000.0f;
+        c->bms_hv->min_voltage = ((data[6] << 8)  +  data[7]) / 10000.0f;
+        c->bms_hv->timestamp   =   timestamp;
+        modifiedDevices.push_back(c->bms_hv);
+      }else if(data[0] == 0x03){
+        c->bms_hv_state->set_event(EVENT_TS_ON);
+        c->bms_hv_state->timestamp = timestamp;
+        modifiedDevices.push_back(c->bms_hv_state);
+      }else if(data[0] == 0x04){
+        c->bms_hv_state->set_event(EVENT_TS_OFF);
+        c->bms_hv_state->timestamp = timestamp;
+        modifiedDevices.push_back(c->bms_hv_state);
+      }else if(data[0] == 0x09){
+        c->bms_hv_state->set_event(EVENT_BMS_WARNING, data[1], data[2]);
+        c->bms_hv_state->timestamp = timestamp;
+        modifiedDevices.push_back(c->bms_hv_state);
+      }else if(data[0] == 0x08){
+        c->bms_hv_state->set_event(EVENT_BMS_ERROR, data[1], data[2]);
+        c->bms_hv_state->timestamp = timestamp;
+        modifiedDevices.push_back(c->bms_hv_state);
+      }else if(data[0] == 0x05){
+        c->bms_hv->current = ((data[1] << 8) + data[2])/10.0f;
+        c->bms_hv->power   =  (data[3] << 8) + data[4];
+        c->bms_hv->timestamp = timestamp;
+        modifiedDevices.push_back(c->bms_hv);
+      }else if(data[0] == 0x0A){
+        c->bms_hv->temperature     = ((data[1] << 8) + (data[2])) / 100.0f;
+        c->bms_hv->max_temperature = ((data[3] << 8) + (data[4])) / 100.0f;
+        c->bms_hv->min_temperature = ((data[5] << 8) + (data[6])) / 100.0f;
+        c->bms_hv->timestamp       =   timestamp;
+        modifiedDevices.push_back(c->bms_hv);
+      }
+    break;
+    case 0xFF:
+      c->bms_lv->voltage = data[0]/10.0f;
+      c->bms_lv->temperature = data[2]/5.0f;
+      c->bms_lv->max_temperature = data[3]/5.0f;
+      c->bms_lv->timestamp = timestamp;
+      modifiedDevices.push_back(c->bms_lv);
+    break;
+    case 0x181:
+      if(data[0] == 0xA0){
+        c->inverter_left->torque = (data[2] << 8) + data[1];
+        if(c->inverter_left->torque > 32767)
+          c->inverter_left->torque -= 65535;
+        c->inverter_left->timestamp = timestamp;
+        modifiedDevices.push_back(c->inverter_left);
+      }
+      else if(data[0] == 0x4A){
+        c->inverter_left->temperature = ((data[2] << 8) + data[1] - 15797) / 112.1182;
+        c->inverter_left->timestamp = timestamp;
+        modifiedDevices.push_back(c->inverter_left);
+      }
+      else if(data[0] == 0x49){
+        c->inverter_left->motor_temp = ((data[2] << 8) + data[1] - 9393.9)/55.1;
+        c->inverter_left->timestamp = timestamp;
+        modifiedDevices.push_back(c->inverter_left);
+      }
+      // Speed filtered
+      else if(data[0] == 0xA8){
+        c->inverter_left->speed = (data[2] << 8) + data[1];
+        if(c->inverter_left->speed > 32767)
+          c->inverter_left->speed -= 65535;
+
+        c->inverter_left->speed *= (7000.0/32767.0);
+        c->inverter_left->speed *= (6.28318/60.0);
+
+        // Motor reduction ratio
+        c->inverter_left->speed /= 3.47;
+
+        c->inverter_left->timestamp = timestamp;
+        modifiedDevices.push_back(c->inverter_left);
+      }
+      // Speed unfiltered
+      else if(data[0] == 0x30){
+        c->inverter_left->speed = (data[2] << 8) + data[1];
+        if(c->inverter_left->speed > 32767)
+          c->inverter_left->speed -= 65535;
+
+        c->inverter_left->speed *= (7000.0/32767.0);
+        c->inverter_left->speed *= (6.28318/60.0);
+
+        // Motor reduction ratio
+        c->inverter_left->speed /= 3.47;
+
+        c->inverter_left->timestamp = timestamp;
+        modifiedDevices.push_back(c->inverter_left);
+      }
+    break;
+    case 0x182:
+      if(data[0] == 0xA0){
+        c->inverter_right->torque = (data[2] << 8) + data[1];
+        if(c->inverter_right->torque > 32767)
+          c->inverter_right->torque -= 65535;
+        c->inverter_right->timestamp = timestamp;
+        modifiedDevices.push_back(c->inverter_right);
+      }
+      else if(data[0] == 0x4A){
+        c->inverter_right->temperature = ((data[2] << 8) + data[1] - 15797) / 112.1182;
+        c->inverter_right->timestamp = timestamp;
+        modifiedDevices.push_back(c->inverter_right);
+      }
+      else if(data[0] == 0x49){
+        c->inverter_right->motor_temp = ((data[2] << 8) + data[1] - 9393.9)/55.1;
+        c->inverter_right->timestamp = timestamp;
+        modifiedDevices.push_back(c->inverter_right);
+      }
+      // Speed filtered
+      else if(data[0] == 0xA8){
+        c->inverter_right->speed = (data[2] << 8) + data[1];
+        if(c->inverter_right->speed > 32767)
+          c->inverter_right->speed -= 65535;
+        c->inverter_right->speed *= (7000.0/32767.0);
+        c->inverter_right->speed *= (6.28318/60.0);
+
+        // Motor reduction ratio
+        c->inverter_right->speed /= 3.47;
+
+        c->inverter_right->timestamp = timestamp;
+        modifiedDevices.push_back(c->inverter_right);
+      }
+      // Speed unfiltered
+      else if(data[0] == 0x30){
+        c->inverter_right->speed = (data[2] << 8) + data[1];
+        if(c->inverter_right->speed > 32767)
+          c->inverter_right->speed -= 65535;
+        c->inverter_right->speed *= -1;
+        c->inverter_right->speed *= (7000.0/32767.0);
+        c->inverter_right->speed *= (6.28318/60.0);
+
+        // Motor reduction ratio
+        c->inverter_right->speed /= 3.47;
+
+        c->inverter_right->timestamp = timestamp;
+        modifiedDevices.push_back(c->inverter_right);
+      }
+    break;
+    case 0xA0:
+      if(data[0] == 0x03){
+        c->steering_wheel_state->set_event(EVENT_REQUEST_TS_ON);
+        c->steering_wheel_state->timestamp = timestamp;
+        modifiedDevices.push_back(c->steering_wheel_state);
+      }else if(data[0] == 0x04){
+        c->steering_wheel_state->set_event(EVENT_REQUEST_TO_IDLE);
+        c->steering_wheel_state->timestamp = timestamp;
+        modifiedDevices.push_back(c->steering_wheel_state);
+      }else if(data[0] == 0x05){
+        c->steering_wheel_state->set_event(EVENT_REQUEST_TO_RUN);
+        c->steering_wheel_state->timestamp = timestamp;
+        modifiedDevices.push_back(c->steering_wheel_state);
+      }else if(data[0] == 0x06){
+        c->steering_wheel_state->set_event(EVENT_REQUEST_TO_SETUP);
+        c->steering_wheel_state->timestamp = timestamp;
+        modifiedDevices.push_back(c->steering_wheel_state);
+      }else if(data[0] == 0x08){
+        c->steering_wheel_state->set_event(EVENT_REQUEST_INVERTER_LEFT_ON);
+        c->steering_wheel_state->timestamp = timestamp;
+        modifiedDevices.push_back(c->steering_wheel_state);
+      }else if(data[0] == 0x09){
+        c->steering_wheel_state->set_event(EVENT_REQUEST_INVERTER_RIGHT_ON);
+        c->steering_wheel_state->timestamp = timestamp;
+        modifiedDevices.push_back(c->steering_wheel_state);
+      }
+    break;
+    case 0x55:
+      if(data[0] == 0x01){
+        // if(size < NUM_STATES)
+        //   break;
+        c->ecu_state->set_event(EVENT_ECU_STATE, data[4], data[3]);
+        c->ecu_state->timestamp = timestamp;
+        modifiedDevices.push_back(c->ecu_state);
+      }else if(data[0] == 0x0B && data[1] == 0x04){
+        c->ecu_state->set_event(EVENT_REQUEST_TS_OFF);
+        c->ecu_state->timestamp = timestamp;
+        modifiedDevices.push_back(c->ecu_state);
+      }else if(data[0] == 0x0B && data[1] == 0x08){
+        c->ecu_state->set_event(EVENT_REQUEST_TS_OFF_ERRORS);
+        c->ecu_state->timestamp = timestamp;
+        modifiedDevices.push_back(c->ecu_state);
+      }else if(data[0] == 0x0A){
+        c->ecu_state->set_event(EVENT_REQUEST_TS_ON);
+        c->ecu_state->timestamp = timestamp;
+        modifiedDevices.push_back(c->ecu_state);
+      }
+    break;
+    case 0x201:
+      if(data[0] == 0x90){
+        c->ecu->power_request_left = (data[2] << 8) + data[1];
+        c->ecu->timestamp = timestamp;
+        modifiedDevices.push_back(c->ecu);
+      }
+    break;
+    case 0x202:
+      if(data[0] == 0x90){
+        c->ecu->power_request_right = (data[2] << 8) + data[1];
+        c->ecu->timestamp = timestamp;
+        modifiedDevices.push_back(c->ecu);
+      }
+    break;
+    //////////////////////// Temp 1
+    case 0x5B0:
+      c->temp_fl->temps[ 0] = (((data[0] << 8) + data[1]) * 0.1) - 100;
+      c->temp_fl->temps[ 1] = (((data[2] << 8) + data[3]) * 0.1) - 100;
+      c->temp_fl->temps[ 2] = (((data[4] << 8) + data[5]) * 0.1) - 100;
+      c->temp_fl->temps[ 3] = (((data[6] << 8) + data[7]) * 0.1) - 100;
+      c->temp_fl->timestamp = timestamp;
+      legacy_msg_count[0] ++;
+      if(legacy_msg_count[0] == 4)
+      {
+        modifiedDevices.push_back(c->temp_fl);
+        legacy_msg_count[0] = 0;
+      }
+    break;
+    case 0x5B1:
+      c->temp_fl->temps[ 4] = (((data[0] << 8) + data[1]) * 0.1) - 100;
+      c->temp_fl->temps[ 5] = (((data[2] << 8) + data[3]) * 0.1) - 100;
+      c->temp_fl->temps[ 6] = (((data[4] << 8) + data[5]) * 0.1) - 100;
+      c->temp_fl->temps[ 7] = (((data[6] << 8) + data[7]) * 0.1) - 100;
+      c->temp_fl->timestamp = timestamp;
+      legacy_msg_count[0] ++;
+      if(legacy_msg_count[0] == 4)
+      {
+        modifiedDevices.push_back(c->temp_fl);
+        legacy_msg_count[0] = 0;
+      }
+    break;
+    case 0x5B2:
+      c->temp_fl->temps[ 8] = (((data[0] << 8) + data[1]) * 0.1) - 100;
+      c->temp_fl->temps[ 9] = (((data[2] << 8) + data[3]) * 0.1) - 100;
+      c->temp_fl->temps[10] = (((data[4] << 8) + data[5]) * 0.1) - 100;
+      c->temp_fl->temps[11] = (((data[6] << 8) + data[7]) * 0.1) - 100;
+      c->temp_fl->timestamp = timestamp;
+      legacy_msg_count[0] ++;
+      if(legacy_msg_count[0] == 4)
+      {
+        modifiedDevices.push_back(c->temp_fl);
+        legacy_msg_count[0] = 0;
+      }
+    break;
+    case 0x5B3:
+      c->temp_fl->temps[12] = (((data[0] << 8) + data[1]) * 0.1) - 100;
+      c->temp_fl->temps[13] = (((data[2] << 8) + data[3]) * 0.1) - 100;
+      c->temp_fl->temps[14] = (((data[4] << 8) + data[5]) * 0.1) - 100;
+      c->temp_fl->temps[15] = (((data[6] << 8) + data[7]) * 0.1) - 100;
+      c->temp_fl->timestamp = timestamp;
+      legacy_msg_count[0] ++;
+      if(legacy_msg_count[0] == 4)
+      {
+        modifiedDevices.push_back(c->temp_fl);
+        legacy_msg_count[0] = 0;
+      }
+    break;
+    //////////////////////// Temp 2
+    case 0x5B4:
+      c->temp_fr->temps[ 0] = (((data[0] << 8) + data[1]) * 0.1) - 100;
+      c->temp_fr->temps[ 1] = (((data[2] << 8) + data[3]) * 0.1) - 100;
+      c->temp_fr->temps[ 2] = (((data[4] << 8) + data[5]) * 0.1) - 100;
+      c->temp_fr->temps[ 3] = (((data[6] << 8) + data[7]) * 0.1) - 100;
+      c->temp_fr->timestamp = timestamp;
+      legacy_msg_count[1] ++;
+      if(legacy_msg_count[1] == 4)
+      {
+        modifiedDevices.push_back(c->temp_fr);
+        legacy_msg_count[1] = 0;
+      }
+    break;
+    case 0x5B5:
+      c->temp_fr->temps[ 4] = (((data[0] << 8) + data[1]) * 0.1) - 100;
+      c->temp_fr->temps[ 5] = (((data[2] << 8) + data[3]) * 0.1) - 100;
+      c->temp_fr->temps[ 6] = (((data[4] << 8) + data[5]) * 0.1) - 100;
+      c->temp_fr->temps[ 7] = (((data[6] << 8) + data[7]) * 0.1) - 100;
+      c->temp_fr->timestamp = timestamp;
+      legacy_msg_count[1] ++;
+      if(legacy_msg_count[1] == 4)
+      {
+        modifiedDevices.push_back(c->temp_fr);
+        legacy_msg_count[1] = 0;
+      }
+    break;
+    case 0x5B6:
+      c->temp_fr->temps[ 8] = (((data[0] << 8) + data[1]) * 0.1) - 100;
+      c->temp_fr->temps[ 9] = (((data[2] << 8) + data[3]) * 0.1) - 100;
+      c->temp_fr->temps[10] = (((data[4] << 8) + data[5]) * 0.1) - 100;
+      c->temp_fr->temps[11] = (((data[6] << 8) + data[7]) * 0.1) - 100;
+      c->temp_fr->timestamp = timestamp;
+      legacy_msg_count[1] ++;
+      if(legacy_msg_count[1] == 4)
+      {
+        modifiedDevices.push_back(c->temp_fr);
+        legacy_msg_count[1] = 0;
+      }
+    break;
+    case 0x5B7:
+      c->temp_fr->temps[12] = (((data[0] << 8) + data[1]) * 0.1) - 100;
+      c->temp_fr->temps[13] = (((data[2] << 8) + data[3]) * 0.1) - 100;
+      c->temp_fr->temps[14] = (((data[4] << 8) + data[5]) * 0.1) - 100;
+      c->temp_fr->temps[15] = (((data[6] << 8) + data[7]) * 0.1) - 100;
+      c->temp_fr->timestamp = timestamp;
+      legacy_msg_count[1] ++;
+      if(legacy_msg_count[1] == 4)
+      {
+        modifiedDevices.push_back(c->temp_fr);
+        legacy_msg_count[1] = 0;
+      }
+    break;
+    //////////////////////// Temp 3
+    case 0x5B8:
+      c->temp_rl->temps[ 0] = (((data[0] << 8) + data[1]) * 0.1) - 100;
+      c->temp_rl->temps[ 1] = (((data[2] << 8) + data[3]) * 0.1) - 100;
+      c->temp_rl->temps[ 2] = (((data[4] << 8) + data[5]) * 0.1) - 100;
+      c->temp_rl->temps[ 3] = (((data[6] << 8) + data[7]) * 0.1) - 100;
+      c->temp_rl->timestamp = timestamp;
+      legacy_msg_count[2] ++;
+      if(legacy_msg_count[2] == 4)
+      {
+        modifiedDevices.push_back(c->temp_rl);
+        legacy_msg_count[2] = 0;
+      }
+    break;
+    case 0x5B9:
+      c->temp_rl->temps[ 4] = (((data[0] << 8) + data[1]) * 0.1) - 100;
+      c->temp_rl->temps[ 5] = (((data[2] << 8) + data[3]) * 0.1) - 100;
+      c->temp_rl->temps[ 6] = (((data[4] << 8) + data[5]) * 0.1) - 100;
+      c->temp_rl->temps[ 7] = (((data[6] << 8) + data[7]) * 0.1) - 100;
+      c->temp_rl->timestamp = timestamp;
+      legacy_msg_count[2] ++;
+      if(legacy_msg_count[2] == 4)
+      {
+        modifiedDevices.push_back(c->temp_rl);
+        legacy_msg_count[2] = 0;
+      }
+    break;
+    case 0x5BA:
+      c->temp_rl->temps[ 8] = (((data[0] << 8) + data[1]) * 0.1) - 100;
+      c->temp_rl->temps[ 9] = (((data[2] << 8) + data[3]) * 0.1) - 100;
+      c->temp_rl->temps[10] = (((data[4] << 8) + data[5]) * 0.1) - 100;
+      c->temp_rl->temps[11] = (((data[6] << 8) + data[7]) * 0.1) - 100;
+      c->temp_rl->timestamp = timestamp;
+      legacy_msg_count[2] ++;
+      if(legacy_msg_count[2] == 4)
+      {
+        modifiedDevices.push_back(c->temp_rl);
+        legacy_msg_count[2] = 0;
+      }
+    break;
+    case 0x5BB:
+      c->temp_rl->temps[12] = (((data[0] << 8) + data[1]) * 0.1) - 100;
+      c->temp_rl->temps[13] = (((data[2] << 8) + data[3]) * 0.1) - 100;
+      c->temp_rl->temps[14] = (((data[4] << 8) + data[5]) * 0.1) - 100;
+      c->temp_rl->temps[15] = (((data[6] << 8) + data[7]) * 0.1) - 100;
+      c->temp_rl->timestamp = timestamp;
+      legacy_msg_count[2] ++;
+      if(legacy_msg_count[2] == 4)
+      {
+        modifiedDevices.push_back(c->temp_rl);
+        legacy_msg_count[2] = 0;
+      }
+    break;
+    //////////////////////// Temp 4
+    case 0x5BC:
+      c->temp_rr->temps[ 0] = (((data[0] << 8) + data[1]) * 0.1) - 100;
+      c->temp_rr->temps[ 1] = (((data[2] << 8) + data[3]) * 0.1) - 100;
+      c->temp_rr->temps[ 2] = (((data[4] << 8) + data[5]) * 0.1) - 100;
+      c->temp_rr->temps[ 3] = (((data[6] << 8) + data[7]) * 0.1) - 100;
+      c->temp_rr->timestamp = timestamp;
+      legacy_msg_count[3] ++;
+      if(legacy_msg_count[3] == 4)
+      {
+        modifiedDevices.push_back(c->temp_rr);
+        legacy_msg_count[3] = 0;
+      }
+    break;
+    case 0x5BD:
+      c->temp_rr->temps[ 4] = (((data[0] << 8) + data[1]) * 0.1) - 100;
+      c->temp_rr->temps[ 5] = (((data[2] << 8) + data[3]) * 0.1) - 100;
+      c->temp_rr->temps[ 6] = (((data[4] << 8) + data[5]) * 0.1) - 100;
+      c->temp_rr->temps[ 7] = (((data[6] << 8) + data[7]) * 0.1) - 100;
+      c->temp_rr->timestamp = timestamp;
+      legacy_msg_count[3] ++;
+      if(legacy_msg_count[3] == 4)
+      {
+        modifiedDevices.push_back(c->temp_rr);
+        legacy_msg_count[3] = 0;
+      }
+    break;
+    case 0x5BE:
+      c->temp_rr->temps[ 8] = (((data[0] << 8) + data[1]) * 0.1) - 100;
+      c->temp_rr->temps[ 9] = (((data[2] << 8) + data[3]) * 0.1) - 100;
+      c->temp_rr->temps[10] = (((data[4] << 8) + data[5]) * 0.1) - 100;
+      c->temp_rr->temps[11] = (((data[6] << 8) + data[7]) * 0.1) - 100;
+      c->temp_rr->timestamp = timestamp;
+      legacy_msg_count[3] ++;
+      if(legacy_msg_count[3] == 4)
+      {
+        modifiedDevices.push_back(c->temp_rr);
+        legacy_msg_count[3] = 0;
+      }
+    break;
+    case 0x5BF:
+      c->temp_rr->temps[12] = (((data[0] << 8) + data[1]) * 0.1) - 100;
+      c->temp_rr->temps[13] = (((data[2] << 8) + data[3]) * 0.1) - 100;
+      c->temp_rr->temps[14] = (((data[4] << 8) + data[5]) * 0.1) - 100;
+      c->temp_rr->temps[15] = (((data[6] << 8) + data[7]) * 0.1) - 100;
+      c->temp_rr->timestamp = timestamp;
+      legacy_msg_count[3] ++;
+      if(legacy_msg_count[3] == 4)
+      {
+        modifiedDevices.push_back(c->temp_rr);
+        legacy_msg_count[3] = 0;
+      }
+    break;
+    default:
+    break;
+  }
+}
+
+static int64_t cpu_ns()
+{
+  timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return int64_t(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+typedef void (*Parse_Fn)(Chimera*, const message&, vector<Device*>&);
+
+static void parse_table(Chimera* c, const message& msg, vector<Device*>& modified)
+{
+  modified.clear();
+  c->for_each_device(c->parse_message(msg.timestamp, 0, msg.id, msg.data, msg.size), [&](Device* device){
+    modified.push_back(device);
+  });
+}
+static void parse_legacy(Chimera* c, const message& msg, vector<Device*>& modified)
+{
+  legacy_parse_message(c, msg.timestamp, msg.id, msg.data, msg.size, modified);
+}
+
+// Returns ns/frame, modified counts the devices returned
+static double run(Parse_Fn parse, const vector<message>& messages, int repeats, uint64_t* modified)
+{
+  Chimera chimera;
+  memset(legacy_msg_count, 0, sizeof(legacy_msg_count));
+  vector<Device*> devices;
+  devices.reserve(16);
+  *modified = 0;
+
+  const int64_t start = cpu_ns();
+  for(int r = 0; r < repeats; r++)
+  {
+    for(const auto& msg : messages)
+    {
+      parse(&chimera, msg, devices);
+      *modified += devices.size();
+    }
+  }
+  const int64_t elapsed = cpu_ns() - start;
+  return double(elapsed) / (double(messages.size()) * repeats);
+}
+
+// Values compared, without the partial field that the switch does not have
+static string compared_values(Device* device)
+{
+  if(!device->has_fields())
+    return device->get_string(",");
+  string values = to_string(*device->sample_timestamp);
+  for(size_t i = 0; i < device->fields.size(); i++)
+    if(device->field_names[i] != "partial")
+      values += "," + to_string(*device->fields[i]);
+  return values;
+}
+
+// Devices written by group by the assembler (temperatures) are not compared,
+// the switch wrote them every 4 frames whatever their group
+static void remove_groups(vector<Device*>& devices)
+{
+  size_t kept = 0;
+  for(auto device : devices)
+    if(device->assembler.get_config().mode != ASSEMBLER_GROUP)
+      devices[kept++] = device;
+  devices.resize(kept);
+}
+
+// Decodes the log once with both implementations and compares the devices
+static uint64_t compare(const vector<message>& messages)
+{
+  Chimera table, legacy;
+  vector<Device*> table_devices, legacy_devices;
+  uint64_t mismatches = 0;
+  memset(legacy_msg_count, 0, sizeof(legacy_msg_count));
+
+  for(size_t i = 0; i < messages.size(); i++)
+  {
+    parse_table(&table, messages[i], table_devices);
+    parse_legacy(&legacy, messages[i], legacy_devices);
+    remove_groups(table_devices);
+    remove_groups(legacy_devices);
+
+    bool equal = table_devices.size() == legacy_devices.size();
+    for(size_t j = 0; equal && j < table_devices.size(); j++)
+      equal = table_devices[j]->get_name() == legacy_devices[j]->get_name() &&
+              compared_values(table_devices[j]) == compared_values(legacy_devices[j]);
+
+    if(!equal)
+    {
+      if(mismatches < 10)
+        printf("Mismatch at line %lu (id 0x%X)\n", i + 1, messages[i].id);
+      mismatches ++;
+    }
+  }
+  return mismatches;
+}
+
+int main(int argc, char** argv)
+{
+  if(argc < 2)
+  {
+    printf("Usage: %s <candump.log> [repeats]\n", argv[0]);
+    return -1;
+  }
+  int repeats = argc > 2 ? atoi(argv[2]) : 20;
+  if(repeats <= 0)
+    repeats = 1;
+
+  vector<string> lines;
+  get_lines(argv[1], &lines);
+
+  vector<message> messages;
+  messages.reserve(lines.size());
+  message msg;
+  for(auto& line : lines)
+    if(parse_message(line, &msg))
+      messages.push_back(msg);
+
+  if(messages.size() == 0)
+  {
+    printf("No CAN frames in %s\n", argv[1]);
+    return -1;
+  }
+  printf("%lu frames, %d repeats\n", messages.size(), repeats);
+
+  uint64_t mismatches = compare(messages);
+  printf("Outputs: %s (%lu mismatches)\n", mismatches == 0 ? "equal" : "DIFFERENT", mismatches);
+
+  uint64_t legacy_modified, table_modified;
+  // Warm up caches and branch predictors once for each
+  run(parse_legacy, messages, 1, &legacy_modified);
+  run(parse_table, messages, 1, &table_modified);
+
+  double legacy_ns = run(parse_legacy, messages, repeats, &legacy_modified);
+  double table_ns = run(parse_table, messages, repeats, &table_modified);
+
+  printf("%-8s %8.1f ns/frame  (%lu devices)\n", "switch", legacy_ns, legacy_modified);
+  printf("%-8s %8.1f ns/frame  (%lu devices)\n", "table", table_ns, table_modified);
+  printf("Speedup %.2fx\n", legacy_ns / table_ns);
+
+  return mismatches == 0 ? 0 : 1;
+}
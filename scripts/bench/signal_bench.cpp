@@ -0,0 +1,182 @@
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "can_signal.h"
+
+using namespace std;
+
+/**
+* Compares the Signal/Message_Layout kernels of can_signal.h with the
+* hand written expressions they replaced in the Chimera decoders.
+* Both run on the same random payloads, results must be bit exact.
+*
+* Usage: signal_bench [frames (1000000)] [repeats (20)]
+*/
+
+//////////////////////// Kernels
+typedef Signal< 7, 16, SIGNAL_BE, true, Divide<100>> Imu_X;
+typedef Signal<23, 16, SIGNAL_BE, true, Divide<100>> Imu_Y;
+typedef Signal<39, 16, SIGNAL_BE, true, Divide<100>> Imu_Z;
+typedef Message_Layout<Imu_X, Imu_Y, Imu_Z> Imu_Frame;
+
+typedef Signal< 7, 24, SIGNAL_BE, false, Divide<10000>> Encoder_Left_Rads;
+typedef Signal<31, 24, SIGNAL_BE, false, Divide<10000>> Encoder_Right_Rads;
+typedef Message_Layout<Encoder_Left_Rads, Encoder_Right_Rads> Encoders_Frame;
+
+typedef Signal<15, 24, SIGNAL_BE, false, Divide_Float<10000>> Bms_Voltage;
+typedef Signal<39, 16, SIGNAL_BE, false, Divide_Float<10000>> Bms_Max_Voltage;
+typedef Signal<55, 16, SIGNAL_BE, false, Divide_Float<10000>> Bms_Min_Voltage;
+typedef Message_Layout<Bms_Voltage, Bms_Max_Voltage, Bms_Min_Voltage> Bms_Voltage_Frame;
+
+struct Temperature_Scale
+{
+  static constexpr double factor = 0.1;
+  static constexpr double offset = -100;
+};
+typedef Signal< 7, 16, SIGNAL_BE, false, Linear<Temperature_Scale>> Temperature_0;
+typedef Signal<23, 16, SIGNAL_BE, false, Linear<Temperature_Scale>> Temperature_1;
+typedef Signal<39, 16, SIGNAL_BE, false, Linear<Temperature_Scale>> Temperature_2;
+typedef Signal<55, 16, SIGNAL_BE, false, Linear<Temperature_Scale>> Temperature_3;
+typedef Message_Layout<Temperature_0, Temperature_1, Temperature_2, Temperature_3> Temperature_Frame;
+
+//////////////////////// Frames
+// Each writes count doubles in out
+
+#define MAX_OUT 4
+
+struct Frame_t
+{
+  const char* name;
+  int count;
+  void (*hand)(const uint8_t* data, double* out);
+  void (*kernel)(const uint8_t* data, double* out);
+};
+
+static void imu_hand(const uint8_t* data, double* out)
+{
+  double x = (data[0] << 8) + data[1];
+  double y = (data[2] << 8) + data[3];
+  double z = (data[4] << 8) + data[5];
+  if(x > 32767)
+    x -= 65536;
+  if(y > 32767)
+    y -= 65536;
+  if(z > 32767)
+    z -= 65536;
+  out[0] = x / 100.0f;
+  out[1] = y / 100.0f;
+  out[2] = z / 100.0f;
+}
+static void imu_kernel(const uint8_t* data, double* out)
+{
+  Imu_Frame::decode_array(data, out);
+}
+
+static void encoders_hand(const uint8_t* data, double* out)
+{
+  double left = (data[0] << 16) + (data[1] << 8) + data[2];
+  double right = (data[3] << 16) + (data[4] << 8) + data[5];
+  out[0] = left / 10000.0f;
+  out[1] = right / 10000.0f;
+}
+static void encoders_kernel(const uint8_t* data, double* out)
+{
+  Encoders_Frame::decode_array(data, out);
+}
+
+static void bms_hand(const uint8_t* data, double* out)
+{
+  out[0] = ((data[1] << 16) + (data[2] << 8) + data[3])/10000.0f;
+  out[1] = ((data[4] << 8)  +  data[5]) / 10000.0f;
+  out[2] = ((data[6] << 8)  +  data[7]) / 10000.0f;
+}
+static void bms_kernel(const uint8_t* data, double* out)
+{
+  Bms_Voltage_Frame::decode_array(data, out);
+}
+
+static void temperature_hand(const uint8_t* data, double* out)
+{
+  out[0] = (((data[0] << 8) + data[1]) * 0.1) - 100;
+  out[1] = (((data[2] << 8) + data[3]) * 0.1) - 100;
+  out[2] = (((data[4] << 8) + data[5]) * 0.1) - 100;
+  out[3] = (((data[6] << 8) + data[7]) * 0.1) - 100;
+}
+static void temperature_kernel(const uint8_t* data, double* out)
+{
+  Temperature_Frame::decode_array(data, out);
+}
+
+static int64_t cpu_ns()
+{
+  timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return int64_t(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+// Returns ns/frame, sum keeps the results alive
+static double run(void (*decode)(const uint8_t*, double*), const vector<uint8_t>& payloads, int frames, int repeats, double* sum)
+{
+  double out[MAX_OUT] = {0};
+  const int64_t start = cpu_ns();
+  for(int r = 0; r < repeats; r++)
+  {
+    for(int i = 0; i < frames; i++)
+    {
+      decode(&payloads[i * 8], out);
+      *sum += out[0];
+    }
+  }
+  return double(cpu_ns() - start) / (double(frames) * repeats);
+}
+
+int main(int argc, char** argv)
+{
+  int frames = argc > 1 ? atoi(argv[1]) : 1000000;
+  int repeats = argc > 2 ? atoi(argv[2]) : 20;
+  if(frames <= 0)
+    frames = 1;
+  if(repeats <= 0)
+    repeats = 1;
+
+  vector<uint8_t> payloads(frames * 8);
+  srand(1);
+  for(auto& byte : payloads)
+    byte = rand() & 0xFF;
+
+  const Frame_t tests[] = {
+    {"imu",         3, imu_hand,         imu_kernel},
+    {"encoders",    2, encoders_hand,    encoders_kernel},
+    {"bms voltage", 3, bms_hand,         bms_kernel},
+    {"temperature", 4, temperature_hand, temperature_kernel},
+  };
+
+  int ret = 0;
+  printf("%d frames, %d repeats\n", frames, repeats);
+  for(auto& test : tests)
+  {
+    // Bit exact check
+    uint64_t mismatches = 0;
+    for(int i = 0; i < frames; i++)
+    {
+      double hand[MAX_OUT], kernel[MAX_OUT];
+      test.hand(&payloads[i * 8], hand);
+      test.kernel(&payloads[i * 8], kernel);
+      if(memcmp(hand, kernel, test.count * sizeof(double)) != 0)
+        mismatches ++;
+    }
+
+    double sum = 0;
+    double hand_ns = run(test.hand, payloads, frames, repeats, &sum);
+    double kernel_ns = run(test.kernel, payloads, frames, repeats, &sum);
+
+    printf("%-12s hand %6.2f ns/frame  kernel %6.2f ns/frame  %s (%lu mismatches)  [%g]\n",
+           test.name, hand_ns, kernel_ns, mismatches == 0 ? "bit exact" : "DIFFERENT", mismatches, sum);
+    if(mismatches != 0)
+      ret = 1;
+  }
+  return ret;
+}
@@ -0,0 +1,225 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils.h"
+#include "candump.h"
+
+using namespace std;
+
+/**
+* Converts a candump between the text format (candump.log), the
+* binary one (candump.bin) and the compressed one (candump.zbin).
+* The output format is given by its extension, other names convert
+* text to binary and binary (or compressed) to text.
+* The metadata (session header) and every frame are kept, a text log
+* written by the telemetry converted to binary and back is the same file.
+* The input can be the manifest of a segmented candump (candump.manifest.json),
+* its segments are converted in one file.
+*
+* Usage: candump_convert <input> <output> [--ns] [--level N] [--from S] [--to S]
+* --ns writes the text timestamps with nanoseconds (the binary keeps them,
+*      the text written by the telemetry has microseconds)
+* --level zlib level of candump.zbin, 1 (fastest) ~ 9 (smallest)
+* --from, --to converts only the frames in this window, seconds from the
+*      first frame. Compressed inputs decode only the blocks of the window
+*/
+
+static uint64_t file_size(const string& path)
+{
+  error_code ec;
+  uint64_t size = filesystem::file_size(path, ec);
+  return ec ? 0 : size;
+}
+
+// Of all the segments of a manifest
+static uint64_t input_size(const string& path, const vector<Candump_Segment_t>& segments)
+{
+  if(segments.size() == 0)
+    return file_size(path);
+  const string folder = filesystem::path(path).parent_path().string();
+  uint64_t size = 0;
+  for(auto& segment : segments)
+    size += file_size(folder == "" ? segment.file : folder + "/" + segment.file);
+  return size;
+}
+
+// Bus names of a text log are known only after reading all the frames
+static vector<string> read_buses(const string& input)
+{
+  CandumpReader reader;
+  message msg;
+  if(reader.open(input))
+    while(reader.next(&msg));
+  return reader.get_buses();
+}
+
+static uint8_t bus_index(const vector<string>& buses, const string& device)
+{
+  for(size_t i = 0; i < buses.size(); i++)
+    if(buses[i] == device)
+      return i;
+  return CANDUMP_NO_BUS;
+}
+
+int main(int argc, char** argv)
+{
+  if(argc < 3)
+  {
+    printf("Usage: %s <input> <output> [--ns] [--level N] [--from S] [--to S]\n", argv[0]);
+    return -1;
+  }
+  const string input = argv[1];
+  const string output = argv[2];
+  bool ns = false;
+  int level = CANDUMP_ZLIB_LEVEL;
+  double from = 0.0;
+  double to = -1.0;
+  for(int i = 3; i < argc; i++)
+  {
+    if(strcmp(argv[i], "--ns") == 0)
+      ns = true;
+    else if(strcmp(argv[i], "--level") == 0 && i + 1 < argc)
+      level = atoi(argv[++i]);
+    else if(strcmp(argv[i], "--from") == 0 && i + 1 < argc)
+      from = atof(argv[++i]);
+    else if(strcmp(argv[i], "--to") == 0 && i + 1 < argc)
+      to = atof(argv[++i]);
+  }
+
+  CandumpReader reader;
+  if(!reader.open(input))
+  {
+    printf("Failed reading %s\n", input.c_str());
+    return -1;
+  }
+  Candump_Format_t in_format = reader.is_compressed() ? CANDUMP_COMPRESSED : (reader.is_binary() ? CANDUMP_BINARY : CANDUMP_TEXT);
+  Candump_Format_t out_format = in_format == CANDUMP_TEXT ? CANDUMP_BINARY : CANDUMP_TEXT;
+  const string extension = filesystem::path(output).extension().string();
+  if(extension == ".log")
+    out_format = CANDUMP_TEXT;
+  else if(extension == ".bin")
+    out_format = CANDUMP_BINARY;
+  else if(extension == ".zbin")
+    out_format = CANDUMP_COMPRESSED;
+
+  const char* names[] = {"text", "binary", "compressed"};
+  printf("%s: %s -> %s\n", input.c_str(), names[in_format], names[out_format]);
+  if(reader.get_segments().size() > 0)
+    printf("%lu segments\n", reader.get_segments().size());
+  if(reader.is_recovered())
+    printf("No block index, the file was not closed: %lu complete blocks recovered\n", reader.get_index().size());
+
+  ofstream out(output, ios::binary);
+  if(!out.is_open())
+  {
+    printf("Failed opening %s\n", output.c_str());
+    return -1;
+  }
+
+  double t_start = get_timestamp();
+  vector<string> buses = in_format == CANDUMP_TEXT ? read_buses(input) : reader.get_buses();
+  CandumpTextWriter text;
+  CandumpBlockWriter blocks(level);
+  bool header_ok = true;
+  if(out_format == CANDUMP_TEXT)
+  {
+    out << reader.get_metadata();
+    text.set_stream(&out);
+  }
+  else if(out_format == CANDUMP_BINARY)
+    header_ok = candump_bin_write_header(out, reader.get_metadata(), buses);
+  else
+    header_ok = blocks.open(&out, reader.get_metadata(), buses);
+  if(!header_ok)
+  {
+    printf("Too many CAN buses (max %d) or name too long\n", CANDUMP_MAX_BUSES);
+    return -1;
+  }
+
+  // Time window from the first frame
+  message msg;
+  bool has_frame = reader.next(&msg);
+  int64_t end = INT64_MAX;
+  if(has_frame)
+  {
+    const int64_t first = msg.timestamp;
+    if(to >= 0.0)
+      end = first + int64_t(to * 1e9);
+    if(from > 0.0)
+      has_frame = reader.seek(first + int64_t(from * 1e9)) && reader.next(&msg);
+  }
+
+  uint64_t frames = 0;
+  uint64_t different = 0;
+  uint64_t truncated = 0;
+  for(; has_frame && msg.timestamp <= end; has_frame = reader.next(&msg))
+  {
+    // Lines not written like the telemetry would not be converted back the same
+    if(in_format == CANDUMP_TEXT && candump_line(msg) != reader.get_line())
+      different ++;
+
+    if(out_format == CANDUMP_TEXT)
+    {
+      if(ns)
+        out << candump_line(msg, ns);
+      else
+      {
+        if(msg.timestamp % 1000 != 0)
+          truncated ++;
+        text.write(msg.timestamp, msg.device, msg.id, msg.fd, msg.flags, msg.data, msg.size);
+      }
+    }
+    else
+    {
+      uint8_t flags = msg.flags;
+      if(msg.fd)
+        flags |= CANDUMP_FLAG_FD;
+      const uint8_t bus = bus_index(buses, msg.device);
+      if(out_format == CANDUMP_BINARY)
+        candump_bin_write_frame(out, msg.timestamp, bus, msg.id, flags, msg.data, msg.size);
+      else
+        blocks.write(msg.timestamp, bus, msg.id, flags, msg.data, msg.size);
+    }
+    frames ++;
+  }
+  text.flush();
+  blocks.close();
+  out.close();
+
+  printf("%lu frames", frames);
+  if(in_format == CANDUMP_TEXT)
+  {
+    printf(", %lu lines skipped, buses:", reader.get_skipped());
+    for(auto& bus : buses)
+      printf(" %s", bus.c_str());
+  }
+  printf("\n");
+  if(in_format == CANDUMP_COMPRESSED)
+  {
+    if(reader.get_segments().size() > 0)
+      printf("%lu blocks decompressed\n", reader.get_blocks_read());
+    else
+      printf("%lu of %lu blocks decompressed\n", reader.get_blocks_read(), reader.get_index().size());
+  }
+  if(out_format == CANDUMP_COMPRESSED)
+  {
+    const Candump_Block_Stats_t& stat = blocks.get_stats();
+    const double mb = stat.raw_bytes / 1e6;
+    printf("%lu blocks, level %d, records %.2fx smaller, compression %.1f ms CPU per MB of records (worst block %.2f ms)\n",
+           stat.blocks, level, stat.compressed_bytes > 0 ? double(stat.raw_bytes) / stat.compressed_bytes : 0.0,
+           mb > 0 ? stat.compress_ns / 1e6 / mb : 0.0, stat.worst_block_ns / 1e6);
+  }
+  if(in_format == CANDUMP_TEXT && reader.get_skipped() > 0)
+    printf("Lines that are not frames are not kept\n");
+  if(different > 0)
+    printf("%lu frames are not formatted like the telemetry (separators, timestamp or id digits), they are converted back in the telemetry format\n", different);
+  if(truncated > 0)
+    printf("%lu timestamps have nanoseconds, written with microseconds (use --ns to keep them)\n", truncated);
+
+  const uint64_t in_size = input_size(input, reader.get_segments());
+  const uint64_t out_size = file_size(output);
+  printf("%lu -> %lu bytes (%.2fx) in %.2f seconds\n", in_size, out_size,
+         out_size > 0 ? double(in_size) / out_size : 0.0, get_timestamp() - t_start);
+  return 0;
+}
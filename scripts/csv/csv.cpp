@@ -6,9 +6,12 @@
 #include <string.h>
 #include <exception>
 
+#include "dbc.h"
 #include "utils.h"
 #include "browse.h"
+#include "candump.h"
 #include "vehicle.h"
+#include "batch_decode.h"
 
 #include "report.h"
 
@@ -18,6 +21,10 @@
 
 using namespace std;
 
+// Lines parsed between two writes of the rows stored in the vehicle,
+// less than the rows kept for each device (VEHICLE_STORE_CHUNKS * COLUMN_CHUNK_SIZE)
+#define CSV_STORE_FLUSH_LINES 4096
+
 csv_parser_config config;
 /**
 * Total lines parse
@@ -35,6 +42,28 @@ void parse_file(string fname);
 * @param files vector of filenames
 */
 void parse_files(vector<string> files);
+/**
+* Decodes the queued frames, writes the rows stored in the vehicle
+* in the csv files and adds them to the report
+*
+* @param vehicle selected in the config
+* @param batch decoder of the IMU and temperature frames
+* @param report filled if generate_report is set
+* @param csv_reader, report_reader stores readers of the vehicle
+*/
+void flush_store(Vehicle* vehicle, BatchDecoder& batch, Report& report, int csv_reader, int report_reader);
+/**
+* Writes a row with the values of all the signals of a DBC message,
+* the file is created at the first row
+*
+* @param dbc database
+* @param store containing the values
+* @param index of the message in the database
+* @param folder of the csv files
+* @param timestamp of the frame in nanoseconds
+* @param files one for each message of the database
+*/
+void write_dbc_row(const Dbc& dbc, const SignalStore& store, int index, const string& folder, int64_t timestamp, vector<fstream *>& files);
 
 // Add here a thread when is started
 vector<thread *> active_threads;
@@ -44,6 +73,11 @@ int main()
 
   string home = getenv("HOME");
   string config_path = home + "/csv_parser_config.json";
+  // Configs written before the vehicle selection are of Chimera
+  config.vehicle = "chimera";
+  // Whole logs
+  config.time_from = 0;
+  config.time_to = 0;
   if(fs::exists(config_path))
   {
     LoadJson(config, config_path);
@@ -54,6 +88,9 @@ int main()
     config.parse_gps = true;
     config.parse_candump = true;
     config.generate_report = true;
+    config.dbc_files = {};
+    config.time_from = 0;
+    config.time_to = 0;
     SaveJson(config, config_path);
   }
 
@@ -75,12 +112,26 @@ int main()
     cout << "\t" << get_colored(sel, 9, 1) << endl;
   cout << endl;
 
+  // Check the DBC files once, each thread loads its own database
+  for(auto& dbc_file : config.dbc_files)
+  {
+    SignalStore store;
+    Dbc dbc;
+    if(dbc.load(dbc_file, &store) < 0)
+    {
+      cout << get_colored("Failed loading DBC: " + dbc.get_error(), 1) << endl;
+      return -1;
+    }
+    cout << "DBC " << dbc_file << ": " << dbc.size() << " messages, " << store.size() << " signals" << endl;
+  }
+
   // Start the timer
   time_point t_start = high_resolution_clock::now();
   for (string path : selected_paths)
   {
-    // Get all the files with that extension
-    auto files = get_all_files(path, ".log");
+    // Get all the files, candumps are .log (text), .bin (binary), .zbin (compressed)
+    // or the manifest of the segments of a run, parsed in order as one log
+    auto files = get_all_files(path);
 
     // Select only candump files
     auto candump_files = get_candump_from_files(files);
@@ -146,6 +197,7 @@ void parse_file(string fname)
   int can_lines = 0;
   int gps_lines = 0;
   int lines_count = 0;
+  int frames = 0;
   Report report;
 
   string out_folder;
@@ -182,62 +234,156 @@ void parse_file(string fname)
     out_folder = base_folder + "/" + config.subfolder_name;
   }
   
-  create_directory(out_folder);
+  Vehicle* vehicle = new_vehicle(config.vehicle);
+  if(vehicle == nullptr)
+  {
+    cout << get_colored("Unknown vehicle: " + config.vehicle + " (chimera, fenice)", 1) << endl;
+    return;
+  }
 
-  Chimera chimera;
+  create_directory(out_folder);
 
   // Add csv files for each device
   // Open them
   // Write CSV header (column name)
-  chimera.add_filenames(out_folder, ".csv");
-  chimera.open_all_files();
-  chimera.write_all_headers(0);
-
-  // Get all lines
+  vehicle->add_filenames(out_folder, ".csv");
+  vehicle->open_all_files();
+  vehicle->write_all_headers(0);
+
+  // Messages defined in the DBC files are written in DBC/MessageName.csv
+  SignalStore store;
+  Dbc dbc;
+  for(auto& dbc_file : config.dbc_files)
+    dbc.load(dbc_file, &store);
+  vector<fstream *> dbc_files(dbc.size(), nullptr);
+  if(dbc.size() > 0)
+    create_directory(out_folder + "/DBC");
+
+  // Text candumps are read whole, binary, compressed and segmented ones a frame at a time
   message msg;
   vector<string> lines;
-  get_lines(fname, &lines);
-
-  // Contains devices modified from the CAN message
-  vector<Device *> modifiedDevices;
-
-  // Start Timer
-  double t_start = get_timestamp();
-  double prev_timestsamp;
-  if(config.parse_candump)
+  CandumpReader reader;
+  const bool use_reader = candump_is_binary(fname) || candump_is_compressed(fname) || candump_is_manifest(fname);
+  if(use_reader)
   {
-    for (uint32_t i = 20; i < lines.size(); i++)
+    if(!reader.open(fname))
+      cout << get_colored("Failed reading candump: " + fname, 1) << endl;
+  }
+  else
+    get_lines(fname, &lines);
+  // Bus of the vehicle of each interface: its position in the buses of the
+  // binary header, or the order of appearance, 0 if the candump has no names
+  vector<string> buses = reader.get_buses();
+  auto vehicle_bus = [&](const string& device) -> uint8_t {
+    if(device.empty())
+      return 0;
+    for(size_t bus = 0; bus < buses.size(); bus++)
+      if(buses[bus] == device)
+        return bus;
+    buses.push_back(device);
+    return buses.size() - 1;
+  };
+  // Skips the header of text candumps
+  size_t line_index = 20;
+  auto read_frame = [&](message* msg) -> bool {
+    if(use_reader)
+      return reader.next(msg);
+    while(line_index < lines.size())
     {
       // Try parsing the line
       try{
-        if (!parse_message(lines[i], &msg))
-          continue;
+        if(parse_message(lines[line_index++], msg))
+          return true;
       }
       catch(exception e)
       {
         continue;
       }
-      // Fill the devices
-      chimera.parse_message(msg.timestamp, msg.id, msg.data, msg.size, modifiedDevices);
+    }
+    return false;
+  };
+  // Frames from time_from to time_to (seconds from the first frame),
+  // segments before time_from are skipped, compressed candumps decode only the blocks from it
+  int64_t window_end = INT64_MAX;
+  bool first_frame = true;
+  auto next_frame = [&](message* msg) -> bool {
+    if(!read_frame(msg))
+      return false;
+    if(first_frame)
+    {
+      first_frame = false;
+      const int64_t first = msg->timestamp;
+      if(config.time_to > 0)
+        window_end = first + int64_t(config.time_to * 1e9);
+      const int64_t start = first + int64_t(config.time_from * 1e9);
+      if(use_reader && config.time_from > 0)
+      {
+        if(!reader.seek(start) || !reader.next(msg))
+          return false;
+      }
+      while(msg->timestamp < start)
+        if(!read_frame(msg))
+          return false;
+    }
+    return msg->timestamp <= window_end;
+  };
 
-      if (prev_timestsamp > msg.timestamp)
+
+  // Numeric devices are stored in columns and written in batches,
+  // the csv files and the report read them with separate readers
+  int csv_reader = vehicle->add_store_reader();
+  int report_reader = vehicle->add_store_reader();
+  // IMU and temperature frames are decoded in batches, directly in the store
+  BatchDecoder batch(vehicle);
+
+  // Start Timer
+  double t_start = get_timestamp();
+  int64_t prev_timestsamp = 0;
+  if(config.parse_candump)
+  {
+    for (uint32_t i = 0; next_frame(&msg); i++)
+    {
+      // Fill the devices, unknown ids would not modify any
+      const uint8_t bus = vehicle_bus(msg.device);
+      if(vehicle->is_known_id(bus, msg.id) && !batch.add(msg.timestamp, bus, msg.id, msg.data, msg.size))
       {
-        cout << fname << "\n";
-        cout << std::fixed << setprecision(9) << msg.timestamp << "\t";
-        cout << lines[i] << "\t" << i << endl;
+        // Devices without numeric fields (states) are written one sample at a time
+        const Device_Set_t& modified = vehicle->parse_message(msg.timestamp, bus, msg.id, msg.data, msg.size);
+        vehicle->store_samples(modified);
+        vehicle->for_each_device(modified, [](Device* device){
+          if(!device->has_fields())
+            *device->files[0] << device->get_string(",") + "\n";
+        });
       }
 
-      // For each device modified write the values in the csv file
-      for (auto modified : modifiedDevices)
+      int dbc_index = dbc.decode(msg.timestamp, msg.id, msg.data, msg.size);
+      if(dbc_index >= 0)
+        write_dbc_row(dbc, store, dbc_index, out_folder + "/DBC", msg.timestamp, dbc_files);
+
+      if (prev_timestsamp > msg.timestamp)
       {
-        *modified->files[0] << modified->get_string(",") + "\n";
-        if(config.generate_report)
-          report.AddDeviceSample(&chimera, modified);
+        cout << fname << "\n";
+        cout << timestamp_ns_to_string(msg.timestamp) << "\t";
+        cout << candump_frame_str(msg.id, msg.fd, msg.flags, msg.data, msg.size) << "\t" << i << endl;
       }
+
       prev_timestsamp = msg.timestamp;
+
+      if(i % CSV_STORE_FLUSH_LINES == 0)
+        flush_store(vehicle, batch, report, csv_reader, report_reader);
+      frames ++;
     }
+    flush_store(vehicle, batch, report, csv_reader, report_reader);
+
+    // Devices sent in more frames, rows with frames missing are partial.
+    // One string, threads of other logs print too
+    string groups = fname + " frame groups:\n";
+    for(auto device : vehicle->devices)
+      if(device->assembler.get_config().frames > 1)
+        groups += "\t" + device->get_name() + ": " + device->assembler.get_stats_string() + "\n";
+    cout << groups << flush;
   }
-  can_lines = lines.size();
+  can_lines = use_reader ? frames : lines.size();
 
   if(config.parse_gps)
   {
@@ -246,9 +392,11 @@ void parse_file(string fname)
       Gps* current_gps;
       
       if(fs::path(gps_file).filename().string().find("1") != string::npos)
-        current_gps = chimera.gps2;
+        current_gps = (Gps*)vehicle->find_device("gps2");
       else
-        current_gps = chimera.gps1;
+        current_gps = (Gps*)vehicle->find_device("gps1");
+      if(current_gps == nullptr)
+        continue;
 
       get_lines(gps_file, &lines);
       gps_message msg;
@@ -263,12 +411,12 @@ void parse_file(string fname)
           continue;
         }
 
-        int ret = chimera.parse_gps(current_gps, msg.timestamp, msg.message);
+        int ret = vehicle->parse_gps(current_gps, msg.timestamp, msg.message);
         if (ret == 1)
         {
           *current_gps->files[0] << current_gps->get_string(",") + "\n";
           if(config.generate_report)
-            report.AddDeviceSample(&chimera, current_gps);
+            report.AddDeviceSample(current_gps);
         }
       }
     }
@@ -279,7 +427,15 @@ void parse_file(string fname)
   lines_count = can_lines + gps_lines;
   double dt =  get_timestamp() - t_start;
   cout << "Parsed " << lines_count << " lines in: " << to_string(dt) << " -> " << lines_count / dt << " lines/sec" << endl;
-  chimera.close_all_files();
+  vehicle->close_all_files();
+  delete vehicle;
+  for(auto file : dbc_files)
+  {
+    if(file == nullptr)
+      continue;
+    file->close();
+    delete file;
+  }
 
   // Increment total lines
   total_lines += lines_count;
@@ -299,3 +455,32 @@ void parse_file(string fname)
   }
 
 }
+
+void flush_store(Vehicle* vehicle, BatchDecoder& batch, Report& report, int csv_reader, int report_reader)
+{
+  batch.flush();
+  vehicle->write_stored_rows(csv_reader, 0);
+  if(config.generate_report)
+    report.AddStoredRows(vehicle, report_reader);
+  else
+    vehicle->skip_stored(report_reader);
+}
+
+void write_dbc_row(const Dbc& dbc, const SignalStore& store, int index, const string& folder, int64_t timestamp, vector<fstream *>& files)
+{
+  const Dbc_Message_t& message = dbc.get_message(index);
+  if(files[index] == nullptr)
+  {
+    files[index] = new fstream(folder + "/" + message.name + ".csv", fstream::out);
+    *files[index] << "timestamp";
+    for(auto& signal : message.signals)
+      *files[index] << "," << signal.name;
+    *files[index] << "\n";
+  }
+
+  fstream& file = *files[index];
+  file << timestamp_ns_to_string(timestamp);
+  for(auto& signal : message.signals)
+    file << "," << store.get(signal.handle).value;
+  file << "\n";
+}
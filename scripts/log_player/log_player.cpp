@@ -23,7 +23,11 @@ void writer(string fname)
   close(fd);
 }
 
-int main(){
+// Usage: log_player [from] [to]
+// plays the frames from..to seconds from the first frame of the log
+int main(int argc, char** argv){
+  const double from = argc > 1 ? atof(argv[1]) : 0.0;
+  const double to = argc > 2 ? atof(argv[2]) : 0.0;
 
   CAN_DEVICE = "can0";
   can = new Can(CAN_DEVICE, &addr);
@@ -42,6 +46,8 @@ int main(){
     }
   }
   cout << "Opened Socket: " << CAN_DEVICE;
+  if(can->enable_fd() < 0)
+    cout << "CAN FD not supported, CAN FD frames will not be sent" << endl;
 
   signal(SIGPIPE, SIG_IGN);
 
@@ -66,7 +72,8 @@ int main(){
 
   Browse b;
   b.SetMaxSelections(1);
-  b.SetExtension(".log");
+  // candump.log, candump.bin, candump.zbin or candump.manifest.json of a segmented one
+  b.SetExtension("*");
   b.SetSelectionType(SelectionType::sel_all);
   auto selected_paths = b.Start();
 
@@ -80,21 +87,36 @@ int main(){
 
   for (auto file : selected_paths){
     message msg;
-    vector<string> lines;
-    get_lines(file, &lines);
+    vector<message> messages;
+    CandumpReader reader;
+    if(!reader.open(file))
+    {
+      cout << "Failed reading candump: " << file << endl;
+      continue;
+    }
+    if(reader.next(&msg))
+    {
+      // Compressed candumps decode only the blocks from the start time
+      const int64_t first = msg.timestamp;
+      const int64_t end = to > 0 ? first + int64_t(to * 1e9) : INT64_MAX;
+      bool has_frame = from > 0 ? reader.seek(first + int64_t(from * 1e9)) && reader.next(&msg) : true;
+      for(; has_frame && msg.timestamp <= end; has_frame = reader.next(&msg))
+        messages.push_back(msg);
+    }
+    cout << messages.size() << " frames" << endl;
+
     while(true)
     {
-      double prev_timestamp = -1;
+      int64_t prev_timestamp = -1;
       auto start_time = steady_clock::now();
-      for(int i = 20; i < lines.size(); i++){
-        if(!parse_message(lines [i], &msg))
-          continue;
-
-        
-        can->send(msg.id, (char*)msg.data, msg.size);
+      for(auto& msg : messages){
+        if(msg.fd)
+          can->send_fd(msg.id, (char*)msg.data, msg.size, msg.flags);
+        else
+          can->send(msg.id, (char*)msg.data, msg.size);
 
         if(prev_timestamp > 0){
-          usleep((msg.timestamp - prev_timestamp)*100000);
+          usleep((msg.timestamp - prev_timestamp) / 10000);
         }
 
         prev_timestamp = msg.timestamp;
@@ -23,6 +23,7 @@
 #include "can.h"
 #include "utils.h"
 #include "browse.h"
+#include "candump.h"
 
 using namespace std;
 using namespace std::chrono;
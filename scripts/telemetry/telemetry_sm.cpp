@@ -15,10 +15,16 @@ TelemetrySM::TelemetrySM()
 	StatesStr[ST_STOP]            = "ST_STOP";
 	StatesStr[ST_ERROR]           = "ST_ERROR";
 
-  can = nullptr;
-  dump_file = nullptr;
-  chimera = nullptr;
+  can_ring = nullptr;
+  can_ring_event = -1;
+  can_tail_offset = 0;
+  can_tail_count = 0;
+  // Signaled by ws requests, wakes up the CAN loop even if the bus is silent
+  state_event = eventfd(0, EFD_NONBLOCK);
+  log_writer = nullptr;
+  vehicle = nullptr;
   ws_cli = nullptr;
+  ingest_thread = nullptr;
   data_thread = nullptr;
   status_thread = nullptr;
   ws_conn_thread = nullptr;
@@ -32,6 +38,8 @@ TelemetrySM::TelemetrySM()
 TelemetrySM::~TelemetrySM()
 {
   EN_Deinitialize(nullptr);
+  if(state_event >= 0)
+    close(state_event);
 }
 
 void TelemetrySM::Init()
@@ -102,6 +110,29 @@ STATE_DEFINE(TelemetrySM, InitImpl, NoEventData)
   TEL_ERROR_CHECK
   CONSOLE.Log("Done");
 
+  CONSOLE.Log("Vehicle: ", tel_conf.vehicle);
+  vehicle = new_vehicle(tel_conf.vehicle);
+  if(vehicle == nullptr)
+  {
+    EmitError(TEL_UNKNOWN_VEHICLE);
+    return;
+  }
+
+  if(tel_conf.log_writer.enabled)
+  {
+    CONSOLE.Log("Starting log writer");
+    Async_Writer_Config_t writer_conf;
+    writer_conf.buffer_size = size_t(max(tel_conf.log_writer.buffer_kb, 4)) * 1024;
+    writer_conf.flush_period_ms = tel_conf.log_writer.flush_period_ms;
+    writer_conf.fsync = AsyncWriter::fsync_from_string(tel_conf.log_writer.fsync);
+    writer_conf.fsync_period_ms = tel_conf.log_writer.fsync_period_ms;
+    log_writer = new AsyncWriter(writer_conf);
+    log_writer->start();
+    PlaceThread("writer", log_writer->get_thread_handle());
+    vehicle->set_writer(log_writer);
+    CONSOLE.Log("Done");
+  }
+
   CONSOLE.Log("Opening log folders");
   FOLDER_PATH = HOME_PATH + "/logs";
   OpenLogFolder(FOLDER_PATH);
@@ -116,19 +147,34 @@ STATE_DEFINE(TelemetrySM, InitImpl, NoEventData)
     create_directory(FOLDER_PATH);
 
 
-  CAN_DEVICE = tel_conf.can_device;
-  CONSOLE.Log("Opening can socket");
-  can = new Can();
-  OpenCanSocket();
+  CAN_DEVICES = tel_conf.can_devices;
+  if(CAN_DEVICES.size() == 0)
+    CAN_DEVICES.push_back(tel_conf.can_device);
+  CONSOLE.Log("Opening can sockets");
+  OpenCanSockets();
   TEL_ERROR_CHECK
   CONSOLE.Log("Done");
 
+  CONSOLE.Log("Starting CAN ingest thread");
+  can_ring = new SpscRing<CAN_Frame_t>(CAN_RING_SIZE);
+  can_tail_count = 0;
+  can_ring_event = eventfd(0, 0);
+  ingest_thread = new thread(&TelemetrySM::CanIngest, this);
+  PlaceThread("ingest", ingest_thread->native_handle());
+  // This thread processes the frames (IdleImpl, RunImpl)
+  PlaceThread("main", pthread_self());
+  CONSOLE.Log("Done");
+
 
-  CONSOLE.Log("Chimera and WS instances");
-  chimera = new Chimera();
+  CONSOLE.Log("Store readers and WS instances");
+  csv_reader = vehicle->add_store_reader();
+  ws_reader = vehicle->add_store_reader();
+  serialize_timers.assign(vehicle->devices.size(), 0);
   ws_cli = new WebSocketClient();
   ws_conn_thread = new thread(&TelemetrySM::ConnectToWS, this);
   actions_thread = new thread(&TelemetrySM::ActionThread, this);
+  PlaceThread("ws_conn", ws_conn_thread->native_handle());
+  PlaceThread("actions", actions_thread->native_handle());
   CONSOLE.Log("DONE");
   TEL_ERROR_CHECK
 
@@ -137,7 +183,10 @@ STATE_DEFINE(TelemetrySM, InitImpl, NoEventData)
   usleep(100000);
   CONSOLE.Log("Starting gps loggers");
   for(auto logger : gps_loggers)
+  {
     logger->Start();
+    PlaceThread("gps", logger->GetThreadHandle());
+  }
   CONSOLE.Log("Done");
 
   if(tel_conf.camera_enable)
@@ -148,6 +197,11 @@ STATE_DEFINE(TelemetrySM, InitImpl, NoEventData)
     initData.width = 320;
     initData.height = 240;
     CONSOLE.Log("Initializing Camera");
+    string cam_cpus;
+    int cam_priority;
+    GetThreadPlacement("camera", cam_cpus, cam_priority);
+    if(tel_conf.thread_placement.enabled)
+      camera.SetSaveThreadPlacement(cam_cpus, cam_priority);
     camera.Init(&initData);
     CONSOLE.Log("Done");
 #endif
@@ -161,48 +215,76 @@ STATE_DEFINE(TelemetrySM, IdleImpl, NoEventData)
 {
   CONSOLE.LogStatus("IDLE");
 
-  can_frame message;
-  double timestamp;
-  vector<Device *> modifiedDevices;
+  static CAN_Frame_t frames[CAN_RX_BATCH];
+  uint32_t bus_count[CAN_MAX_BUSES];
 
-  string dev = can->get_device();
-  while (GetCurrentState() == ST_IDLE)
+  bool state_changed = false;
+  while (GetCurrentState() == ST_IDLE && !state_changed)
   {
-    can->receive(&message);
-    timestamp = get_timestamp();
-    msgs_counters[dev] ++;
-
-    if(wsRequestState == ST_UNINITIALIZED)
+    const bool from_tail = can_tail_count > 0;
+    int count = ReadCanRing(frames, CAN_RX_BATCH);
+    if(count <= 0)
     {
-      wsRequestState = ST_MAX_STATES;
-      InternalEvent(ST_UNINITIALIZED);
-      break;
+      // Woken up by a ws request
+      States requested = wsRequestState.load();
+      if(requested == ST_UNINITIALIZED || requested == ST_RUN)
+      {
+        wsRequestState = ST_MAX_STATES;
+        InternalEvent(requested);
+        state_changed = true;
+      }
+      continue;
     }
 
-    if(wsRequestState == ST_RUN || (message.can_id  == 0xA0 && message.can_dlc >= 2 &&
-      message.data[0] == 0x66 && message.data[1] == 0x01))
-    {
-      wsRequestState = ST_MAX_STATES;
-      InternalEvent(ST_RUN);
-      break;
-    }
+    // Frames left by the previous state were already counted
+    memset(bus_count, 0, sizeof(bus_count));
+    for(int i = 0; i < count && !from_tail; i++)
+      bus_count[frames[i].bus] ++;
+    for(size_t bus = 0; bus < cans.size(); bus++)
+      if(bus_count[bus] > 0)
+        msgs_counters[CAN_DEVICES[bus]] += bus_count[bus];
 
-    try{
-      chimera->parse_message(timestamp, message.can_id, message.data, message.can_dlc, modifiedDevices);
-    }
-    catch(std::exception ex)
+    for(int i = 0; i < count; i++)
     {
-      CONSOLE.LogError("Exception when parsing CAN message");
-      CONSOLE.LogError("CAN message: ", CanMessage2Str(message));
-      CONSOLE.LogError("Exception: ", ex.what());
-      continue;
-    }
+      const canfd_frame& message = frames[i].frame;
+      const int64_t& timestamp = frames[i].timestamp;
 
-    // For every device that has been modified by the parse operation
-    for (auto modified : modifiedDevices)
-    {
-      unique_lock<mutex> lck(mtx);
-      ProtoSerialize(timestamp, modified);
+      if(wsRequestState == ST_UNINITIALIZED)
+      {
+        wsRequestState = ST_MAX_STATES;
+        KeepCanTail(frames, i, count);
+        InternalEvent(ST_UNINITIALIZED);
+        state_changed = true;
+        break;
+      }
+
+      const bool start_frame = message.can_id  == 0xA0 && message.len >= 2 &&
+        message.data[0] == 0x66 && message.data[1] == 0x01;
+      if(wsRequestState == ST_RUN || start_frame)
+      {
+        wsRequestState = ST_MAX_STATES;
+        // The frames after the start command are the first of the run
+        KeepCanTail(frames, start_frame ? i + 1 : i, count);
+        InternalEvent(ST_RUN);
+        state_changed = true;
+        break;
+      }
+
+      // Frames not decoded by the vehicle would not modify any device
+      const uint8_t& bus = vehicle_bus[frames[i].bus];
+      if(!vehicle->is_known_id(bus, message.can_id))
+        continue;
+
+      try{
+        StoreSamples(timestamp, vehicle->parse_message(timestamp, bus, message.can_id, message.data, message.len));
+      }
+      catch(std::exception ex)
+      {
+        CONSOLE.LogError("Exception when parsing CAN message");
+        CONSOLE.LogError("CAN message: ", CanMessage2Str(message));
+        CONSOLE.LogError("Exception: ", ex.what());
+        continue;
+      }
     }
   }
   CONSOLE.LogStatus("IDLE DONE");
@@ -242,22 +324,62 @@ ENTRY_DEFINE(TelemetrySM, ToRun, NoEventData)
   }
   CONSOLE.Log("Loggers DONE");
 
-  dump_file = new std::fstream(CURRENT_LOG_FOLDER + "/" + "candump.log", std::fstream::out);
-  (*dump_file) << header << "\n";
+  Candump_Segment_Config_t dump_config;
+  if(tel_conf.can_log_format == "binary")
+    dump_config.format = CANDUMP_BINARY;
+  else if(tel_conf.can_log_format == "compressed")
+    dump_config.format = CANDUMP_COMPRESSED;
+  else if(tel_conf.can_log_format != "text")
+    CONSOLE.LogWarn("Unknown can_log_format", tel_conf.can_log_format, "using text");
+  dump_config.level = tel_conf.can_log_level;
+  dump_config.max_bytes = uint64_t(max(tel_conf.can_log_segment_mb, 0)) * 1000000;
+  dump_config.max_duration_ms = int64_t(max(tel_conf.can_log_segment_s, 0)) * 1000;
+  AsyncWriter* writer = log_writer;
+  auto open_file = [writer](const string& path) -> std::ostream*
+  {
+    if(writer != nullptr)
+      return new AsyncFile(writer, path);
+    return new std::fstream(path, std::fstream::out | std::fstream::binary);
+  };
+  // The segment is marked complete by the writer thread after it wrote and closed it,
+  // the CAN thread does not wait for it
+  auto close_file = [writer](std::ostream* out, CandumpSegmentWriter::File_Closed_Fn done)
+  {
+    if(writer != nullptr)
+    {
+      ((AsyncFile*)out)->close(false, done);
+      delete out;
+      return;
+    }
+    out->flush();
+    const bool written = !out->fail();
+    delete out;
+    done(written);
+  };
+  // Same metadata in every format, binary ones are converted back to candump.log as it would be
+  if(!dump.open(CURRENT_LOG_FOLDER, dump_config, header + "\n", CAN_DEVICES, open_file, close_file))
+    CONSOLE.LogError("Failed opening candump in", CURRENT_LOG_FOLDER);
 
   if(tel_conf.generate_csv)
   {
     if(!path_exists(CURRENT_LOG_FOLDER + "/Parsed"))
       create_directory(CURRENT_LOG_FOLDER + "/Parsed");
       
-    chimera->add_filenames(CURRENT_LOG_FOLDER + "/Parsed", ".csv");
-    chimera->open_all_files();
-    chimera->write_all_headers(0);
+    vehicle->add_filenames(CURRENT_LOG_FOLDER + "/Parsed", ".csv");
+    vehicle->open_all_files();
+    vehicle->write_all_headers(0);
+    // Rows stored while in idle are not written
+    vehicle->skip_stored(csv_reader);
   }
   CONSOLE.Log("CSV Done");
 
   can_stat.msg_count = 0;
   can_stat.duration = get_timestamp();
+  can_stat.start_batch_frames = can_tail_count;
+  can_stat.start_batch_logged = 0;
+  for(auto can : cans)
+    can->reset_rx_stat();
+  can_ring->reset_stat();
 
   for(auto logger : gps_loggers)
     logger->StartLogging();
@@ -279,59 +401,82 @@ STATE_DEFINE(TelemetrySM, RunImpl, NoEventData)
 {
   CONSOLE.LogStatus("RUN");
 
-  static can_frame message;
-  double timestamp;
-  vector<Device *> modifiedDevices;
+  static CAN_Frame_t frames[CAN_RX_BATCH];
+  uint32_t bus_count[CAN_MAX_BUSES];
 
-  string dev = can->get_device();
-  while(GetCurrentState() == ST_RUN)
+  bool state_changed = false;
+  while(GetCurrentState() == ST_RUN && !state_changed)
   {
-    timestamp = get_timestamp();
-    can->receive(&message);
-    can_stat.msg_count++;
-    msgs_counters[dev] ++;
+    const bool from_tail = can_tail_count > 0;
+    int count = ReadCanRing(frames, CAN_RX_BATCH);
+    if(count <= 0)
+    {
+      // Woken up by a ws request
+      if(wsRequestState == ST_STOP)
+      {
+        wsRequestState = ST_MAX_STATES;
+        InternalEvent(ST_STOP);
+        state_changed = true;
+      }
+      continue;
+    }
+    can_stat.msg_count += count;
 
+    // Frames left by the previous state were already counted
+    memset(bus_count, 0, sizeof(bus_count));
+    for(int i = 0; i < count && !from_tail; i++)
+      bus_count[frames[i].bus] ++;
+    for(size_t bus = 0; bus < cans.size(); bus++)
+      if(bus_count[bus] > 0)
+        msgs_counters[CAN_DEVICES[bus]] += bus_count[bus];
 
-    LogCan(timestamp, message);
+    for(int i = 0; i < count; i++)
+    {
+      const canfd_frame& message = frames[i].frame;
+      const int64_t& timestamp = frames[i].timestamp;
 
+      LogCan(timestamp, frames[i].bus, message);
+      if(from_tail)
+        can_stat.start_batch_logged ++;
 
-    // Parse the message only if is needed
-    // Parsed messages are for sending via websocket or to be logged in csv
-    if(tel_conf.generate_csv || tel_conf.ws_enabled)
-    {
-      try{
-        chimera->parse_message(timestamp, message.can_id, message.data, message.can_dlc, modifiedDevices);
-      }
-      catch(std::exception ex)
-      {
-        CONSOLE.LogError("Exception when parsing CAN message");
-        CONSOLE.LogError("CAN message: ", CanMessage2Str(message));
-        CONSOLE.LogError("Exception: ", ex.what());
-        continue;
-      }
 
-      // For every device that has been modified by the parse operation
-      for (auto modified : modifiedDevices)
+      // Parse the message only if is needed
+      // Parsed messages are for sending via websocket or to be logged in csv
+      // Frames not decoded by the vehicle are only logged
+      const uint8_t& bus = vehicle_bus[frames[i].bus];
+      if((tel_conf.generate_csv || tel_conf.ws_enabled) && vehicle->is_known_id(bus, message.can_id))
       {
-        unique_lock<mutex> lck(mtx);
-
-        if(tel_conf.generate_csv &&
-          modified->files.size() > 0 && modified->files[0] != nullptr)
+        try{
+          StoreSamples(timestamp, vehicle->parse_message(timestamp, bus, message.can_id, message.data, message.len));
+        }
+        catch(std::exception ex)
         {
-          (*modified->files[0]) << modified->get_string(",") + "\n";
+          CONSOLE.LogError("Exception when parsing CAN message");
+          CONSOLE.LogError("CAN message: ", CanMessage2Str(message));
+          CONSOLE.LogError("Exception: ", ex.what());
+          continue;
         }
+      }
 
-        ProtoSerialize(timestamp, modified);
+      // Stop message
+      if (wsRequestState == ST_STOP || (message.can_id  == 0xA0 && message.len >= 2 &&
+          message.data[0] == 0x66 && message.data[1] == 0x00))
+      {
+        wsRequestState = ST_MAX_STATES;
+        // The frames after the stop command are processed in idle, not logged
+        KeepCanTail(frames, i + 1, count);
+        can_stat.msg_count -= count - (i + 1);
+        InternalEvent(ST_STOP);
+        state_changed = true;
+        break;
       }
     }
 
-    // Stop message
-    if (wsRequestState == ST_STOP || (message.can_id  == 0xA0 && message.can_dlc >= 2 &&
-        message.data[0] == 0x66 && message.data[1] == 0x00))
+    // Rows of the numeric devices are written once for each batch of frames
+    if(tel_conf.generate_csv)
     {
-      wsRequestState = ST_MAX_STATES;
-      InternalEvent(ST_STOP);
-      break;
+      unique_lock<mutex> lck(mtx);
+      vehicle->write_stored_rows(csv_reader, 0);
     }
   }
   CONSOLE.LogStatus("RUN DONE");
@@ -344,14 +489,39 @@ STATE_DEFINE(TelemetrySM, StopImpl, NoEventData)
   unique_lock<mutex> lck(mtx);
   // duration of the log
   can_stat.duration = get_timestamp() - can_stat.duration;
+  if(can_stat.start_batch_logged != can_stat.start_batch_frames)
+    CONSOLE.LogError("Frames received with the start command not logged:",
+                     can_stat.start_batch_frames - can_stat.start_batch_logged, "of", can_stat.start_batch_frames);
 
   CONSOLE.Log("Closing files");
   if(tel_conf.generate_csv){
+    if(vehicle->get_lost_rows(csv_reader) > 0)
+      CONSOLE.LogWarn("CSV rows lost: ", vehicle->get_lost_rows(csv_reader));
+    // Devices sent in more frames, rows with frames missing are partial
+    for(auto device : vehicle->devices)
+    {
+      if(device->assembler.get_config().frames <= 1)
+        continue;
+      if(device->assembler.get_stats().partial > 0)
+        CONSOLE.LogWarn(device->get_name(), "frame groups:", device->assembler.get_stats_string());
+      else
+        CONSOLE.Log(device->get_name(), "frame groups:", device->assembler.get_stats_string());
+    }
     // Close all csv files and the dump file
-    chimera->close_all_files();
+    vehicle->close_all_files();
+  }
+  // Last segment (block and index) and manifest, the async files are written by the writer thread
+  dump.close();
+  if(tel_conf.can_log_format == "compressed")
+  {
+    const Candump_Block_Stats_t stat = dump.get_block_stats();
+    CONSOLE.Log("candump.zbin", stat.blocks, "blocks", double(stat.raw_bytes) / max(stat.compressed_bytes, uint64_t(1)), "x smaller,",
+                stat.compress_ns / 1e6 / max(stat.raw_bytes / 1e6, 1e-6), "ms CPU per MB");
   }
-  dump_file->close();
-  delete dump_file;
+  if(dump.get_segments().size() > 1)
+    CONSOLE.Log("candump", dump.get_segments().size(), "segments");
+  if(dump.get_errors() > 0)
+    CONSOLE.LogWarn("candump", dump.get_errors(), "segments or manifest writes failed");
   CONSOLE.Log("Done");
 
   CONSOLE.Log("Restarting gps loggers");
@@ -404,6 +574,25 @@ ENTRY_DEFINE(TelemetrySM, Deinitialize, NoEventData)
   }
   CONSOLE.Log("Stopped actions thread");
 
+  if(ingest_thread != nullptr)
+  {
+    if(ingest_thread->joinable())
+      ingest_thread->join();
+    delete ingest_thread;
+    ingest_thread = nullptr;
+  }
+  if(can_ring_event >= 0)
+  {
+    close(can_ring_event);
+    can_ring_event = -1;
+  }
+  if(can_ring != nullptr)
+  {
+    delete can_ring;
+    can_ring = nullptr;
+  }
+  CONSOLE.Log("Stopped CAN ingest thread");
+
   if(data_thread != nullptr)
   {
     if(data_thread->joinable())
@@ -445,22 +634,17 @@ ENTRY_DEFINE(TelemetrySM, Deinitialize, NoEventData)
   }
   CONSOLE.Log("Stopped connection");
 
-  if(dump_file != nullptr)
-  {
-    if(dump_file->is_open())
-      dump_file->close();
-    delete dump_file;
-    dump_file = nullptr;
-  }
+  dump.close();
   CONSOLE.Log("Closed dump file");
 
-  if(can != nullptr && can->is_open())
+  for(auto can : cans)
   {
-    can->close_socket();
+    if(can->is_open())
+      can->close_socket();
     delete can;
-    can = nullptr;
   }
-  CONSOLE.Log("Closed can socket");
+  cans.clear();
+  CONSOLE.Log("Closed can sockets");
 
   for(int i = 0; i < gps_loggers.size(); i++)
   {
@@ -473,18 +657,27 @@ ENTRY_DEFINE(TelemetrySM, Deinitialize, NoEventData)
   gps_loggers.resize(0);
   CONSOLE.Log("Closed gps loggers");
 
-  if(chimera != nullptr)
+  if(vehicle != nullptr)
   {
-    chimera->clear_serialized();
-    chimera->close_all_files();
-    delete chimera;
-    chimera = nullptr;
+    vehicle->clear_serialized();
+    vehicle->close_all_files();
+    delete vehicle;
+    vehicle = nullptr;
   }
   CONSOLE.Log("Deleted vehicle");
 
+  if(log_writer != nullptr)
+  {
+    // Writes what is left of the closed files
+    log_writer->stop();
+    delete log_writer;
+    log_writer = nullptr;
+  }
+  CONSOLE.Log("Stopped log writer");
+
   msgs_counters.clear();
   msgs_per_second.clear();
-  timers.clear();
+  serialize_timers.clear();
 
   ws_conn_state = ConnectionState_::NONE;
   currentError = TelemetryError::TEL_NONE;
@@ -509,11 +702,28 @@ void TelemetrySM::EmitError(TelemetryError error)
   InternalEvent(ST_ERROR);
 }
 
+// Values of the Async_Writer_Config_t defaults, also for configs without log_writer
+static void SetLogWriterDefaults(_log_writer_& log_writer)
+{
+  log_writer.enabled = true;
+  log_writer.buffer_kb = 1024;
+  log_writer.flush_period_ms = 500;
+  log_writer.fsync = "close";
+  log_writer.fsync_period_ms = 1000;
+}
+
 // Load all configuration files
 // If the file doesn't exist create it
 void TelemetrySM::LoadAllConfig()
 {
   string path = HOME_PATH + "/telemetry_config.json";
+  // Configs written before the vehicle selection are of Chimera
+  tel_conf.vehicle = "chimera";
+  tel_conf.can_log_format = "text";
+  tel_conf.can_log_level = CANDUMP_ZLIB_LEVEL;
+  tel_conf.can_log_segment_mb = 64;
+  tel_conf.can_log_segment_s = 60;
+  SetLogWriterDefaults(tel_conf.log_writer);
   if(path_exists(path))
   {
     if(LoadJson(tel_conf, path))
@@ -522,7 +732,23 @@ void TelemetrySM::LoadAllConfig()
       EmitError(TEL_LOAD_CONFIG_TELEMETRY);
   }else{
     CONSOLE.Log("Created: " + path);
+    tel_conf.vehicle = "chimera";
     tel_conf.can_device = "can0";
+    tel_conf.can_devices = {"can0"};
+    tel_conf.can_filters.enabled = false;
+    tel_conf.can_rcvbuf_bytes = 0;
+    tel_conf.can_capture = "socket";
+    tel_conf.can_log_format = "text";
+    tel_conf.can_log_level = CANDUMP_ZLIB_LEVEL;
+    tel_conf.can_log_segment_mb = 64;
+    tel_conf.can_log_segment_s = 60;
+    SetLogWriterDefaults(tel_conf.log_writer);
+    // CAN ingest alone on the last core, other threads on the remaining ones
+    tel_conf.thread_placement.enabled = true;
+    tel_conf.thread_placement.threads = {"ingest"};
+    tel_conf.thread_placement.cpus = {to_string(std::thread::hardware_concurrency() - 1)};
+    tel_conf.thread_placement.priorities = {0};
+    tel_conf.can_timestamping = "software";
     tel_conf.generate_csv = false;
     tel_conf.ws_enabled = true;
     tel_conf.ws_send_sensor_data = true;
@@ -580,9 +806,65 @@ void TelemetrySM::SaveStat()
     val.AddMember("Messages", can_stat.msg_count, alloc);
     val.AddMember("Average Frequency (Hz)", int(double(can_stat.msg_count) / can_stat.duration), alloc);
     val.AddMember("Duration (seconds)", can_stat.duration, alloc);
+    val.AddMember("Start batch frames", can_stat.start_batch_frames, alloc);
+    val.AddMember("Start batch frames logged", can_stat.start_batch_logged, alloc);
+
+    CAN_Rx_Stat_t rx_stat = GetRxStat();
+    val.AddMember("Receive batches", rx_stat.batches, alloc);
+    val.AddMember("Full batches", rx_stat.full_batches, alloc);
+    val.AddMember("Truncated frames", rx_stat.truncated, alloc);
+    val.AddMember("CAN FD frames", rx_stat.fd_frames, alloc);
+    val.AddMember("Socket drops", rx_stat.drops, alloc);
+    val.AddMember("Ring high water mark", uint64_t(can_ring->high_water_mark()), alloc);
+    val.AddMember("Ring overflows", can_ring->overflows(), alloc);
   }
   doc.AddMember("CAN", val, alloc);
 
+  if(log_writer != nullptr)
+  {
+    Async_Writer_Stats_t writer_stat = log_writer->get_stats();
+    Value writer(kObjectType);
+    writer.AddMember("Bytes", writer_stat.bytes, alloc);
+    writer.AddMember("Writes", writer_stat.writes, alloc);
+    writer.AddMember("Fsyncs", writer_stat.fsyncs, alloc);
+    writer.AddMember("Max queue depth", writer_stat.max_queue_depth, alloc);
+    writer.AddMember("Worst write (ms)", writer_stat.worst_write_ns / 1e6, alloc);
+    writer.AddMember("Worst fsync (ms)", writer_stat.worst_fsync_ns / 1e6, alloc);
+    writer.AddMember("Stalls", writer_stat.stalls, alloc);
+    writer.AddMember("Worst stall (ms)", writer_stat.worst_stall_ns / 1e6, alloc);
+    writer.AddMember("Errors", writer_stat.errors, alloc);
+    doc.AddMember("Log writer", writer, alloc);
+  }
+
+  Value segments(kObjectType);
+  {
+    uint64_t frames = 0;
+    uint64_t bytes = 0;
+    for(auto& segment : dump.get_segments())
+    {
+      frames += segment.frames;
+      bytes += segment.bytes;
+    }
+    segments.AddMember("Segments", uint64_t(dump.get_segments().size()), alloc);
+    segments.AddMember("Frames", frames, alloc);
+    segments.AddMember("Bytes", bytes, alloc);
+    segments.AddMember("Errors", dump.get_errors(), alloc);
+  }
+  doc.AddMember("candump", segments, alloc);
+
+  if(tel_conf.can_log_format == "compressed")
+  {
+    const Candump_Block_Stats_t stat = dump.get_block_stats();
+    Value compression(kObjectType);
+    compression.AddMember("Level", tel_conf.can_log_level, alloc);
+    compression.AddMember("Blocks", stat.blocks, alloc);
+    compression.AddMember("Records bytes", stat.raw_bytes, alloc);
+    compression.AddMember("File bytes", stat.compressed_bytes, alloc);
+    compression.AddMember("CPU ms per MB", stat.raw_bytes > 0 ? stat.compress_ns / 1e6 / (stat.raw_bytes / 1e6) : 0.0, alloc);
+    compression.AddMember("Worst block (ms)", stat.worst_block_ns / 1e6, alloc);
+    doc.AddMember("candump.zbin", compression, alloc);
+  }
+
   doc.Accept(writer);
   std::ofstream stat_f(CURRENT_LOG_FOLDER + "/CAN_Info.json");
   stat_f << json_ss.GetString();
@@ -618,14 +900,14 @@ void TelemetrySM::CreateFolderName(string& out)
 
   out = s;
 }
-void TelemetrySM::LogCan(const double& timestamp, const can_frame& msg)
+void TelemetrySM::LogCan(const int64_t& timestamp, const uint8_t& bus, const canfd_frame& msg)
 {
-  string line = "";
-  line += "(" + to_string(timestamp) + ")\t" + CAN_DEVICE + "\t";
-  line += CanMessage2Str(msg);
-  line += "\n";
-
-  (*dump_file) << line;
+  uint8_t flags = msg.flags & (CANFD_BRS | CANFD_ESI);
+  if(msg.flags & CANFD_FDF)
+    flags |= CANDUMP_FLAG_FD;
+  // Text formatted without allocations, blocks compressed here when full.
+  // A new segment (and the manifest) is written before the frame that exceeds the limits
+  dump.write(timestamp, bus, msg.can_id, flags, msg.data, msg.len);
 }
 
 string TelemetrySM::GetDate()
@@ -648,17 +930,11 @@ string TelemetrySM::GetTime()
   ss << std::put_time(&ltm, "%H:%M:%S");
   return ss.str();
 }
-string TelemetrySM::CanMessage2Str(const can_frame& msg)
+string TelemetrySM::CanMessage2Str(const canfd_frame& msg)
 {
-  string out = "";
   // Format message as ID#<payload>
-  // Hexadecimal representation
-  out += get_hex(int(msg.can_id), 3) + "#";
-  for (int i = 0; i < msg.can_dlc; i++)
-  {
-    out += get_hex(int(msg.data[i]), 2);
-  }
-  return out;
+  // CAN FD as ID##<flags><payload> (same as candump)
+  return candump_frame_str(msg.can_id, msg.flags & CANFD_FDF, msg.flags, msg.data, msg.len);
 }
 
 
@@ -673,23 +949,329 @@ void TelemetrySM::OpenLogFolder(const string& path)
   }
 }
 
-void TelemetrySM::OpenCanSocket()
+bool TelemetrySM::OpenCanSocket(Can* can, const string& device, sockaddr_can* addr)
 {
-  can->init(CAN_DEVICE.c_str(), &addr);
-
+  can->init(device.c_str(), addr);
   if (can->open_socket() < 0)
   {
-    CONSOLE.LogWarn("Failed binding socket: ", CAN_DEVICE);
-    CAN_DEVICE = "vcan0";
-    can->init(CAN_DEVICE.c_str(), &addr);
-    if (can->open_socket() < 0)
+    CONSOLE.LogWarn("Failed binding socket: ", device);
+    return false;
+  }
+  CONSOLE.Log("Opened Socket: ", device);
+
+  if(can->enable_fd() < 0)
+    CONSOLE.LogWarn("CAN FD not supported, receiving only classic frames", device);
+
+  if(tel_conf.can_rcvbuf_bytes > 0)
+  {
+    if(can->set_receive_buffer(tel_conf.can_rcvbuf_bytes) < 0)
+      CONSOLE.LogWarn("Failed setting CAN receive buffer", device);
+  }
+  CONSOLE.Log("CAN receive buffer (bytes):", can->get_receive_buffer(), device);
+
+  // Kernel filters, frames not matching are dropped before waking up the ingest
+  // (also with the mmap capture, where they are attached as BPF)
+  if(tel_conf.can_filters.enabled)
+  {
+    vector<can_filter> filters;
+    const auto& ids = tel_conf.can_filters.ids;
+    const auto& masks = tel_conf.can_filters.masks;
+    for(size_t i = 0; i < ids.size(); i++)
     {
-      CONSOLE.LogWarn("Failed binding socket: ", CAN_DEVICE);
+      can_filter filter;
+      filter.can_id = ids[i];
+      // Missing mask matches the exact standard id
+      filter.can_mask = i < masks.size() ? masks[i] : CAN_SFF_MASK;
+      filters.push_back(filter);
+    }
+    if(can->set_filters(filters) < 0)
+      CONSOLE.LogWarn("Failed setting CAN filters", device);
+    else
+      CONSOLE.Log("CAN filters set:", filters.size(), device);
+  }
+
+  CanTimestampMode ts_mode = CAN_TS_SOFTWARE;
+  if(tel_conf.can_timestamping == "userspace")
+    ts_mode = CAN_TS_USERSPACE;
+  else if(tel_conf.can_timestamping == "hardware")
+    ts_mode = CAN_TS_HARDWARE;
+  if(can->set_timestamping(ts_mode) < 0)
+    CONSOLE.LogWarn("Kernel timestamps not available, using userspace clock", device);
+
+  if(tel_conf.can_capture == "mmap")
+  {
+    if(can->open_mmap(CAN_MMAP_BLOCK_SIZE, CAN_MMAP_BLOCK_COUNT) < 0)
+      CONSOLE.LogWarn("Failed opening mmap capture, using socket", device, errno);
+    else
+      CONSOLE.Log("Opened mmap capture: ", device);
+  }
+  return true;
+}
+
+void TelemetrySM::OpenCanSockets()
+{
+  if(CAN_DEVICES.size() > CAN_MAX_BUSES)
+  {
+    CONSOLE.LogWarn("Too many CAN devices, using the first", CAN_MAX_BUSES);
+    CAN_DEVICES.resize(CAN_MAX_BUSES);
+  }
+
+  // Interfaces that can't be opened are skipped,
+  // CAN_DEVICES is kept in the same order as cans (bus index)
+  vector<string> opened;
+  for(size_t i = 0; i < CAN_DEVICES.size(); i++)
+  {
+    Can* can = new Can();
+    if(OpenCanSocket(can, CAN_DEVICES[i], &addrs[cans.size()]))
+    {
+      vehicle_bus[cans.size()] = i;
+      cans.push_back(can);
+      opened.push_back(CAN_DEVICES[i]);
+    }
+    else
+      delete can;
+  }
+
+  if(cans.size() == 0)
+  {
+    Can* can = new Can();
+    if(!OpenCanSocket(can, "vcan0", &addrs[0]))
+    {
+      delete can;
       EmitError(TEL_CAN_SOCKET_OPEN);
       return;
     }
+    vehicle_bus[0] = 0;
+    cans.push_back(can);
+    opened.push_back("vcan0");
+  }
+
+  CAN_DEVICES = opened;
+}
+
+CAN_Rx_Stat_t TelemetrySM::GetRxStat()
+{
+  CAN_Rx_Stat_t total;
+  memset(&total, 0, sizeof(total));
+  for(auto can : cans)
+  {
+    const CAN_Rx_Stat_t rx_stat = can->get_rx_stat();
+    total.frames += rx_stat.frames;
+    total.batches += rx_stat.batches;
+    total.full_batches += rx_stat.full_batches;
+    total.truncated += rx_stat.truncated;
+    total.fd_frames += rx_stat.fd_frames;
+    total.drops += rx_stat.drops;
   }
-  CONSOLE.Log("Opened Socket: ", CAN_DEVICE);
+  return total;
+}
+
+// Only reads the CAN sockets and moves frames in the ring,
+// everything else is done by the consumer (IdleImpl/RunImpl).
+// All buses are served by this thread with a single epoll.
+void TelemetrySM::CanIngest()
+{
+  static canfd_frame messages[CAN_RX_BATCH];
+  static int64_t timestamps[CAN_RX_BATCH];
+  static CAN_Frame_t frames[CAN_RX_BATCH];
+  const uint64_t event = 1;
+
+  int epoll_fd = epoll_create1(0);
+  for(size_t bus = 0; bus < cans.size(); bus++)
+  {
+    epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u32 = bus;
+    if(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, cans[bus]->get_socket(), &ev) < 0)
+      CONSOLE.LogError("Failed adding CAN socket to epoll", CAN_DEVICES[bus]);
+  }
+
+  epoll_event events[CAN_MAX_BUSES];
+  while(kill_threads.load() == false)
+  {
+    // Timeout only to check kill_threads
+    int ready = epoll_wait(epoll_fd, events, CAN_MAX_BUSES, 100);
+    for(int e = 0; e < ready; e++)
+    {
+      uint8_t bus = events[e].data.u32;
+      if(cans[bus]->is_mmap())
+      {
+        CanIngestMmap(bus);
+        continue;
+      }
+
+      int count = cans[bus]->receive_batch(messages, CAN_RX_BATCH, timestamps);
+      if(count <= 0)
+        continue;
+
+      for(int i = 0; i < count; i++)
+      {
+        frames[i].timestamp = timestamps[i];
+        frames[i].bus = bus;
+        frames[i].frame = messages[i];
+      }
+      can_ring->push(frames, count);
+
+      // Wake up the consumer
+      if(write(can_ring_event, &event, sizeof(event)) < 0)
+        CONSOLE.LogError("CAN ring event write failed", errno);
+    }
+  }
+  close(epoll_fd);
+}
+
+void TelemetrySM::GetThreadPlacement(const string& name, string& cpus, int& priority)
+{
+  const auto& placement = tel_conf.thread_placement;
+  cpus = "";
+  priority = 0;
+  if(!placement.enabled)
+    return;
+
+  for(size_t i = 0; i < placement.threads.size(); i++)
+  {
+    if(placement.threads[i] != name)
+      continue;
+    if(i < placement.cpus.size())
+      cpus = placement.cpus[i];
+    if(i < placement.priorities.size())
+      priority = placement.priorities[i];
+  }
+
+  // Threads without cpus are kept away from the ingest cores
+  if(cpus == "" && name != "ingest")
+  {
+    string ingest_cpus;
+    int ingest_priority;
+    GetThreadPlacement("ingest", ingest_cpus, ingest_priority);
+
+    cpu_set_t ingest_set;
+    if(ingest_cpus != "" && parse_cpu_list(ingest_cpus, &ingest_set))
+    {
+      cpu_set_t others;
+      CPU_ZERO(&others);
+      int cpu_count = std::thread::hardware_concurrency();
+      for(int cpu = 0; cpu < cpu_count && cpu < CPU_SETSIZE; cpu++)
+        if(!CPU_ISSET(cpu, &ingest_set))
+          CPU_SET(cpu, &others);
+      if(CPU_COUNT(&others) > 0)
+        cpus = cpu_list_str(others);
+    }
+  }
+}
+
+void TelemetrySM::PlaceThread(const string& name, pthread_t handle)
+{
+  // Visible in top/htop (max 15 chars)
+  pthread_setname_np(handle, ("tel_" + name).substr(0, 15).c_str());
+
+  if(!tel_conf.thread_placement.enabled)
+    return;
+
+  string cpus;
+  int priority;
+  GetThreadPlacement(name, cpus, priority);
+
+  if(cpus != "")
+  {
+    cpu_set_t set;
+    int ret = -1;
+    if(parse_cpu_list(cpus, &set))
+      ret = set_thread_affinity(handle, set);
+    if(ret != 0)
+      CONSOLE.LogWarn("Failed setting cpus of thread", name, cpus, ret);
+  }
+  // Always set: threads inherit the scheduling of their creator,
+  // which is SCHED_FIFO if main has a priority
+  if(set_thread_priority(handle, priority) != 0)
+    CONSOLE.LogWarn("Failed setting scheduling of thread", name, priority > 0 ? "SCHED_FIFO" : "SCHED_OTHER", priority);
+
+  CONSOLE.Log("Thread", name, thread_placement_str(handle));
+}
+
+// Moves all the ready blocks of the mapped ring to the CAN ring,
+// frames are copied only once, from the mapped block into the ring slots
+void TelemetrySM::CanIngestMmap(const uint8_t& bus)
+{
+  static CAN_Mmap_Frame_t mapped[CAN_RX_BATCH];
+  const uint64_t event = 1;
+
+  int count;
+  bool pushed = false;
+  while((count = cans[bus]->receive_mmap(mapped, CAN_RX_BATCH)) > 0)
+  {
+    size_t fit = min((size_t)count, can_ring->free_slots());
+    for(size_t i = 0; i < fit; i++)
+    {
+      const canfd_frame* frame = mapped[i].frame;
+      CAN_Frame_t* slot = can_ring->slot(i);
+      slot->timestamp = mapped[i].timestamp;
+      slot->bus = bus;
+      // Classic frames are only CAN_MTU bytes in the mapped ring
+      memcpy(&slot->frame, frame, (frame->flags & CANFD_FDF) ? CANFD_MTU : CAN_MTU);
+    }
+    can_ring->publish(fit, count - fit);
+    pushed = true;
+  }
+
+  // Wake up the consumer
+  if(pushed && write(can_ring_event, &event, sizeof(event)) < 0)
+    CONSOLE.LogError("CAN ring event write failed", errno);
+}
+
+// Keeps frames[from, count) to be read first by the next state
+void TelemetrySM::KeepCanTail(const CAN_Frame_t* frames, const int& from, const int& count)
+{
+  can_tail_offset = 0;
+  can_tail_count = from < count ? count - from : 0;
+  if(can_tail_count > 0)
+    memcpy(can_tail, frames + from, can_tail_count * sizeof(CAN_Frame_t));
+}
+
+// Pops frames from the ring, sleeps if it is empty
+int TelemetrySM::ReadCanRing(CAN_Frame_t* frames, size_t max)
+{
+  // Frames left by the previous state, in order before the ring
+  if(can_tail_count > 0)
+  {
+    size_t count = min(max, can_tail_count);
+    memcpy(frames, can_tail + can_tail_offset, count * sizeof(CAN_Frame_t));
+    can_tail_offset += count;
+    can_tail_count -= count;
+    return count;
+  }
+
+  size_t count = can_ring->pop(frames, max);
+  if(count > 0)
+    return count;
+
+  // Sleeps until new frames or a state request
+  pollfd fds[2];
+  fds[0].fd = can_ring_event;
+  fds[0].events = POLLIN;
+  fds[1].fd = state_event;
+  fds[1].events = POLLIN;
+  if(poll(fds, 2, -1) < 0)
+    return -1;
+
+  uint64_t events;
+  if(fds[1].revents & POLLIN)
+  {
+    if(read(state_event, &events, sizeof(events)) < 0)
+      CONSOLE.LogError("State event read failed", errno);
+    return 0;
+  }
+  if(read(can_ring_event, &events, sizeof(events)) < 0)
+    return -1;
+  return can_ring->pop(frames, max);
+}
+
+void TelemetrySM::RequestState(States state)
+{
+  wsRequestState = state;
+  const uint64_t event = 1;
+  if(write(state_event, &event, sizeof(event)) < 0)
+    CONSOLE.LogError("State event write failed", errno);
 }
 
 
@@ -707,11 +1289,14 @@ void TelemetrySM::SetupGps()
 
     CONSOLE.Log("Initializing ", dev, mode, enabled);
 
-    int id;
-    if(i == 0)
-      id = chimera->gps1->get_id();
-    else if(i == 1)
-      id = chimera->gps2->get_id();
+    // gps1, gps2... of the vehicle
+    Device* device = vehicle->find_device("gps" + to_string(i + 1));
+    if(device == nullptr)
+    {
+      CONSOLE.LogWarn("No device for gps", i + 1, "in", vehicle->get_name());
+      continue;
+    }
+    int id = device->get_id();
 
     GpsLogger* gps = new GpsLogger(id, dev);
     gps->SetOutFName("gps_" + to_string(i));
@@ -722,6 +1307,7 @@ void TelemetrySM::SetupGps()
     else
       gps->SetMode(MODE_PORT);
     gps->SetCallback(bind(&TelemetrySM::OnGpsLine, this, std::placeholders::_1, std::placeholders::_2));
+    gps->SetWriter(log_writer);
 
     gps_loggers.push_back(gps);
   }
@@ -732,18 +1318,21 @@ void TelemetrySM::OnGpsLine(int id, string line)
 {
   Gps* gps;
 
-  // Selecting one of chimera GPS
-  if(id == chimera->gps1->get_id())
-    gps = chimera->gps1;
-  else if(id == chimera->gps2->get_id())
-    gps = chimera->gps2;
-  else
+  // Selecting one of the vehicle GPS
+  gps = nullptr;
+  for(auto role : {"gps1", "gps2"})
+  {
+    Device* device = vehicle->find_device(role);
+    if(device != nullptr && device->get_id() == id)
+      gps = (Gps*)device;
+  }
+  if(gps == nullptr)
     return;
 
   // Parsing GPS data
   int ret = 0;
   try{
-    ret = chimera->parse_gps(gps, get_timestamp(), line);
+    ret = vehicle->parse_gps(gps, get_timestamp(), line);
   }
   catch(std::exception e)
   {
@@ -764,7 +1353,7 @@ void TelemetrySM::OnGpsLine(int id, string line)
       (*gps->files[0]) << gps->get_string(",") + "\n" << flush;
     }
     if(tel_conf.ws_send_sensor_data)
-      chimera->serialize_device(gps);
+      vehicle->serialize_device(gps);
   }
   else
   {
@@ -782,6 +1371,8 @@ void TelemetrySM::ConnectToWS()
   // sends sensors data only if connected
   data_thread = new thread(&TelemetrySM::SendWsData, this);
   status_thread = new thread(&TelemetrySM::SendStatus, this);
+  PlaceThread("data", data_thread->native_handle());
+  PlaceThread("status", status_thread->native_handle());
   while(kill_threads.load() == false)
   {
     usleep(1000000);
@@ -889,17 +1480,17 @@ void TelemetrySM::OnMessage(client* cli, websocketpp::connection_hdl hdl, messag
   else if(req["type"] == "telemetry_reset")
   {
     CONSOLE.Log("Requested Reset (from ws)");
-    wsRequestState = ST_UNINITIALIZED;
+    RequestState(ST_UNINITIALIZED);
   }
   else if(req["type"] == "telemetry_start")
   {
     CONSOLE.Log("Requested Start (from ws)");
-    wsRequestState = ST_RUN;
+    RequestState(ST_RUN);
   }
   else if(req["type"] == "telemetry_stop")
   {
     CONSOLE.Log("Requested Stop (from ws)");
-    wsRequestState = ST_STOP;
+    RequestState(ST_STOP);
   }
   else if(req["type"] == "telemetry_action_zip_logs")
   {
@@ -929,12 +1520,22 @@ void TelemetrySM::OnMessage(client* cli, websocketpp::connection_hdl hdl, messag
        (req["id"].IsInt() && req["payload"].IsArray()))
     {
       auto payload = req["payload"].GetArray();
-      if(payload.Size() > 0 && payload.Size() <= 8 && payload[0].IsInt())
+      // Optional bus index, default first bus
+      size_t bus = 0;
+      if(req.HasMember("bus") && req["bus"].IsInt())
+        bus = req["bus"].GetInt();
+      // Payloads longer than 8 bytes (or "fd": true) are sent as CAN FD
+      bool fd = payload.Size() > 8 || (req.HasMember("fd") && req["fd"].IsBool() && req["fd"].GetBool());
+      bool brs = req.HasMember("brs") && req["brs"].IsBool() && req["brs"].GetBool();
+      if(payload.Size() > 0 && payload.Size() <= CANFD_MAX_DLEN && payload[0].IsInt() && bus < cans.size())
       {
-        char msg[8];
+        char msg[CANFD_MAX_DLEN] = {0};
         for(int i = 0 ; i < payload.Size(); i++)
           msg[i] = (char)payload[i].GetInt();
-        can->send(req["id"].GetInt(), msg, 8);
+        if(fd)
+          cans[bus]->send_fd(req["id"].GetInt(), msg, payload.Size(), brs ? CANFD_BRS : 0);
+        else
+          cans[bus]->send(req["id"].GetInt(), msg, 8);
       }else{
         CONSOLE.LogWarn("CAN message malformed (from ws)");
       }
@@ -949,6 +1550,10 @@ void TelemetrySM::SendStatus()
 {
   char msg_data[8];
   int is_in_run;
+  // Log writer rate since the previous status
+  Async_Writer_Stats_t previous_writer_stat;
+  if(log_writer != nullptr)
+    previous_writer_stat = log_writer->get_stats();
   while(kill_threads.load() == false)
   {
     if(GetCurrentState() == ST_RUN)
@@ -956,7 +1561,8 @@ void TelemetrySM::SendStatus()
     else
       is_in_run = 0;
     msg_data[0] = is_in_run;
-    can->send(0x99, msg_data, 1);
+    for(auto can : cans)
+      can->send(0x99, msg_data, 1);
 
     string str;
     for(auto el : msgs_counters)
@@ -967,6 +1573,22 @@ void TelemetrySM::SendStatus()
     }
     CONSOLE.Log("Status",StatesStr[GetCurrentState()],"MSGS per second: " + str);
 
+    CAN_Rx_Stat_t rx_stat = GetRxStat();
+    CONSOLE.Log("CAN rx", "batches:", rx_stat.batches, "full batches:", rx_stat.full_batches, "truncated:", rx_stat.truncated, "socket drops:", rx_stat.drops);
+    CONSOLE.Log("CAN ring", "size:", can_ring->size(), "high water:", can_ring->high_water_mark(), "overflows:", can_ring->overflows());
+
+    Async_Writer_Stats_t writer_stat;
+    double writer_bytes_per_second = 0.0;
+    if(log_writer != nullptr)
+    {
+      writer_stat = log_writer->get_stats();
+      writer_bytes_per_second = AsyncWriter::bytes_per_second(previous_writer_stat, writer_stat);
+      previous_writer_stat = writer_stat;
+      CONSOLE.Log("Log writer", "MB/s:", writer_bytes_per_second / 1e6, "queue:", writer_stat.queue_depth,
+                  "max queue:", writer_stat.max_queue_depth, "worst write ms:", writer_stat.worst_write_ns / 1e6,
+                  "worst fsync ms:", writer_stat.worst_fsync_ns / 1e6, "stalls:", writer_stat.stalls, "errors:", writer_stat.errors);
+    }
+
     if(tel_conf.ws_enabled && ws_conn_state == ConnectionState_::CONNECTED)
     {
       Document d;
@@ -985,6 +1607,33 @@ void TelemetrySM::SendStatus()
         val.AddMember(Value().SetString(el.first.c_str(), alloc), el.second, alloc);
       }
       d.AddMember("msgs_per_second", val, alloc);
+
+      Value ring;
+      ring.SetObject();
+      ring.AddMember("size", uint64_t(can_ring->size()), alloc);
+      ring.AddMember("capacity", uint64_t(can_ring->capacity()), alloc);
+      ring.AddMember("high_water_mark", uint64_t(can_ring->high_water_mark()), alloc);
+      ring.AddMember("overflows", can_ring->overflows(), alloc);
+      d.AddMember("can_ring", ring, alloc);
+
+      // Frames dropped by the kernel since the start of the run
+      Value drops(kObjectType);
+      for(size_t bus = 0; bus < cans.size(); bus++)
+        drops.AddMember(Value().SetString(CAN_DEVICES[bus].c_str(), alloc), cans[bus]->get_rx_stat().drops, alloc);
+      d.AddMember("can_socket_drops", drops, alloc);
+
+      if(log_writer != nullptr)
+      {
+        Value writer(kObjectType);
+        writer.AddMember("bytes_per_second", writer_bytes_per_second, alloc);
+        writer.AddMember("queue_depth", writer_stat.queue_depth, alloc);
+        writer.AddMember("max_queue_depth", writer_stat.max_queue_depth, alloc);
+        writer.AddMember("worst_write_ms", writer_stat.worst_write_ns / 1e6, alloc);
+        writer.AddMember("worst_fsync_ms", writer_stat.worst_fsync_ns / 1e6, alloc);
+        writer.AddMember("stalls", writer_stat.stalls, alloc);
+        writer.AddMember("errors", writer_stat.errors, alloc);
+        d.AddMember("log_writer", writer, alloc);
+      }
       auto cam_state = camera.StatesStr[camera.GetCurrentState()];
       auto cam_error = CamErrorStr[camera.GetError()];
       d.AddMember("camera_status", Value().SetString(cam_state.c_str(), cam_state.size(), alloc), alloc);
@@ -1026,8 +1675,14 @@ void TelemetrySM::SendWsData()
 
       unique_lock<mutex> lck(mtx);
 
+      // Rows stored since the last send, downsampled for each device
+      double min_period = 0.0;
+      if(tel_conf.ws_downsample == true)
+        min_period = 1.0 / tel_conf.ws_downsample_mps;
+      vehicle->serialize_stored(ws_reader, min_period);
+
       string serialized_string;
-      chimera->serialized_to_string(&serialized_string);
+      vehicle->serialized_to_string(&serialized_string);
 
       if(serialized_string.size() == 0)
       {
@@ -1043,7 +1698,7 @@ void TelemetrySM::SendWsData()
       d.Accept(w);
 
       ws_cli->set_data(sb.GetString());
-      chimera->clear_serialized();
+      vehicle->clear_serialized();
     }
   }
 }
@@ -1090,21 +1745,47 @@ void TelemetrySM::ActionThread()
   }
 }
 
-void TelemetrySM::ProtoSerialize(const double& timestamp, Device* device)
+void TelemetrySM::StoreSamples(const int64_t& timestamp, const Device_Set_t& modified)
+{
+  if(modified.none())
+    return;
+
+  unique_lock<mutex> lck(mtx);
+
+  // Numeric devices are stored in columns, written and serialized in batches
+  vehicle->store_samples(modified);
+
+  // The others one sample at a time
+  vehicle->for_each_device(modified, [&](Device* device){
+    if(device->has_fields())
+      return;
+
+    if(GetCurrentState() == ST_RUN && tel_conf.generate_csv &&
+      device->files.size() > 0 && device->files[0] != nullptr)
+    {
+      (*device->files[0]) << device->get_string(",") + "\n";
+    }
+
+    ProtoSerialize(timestamp, device);
+  });
+}
+
+void TelemetrySM::ProtoSerialize(const int64_t& timestamp, Device* device)
 {
   // Serialize with protobuf if websocket is enabled
   if(tel_conf.ws_enabled && tel_conf.ws_send_sensor_data)
   {
     if(tel_conf.ws_downsample == true)
     {
-      if((1.0/tel_conf.ws_downsample_mps) < (timestamp - timers[device->get_name()]))
+      int64_t& last = serialize_timers[device->index];
+      if((1000000000LL / tel_conf.ws_downsample_mps) < (timestamp - last))
       {
-        timers[device->get_name()] = timestamp;
-        chimera->serialize_device(device);
+        last = timestamp;
+        vehicle->serialize_device(device);
       }
     }else
     {
-      chimera->serialize_device(device);
+      vehicle->serialize_device(device);
     }
   }
 }
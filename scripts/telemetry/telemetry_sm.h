@@ -12,12 +12,19 @@
 #include <thread>
 #include <condition_variable>
 
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
 #include "can.h"
 #include "utils.h"
 #include "serial.h"
+#include "candump.h"
+#include "async_writer.h"
 #include "vehicle.h"
 #include "gps_logger.h"
 #include "loads.h"
+#include "spsc_ring.h"
 
 #ifdef WITH_CAMERA
 #include "camera.h"
@@ -41,10 +48,28 @@ using namespace rapidjson;
 using namespace std;
 using namespace std::chrono;
 
+// Max number of frames read from the CAN socket with a single syscall
+#define CAN_RX_BATCH 64
+// Frames buffered between the ingest thread and the processing
+#define CAN_RING_SIZE 16384
+// Max number of CAN interfaces logged at the same time
+#define CAN_MAX_BUSES 4
+
+struct CAN_Frame_t
+{
+  int64_t timestamp;
+  uint8_t bus;      // index in CAN_DEVICES
+  canfd_frame frame;  // classic frames have flags = 0
+};
+
 struct CAN_Stat_t
 {
   double duration;
   uint64_t msg_count;
+  // Frames read with the start command (in its batch, after it),
+  // and how many of them were logged in the run: must be the same
+  uint64_t start_batch_frames;
+  uint64_t start_batch_logged;
 };
 enum TelemetryError
 {
@@ -52,7 +77,8 @@ enum TelemetryError
 	TEL_LOAD_CONFIG_TELEMETRY,
 	TEL_LOAD_CONFIG_SESSION,
 	TEL_LOG_FOLDER,
-	TEL_CAN_SOCKET_OPEN
+	TEL_CAN_SOCKET_OPEN,
+	TEL_UNKNOWN_VEHICLE
 };
 static const char* TelemetryErrorStr[]
 {
@@ -60,7 +86,8 @@ static const char* TelemetryErrorStr[]
 	"Load telemetry config Error",
 	"Load session config Error",
 	"Log folder error",
-	"Can failed opening socket"
+	"Can failed opening socket",
+	"Unknown vehicle in telemetry config"
 };
 
 
@@ -92,17 +119,36 @@ private:
 
 
 	string HOME_PATH;
-	string CAN_DEVICE;
+	vector<string> CAN_DEVICES;
 	string FOLDER_PATH;
 	string CURRENT_LOG_FOLDER;
 
-	std::fstream* dump_file;
-
-	Can* can;
-	sockaddr_can addr;
-	Chimera* chimera;
+	// candump of the run in the can_log_format, segments of can_log_segment_mb or
+	// can_log_segment_s listed in candump.manifest.json.
+	// Files are AsyncFile when the log writer is enabled
+	CandumpSegmentWriter dump;
+
+	vector<Can*> cans;
+	sockaddr_can addrs[CAN_MAX_BUSES];
+	// Bus of the vehicle of each socket: position of the interface in can_devices
+	uint8_t vehicle_bus[CAN_MAX_BUSES];
+	SpscRing<CAN_Frame_t>* can_ring;
+	int can_ring_event;
+	// Frames of the last batch not processed when the state changed,
+	// ReadCanRing returns them to the next state before the ring
+	CAN_Frame_t can_tail[CAN_RX_BATCH];
+	size_t can_tail_offset;
+	size_t can_tail_count;
+	int state_event;
+	// Selected in the telemetry config
+	Vehicle* vehicle;
+	// Readers of the samples stored in the vehicle
+	int csv_reader;
+	int ws_reader;
 	WebSocketClient* ws_cli;
 	vector<GpsLogger*> gps_loggers;
+	// Writes candump, csv and gps files from its thread (log_writer)
+	AsyncWriter* log_writer;
 #ifdef WITH_CAMERA
 	Camera camera;
 #endif
@@ -113,6 +159,7 @@ private:
 	mutex mtx;
 	atomic<bool> kill_threads;
 
+	thread* ingest_thread;
 	thread* data_thread;
 	thread* status_thread;
 	thread* ws_conn_thread;
@@ -134,7 +181,8 @@ private:
 	// Maps
 	unordered_map<string, uint32_t> msgs_counters;
 	unordered_map<string, uint32_t> msgs_per_second;
-	unordered_map<string, double> timers;
+	// Last serialized timestamp of each device, indexed by Device::index
+	vector<int64_t> serialize_timers;
 
 
 	TelemetryError currentError;
@@ -142,13 +190,26 @@ private:
 private:
 	string GetDate();
 	string GetTime();
-	string CanMessage2Str(const can_frame& msg);
-
-	void OpenCanSocket();
+	string CanMessage2Str(const canfd_frame& msg);
+
+	void OpenCanSockets();
+	bool OpenCanSocket(Can* can, const string& device, sockaddr_can* addr);
+	CAN_Rx_Stat_t GetRxStat();
+	void CanIngest();
+	void CanIngestMmap(const uint8_t& bus);
+
+	// Applies cpus and priority of tel_conf.thread_placement to a thread
+	void PlaceThread(const string& name, pthread_t handle);
+	void GetThreadPlacement(const string& name, string& cpus, int& priority);
+	int ReadCanRing(CAN_Frame_t* frames, size_t max);
+	// Keeps frames[from, count) for the next state
+	void KeepCanTail(const CAN_Frame_t* frames, const int& from, const int& count);
+	// Sets wsRequestState and wakes up the CAN loop
+	void RequestState(States state);
 	void OpenLogFolder(const string& path);
 	void CreateHeader(string &header);
 	void CreateFolderName(string& folder);
-	void LogCan(const double& timestamp, const can_frame& msg);
+	void LogCan(const int64_t& timestamp, const uint8_t& bus, const canfd_frame& msg);
 
 	// GPS
 	void SetupGps();
@@ -182,7 +243,8 @@ private:
 	void SaveStat();
 
 	// Protobuffer
-	void ProtoSerialize(const double& timestamp, Device*);
+	void ProtoSerialize(const int64_t& timestamp, Device*);
+	void StoreSamples(const int64_t& timestamp, const Device_Set_t& modified);
 
 
 private:
@@ -0,0 +1,441 @@
+#include "async_writer.h"
+
+#include <chrono>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static int64_t steady_ns()
+{
+  return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+AsyncWriter::AsyncWriter(const Async_Writer_Config_t& config_)
+{
+  config = config_;
+  if(config.buffers < 2)
+    config.buffers = 2;
+  // Whole pages, full buffers are written at page aligned offsets
+  if(config.buffer_size < ASYNC_WRITER_ALIGNMENT)
+    config.buffer_size = ASYNC_WRITER_ALIGNMENT;
+  config.buffer_size = (config.buffer_size + ASYNC_WRITER_ALIGNMENT - 1) / ASYNC_WRITER_ALIGNMENT * ASYNC_WRITER_ALIGNMENT;
+  if(config.flush_period_ms < 1)
+    config.flush_period_ms = 1;
+
+  running = false;
+}
+
+AsyncWriter::~AsyncWriter()
+{
+  stop();
+}
+
+void AsyncWriter::start()
+{
+  if(running)
+    return;
+  stopping = false;
+  running = true;
+  writer_thread = new thread(&AsyncWriter::run, this);
+}
+
+void AsyncWriter::stop()
+{
+  {
+    // Files still open by their owners, closed ones are skipped by close
+    unique_lock<mutex> lck(files_mtx);
+    for(int i = 0; i < ASYNC_WRITER_MAX_FILES; i++)
+      if(files[i] != nullptr)
+        close(i);
+  }
+
+  if(writer_thread != nullptr)
+  {
+    {
+      unique_lock<mutex> lck(queue_mtx);
+      stopping = true;
+    }
+    queue_cv.notify_all();
+    writer_thread->join();
+    delete writer_thread;
+    writer_thread = nullptr;
+  }
+  else
+  {
+    // Never started, the queue is written by the caller
+    stopping = true;
+    run();
+  }
+  running = false;
+}
+
+pthread_t AsyncWriter::get_thread_handle()
+{
+  return writer_thread != nullptr ? writer_thread->native_handle() : pthread_t();
+}
+
+int AsyncWriter::open(const string& path)
+{
+  int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if(fd < 0)
+    return -1;
+
+  unique_lock<mutex> lck(files_mtx);
+  for(int i = 0; i < ASYNC_WRITER_MAX_FILES; i++)
+  {
+    if(files[i] != nullptr)
+      continue;
+
+    File_t* file = new File_t();
+    file->fd = fd;
+    file->last_fsync = steady_ns();
+    for(int b = 0; b < config.buffers; b++)
+    {
+      Buffer_t* buffer = new Buffer_t();
+      buffer->data = (char*)aligned_alloc(ASYNC_WRITER_ALIGNMENT, config.buffer_size);
+      buffer->size = 0;
+      file->all.push_back(buffer);
+      file->free.push_back(buffer);
+    }
+    file->active = file->free.back();
+    file->free.pop_back();
+    files[i] = file;
+    return i;
+  }
+  ::close(fd);
+  return -1;
+}
+
+void AsyncWriter::write(const int& handle, const char* data, size_t size)
+{
+  File_t* file = files[handle];
+  unique_lock<mutex> lck(file->mtx);
+  while(size > 0)
+  {
+    if(file->active == nullptr)
+    {
+      // All the buffers are queued, waits for the writer thread
+      const int64_t start = steady_ns();
+      // The writer thread gives back the first buffer written as active
+      file->free_cv.wait(lck, [&]{ return file->active != nullptr; });
+      const int64_t stall = steady_ns() - start;
+
+      unique_lock<mutex> stats_lck(stats_mtx);
+      stats.stalls ++;
+      stats.worst_stall_ns = max(stats.worst_stall_ns, stall);
+    }
+
+    Buffer_t* buffer = file->active;
+    if(buffer->size == 0)
+      file->active_since = steady_ns();
+    const size_t count = min(size, config.buffer_size - buffer->size);
+    memcpy(buffer->data + buffer->size, data, count);
+    buffer->size += count;
+    data += count;
+    size -= count;
+
+    if(buffer->size == config.buffer_size)
+      submit(handle, file);
+  }
+}
+
+void AsyncWriter::flush(const int& handle)
+{
+  File_t* file = files[handle];
+  unique_lock<mutex> lck(file->mtx);
+  if(file->active != nullptr && file->active->size > 0)
+    submit(handle, file);
+}
+
+bool AsyncWriter::close(const int& handle, const bool& wait, Closed_Fn on_closed)
+{
+  File_t* file = files[handle];
+  {
+    unique_lock<mutex> lck(file->mtx);
+    if(file->closing)
+    {
+      if(on_closed)
+        on_closed(false);
+      return !wait;
+    }
+    file->closing = true;
+    if(file->active != nullptr && file->active->size > 0)
+      submit(handle, file);
+  }
+
+  Close_Wait_t result;
+  if((wait || on_closed) && !running)
+  {
+    // No writer thread, the buffers were written by submit
+    close_file(handle, &result, on_closed);
+    return result.ok;
+  }
+  {
+    unique_lock<mutex> lck(queue_mtx);
+    queue.push_back({handle, nullptr, wait ? &result : nullptr, on_closed});
+  }
+  queue_cv.notify_all();
+  if(!wait)
+    return true;
+
+  unique_lock<mutex> lck(queue_mtx);
+  closed_cv.wait(lck, [&]{ return result.closed; });
+  return result.ok;
+}
+
+void AsyncWriter::submit(const int& handle, File_t* file)
+{
+  Buffer_t* buffer = file->active;
+  if(!running)
+  {
+    // No writer thread, written by the caller
+    write_buffer(file, buffer);
+    buffer->size = 0;
+    return;
+  }
+
+  file->active = nullptr;
+  if(file->free.size() > 0)
+  {
+    file->active = file->free.back();
+    file->free.pop_back();
+  }
+
+  uint32_t depth;
+  {
+    unique_lock<mutex> lck(queue_mtx);
+    queue.push_back({handle, buffer});
+    depth = queue.size();
+  }
+  queue_cv.notify_all();
+
+  unique_lock<mutex> stats_lck(stats_mtx);
+  stats.max_queue_depth = max(stats.max_queue_depth, depth);
+}
+
+void AsyncWriter::run()
+{
+  // Buffers not full are checked a few times in each flush period
+  const auto wait = chrono::milliseconds(max(1, config.flush_period_ms / 4));
+  while(true)
+  {
+    Job_t job;
+    bool has_job = false;
+    {
+      unique_lock<mutex> lck(queue_mtx);
+      if(queue.empty() && !stopping)
+        queue_cv.wait_for(lck, wait);
+      if(!queue.empty())
+      {
+        job = queue.front();
+        queue.pop_front();
+        has_job = true;
+      }
+      else if(stopping)
+        break;
+    }
+
+    if(has_job)
+    {
+      File_t* file = files[job.file];
+      if(job.buffer == nullptr)
+      {
+        close_file(job.file, job.wait, job.on_closed);
+        continue;
+      }
+      write_buffer(file, job.buffer);
+      {
+        unique_lock<mutex> lck(file->mtx);
+        job.buffer->size = 0;
+        if(file->active == nullptr)
+          file->active = job.buffer;
+        else
+          file->free.push_back(job.buffer);
+      }
+      file->free_cv.notify_all();
+      continue;
+    }
+
+    // Queues the buffers filled for more than flush_period_ms
+    const int64_t now = steady_ns();
+    unique_lock<mutex> files_lck(files_mtx);
+    for(int i = 0; i < ASYNC_WRITER_MAX_FILES; i++)
+    {
+      File_t* file = files[i];
+      if(file == nullptr)
+        continue;
+      unique_lock<mutex> lck(file->mtx);
+      if(file->active != nullptr && file->active->size > 0 &&
+         now - file->active_since >= int64_t(config.flush_period_ms) * 1000000)
+        submit(i, file);
+    }
+  }
+}
+
+void AsyncWriter::write_buffer(File_t* file, Buffer_t* buffer)
+{
+  const int64_t start = steady_ns();
+  size_t written = 0;
+  bool failed = false;
+  while(written < buffer->size)
+  {
+    ssize_t ret = ::write(file->fd, buffer->data + written, buffer->size - written);
+    if(ret < 0 && errno == EINTR)
+      continue;
+    if(ret <= 0)
+    {
+      failed = true;
+      break;
+    }
+    written += ret;
+  }
+  const int64_t elapsed = steady_ns() - start;
+
+  {
+    unique_lock<mutex> lck(stats_mtx);
+    stats.bytes += written;
+    stats.writes ++;
+    stats.worst_write_ns = max(stats.worst_write_ns, elapsed);
+    if(failed)
+      stats.errors ++;
+  }
+  if(failed)
+    file->failed = true;
+
+  if(config.fsync == ASYNC_FSYNC_ALWAYS ||
+     (config.fsync == ASYNC_FSYNC_PERIODIC && steady_ns() - file->last_fsync >= int64_t(config.fsync_period_ms) * 1000000))
+    fsync_file(file);
+}
+
+void AsyncWriter::fsync_file(File_t* file)
+{
+  const int64_t start = steady_ns();
+  const int ret = fdatasync(file->fd);
+  const int64_t elapsed = steady_ns() - start;
+  file->last_fsync = start + elapsed;
+  if(ret != 0)
+    file->failed = true;
+
+  unique_lock<mutex> lck(stats_mtx);
+  stats.fsyncs ++;
+  stats.worst_fsync_ns = max(stats.worst_fsync_ns, elapsed);
+  if(ret != 0)
+    stats.errors ++;
+}
+
+void AsyncWriter::close_file(const int& handle, Close_Wait_t* wait, Closed_Fn on_closed)
+{
+  File_t* file = files[handle];
+  if(config.fsync != ASYNC_FSYNC_NONE)
+    fsync_file(file);
+  const bool ok = ::close(file->fd) == 0 && !file->failed;
+  if(wait != nullptr)
+  {
+    {
+      unique_lock<mutex> lck(queue_mtx);
+      wait->closed = true;
+      wait->ok = ok;
+    }
+    closed_cv.notify_all();
+  }
+  if(on_closed)
+    on_closed(ok);
+
+  {
+    unique_lock<mutex> lck(files_mtx);
+    files[handle] = nullptr;
+  }
+  for(auto buffer : file->all)
+  {
+    free(buffer->data);
+    delete buffer;
+  }
+  delete file;
+}
+
+Async_Writer_Stats_t AsyncWriter::get_stats()
+{
+  uint32_t depth;
+  {
+    unique_lock<mutex> lck(queue_mtx);
+    depth = queue.size();
+  }
+
+  unique_lock<mutex> lck(stats_mtx);
+  Async_Writer_Stats_t stat = stats;
+  stat.time_ns = steady_ns();
+  stat.queue_depth = depth;
+  return stat;
+}
+
+double AsyncWriter::bytes_per_second(const Async_Writer_Stats_t& previous, const Async_Writer_Stats_t& current)
+{
+  if(current.time_ns <= previous.time_ns || current.bytes < previous.bytes)
+    return 0.0;
+  return double(current.bytes - previous.bytes) * 1e9 / double(current.time_ns - previous.time_ns);
+}
+
+Async_Fsync_t AsyncWriter::fsync_from_string(const string& name)
+{
+  if(name == "none")
+    return ASYNC_FSYNC_NONE;
+  if(name == "periodic")
+    return ASYNC_FSYNC_PERIODIC;
+  if(name == "always")
+    return ASYNC_FSYNC_ALWAYS;
+  return ASYNC_FSYNC_CLOSE;
+}
+
+AsyncFile::AsyncFile(AsyncWriter* writer, const string& path) : ostream(&buffer)
+{
+  buffer.writer = writer;
+  buffer.file = writer->open(path);
+  if(buffer.file < 0)
+    setstate(ios::failbit);
+}
+
+AsyncFile::~AsyncFile()
+{
+  close();
+}
+
+bool AsyncFile::close(const bool& wait, AsyncWriter::Closed_Fn on_closed)
+{
+  if(buffer.file < 0)
+  {
+    if(on_closed)
+      on_closed(false);
+    return !wait;
+  }
+  const bool ok = buffer.writer->close(buffer.file, wait, on_closed);
+  buffer.file = -1;
+  return ok;
+}
+
+streamsize AsyncFile::Buffer::xsputn(const char* s, streamsize n)
+{
+  if(file < 0)
+    return 0;
+  writer->write(file, s, n);
+  return n;
+}
+
+int AsyncFile::Buffer::overflow(int c)
+{
+  if(file < 0)
+    return traits_type::eof();
+  if(c != traits_type::eof())
+  {
+    char ch = c;
+    writer->write(file, &ch, 1);
+  }
+  return c;
+}
+
+int AsyncFile::Buffer::sync()
+{
+  // The data is already in the writer, written within flush_period_ms
+  return 0;
+}
@@ -0,0 +1,196 @@
+#include "batch_decode.h"
+#include "vehicle_signals.h"
+
+#include <string.h>
+
+//////////////////////// Columns
+// Same decoders of Chimera in a loop, one column for each signal
+
+void batch_decode_imu(const uint8_t* payloads, size_t count, double* x, double* y, double* z)
+{
+  for(size_t i = 0; i < count; i++)
+    Imu_Frame::decode(payloads + i * 8, x[i], y[i], z[i]);
+}
+
+void batch_decode_temperature(const uint8_t* payloads, size_t count, double* channels[4])
+{
+  double values[4];
+  for(size_t i = 0; i < count; i++)
+  {
+    Temperature_Frame::decode_array(payloads + i * 8, values);
+    for(int k = 0; k < 4; k++)
+      channels[k][i] = values[k];
+  }
+}
+
+//////////////////////// BatchDecoder
+
+BatchDecoder::BatchDecoder(Vehicle* vehicle_)
+{
+  vehicle = vehicle_;
+  for(int bus = 0; bus < VEHICLE_MAX_BUSES; bus++)
+  for(int id = 0; id < CAN_STD_ID_COUNT; id++)
+  {
+    queues[bus][id] = nullptr;
+    args[bus][id] = 0;
+
+    const Decoder_t* decoder = vehicle->get_decoder(bus, id);
+    if(decoder == nullptr || decoder->device == nullptr || decoder->batch == DECODE_SINGLE)
+      continue;
+    bool is_imu = decoder->batch == DECODE_BATCH_IMU;
+
+    // Ids of the same device share the queue, so frames keep their order
+    Batch_Queue_t* queue = nullptr;
+    for(auto q : device_queues)
+      if(q->device == decoder->device)
+        queue = q;
+    if(queue == nullptr)
+    {
+      queue = new Batch_Queue_t;
+      queue->device = decoder->device;
+      queue->is_imu = is_imu;
+      device_queues.push_back(queue);
+    }
+    queues[bus][id] = queue;
+    args[bus][id] = decoder->arg;
+  }
+
+  for(auto& column : columns)
+    column.resize(BATCH_FRAMES);
+  row_timestamps.resize(BATCH_FRAMES);
+  for(auto& row : rows)
+    row.resize(BATCH_FRAMES);
+}
+
+BatchDecoder::~BatchDecoder()
+{
+  for(auto queue : device_queues)
+    delete queue;
+}
+
+bool BatchDecoder::add(const int64_t& timestamp_ns, const uint8_t& bus, const int& id, const uint8_t data[], const int& size)
+{
+  if(bus >= VEHICLE_MAX_BUSES || id < 0 || id >= CAN_STD_ID_COUNT || queues[bus][id] == nullptr)
+    return false;
+
+  Batch_Queue_t* queue = queues[bus][id];
+  const double timestamp = ns_to_seconds(timestamp_ns);
+  if(queue->is_imu)
+  {
+    push(queue, timestamp, data, args[bus][id], true);
+    return true;
+  }
+
+  // CAN FD temperatures pack the following frames of the sensor in 8 bytes blocks,
+  // queued as classic frames with the same timestamp
+  int block = args[bus][id];
+  int offset = 0;
+  while(true)
+  {
+    const bool last = block == 3 || offset + 16 > size;
+    push(queue, timestamp, data + offset, block, last);
+    if(last)
+      break;
+    block ++;
+    offset += 8;
+  }
+  return true;
+}
+
+void BatchDecoder::push(Batch_Queue_t* queue, const double& timestamp, const uint8_t payload[], const int& arg, bool frame_end)
+{
+  queue->timestamps[queue->count] = timestamp;
+  memcpy(queue->payloads + queue->count * 8, payload, 8);
+  queue->args[queue->count] = arg;
+  queue->frame_end[queue->count] = frame_end;
+  queue->count ++;
+  if(queue->count == BATCH_FRAMES)
+    flush(queue);
+}
+
+void BatchDecoder::flush()
+{
+  for(auto queue : device_queues)
+    flush(queue);
+}
+
+void BatchDecoder::flush(Batch_Queue_t* queue)
+{
+  if(queue->count == 0)
+    return;
+  if(queue->is_imu)
+    flush_imu(queue);
+  else
+    flush_temperature(queue);
+  queue->count = 0;
+}
+
+void BatchDecoder::flush_imu(Batch_Queue_t* queue)
+{
+  const size_t count = queue->count;
+  double* x = columns[0].data();
+  double* y = columns[1].data();
+  double* z = columns[2].data();
+  double* scale = columns[3].data();
+
+  batch_decode_imu(queue->payloads, count, x, y, z);
+  for(size_t i = 0; i < count; i++)
+    scale[i] = queue->args[i];
+
+  // Each frame is a row
+  Row_Batch_t batch;
+  batch.count = count;
+  batch.timestamp = queue->timestamps;
+  batch.fields[0] = x;
+  batch.fields[1] = y;
+  batch.fields[2] = z;
+  batch.fields[3] = scale;
+  vehicle->store_rows(queue->device, batch);
+}
+
+void BatchDecoder::flush_temperature(Batch_Queue_t* queue)
+{
+  const size_t count = queue->count;
+  double* channels[4] = {columns[0].data(), columns[1].data(), columns[2].data(), columns[3].data()};
+  batch_decode_temperature(queue->payloads, count, channels);
+
+  // The assembler writes the device when a group is complete or closed, as in parse_message
+  // the row is stored with the values at the end of the CAN frame
+  Temperature* temp = (Temperature*)queue->device;
+  const size_t fields = temp->fields.size();
+  size_t row_count = 0;
+  double values[4];
+  for(size_t i = 0; i < count; i++)
+  {
+    for(int k = 0; k < 4; k++)
+      values[k] = channels[k][i];
+    if(temp->assembler.add(queue->args[i], queue->timestamps[i], values))
+      queue->row_pending = true;
+    if(queue->row_pending && queue->frame_end[i])
+    {
+      row_timestamps[row_count] = temp->timestamp;
+      for(size_t j = 0; j < fields; j++)
+        rows[j][row_count] = *temp->fields[j];
+      row_count ++;
+      queue->row_pending = false;
+    }
+  }
+
+  // store_rows leaves the device at the last stored row,
+  // a group written after it must be kept
+  double last[DEVICE_MAX_FIELDS];
+  const double timestamp = temp->timestamp;
+  for(size_t j = 0; j < fields; j++)
+    last[j] = *temp->fields[j];
+
+  Row_Batch_t batch;
+  batch.count = row_count;
+  batch.timestamp = row_timestamps.data();
+  for(size_t j = 0; j < fields; j++)
+    batch.fields[j] = rows[j].data();
+  vehicle->store_rows(temp, batch);
+
+  temp->timestamp = timestamp;
+  for(size_t j = 0; j < fields; j++)
+    *temp->fields[j] = last[j];
+}
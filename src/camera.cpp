@@ -128,6 +128,21 @@ STATE_DEFINE(Camera, RunImpl, CamRunData)
 	cam_config_data.fname = data->filename;
 
 	save_thread = new thread(&Camera::SaveLoop, this);
+
+	cpu_set_t set;
+	if(save_thread_cpus != "" && parse_cpu_list(save_thread_cpus, &set))
+		set_thread_affinity(save_thread->native_handle(), set);
+	// 0 sets SCHED_OTHER, otherwise the thread inherits the scheduling of its creator
+	if(save_thread_placement)
+		set_thread_priority(save_thread->native_handle(), save_thread_priority);
+	CONSOLE.Log("Camera save thread", thread_placement_str(save_thread->native_handle()));
+}
+
+void Camera::SetSaveThreadPlacement(const string& cpus, int priority)
+{
+	save_thread_placement = true;
+	save_thread_cpus = cpus;
+	save_thread_priority = priority;
 }
 
 // Define state STOP function
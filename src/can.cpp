@@ -1,4 +1,19 @@
 #include "can.h"
+#include "utils.h"
+
+// Counters have a single writer, no read-modify-write needed
+static inline void rx_add(atomic<uint64_t>& counter, uint64_t value)
+{
+	counter.store(counter.load(memory_order_relaxed) + value, memory_order_relaxed);
+}
+
+uint8_t can_fd_valid_len(int len){
+	static const uint8_t valid_len[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64};
+	for(auto valid : valid_len)
+		if(len <= valid)
+			return valid;
+	return CANFD_MAX_DLEN;
+}
 
 Can::Can(){
 }
@@ -11,6 +26,21 @@ void Can::init(const char* device, sockaddr_can* address){
   this->device = device;
   this->address = address;
 	opened = false;
+	fd_enabled = false;
+	ts_mode = CAN_TS_USERSPACE;
+	hw_offset = 0;
+	hw_offset_valid = false;
+	drop_counter = 0;
+	rx_count.frames = 0;
+	rx_count.batches = 0;
+	rx_count.full_batches = 0;
+	rx_count.truncated = 0;
+	rx_count.fd_frames = 0;
+	rx_count.drops = 0;
+	mmap_sock = -1;
+	mmap_ring = nullptr;
+	mmap_block = nullptr;
+	reset_rx_stat();
 }
 
 bool Can::is_open()
@@ -20,7 +50,14 @@ bool Can::is_open()
 
 const char* Can::get_device()
 {
-	return device;
+	return device.c_str();
+}
+
+int Can::get_socket()
+{
+	if(mmap_ring != nullptr)
+		return mmap_sock;
+	return sock;
 }
 
 int Can::open_socket(){
@@ -34,7 +71,8 @@ int Can::open_socket(){
 
 	// If can_socket is set to 0,
 	// messages are received from all interfaces (can0, can1, vcan0)
-	strcpy(ifr.ifr_name, this->device);
+	strncpy(ifr.ifr_name, this->device.c_str(), IFNAMSIZ - 1);
+	ifr.ifr_name[IFNAMSIZ - 1] = '\0';
 	ioctl(can_socket, SIOCGIFINDEX, &ifr);
 
 	(*address).can_family = AF_CAN;
@@ -44,6 +82,10 @@ int Can::open_socket(){
 		return -2;
 	}
 
+	// Kernel adds the number of dropped frames to each received frame
+	int enable = 1;
+	setsockopt(can_socket, SOL_SOCKET, SO_RXQ_OVFL, &enable, sizeof(enable));
+
 	opened = true;
   this->sock = can_socket;
 	return can_socket;
@@ -51,6 +93,7 @@ int Can::open_socket(){
 
 bool Can::close_socket()
 {
+	close_mmap();
 	if(opened)
 	{
 		if(close(this->sock) < 0)
@@ -78,10 +121,454 @@ int Can::send(int id, char* data, int len){
 	return write(this->sock, &frame, sizeof(frame));
 }
 
+int Can::send_fd(int id, char* data, int len, uint8_t flags){
+	if (len < 0 || len > CANFD_MAX_DLEN || !fd_enabled) {
+		return -1;
+	}
+
+	struct canfd_frame frame;
+	memset(&frame, 0, sizeof(frame));
+	frame.can_id = id;
+	frame.len = can_fd_valid_len(len);
+	frame.flags = flags | CANFD_FDF;
+
+	for (int i = 0; i < len; ++i) {
+		frame.data[i] = data[i];
+	}
+
+	return write(this->sock, &frame, sizeof(frame));
+}
+
+int Can::enable_fd(){
+	int enable = 1;
+	int ret = setsockopt(this->sock, SOL_CAN_RAW, CAN_RAW_FD_FRAMES, &enable, sizeof(enable));
+	fd_enabled = ret == 0;
+	return ret;
+}
+
+bool Can::is_fd_enabled()
+{
+	return fd_enabled;
+}
+
 int Can::receive(can_frame* frame){
 	return read(this->sock, frame, sizeof(struct can_frame));
 }
 
 int Can::set_filters(can_filter& filter){
+	rx_filters.assign(1, filter);
+	if(mmap_ring != nullptr && attach_mmap_filters(mmap_sock) < 0)
+		return -1;
 	return setsockopt(this->sock, SOL_CAN_RAW, CAN_RAW_FILTER, &filter, sizeof(filter));
 }
+
+int Can::set_filters(const vector<can_filter>& filters){
+	rx_filters = filters;
+	if(mmap_ring != nullptr && attach_mmap_filters(mmap_sock) < 0)
+		return -1;
+	if(filters.size() == 0)
+	{
+		can_filter all;
+		all.can_id = 0;
+		all.can_mask = 0;
+		return setsockopt(this->sock, SOL_CAN_RAW, CAN_RAW_FILTER, &all, sizeof(all));
+	}
+	return setsockopt(this->sock, SOL_CAN_RAW, CAN_RAW_FILTER, filters.data(), filters.size() * sizeof(can_filter));
+}
+
+int Can::attach_mmap_filters(int fd)
+{
+	if(rx_filters.size() == 0)
+	{
+		int detach = 0;
+		setsockopt(fd, SOL_SOCKET, SO_DETACH_FILTER, &detach, sizeof(detach));
+		return 0;
+	}
+
+	// The packet data is the CAN frame, can_id is in host byte order
+	// and BPF loads words in network order: constants are swapped with htonl
+	const uint32_t accept = 0xFFFFFFFF;
+	vector<sock_filter> code;
+	// Error frames are not received by CAN_RAW (no error mask)
+	code.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, 0));
+	code.push_back(BPF_STMT(BPF_ALU | BPF_AND | BPF_K, htonl(CAN_ERR_FLAG)));
+	code.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 1, 0));
+	code.push_back(BPF_STMT(BPF_RET | BPF_K, 0));
+	// Same match of CAN_RAW_FILTER: (can_id & mask) == (id & mask), inverted with CAN_INV_FILTER
+	for(const auto& filter : rx_filters)
+	{
+		// Jump over the accept when the match fails
+		bool inverted = filter.can_id & CAN_INV_FILTER;
+		uint8_t jump_equal = inverted ? 1 : 0;
+		uint8_t jump_different = inverted ? 0 : 1;
+		uint32_t id = filter.can_id & ~CAN_INV_FILTER;
+		code.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, 0));
+		code.push_back(BPF_STMT(BPF_ALU | BPF_AND | BPF_K, htonl(filter.can_mask)));
+		code.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htonl(id & filter.can_mask), jump_equal, jump_different));
+		code.push_back(BPF_STMT(BPF_RET | BPF_K, accept));
+	}
+	code.push_back(BPF_STMT(BPF_RET | BPF_K, 0));
+
+	sock_fprog program;
+	program.len = code.size();
+	program.filter = code.data();
+	return setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &program, sizeof(program));
+}
+
+int Can::receive_batch(canfd_frame* frames, size_t max, int64_t* timestamps){
+	if(max == 0)
+		return 0;
+
+	if(rx_msgs.size() < max)
+	{
+		rx_msgs.resize(max);
+		rx_iovecs.resize(max);
+		rx_control.resize(max * CAN_RX_CONTROL_LEN);
+	}
+	for(size_t i = 0; i < max; i++)
+	{
+		rx_iovecs[i].iov_base = &frames[i];
+		rx_iovecs[i].iov_len = sizeof(struct canfd_frame);
+		memset(&rx_msgs[i].msg_hdr, 0, sizeof(rx_msgs[i].msg_hdr));
+		rx_msgs[i].msg_hdr.msg_iov = &rx_iovecs[i];
+		rx_msgs[i].msg_hdr.msg_iovlen = 1;
+		rx_msgs[i].msg_hdr.msg_control = &rx_control[i * CAN_RX_CONTROL_LEN];
+		rx_msgs[i].msg_hdr.msg_controllen = CAN_RX_CONTROL_LEN;
+	}
+
+	// MSG_WAITFORONE: block for the first frame only
+	int count = recvmmsg(this->sock, rx_msgs.data(), max, MSG_WAITFORONE, nullptr);
+	if(count <= 0)
+		return -1;
+
+	// Clock is read at most once per batch, only if the kernel
+	// did not provide a timestamp
+	int64_t batch_timestamp = 0;
+
+	// Compact out datagrams that are not a full can_frame/canfd_frame
+	int valid = 0;
+	for(int i = 0; i < count; i++)
+	{
+		if(rx_msgs[i].msg_len == CANFD_MTU)
+		{
+			frames[i].flags |= CANFD_FDF;
+			rx_add(rx_count.fd_frames, 1);
+		}
+		else if(rx_msgs[i].msg_len == CAN_MTU)
+		{
+			// same layout as can_frame, only flags must be cleared
+			frames[i].flags = 0;
+		}
+		else
+		{
+			rx_add(rx_count.truncated, 1);
+			continue;
+		}
+		if(valid != i)
+			frames[valid] = frames[i];
+		int64_t timestamp = parse_control(&rx_msgs[i].msg_hdr);
+		if(timestamps != nullptr)
+		{
+			if(timestamp == 0)
+			{
+				if(batch_timestamp == 0)
+					batch_timestamp = get_timestamp_ns();
+				timestamp = batch_timestamp;
+			}
+			timestamps[valid] = timestamp;
+		}
+		valid ++;
+	}
+
+	rx_add(rx_count.batches, 1);
+	rx_add(rx_count.frames, valid);
+	rx_count.drops.store(drop_counter, memory_order_relaxed);
+	if(size_t(count) == max)
+		rx_add(rx_count.full_batches, 1);
+
+	return valid;
+}
+
+int64_t Can::parse_control(msghdr* hdr)
+{
+	int64_t timestamp = 0;
+	for(cmsghdr* cmsg = CMSG_FIRSTHDR(hdr); cmsg != nullptr; cmsg = CMSG_NXTHDR(hdr, cmsg))
+	{
+		if(cmsg->cmsg_level != SOL_SOCKET)
+			continue;
+
+		if(cmsg->cmsg_type == SO_RXQ_OVFL)
+		{
+			// Total frames dropped by the socket since it was opened
+			memcpy(&drop_counter, CMSG_DATA(cmsg), sizeof(drop_counter));
+		}
+		else if(ts_mode == CAN_TS_USERSPACE)
+		{
+			continue;
+		}
+		else if(cmsg->cmsg_type == SCM_TIMESTAMPNS)
+		{
+			timespec ts;
+			memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+			timestamp = int64_t(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+		}
+		else if(cmsg->cmsg_type == SCM_TIMESTAMPING)
+		{
+			scm_timestamping tss;
+			memcpy(&tss, CMSG_DATA(cmsg), sizeof(tss));
+			int64_t sw = int64_t(tss.ts[0].tv_sec) * 1000000000LL + tss.ts[0].tv_nsec;
+			int64_t hw = int64_t(tss.ts[2].tv_sec) * 1000000000LL + tss.ts[2].tv_nsec;
+			if(hw == 0 || sw == 0)
+			{
+				timestamp = sw;
+				continue;
+			}
+
+			// The controller clock is not the system clock.
+			// The software stamp is always taken after the hardware one,
+			// so the smallest difference seen is the best estimate of the offset.
+			// A difference far from the estimate means one of the clocks jumped.
+			int64_t offset = sw - hw;
+			if(!hw_offset_valid || offset < hw_offset || offset - hw_offset > 1000000000LL)
+			{
+				hw_offset = offset;
+				hw_offset_valid = true;
+			}
+			timestamp = hw + hw_offset;
+		}
+	}
+	return timestamp;
+}
+
+int Can::open_mmap(int block_size, int block_count)
+{
+	if(!opened)
+		return -1;
+	close_mmap();
+
+	int fd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+	if(fd < 0)
+		return -1;
+
+	// Attached before bind, no frame is captured unfiltered
+	if(attach_mmap_filters(fd) < 0)
+	{
+		close(fd);
+		return -6;
+	}
+
+	int version = TPACKET_V3;
+	if(setsockopt(fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0)
+	{
+		close(fd);
+		return -2;
+	}
+
+	tpacket_req3 req;
+	memset(&req, 0, sizeof(req));
+	req.tp_block_size = block_size;
+	req.tp_block_nr = block_count;
+	req.tp_frame_size = CAN_MMAP_FRAME_SIZE;
+	req.tp_frame_nr = (block_size / CAN_MMAP_FRAME_SIZE) * block_count;
+	req.tp_retire_blk_tov = CAN_MMAP_BLOCK_TIMEOUT_MS;
+	if(setsockopt(fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0)
+	{
+		close(fd);
+		return -3;
+	}
+
+	size_t size = size_t(block_size) * block_count;
+	void* ring = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if(ring == MAP_FAILED)
+	{
+		close(fd);
+		return -4;
+	}
+
+	// Same interface of the raw socket (ifindex set by open_socket)
+	sockaddr_ll ll;
+	memset(&ll, 0, sizeof(ll));
+	ll.sll_family = AF_PACKET;
+	ll.sll_protocol = htons(ETH_P_ALL);
+	ll.sll_ifindex = address->can_ifindex;
+	if(bind(fd, (sockaddr*)&ll, sizeof(ll)) < 0)
+	{
+		munmap(ring, size);
+		close(fd);
+		return -5;
+	}
+
+	// Raw socket is used only to send, no filter matches
+	setsockopt(this->sock, SOL_CAN_RAW, CAN_RAW_FILTER, nullptr, 0);
+
+	mmap_sock = fd;
+	mmap_ring = (uint8_t*)ring;
+	mmap_block_size = block_size;
+	mmap_block_count = block_count;
+	mmap_block_index = 0;
+	mmap_block = nullptr;
+	mmap_packet = nullptr;
+	mmap_packets_left = 0;
+	return fd;
+}
+
+bool Can::is_mmap()
+{
+	return mmap_ring != nullptr;
+}
+
+int Can::receive_mmap(CAN_Mmap_Frame_t* frames, size_t max)
+{
+	if(mmap_ring == nullptr)
+		return -1;
+
+	// Frames returned by the previous call are not used anymore
+	if(mmap_block != nullptr && mmap_packets_left == 0)
+		release_mmap_block();
+
+	if(mmap_block == nullptr)
+	{
+		tpacket_block_desc* block = (tpacket_block_desc*)(mmap_ring + mmap_block_index * mmap_block_size);
+		if((block->hdr.bh1.block_status & TP_STATUS_USER) == 0)
+			return 0;
+		// Block content must be read after its status
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+		mmap_block = block;
+		mmap_packet = (uint8_t*)block + block->hdr.bh1.offset_to_first_pkt;
+		mmap_packets_left = block->hdr.bh1.num_pkts;
+		rx_add(rx_count.batches, 1);
+	}
+
+	size_t count = 0;
+	while(count < max && mmap_packets_left > 0)
+	{
+		tpacket3_hdr* hdr = (tpacket3_hdr*)mmap_packet;
+		sockaddr_ll* ll = (sockaddr_ll*)(mmap_packet + TPACKET_ALIGN(sizeof(tpacket3_hdr)));
+		canfd_frame* frame = (canfd_frame*)(mmap_packet + hdr->tp_mac);
+		mmap_packet += hdr->tp_next_offset;
+		mmap_packets_left --;
+
+		// Frames sent from this host are seen twice (outgoing and loopback)
+		if(ll->sll_pkttype == PACKET_OUTGOING)
+			continue;
+
+		// The block belongs to userspace until released, flags can be written in place
+		if(hdr->tp_snaplen == CANFD_MTU)
+		{
+			frame->flags |= CANFD_FDF;
+			rx_add(rx_count.fd_frames, 1);
+		}
+		else if(hdr->tp_snaplen == CAN_MTU)
+		{
+			frame->flags = 0;
+		}
+		else
+		{
+			rx_add(rx_count.truncated, 1);
+			continue;
+		}
+
+		frames[count].frame = frame;
+		frames[count].timestamp = int64_t(hdr->tp_sec) * 1000000000LL + hdr->tp_nsec;
+		count ++;
+	}
+	rx_add(rx_count.frames, count);
+
+	return count;
+}
+
+void Can::release_mmap_block()
+{
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	mmap_block->hdr.bh1.block_status = TP_STATUS_KERNEL;
+	mmap_block = nullptr;
+	mmap_block_index = (mmap_block_index + 1) % mmap_block_count;
+
+	// Counters are reset by the kernel at each read
+	tpacket_stats_v3 stats;
+	socklen_t len = sizeof(stats);
+	if(getsockopt(mmap_sock, SOL_PACKET, PACKET_STATISTICS, &stats, &len) == 0)
+		drop_counter += stats.tp_drops;
+	rx_count.drops.store(drop_counter, memory_order_relaxed);
+}
+
+void Can::close_mmap()
+{
+	if(mmap_ring == nullptr)
+		return;
+	munmap(mmap_ring, mmap_block_size * mmap_block_count);
+	close(mmap_sock);
+	mmap_ring = nullptr;
+	mmap_block = nullptr;
+	mmap_sock = -1;
+}
+
+int Can::set_timestamping(CanTimestampMode mode)
+{
+	ts_mode = CAN_TS_USERSPACE;
+	hw_offset_valid = false;
+
+	int ret = 0;
+	if(mode == CAN_TS_SOFTWARE)
+	{
+		int enable = 1;
+		ret = setsockopt(this->sock, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable));
+	}
+	else if(mode == CAN_TS_HARDWARE)
+	{
+		int flags = SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE |
+								SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+		ret = setsockopt(this->sock, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags));
+	}
+	if(ret < 0)
+		return ret;
+
+	ts_mode = mode;
+	return 0;
+}
+
+CanTimestampMode Can::get_timestamping()
+{
+	return ts_mode;
+}
+
+int Can::set_receive_buffer(int bytes)
+{
+	if(setsockopt(this->sock, SOL_SOCKET, SO_RCVBUFFORCE, &bytes, sizeof(bytes)) == 0)
+		return 0;
+	return setsockopt(this->sock, SOL_SOCKET, SO_RCVBUF, &bytes, sizeof(bytes));
+}
+
+int Can::get_receive_buffer()
+{
+	int bytes = 0;
+	socklen_t len = sizeof(bytes);
+	if(getsockopt(this->sock, SOL_SOCKET, SO_RCVBUF, &bytes, &len) < 0)
+		return -1;
+	return bytes;
+}
+
+CAN_Rx_Stat_t Can::get_rx_stat()
+{
+	CAN_Rx_Stat_t stat;
+	stat.frames = rx_count.frames.load(memory_order_relaxed) - rx_base.frames.load(memory_order_relaxed);
+	stat.batches = rx_count.batches.load(memory_order_relaxed) - rx_base.batches.load(memory_order_relaxed);
+	stat.full_batches = rx_count.full_batches.load(memory_order_relaxed) - rx_base.full_batches.load(memory_order_relaxed);
+	stat.truncated = rx_count.truncated.load(memory_order_relaxed) - rx_base.truncated.load(memory_order_relaxed);
+	stat.fd_frames = rx_count.fd_frames.load(memory_order_relaxed) - rx_base.fd_frames.load(memory_order_relaxed);
+	// The kernel counter wraps at 32 bits
+	stat.drops = uint32_t(rx_count.drops.load(memory_order_relaxed) - rx_base.drops.load(memory_order_relaxed));
+	return stat;
+}
+
+void Can::reset_rx_stat()
+{
+	// Only the base moves, the counters keep a single writer
+	rx_base.frames.store(rx_count.frames.load(memory_order_relaxed), memory_order_relaxed);
+	rx_base.batches.store(rx_count.batches.load(memory_order_relaxed), memory_order_relaxed);
+	rx_base.full_batches.store(rx_count.full_batches.load(memory_order_relaxed), memory_order_relaxed);
+	rx_base.truncated.store(rx_count.truncated.load(memory_order_relaxed), memory_order_relaxed);
+	rx_base.fd_frames.store(rx_count.fd_frames.load(memory_order_relaxed), memory_order_relaxed);
+	rx_base.drops.store(rx_count.drops.load(memory_order_relaxed), memory_order_relaxed);
+}
@@ -0,0 +1,1000 @@
+#include "candump.h"
+
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <charconv>
+#include <filesystem>
+
+#include "rapidjson/document.h"
+#include "rapidjson/prettywriter.h"
+
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+
+namespace io = boost::iostreams;
+
+// Two uppercase hex digits of each byte
+struct Hex_Table_t
+{
+  char digits[256][2];
+  constexpr Hex_Table_t() : digits()
+  {
+    const char hex[] = "0123456789ABCDEF";
+    for(int i = 0; i < 256; i++)
+    {
+      digits[i][0] = hex[i >> 4];
+      digits[i][1] = hex[i & 0xF];
+    }
+  }
+};
+static constexpr Hex_Table_t HEX_TABLE;
+
+static int64_t thread_cpu_ns()
+{
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return int64_t(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+// Header of .bin and .zbin, they differ only in the magic
+static bool write_header(ostream& out, const char* magic, const string& metadata, const vector<string>& buses)
+{
+  if(buses.size() > CANDUMP_MAX_BUSES)
+    return false;
+
+  Candump_Bin_Header_t header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, magic, sizeof(header.magic));
+  header.version = CANDUMP_BIN_VERSION;
+  header.record_size = CANDUMP_RECORD_SIZE;
+  header.bus_count = buses.size();
+  header.metadata_size = metadata.size();
+  for(size_t i = 0; i < buses.size(); i++)
+  {
+    // Names are zero terminated
+    if(buses[i].size() >= CANDUMP_BUS_NAME_SIZE)
+      return false;
+    memcpy(header.buses[i], buses[i].c_str(), buses[i].size());
+  }
+
+  out.write((const char*)&header, sizeof(header));
+  out.write(metadata.c_str(), metadata.size());
+  return true;
+}
+
+bool candump_bin_write_header(ostream& out, const string& metadata, const vector<string>& buses)
+{
+  return write_header(out, CANDUMP_BIN_MAGIC, metadata, buses);
+}
+
+void candump_bin_write_frame(ostream& out, const int64_t& timestamp, const uint8_t& bus,
+                             const uint32_t& id, const uint8_t& flags, const uint8_t* data, const uint8_t& len)
+{
+  // Head and continuation records of the longest CAN FD frame
+  uint8_t buffer[CANDUMP_RECORD_SIZE * 4];
+  const size_t size = candump_bin_encode_frame(buffer, timestamp, bus, id, flags, data, len);
+  out.write((const char*)buffer, size);
+}
+
+size_t candump_bin_encode_frame(uint8_t* buffer, const int64_t& timestamp, const uint8_t& bus,
+                                const uint32_t& id, const uint8_t& flags, const uint8_t* data, const uint8_t& len)
+{
+  const int records = candump_records(len);
+  memset(buffer, 0, records * CANDUMP_RECORD_SIZE);
+
+  Candump_Record_t* record = (Candump_Record_t*)buffer;
+  record->timestamp = timestamp;
+  record->id = id;
+  record->bus = bus;
+  record->flags = flags;
+  record->len = len;
+  record->extra = records - 1;
+  memcpy(record->data, data, len < 8 ? len : 8);
+  if(len > 8)
+    memcpy(buffer + CANDUMP_RECORD_SIZE, data + 8, len - 8);
+
+  return records * CANDUMP_RECORD_SIZE;
+}
+
+static bool has_magic(const string& path, const char* expected)
+{
+  char magic[8];
+  ifstream in(path, ios::binary);
+  if(!in.read(magic, sizeof(magic)))
+    return false;
+  return memcmp(magic, expected, sizeof(magic)) == 0;
+}
+
+bool candump_is_binary(const string& path)
+{
+  return has_magic(path, CANDUMP_BIN_MAGIC);
+}
+
+bool candump_is_compressed(const string& path)
+{
+  return has_magic(path, CANDUMP_ZBIN_MAGIC);
+}
+
+bool candump_is_manifest(const string& path)
+{
+  const string name = filesystem::path(path).filename().string();
+  const string suffix = ".manifest.json";
+  return name.size() >= suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+string candump_extension(const Candump_Format_t& format)
+{
+  if(format == CANDUMP_BINARY)
+    return ".bin";
+  if(format == CANDUMP_COMPRESSED)
+    return ".zbin";
+  return ".log";
+}
+
+bool candump_read_manifest(const string& path, vector<Candump_Segment_t>* segments, bool* complete)
+{
+  ifstream in(path);
+  if(!in.is_open())
+    return false;
+  const string text((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+
+  rapidjson::Document doc;
+  doc.Parse(text.c_str());
+  if(doc.HasParseError() || !doc.IsObject() || !doc.HasMember("segments") || !doc["segments"].IsArray())
+    return false;
+  if(complete != nullptr)
+    *complete = doc.HasMember("complete") && doc["complete"].IsBool() && doc["complete"].GetBool();
+
+  segments->clear();
+  for(auto& value : doc["segments"].GetArray())
+  {
+    if(!value.IsObject() || !value.HasMember("file") || !value["file"].IsString())
+      return false;
+    Candump_Segment_t segment;
+    segment.file = value["file"].GetString();
+    if(value.HasMember("first_timestamp") && value["first_timestamp"].IsInt64())
+      segment.first_timestamp = value["first_timestamp"].GetInt64();
+    if(value.HasMember("last_timestamp") && value["last_timestamp"].IsInt64())
+      segment.last_timestamp = value["last_timestamp"].GetInt64();
+    if(value.HasMember("frames") && value["frames"].IsUint64())
+      segment.frames = value["frames"].GetUint64();
+    if(value.HasMember("bytes") && value["bytes"].IsUint64())
+      segment.bytes = value["bytes"].GetUint64();
+    if(value.HasMember("complete") && value["complete"].IsBool())
+      segment.complete = value["complete"].GetBool();
+    segments->push_back(segment);
+  }
+  return true;
+}
+
+bool candump_fsync_path(const string& path, const bool& directory)
+{
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC | (directory ? O_DIRECTORY : 0));
+  if(fd < 0)
+    return false;
+  const bool synced = fsync(fd) == 0;
+  ::close(fd);
+  return synced;
+}
+
+bool candump_write_manifest(const string& path, const Candump_Format_t& format,
+                            const vector<Candump_Segment_t>& segments, const bool& complete)
+{
+  rapidjson::StringBuffer json;
+  rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(json);
+  const char* formats[] = {"text", "binary", "compressed"};
+  writer.StartObject();
+  writer.Key("format");
+  writer.String(formats[format]);
+  writer.Key("complete");
+  writer.Bool(complete);
+  writer.Key("segments");
+  writer.StartArray();
+  for(auto& segment : segments)
+  {
+    writer.StartObject();
+    writer.Key("file");
+    writer.String(segment.file.c_str());
+    writer.Key("first_timestamp");
+    writer.Int64(segment.first_timestamp);
+    writer.Key("last_timestamp");
+    writer.Int64(segment.last_timestamp);
+    writer.Key("frames");
+    writer.Uint64(segment.frames);
+    writer.Key("bytes");
+    writer.Uint64(segment.bytes);
+    writer.Key("complete");
+    writer.Bool(segment.complete);
+    writer.EndObject();
+  }
+  writer.EndArray();
+  writer.EndObject();
+
+  // The old manifest stays valid until the rename
+  const string tmp = path + ".tmp";
+  int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if(fd < 0)
+    return false;
+  const char* data = json.GetString();
+  size_t size = json.GetSize();
+  while(size > 0)
+  {
+    ssize_t ret = ::write(fd, data, size);
+    if(ret < 0 && errno == EINTR)
+      continue;
+    if(ret <= 0)
+    {
+      ::close(fd);
+      return false;
+    }
+    data += ret;
+    size -= ret;
+  }
+  const bool synced = fsync(fd) == 0;
+  ::close(fd);
+  if(!synced || rename(tmp.c_str(), path.c_str()) != 0)
+    return false;
+  // The rename is written with the folder
+  return candump_fsync_path(filesystem::path(path).parent_path().string(), true);
+}
+
+string candump_frame_str(const uint32_t& id, const bool& fd, const uint8_t& flags, const uint8_t* data, const int& len)
+{
+  string out = "";
+  // Hexadecimal representation
+  out += get_hex(int(id), 3) + "#";
+  if(fd)
+    out += "#" + get_hex(int(flags & (CANDUMP_FLAG_BRS | CANDUMP_FLAG_ESI)), 1);
+  for (int i = 0; i < len; i++)
+  {
+    out += get_hex(int(data[i]), 2);
+  }
+  return out;
+}
+
+string candump_line(const message& msg, const bool& ns)
+{
+  string timestamp;
+  if(ns)
+  {
+    char bff[32];
+    snprintf(bff, sizeof(bff), "%lld.%09lld", (long long)(msg.timestamp / 1000000000LL), (long long)(msg.timestamp % 1000000000LL));
+    timestamp = bff;
+  }
+  else
+    timestamp = timestamp_ns_to_string(msg.timestamp);
+
+  string line = "(" + timestamp + ")";
+  if(msg.device != "")
+    line += "\t" + msg.device + "\t";
+  else
+    line += " ";
+  line += candump_frame_str(msg.id, msg.fd, msg.flags, msg.data, msg.size);
+  line += "\n";
+  return line;
+}
+
+size_t candump_format_line(char* out, const int64_t& timestamp, const string& bus, const uint32_t& id,
+                           const bool& fd, const uint8_t& flags, const uint8_t* data, const int& len)
+{
+  char* p = out;
+  *p++ = '(';
+  if(timestamp >= 0)
+  {
+    // Seconds and 6 digits of microseconds, as timestamp_ns_to_string
+    p = to_chars(p, p + 20, timestamp / 1000000000LL).ptr;
+    *p++ = '.';
+    uint32_t us = (timestamp % 1000000000LL) / 1000;
+    for(int i = 5; i >= 0; i--)
+    {
+      p[i] = '0' + us % 10;
+      us /= 10;
+    }
+    p += 6;
+  }
+  else
+    p += snprintf(p, 32, "%lld.%06lld", (long long)(timestamp / 1000000000LL), (long long)((timestamp % 1000000000LL) / 1000));
+  *p++ = ')';
+
+  if(bus.size() > 0)
+  {
+    *p++ = '\t';
+    memcpy(p, bus.c_str(), bus.size() < CANDUMP_BUS_NAME_SIZE ? bus.size() : CANDUMP_BUS_NAME_SIZE);
+    p += bus.size() < CANDUMP_BUS_NAME_SIZE ? bus.size() : CANDUMP_BUS_NAME_SIZE;
+    *p++ = '\t';
+  }
+  else
+    *p++ = ' ';
+
+  // Id with at least 3 digits, as get_hex(id, 3)
+  int digits = 3;
+  while(digits < 8 && (id >> (digits * 4)) != 0)
+    digits ++;
+  for(int i = digits - 1; i >= 0; i--)
+    *p++ = HEX_TABLE.digits[(id >> (i * 4)) & 0xF][1];
+  *p++ = '#';
+  if(fd)
+  {
+    *p++ = '#';
+    *p++ = HEX_TABLE.digits[flags & (CANDUMP_FLAG_BRS | CANDUMP_FLAG_ESI)][1];
+  }
+
+  const int size = len < 64 ? len : 64;
+  for(int i = 0; i < size; i++)
+  {
+    *p++ = HEX_TABLE.digits[data[i]][0];
+    *p++ = HEX_TABLE.digits[data[i]][1];
+  }
+  *p++ = '\n';
+  return p - out;
+}
+
+CandumpTextWriter::CandumpTextWriter(size_t capacity)
+{
+  buffer.resize(capacity > CANDUMP_MAX_LINE ? capacity : CANDUMP_MAX_LINE);
+}
+
+void CandumpTextWriter::set_stream(ostream* out_)
+{
+  out = out_;
+  used = 0;
+  bytes = 0;
+}
+
+void CandumpTextWriter::flush()
+{
+  if(out != nullptr && used > 0)
+    out->write(buffer.data(), used);
+  used = 0;
+}
+
+CandumpBlockWriter::CandumpBlockWriter(int level_, size_t block_size)
+{
+  level = level_ < 0 ? 0 : (level_ > 9 ? 9 : level_);
+  // At least the longest CAN FD frame
+  raw.resize(block_size > CANDUMP_RECORD_SIZE * 4 ? block_size : CANDUMP_RECORD_SIZE * 4);
+}
+
+bool CandumpBlockWriter::open(ostream* out_, const string& metadata, const vector<string>& buses)
+{
+  out = nullptr;
+  used = 0;
+  index.clear();
+  stats = Candump_Block_Stats_t();
+  if(!write_header(*out_, CANDUMP_ZBIN_MAGIC, metadata, buses))
+    return false;
+
+  out = out_;
+  offset = sizeof(Candump_Bin_Header_t) + metadata.size();
+  stats.compressed_bytes = offset;
+  return true;
+}
+
+void CandumpBlockWriter::write(const int64_t& timestamp, const uint8_t& bus, const uint32_t& id,
+                               const uint8_t& flags, const uint8_t* data, const uint8_t& len)
+{
+  const size_t size = candump_records(len) * CANDUMP_RECORD_SIZE;
+  if(used > 0 && (used + size > raw.size() ||
+                  timestamp - block.min_timestamp >= int64_t(CANDUMP_BLOCK_PERIOD_MS) * 1000000LL))
+    flush();
+
+  if(used == 0)
+  {
+    block.frames = 0;
+    block.min_timestamp = timestamp;
+    block.max_timestamp = timestamp;
+  }
+  used += candump_bin_encode_frame(raw.data() + used, timestamp, bus, id, flags, data, len);
+  block.frames ++;
+  block.min_timestamp = min(block.min_timestamp, timestamp);
+  block.max_timestamp = max(block.max_timestamp, timestamp);
+}
+
+void CandumpBlockWriter::flush()
+{
+  if(out == nullptr || used == 0)
+    return;
+
+  const int64_t start = thread_cpu_ns();
+  compressed.clear();
+  {
+    io::filtering_ostream zlib;
+    zlib.push(io::zlib_compressor(io::zlib_params(level)));
+    zlib.push(io::back_inserter(compressed));
+    zlib.write((const char*)raw.data(), used);
+    // Writes the end of the zlib stream
+    zlib.reset();
+  }
+  const int64_t elapsed = thread_cpu_ns() - start;
+
+  Candump_Block_Header_t header;
+  memcpy(header.magic, CANDUMP_BLOCK_MAGIC, sizeof(header.magic));
+  header.compressed_size = compressed.size();
+  header.raw_size = used;
+  header.frames = block.frames;
+  header.min_timestamp = block.min_timestamp;
+  header.max_timestamp = block.max_timestamp;
+  out->write((const char*)&header, sizeof(header));
+  out->write(compressed.data(), compressed.size());
+
+  block.offset = offset;
+  block.reserved = 0;
+  index.push_back(block);
+  offset += sizeof(header) + compressed.size();
+
+  stats.frames += block.frames;
+  stats.blocks ++;
+  stats.raw_bytes += used;
+  stats.compressed_bytes += sizeof(header) + compressed.size();
+  stats.compress_ns += elapsed;
+  stats.worst_block_ns = max(stats.worst_block_ns, elapsed);
+  used = 0;
+}
+
+void CandumpBlockWriter::close()
+{
+  if(out == nullptr)
+    return;
+  flush();
+
+  Candump_Index_Trailer_t trailer;
+  memset(&trailer, 0, sizeof(trailer));
+  memcpy(trailer.magic, CANDUMP_INDEX_MAGIC, sizeof(trailer.magic));
+  trailer.index_offset = offset;
+  trailer.blocks = index.size();
+  out->write((const char*)index.data(), index.size() * sizeof(Candump_Block_Index_t));
+  out->write((const char*)&trailer, sizeof(trailer));
+  stats.compressed_bytes += index.size() * sizeof(Candump_Block_Index_t) + sizeof(trailer);
+  out = nullptr;
+}
+
+bool CandumpSegmentWriter::open(const string& folder_, const Candump_Segment_Config_t& config_, const string& metadata_,
+                                const vector<string>& buses_, Open_File_Fn open_file_, Close_File_Fn close_file_)
+{
+  close();
+  folder = folder_;
+  config = config_;
+  metadata = metadata_;
+  buses = buses_;
+  open_file = open_file_;
+  close_file = close_file_;
+  segmented = config.max_bytes > 0 || config.max_duration_ms > 0;
+  blocks = CandumpBlockWriter(config.level);
+  segments.clear();
+  block_stats = Candump_Block_Stats_t();
+  errors = 0;
+  opened = true;
+  if(open_segment(true))
+    return true;
+  close();
+  return false;
+}
+
+bool CandumpSegmentWriter::open_segment(const bool& write_manifest)
+{
+  current = Candump_Segment_t();
+  if(segmented)
+  {
+    char name[32];
+    snprintf(name, sizeof(name), "candump_%04lu", segments.size());
+    current.file = string(name) + candump_extension(config.format);
+  }
+  else
+    current.file = "candump" + candump_extension(config.format);
+
+  {
+    unique_lock<mutex> lck(segments_mtx);
+    segments.push_back(current);
+    // Listed before it is written, a crash leaves it not complete in the manifest
+    if(segmented && write_manifest && !candump_write_manifest(folder + "/" + CANDUMP_MANIFEST, config.format, segments, false))
+      errors ++;
+  }
+
+  out = open_file(folder + "/" + current.file);
+  if(out == nullptr || out->fail())
+  {
+    delete out;
+    out = nullptr;
+    errors ++;
+    return false;
+  }
+
+  bool header_ok = true;
+  binary_bytes = 0;
+  if(config.format == CANDUMP_TEXT)
+  {
+    *out << metadata;
+    text.set_stream(out);
+  }
+  else if(config.format == CANDUMP_BINARY)
+  {
+    header_ok = candump_bin_write_header(*out, metadata, buses);
+    binary_bytes = sizeof(Candump_Bin_Header_t) + metadata.size();
+  }
+  else
+    header_ok = blocks.open(out, metadata, buses);
+  if(!header_ok)
+  {
+    delete out;
+    out = nullptr;
+    errors ++;
+    return false;
+  }
+  return true;
+}
+
+uint64_t CandumpSegmentWriter::segment_bytes()
+{
+  if(config.format == CANDUMP_TEXT)
+    return metadata.size() + text.get_bytes();
+  if(config.format == CANDUMP_BINARY)
+    return binary_bytes;
+  return blocks.get_stats().compressed_bytes;
+}
+
+ostream* CandumpSegmentWriter::end_segment()
+{
+  ostream* segment_out = out;
+  if(out != nullptr)
+  {
+    text.flush();
+    if(config.format == CANDUMP_COMPRESSED)
+    {
+      blocks.close();
+      const Candump_Block_Stats_t& stat = blocks.get_stats();
+      block_stats.frames += stat.frames;
+      block_stats.blocks += stat.blocks;
+      block_stats.raw_bytes += stat.raw_bytes;
+      block_stats.compressed_bytes += stat.compressed_bytes;
+      block_stats.compress_ns += stat.compress_ns;
+      block_stats.worst_block_ns = max(block_stats.worst_block_ns, stat.worst_block_ns);
+    }
+    current.bytes = segment_bytes();
+    text.set_stream(nullptr);
+    out = nullptr;
+  }
+
+  unique_lock<mutex> lck(segments_mtx);
+  segments.back() = current;
+  return segment_out;
+}
+
+void CandumpSegmentWriter::close_segment(ostream* segment_out, const size_t& index)
+{
+  if(segment_out == nullptr)
+    return;
+  {
+    unique_lock<mutex> lck(segments_mtx);
+    closing ++;
+  }
+
+  const string file = segments[index].file;
+  auto done = [this, index, file](bool written){ segment_closed(index, file, written); };
+  if(close_file)
+    close_file(segment_out, done);
+  else
+  {
+    segment_out->flush();
+    const bool written = !segment_out->fail();
+    delete segment_out;
+    done(written);
+  }
+}
+
+void CandumpSegmentWriter::segment_closed(const size_t& index, const string& file, const bool& written)
+{
+  // Complete only when all its data is in the file and on the storage
+  const bool synced = written && candump_fsync_path(folder + "/" + file, false);
+
+  {
+    unique_lock<mutex> lck(segments_mtx);
+    if(synced)
+      segments[index].complete = true;
+    else
+      errors ++;
+    // Also lists the segment opened after this one
+    if(segmented && !candump_write_manifest(folder + "/" + CANDUMP_MANIFEST, config.format, segments, false))
+      errors ++;
+    closing --;
+    // With the lock held, close may return and destroy the writer right after
+    closed_cv.notify_all();
+  }
+}
+
+void CandumpSegmentWriter::rotate()
+{
+  const size_t index = segments.size() - 1;
+  ostream* segment_out = end_segment();
+  // The manifest is written when the previous segment is closed (by the thread closing it),
+  // here only if there is no file to close.
+  // If it fails the frames are lost until the next rotation, the segment stays not complete
+  open_segment(segment_out == nullptr);
+  close_segment(segment_out, index);
+}
+
+void CandumpSegmentWriter::close()
+{
+  if(!opened)
+    return;
+  opened = false;
+  close_segment(end_segment(), segments.size() - 1);
+
+  unique_lock<mutex> lck(segments_mtx);
+  closed_cv.wait(lck, [this]{ return closing == 0; });
+  if(segmented && !candump_write_manifest(folder + "/" + CANDUMP_MANIFEST, config.format, segments, true))
+    errors ++;
+}
+
+Candump_Block_Stats_t CandumpSegmentWriter::get_block_stats()
+{
+  Candump_Block_Stats_t stat = block_stats;
+  if(out != nullptr && config.format == CANDUMP_COMPRESSED)
+  {
+    const Candump_Block_Stats_t& open = blocks.get_stats();
+    stat.frames += open.frames;
+    stat.blocks += open.blocks;
+    stat.raw_bytes += open.raw_bytes;
+    stat.compressed_bytes += open.compressed_bytes;
+    stat.compress_ns += open.compress_ns;
+    stat.worst_block_ns = max(stat.worst_block_ns, open.worst_block_ns);
+  }
+  return stat;
+}
+
+CandumpReader::~CandumpReader()
+{
+  close();
+}
+
+bool CandumpReader::open(const string& path)
+{
+  close();
+  if(!candump_is_manifest(path))
+    return open_file(path);
+
+  if(!candump_read_manifest(path, &segments))
+    return false;
+  segments_folder = filesystem::path(path).parent_path().string();
+  return open_segment(0);
+}
+
+bool CandumpReader::open_segment(size_t i)
+{
+  close_file();
+  // Segments missing or not valid (the one open in a crash can be empty) are skipped
+  for(; i < segments.size(); i++)
+  {
+    segment = i;
+    const string path = segments_folder == "" ? segments[i].file : segments_folder + "/" + segments[i].file;
+    if(open_file(path))
+      return true;
+  }
+  segment = segments.size();
+  return false;
+}
+
+bool CandumpReader::open_file(const string& path)
+{
+  close_file();
+  metadata = "";
+  compressed = candump_is_compressed(path);
+  binary = compressed || candump_is_binary(path);
+  in.open(path, ios::binary);
+  if(!in.is_open())
+    return false;
+
+  if(binary)
+  {
+    Candump_Bin_Header_t header;
+    if(!in.read((char*)&header, sizeof(header)) ||
+       header.version != CANDUMP_BIN_VERSION ||
+       header.record_size != CANDUMP_RECORD_SIZE ||
+       header.bus_count > CANDUMP_MAX_BUSES)
+    {
+      close_file();
+      return false;
+    }
+    buses.clear();
+    for(int i = 0; i < header.bus_count; i++)
+      buses.push_back(string(header.buses[i], strnlen(header.buses[i], CANDUMP_BUS_NAME_SIZE)));
+    metadata.resize(header.metadata_size);
+    if(!in.read(&metadata[0], header.metadata_size))
+    {
+      close_file();
+      return false;
+    }
+    data_offset = sizeof(header) + header.metadata_size;
+    if(compressed)
+      read_index();
+    return true;
+  }
+
+  // Text metadata: every line before the first frame
+  data_offset = 0;
+  while(getline(in, line))
+  {
+    line += "\n";
+    if(parse_line(line, &pending_msg))
+    {
+      pending = true;
+      break;
+    }
+    metadata += line;
+    data_offset += line.size();
+  }
+  return true;
+}
+
+void CandumpReader::read_index()
+{
+  index.clear();
+  in.clear();
+  in.seekg(0, ios::end);
+  const uint64_t size = in.tellg();
+
+  Candump_Index_Trailer_t trailer;
+  if(size >= data_offset + sizeof(trailer))
+  {
+    in.seekg(size - sizeof(trailer));
+    if(in.read((char*)&trailer, sizeof(trailer)) &&
+       memcmp(trailer.magic, CANDUMP_INDEX_MAGIC, sizeof(trailer.magic)) == 0 &&
+       trailer.index_offset + uint64_t(trailer.blocks) * sizeof(Candump_Block_Index_t) + sizeof(trailer) == size)
+    {
+      index.resize(trailer.blocks);
+      in.seekg(trailer.index_offset);
+      if(in.read((char*)index.data(), index.size() * sizeof(Candump_Block_Index_t)))
+      {
+        in.seekg(data_offset);
+        return;
+      }
+      index.clear();
+    }
+  }
+
+  // Not closed, the blocks written completely are kept
+  recovered = true;
+  index.clear();
+  in.clear();
+  uint64_t offset = data_offset;
+  Candump_Block_Header_t header;
+  while(offset + sizeof(header) <= size)
+  {
+    in.seekg(offset);
+    if(!in.read((char*)&header, sizeof(header)) ||
+       memcmp(header.magic, CANDUMP_BLOCK_MAGIC, sizeof(header.magic)) != 0 ||
+       offset + sizeof(header) + header.compressed_size > size)
+      break;
+
+    Candump_Block_Index_t entry;
+    entry.offset = offset;
+    entry.frames = header.frames;
+    entry.reserved = 0;
+    entry.min_timestamp = header.min_timestamp;
+    entry.max_timestamp = header.max_timestamp;
+    index.push_back(entry);
+    offset += sizeof(header) + header.compressed_size;
+  }
+  in.clear();
+  in.seekg(data_offset);
+}
+
+bool CandumpReader::load_block(size_t i)
+{
+  block.clear();
+  block_pos = 0;
+  if(i >= index.size())
+    return false;
+  next_block = i + 1;
+
+  Candump_Block_Header_t header;
+  in.clear();
+  in.seekg(index[i].offset);
+  if(!in.read((char*)&header, sizeof(header)) ||
+     memcmp(header.magic, CANDUMP_BLOCK_MAGIC, sizeof(header.magic)) != 0)
+    return false;
+  block_data.resize(header.compressed_size);
+  if(!in.read(block_data.data(), header.compressed_size))
+    return false;
+
+  block.resize(header.raw_size);
+  try
+  {
+    io::filtering_istream zlib;
+    zlib.push(io::zlib_decompressor());
+    zlib.push(io::array_source(block_data.data(), block_data.size()));
+    zlib.read((char*)block.data(), block.size());
+    if(size_t(zlib.gcount()) != block.size())
+    {
+      block.clear();
+      return false;
+    }
+  }
+  catch(exception& e)
+  {
+    // Corrupted block
+    block.clear();
+    return false;
+  }
+  blocks_read ++;
+  return true;
+}
+
+bool CandumpReader::read_records(uint8_t* out, const size_t& size)
+{
+  if(!compressed)
+    return bool(in.read((char*)out, size));
+
+  size_t copied = 0;
+  while(copied < size)
+  {
+    if(block_pos == block.size())
+    {
+      // Corrupted blocks are skipped
+      while(!load_block(next_block))
+        if(next_block >= index.size())
+          return false;
+      continue;
+    }
+    const size_t count = min(size - copied, block.size() - block_pos);
+    memcpy(out + copied, block.data() + block_pos, count);
+    block_pos += count;
+    copied += count;
+  }
+  return true;
+}
+
+bool CandumpReader::seek(const int64_t& timestamp)
+{
+  if(segments.size() > 0)
+  {
+    // First segment that can have the timestamp, the range of the open one is not known
+    size_t i = 0;
+    while(i < segments.size() && segments[i].complete && segments[i].last_timestamp < timestamp)
+      i ++;
+    if(i != segment || !in.is_open())
+    {
+      if(!open_segment(i))
+        return false;
+    }
+  }
+  if(!in.is_open())
+    return false;
+  pending = false;
+  in.clear();
+  if(compressed)
+  {
+    // First block that can have the timestamp
+    next_block = 0;
+    while(next_block < index.size() && index[next_block].max_timestamp < timestamp)
+      next_block ++;
+    block.clear();
+    block_pos = 0;
+  }
+  else
+    in.seekg(data_offset);
+
+  message msg;
+  while(next(&msg))
+  {
+    if(msg.timestamp >= timestamp)
+    {
+      pending_msg = msg;
+      pending = true;
+      return true;
+    }
+  }
+  return false;
+}
+
+void CandumpReader::close()
+{
+  close_file();
+  metadata = "";
+  buses.clear();
+  skipped = 0;
+  recovered = false;
+  blocks_read = 0;
+  segments.clear();
+  segments_folder = "";
+  segment = 0;
+}
+
+void CandumpReader::close_file()
+{
+  if(in.is_open())
+    in.close();
+  in.clear();
+  line = "";
+  pending = false;
+  binary = false;
+  compressed = false;
+  data_offset = 0;
+  index.clear();
+  next_block = 0;
+  block.clear();
+  block_pos = 0;
+}
+
+bool CandumpReader::next(message* msg)
+{
+  while(in.is_open())
+  {
+    // First frame of a text log, or found by seek
+    if(pending)
+    {
+      pending = false;
+      *msg = pending_msg;
+      return true;
+    }
+    if(binary ? next_binary(msg) : next_text(msg))
+      return true;
+    // End of a segment
+    if(segments.size() == 0 || !open_segment(segment + 1))
+      return false;
+  }
+  return false;
+}
+
+bool CandumpReader::next_text(message* msg)
+{
+  while(getline(in, line))
+  {
+    line += "\n";
+    if(parse_line(line, msg))
+      return true;
+    skipped ++;
+  }
+  return false;
+}
+
+bool CandumpReader::next_binary(message* msg)
+{
+  Candump_Record_t record;
+  if(!read_records((uint8_t*)&record, sizeof(record)))
+    return false;
+
+  msg->timestamp = record.timestamp;
+  msg->id = record.id;
+  msg->fd = (record.flags & CANDUMP_FLAG_FD) != 0;
+  msg->flags = record.flags & (CANDUMP_FLAG_BRS | CANDUMP_FLAG_ESI);
+  msg->size = record.len <= 64 ? record.len : 64;
+  msg->device = record.bus < buses.size() ? buses[record.bus] : "";
+
+  memcpy(msg->data, record.data, msg->size < 8 ? msg->size : 8);
+  if(record.extra > 0)
+  {
+    uint8_t rest[CANDUMP_RECORD_SIZE * 3];
+    if(record.extra > 3 || !read_records(rest, record.extra * CANDUMP_RECORD_SIZE))
+      return false;
+    if(msg->size > 8)
+      memcpy(msg->data + 8, rest, msg->size - 8);
+  }
+  return true;
+}
+
+bool CandumpReader::parse_line(const string& str, message* msg)
+{
+  try
+  {
+    if(!parse_message(str, msg))
+      return false;
+  }
+  catch(exception& e)
+  {
+    return false;
+  }
+
+  if(msg->device != "")
+  {
+    bool found = false;
+    for(auto& bus : buses)
+      found = found || bus == msg->device;
+    if(!found)
+      buses.push_back(msg->device);
+  }
+  return true;
+}
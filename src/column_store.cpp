@@ -0,0 +1,115 @@
+#include "column_store.h"
+
+#include <string.h>
+
+ColumnStore::ColumnStore(size_t max_chunks_)
+{
+  max_chunks = max_chunks_;
+}
+
+ColumnStore::~ColumnStore()
+{
+  clear();
+  for(auto chunk : free_chunks)
+    delete chunk;
+}
+
+int ColumnStore::add_column(const string& name)
+{
+  auto it = handles.find(name);
+  if(it != handles.end())
+    return it->second;
+
+  Column_t column;
+  column.name = name;
+  column.first = 0;
+  column.end = 0;
+  columns.push_back(column);
+
+  int handle = columns.size() - 1;
+  handles.insert({name, handle});
+  return handle;
+}
+
+int ColumnStore::find(const string& name) const
+{
+  auto it = handles.find(name);
+  return it == handles.end() ? -1 : it->second;
+}
+
+void ColumnStore::append(const int& handle, const double* timestamps, const double* values, size_t count)
+{
+  Column_t& column = columns[handle];
+  while(count > 0)
+  {
+    const size_t offset = column.end % COLUMN_CHUNK_SIZE;
+    if(offset == 0)
+      new_chunk(column);
+    Column_Chunk_t* chunk = column.chunks.back();
+
+    size_t n = COLUMN_CHUNK_SIZE - offset;
+    if(n > count)
+      n = count;
+    memcpy(chunk->timestamp + offset, timestamps, n * sizeof(double));
+    memcpy(chunk->value + offset, values, n * sizeof(double));
+
+    column.end += n;
+    timestamps += n;
+    values += n;
+    count -= n;
+  }
+}
+
+size_t ColumnStore::span(const int& handle, const uint64_t& index, const double** timestamps, const double** values) const
+{
+  const Column_t& column = columns[handle];
+  if(index < column.first || index >= column.end)
+    return 0;
+
+  // first is always at the beginning of the first chunk
+  const size_t chunk_index = (index - column.first) / COLUMN_CHUNK_SIZE;
+  const size_t offset = index % COLUMN_CHUNK_SIZE;
+  const Column_Chunk_t* chunk = column.chunks[chunk_index];
+
+  *timestamps = chunk->timestamp + offset;
+  *values = chunk->value + offset;
+
+  uint64_t chunk_end = index - offset + COLUMN_CHUNK_SIZE;
+  if(chunk_end > column.end)
+    chunk_end = column.end;
+  return chunk_end - index;
+}
+
+void ColumnStore::clear()
+{
+  for(auto& column : columns)
+  {
+    for(auto chunk : column.chunks)
+      free_chunks.push_back(chunk);
+    column.chunks.clear();
+    column.first = 0;
+    column.end = 0;
+  }
+}
+
+void ColumnStore::new_chunk(Column_t& column)
+{
+  Column_Chunk_t* chunk;
+  if(max_chunks > 0 && column.chunks.size() >= max_chunks)
+  {
+    // Ring full, the oldest chunk is overwritten
+    chunk = column.chunks.front();
+    column.chunks.pop_front();
+    column.first += COLUMN_CHUNK_SIZE;
+  }
+  else if(free_chunks.size() > 0)
+  {
+    chunk = free_chunks.back();
+    free_chunks.pop_back();
+  }
+  else
+  {
+    chunk = new Column_Chunk_t;
+  }
+  column.chunks.push_back(chunk);
+}
@@ -0,0 +1,298 @@
+#include "dbc.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+
+Dbc::Dbc()
+{
+  for(int i = 0; i < DBC_STD_ID_COUNT; i++)
+    std_index[i] = -1;
+  store = nullptr;
+}
+
+int Dbc::load(const string& path, SignalStore* store_)
+{
+  ifstream file(path);
+  if(!file.is_open())
+  {
+    error = "Failed opening " + path;
+    return -1;
+  }
+  store = store_;
+
+  const size_t first_new = messages.size();
+  int current = -1;
+  int line_number = 0;
+  string line;
+  while(getline(file, line))
+  {
+    line_number ++;
+    size_t start = line.find_first_not_of(" \t");
+    if(start == string::npos)
+    {
+      current = -1;
+      continue;
+    }
+
+    int ret = 0;
+    if(line.compare(start, 4, "BO_ ") == 0)
+    {
+      current = parse_message_line(line.substr(start));
+      ret = current;
+    }
+    else if(line.compare(start, 4, "SG_ ") == 0)
+    {
+      // Signals of a message follow its BO_ line
+      if(current < 0)
+        continue;
+      ret = parse_signal_line(line.substr(start), &messages[current]);
+    }
+    else if(line.compare(start, 13, "SIG_VALTYPE_ ") == 0)
+    {
+      ret = parse_value_type_line(line.substr(start));
+    }
+    else
+    {
+      current = -1;
+    }
+
+    if(ret < 0)
+    {
+      error = path + ":" + to_string(line_number) + " " + error;
+      messages.resize(first_new);
+      return -1;
+    }
+  }
+
+  // Index and register the signals of the new messages
+  for(size_t i = first_new; i < messages.size(); i++)
+  {
+    Dbc_Message_t& message = messages[i];
+    if(message.extended)
+      extended_index.insert({message.id, int(i)});
+    else
+      std_index[message.id] = int(i);
+
+    for(auto& signal : message.signals)
+      signal.handle = store->add(message.name + "." + signal.name, signal.unit);
+  }
+
+  return int(messages.size() - first_new);
+}
+
+int Dbc::decode(const int64_t& timestamp_ns, const uint32_t& can_id, const uint8_t data[], const int& size)
+{
+  const int index = find(can_id);
+  if(index < 0)
+    return -1;
+
+  const Dbc_Message_t& message = messages[index];
+  const Dbc_Signal_t* signals = message.signals.data();
+  const int count = message.signals.size();
+
+  int mux = -1;
+  if(message.mux_signal >= 0)
+  {
+    const Signal_Plan_t& plan = signals[message.mux_signal].plan;
+    if(plan.end > size)
+      return index;
+    mux = int(dbc_extract_raw(plan, data));
+  }
+
+  for(int i = 0; i < count; i++)
+  {
+    const Dbc_Signal_t& signal = signals[i];
+    if(signal.mux_value >= 0 && signal.mux_value != mux)
+      continue;
+    if(signal.plan.end > size)
+      continue;
+
+    int64_t raw = dbc_extract_raw(signal.plan, data);
+    store->set(signal.handle, timestamp_ns, raw, dbc_raw_to_value(signal.plan, raw));
+  }
+  return index;
+}
+
+bool Dbc::compile(Dbc_Signal_t* signal, const int& message_size)
+{
+  Signal_Plan_t& plan = signal->plan;
+  const int length = signal->length;
+  if(length <= 0 || length > 64)
+    return false;
+
+  int first_byte, last_byte;
+  if(signal->little_endian)
+  {
+    // Intel: start bit is the LSB, bits grow to the following bytes
+    first_byte = signal->start_bit / 8;
+    last_byte = (signal->start_bit + length - 1) / 8;
+    plan.shift = signal->start_bit % 8;
+  }
+  else
+  {
+    // Motorola: start bit is the MSB (bit 7 of byte 0 is 7, bit 0 of byte 0 is 0),
+    // bits grow to the following bytes going from bit 0 to bit 7 of the next
+    const int msb = (signal->start_bit / 8) * 8 + (7 - signal->start_bit % 8);
+    const int lsb = msb + length - 1;
+    first_byte = msb / 8;
+    last_byte = lsb / 8;
+    plan.shift = 7 - lsb % 8;
+  }
+
+  // Read as one 64 bit integer
+  if(last_byte - first_byte + 1 > 8)
+    return false;
+  if(last_byte >= message_size)
+    return false;
+
+  plan.byte_offset = first_byte;
+  plan.byte_count = last_byte - first_byte + 1;
+  plan.end = last_byte + 1;
+  plan.big_endian = !signal->little_endian;
+  plan.mask = length == 64 ? ~uint64_t(0) : (uint64_t(1) << length) - 1;
+  plan.sign_bit = signal->is_signed ? uint64_t(1) << (length - 1) : 0;
+  plan.type = signal->is_signed ? DBC_SIGNED : DBC_UNSIGNED;
+  plan.factor = signal->factor;
+  plan.offset = signal->offset;
+  return true;
+}
+
+// BO_ 1260 IMU_Gyro: 8 Vector__XXX
+int Dbc::parse_message_line(const string& line)
+{
+  Dbc_Message_t message;
+  uint32_t id;
+  char name[256];
+  int size;
+  if(sscanf(line.c_str(), "BO_ %u %255[^: ] : %d", &id, name, &size) != 3)
+  {
+    error = "Invalid message: " + line;
+    return -1;
+  }
+  if(size <= 0 || size > 64)
+  {
+    error = "Invalid message size: " + line;
+    return -1;
+  }
+
+  message.extended = (id & DBC_EXTENDED_FLAG) != 0;
+  message.id = id & ~DBC_EXTENDED_FLAG;
+  message.name = name;
+  message.size = size;
+  message.mux_signal = -1;
+
+  if(!message.extended && message.id >= DBC_STD_ID_COUNT)
+  {
+    error = "Invalid standard id: " + line;
+    return -1;
+  }
+  for(auto& other : messages)
+  {
+    if(other.id == message.id && other.extended == message.extended)
+    {
+      error = "Duplicated message id: " + line;
+      return -1;
+    }
+  }
+
+  messages.push_back(message);
+  return messages.size() - 1;
+}
+
+// SG_ Speed m2 : 7|16@0- (0.01,0) [-327.68|327.67] "km/h" Vector__XXX
+int Dbc::parse_signal_line(const string& line, Dbc_Message_t* message)
+{
+  Dbc_Signal_t signal;
+  size_t colon = line.find(':');
+  if(colon == string::npos)
+  {
+    error = "Invalid signal: " + line;
+    return -1;
+  }
+
+  // Name and multiplexer indicator
+  stringstream header(line.substr(4, colon - 4));
+  string mux;
+  header >> signal.name >> mux;
+  signal.is_multiplexer = false;
+  signal.mux_value = -1;
+  if(mux == "M")
+    signal.is_multiplexer = true;
+  else if(mux.size() > 1 && mux[0] == 'm')
+    signal.mux_value = atoi(mux.c_str() + 1);
+
+  char order, sign;
+  if(sscanf(line.c_str() + colon + 1, " %d|%d@%c%c (%lf,%lf) [%lf|%lf]",
+            &signal.start_bit, &signal.length, &order, &sign,
+            &signal.factor, &signal.offset, &signal.min, &signal.max) != 8)
+  {
+    error = "Invalid signal: " + line;
+    return -1;
+  }
+  signal.little_endian = order == '1';
+  signal.is_signed = sign == '-';
+
+  size_t unit_start = line.find('"', colon);
+  size_t unit_end = unit_start == string::npos ? string::npos : line.find('"', unit_start + 1);
+  if(unit_end != string::npos)
+    signal.unit = line.substr(unit_start + 1, unit_end - unit_start - 1);
+
+  if(!compile(&signal, message->size))
+  {
+    error = "Signal " + signal.name + " is not in the payload of " + message->name;
+    return -1;
+  }
+
+  if(signal.is_multiplexer)
+  {
+    if(message->mux_signal >= 0)
+    {
+      error = "More multiplexers in " + message->name;
+      return -1;
+    }
+    message->mux_signal = message->signals.size();
+  }
+  message->signals.push_back(signal);
+  return 0;
+}
+
+// SIG_VALTYPE_ 1260 Temperature : 1;
+int Dbc::parse_value_type_line(const string& line)
+{
+  uint32_t id;
+  char name[256];
+  int type;
+  if(sscanf(line.c_str(), "SIG_VALTYPE_ %u %255[^: ] : %d", &id, name, &type) != 3)
+  {
+    error = "Invalid value type: " + line;
+    return -1;
+  }
+
+  const bool extended = (id & DBC_EXTENDED_FLAG) != 0;
+  id &= ~DBC_EXTENDED_FLAG;
+  for(auto& message : messages)
+  {
+    if(message.id != id || message.extended != extended)
+      continue;
+    for(auto& signal : message.signals)
+    {
+      if(signal.name != name)
+        continue;
+      if((type == 1 && signal.length != 32) || (type == 2 && signal.length != 64))
+      {
+        error = "Invalid length of floating point signal " + signal.name;
+        return -1;
+      }
+      if(type == 1)
+        signal.plan.type = DBC_FLOAT;
+      else if(type == 2)
+        signal.plan.type = DBC_DOUBLE;
+      signal.plan.sign_bit = 0;
+      return 0;
+    }
+  }
+  // Value type of a signal not loaded
+  return 0;
+}
@@ -10,6 +10,12 @@ Device::Device(std::string name)
 	this->name = name;
 	prev_timestamp = 0.0;
 }
+void Device::set_fields(double* timestamp, const std::vector<double*>& fields, const std::vector<std::string>& names)
+{
+	sample_timestamp = timestamp;
+	this->fields = fields;
+	field_names = names;
+}
 std::string Device::json_string()
 {
 	StringBuffer sb;
@@ -43,402 +49,50 @@ std::string Device::get_header(const Descriptor* descriptor, std::string separat
 }
 
 ///////////////////////////////
-////////////  IMU  ////////////
-///////////////////////////////
-std::string Imu::get_header(std::string separator)
-{
-	std::string header = "";
-	header += "timestamp" + separator;
-	header += "x" + separator;
-	header += "y" + separator;
-	header += "z" + separator;
-	header += "scale" + separator;
-	return header;
-}
-std::string Imu::get_string(std::string separator)
-{
-	std::string str = "";
-	str += std::to_string(timestamp) + separator;
-	str += std::to_string(x) + separator;
-	str += std::to_string(y) + separator;
-	str += std::to_string(z) + separator;
-	str += std::to_string(scale) + separator;
-	return str;
-}
-Document Imu::get_json()
-{
-	Document d;
-	d.SetObject();
-	Document::AllocatorType &alloc = d.GetAllocator();
-	d.AddMember("timestamp", timestamp, alloc);
-	d.AddMember("x", x, alloc);
-	d.AddMember("y", y, alloc);
-	d.AddMember("z", z, alloc);
-	d.AddMember("scale", scale, alloc);
-	return d;
-}
-void Imu::serialize(devices::Imu* imu)
-{
-	imu->set_timestamp(timestamp);
-	imu->set_x(x);
-	imu->set_y(y);
-	imu->set_z(z);
-	imu->set_scale(scale);
-}
-std::string Imu::get_readable()
-{
-	std::stringstream ss;
-	ss.precision(3);
-	ss << get_name() << "\n";
-	ss << "\ttimestamp -> \t" << timestamp << "\n";
-	ss << "\tx -> \t" << x << "\n";
-	ss << "\ty -> \t" << y << "\n";
-	ss << "\tz -> \t" << z << "\n";
-	ss << "\tscale -> \t" << scale << "\n";
-	return ss.str();
-}
-
-///////////////////////////////
-//////////  ENCODER  //////////
-///////////////////////////////
-std::string Encoder::get_header(std::string separator)
-{
-	std::string header = "";
-	header += "timestamp" + separator;
-	header += "rads" + separator;
-	header += "km" + separator;
-	header += "rotations" + separator;
-	return header;
-}
-std::string Encoder::get_string(std::string separator)
-{
-	std::string str = "";
-	str += std::to_string(timestamp) + separator;
-	str += std::to_string(rads) + separator;
-	str += std::to_string(km) + separator;
-	str += std::to_string(rotations) + separator;
-	return str;
-}
-Document Encoder::get_json()
-{
-	Document d;
-	d.SetObject();
-	Document::AllocatorType &alloc = d.GetAllocator();
-	d.AddMember("timestamp", timestamp, alloc);
-	d.AddMember("rads", rads, alloc);
-	d.AddMember("km", km, alloc);
-	d.AddMember("rotations", rotations, alloc);
-	return d;
-}
-void Encoder::serialize(devices::Encoder* encoder)
-{
-	encoder->set_timestamp(timestamp);
-	encoder->set_rads(rads);
-	encoder->set_km(km);
-	encoder->set_rotations(rotations);
-}
-std::string Encoder::get_readable()
-{
-	std::stringstream ss;
-	ss.precision(3);
-	ss << get_name() << "\n";
-	ss << "\ttimestamp -> \t" << timestamp << "\n";
-	ss << "\trads -> \t" << rads << "\n";
-	ss << "\tkm -> \t" << km << "\n";
-	ss << "\trotations -> \t" << rotations << "\n";
-	return ss.str();
-}
-
-///////////////////////////////
-///////////  STEER  ///////////
-///////////////////////////////
-std::string Steer::get_header(std::string separator)
-{
-	std::string header = "";
-	header += "timestamp" + separator;
-	header += "angle" + separator;
-	return header;
-}
-std::string Steer::get_string(std::string separator)
-{
-	std::string str = "";
-	str += std::to_string(timestamp) + separator;
-	str += std::to_string(angle) + separator;
-	return str;
-}
-Document Steer::get_json()
-{
-	Document d;
-	d.SetObject();
-	Document::AllocatorType &alloc = d.GetAllocator();
-	d.AddMember("timestamp", timestamp, alloc);
-	d.AddMember("angle", angle, alloc);
-	return d;
-}
-void Steer::serialize(devices::Steer* steer)
-{
-	steer->set_timestamp(timestamp);
-	steer->set_angle(angle);
-}
-std::string Steer::get_readable()
-{
-	std::stringstream ss;
-	ss.precision(3);
-	ss << get_name() << "\n";
-	ss << "\ttimestamp -> \t" << timestamp << "\n";
-	ss << "\tangle -> \t" << angle << "\n";
-	return ss.str();
-}
-
-///////////////////////////////
-//////////  PEDALS  //////////
-///////////////////////////////
-std::string Pedals::get_header(std::string separator)
-{
-	std::string header = "";
-	header += "timestamp" + separator;
-	header += "throttle1" + separator;
-	header += "throttle2" + separator;
-	header += "brake_front" + separator;
-	header += "brake_rear" + separator;
-	return header;
-}
-std::string Pedals::get_string(std::string separator)
-{
-	std::string str = "";
-	str += std::to_string(timestamp) + separator;
-	str += std::to_string(throttle1) + separator;
-	str += std::to_string(throttle2) + separator;
-	str += std::to_string(brake_front) + separator;
-	str += std::to_string(brake_rear) + separator;
-	return str;
-}
-Document Pedals::get_json()
-{
-	Document d;
-	d.SetObject();
-	Document::AllocatorType &alloc = d.GetAllocator();
-	d.AddMember("timestamp", timestamp, alloc);
-	d.AddMember("throttle1", throttle1, alloc);
-	d.AddMember("throttle2", throttle2, alloc);
-	d.AddMember("brake_front", brake_front, alloc);
-	d.AddMember("brake_rear", brake_rear, alloc);
-	return d;
-}
-void Pedals::serialize(devices::Pedals* pedals)
-{
-	pedals->set_timestamp(timestamp);
-	pedals->set_throttle1(throttle1);
-	pedals->set_throttle2(throttle2);
-	pedals->set_brake_front(brake_front);
-	pedals->set_brake_rear(brake_rear);
-}
-std::string Pedals::get_readable()
-{
-	std::stringstream ss;
-	ss.precision(3);
-	ss << get_name() << "\n";
-	ss << "\ttimestamp -> \t" << timestamp << "\n";
-	ss << "\tthrottle1 -> \t" << throttle1 << "\n";
-	ss << "\tthrottle2 -> \t" << throttle2 << "\n";
-	ss << "\tbrake_front -> \t" << brake_front << "\n";
-	ss << "\tbrake_rear -> \t" << brake_rear << "\n";
-	return ss.str();
-}
-
-///////////////////////////////
-/////////  INVERTER  /////////
-///////////////////////////////
-std::string Inverter::get_header(std::string separator)
-{
-	std::string header = "";
-	header += "timestamp" + separator;
-	header += "temperature" + separator;
-	header += "motor_temp" + separator;
-	header += "torque" + separator;
-	header += "speed" + separator;
-	return header;
-}
-std::string Inverter::get_string(std::string separator)
-{
-	std::string str = "";
-	str += std::to_string(timestamp) + separator;
-	str += std::to_string(temperature) + separator;
-	str += std::to_string(motor_temp) + separator;
-	str += std::to_string(torque) + separator;
-	str += std::to_string(speed) + separator;
-	return str;
-}
-Document Inverter::get_json()
-{
-	Document d;
-	d.SetObject();
-	Document::AllocatorType &alloc = d.GetAllocator();
-	d.AddMember("timestamp", timestamp, alloc);
-	d.AddMember("temperature", temperature, alloc);
-	d.AddMember("motor_temp", motor_temp, alloc);
-	d.AddMember("torque", torque, alloc);
-	d.AddMember("speed", speed, alloc);
-	return d;
-}
-void Inverter::serialize(devices::Inverter* inverter)
-{
-	inverter->set_timestamp(timestamp);
-	inverter->set_temperature(temperature);
-	inverter->set_motor_temp(motor_temp);
-	inverter->set_torque(torque);
-	inverter->set_speed(speed);
-}
-std::string Inverter::get_readable()
-{
-	std::stringstream ss;
-	ss.precision(3);
-	ss << get_name() << "\n";
-	ss << "\ttimestamp -> \t" << timestamp << "\n";
-	ss << "\ttemperature -> \t" << temperature << "\n";
-	ss << "\tmotor_temp -> \t" << motor_temp << "\n";
-	ss << "\ttorque -> \t" << torque << "\n";
-	ss << "\tspeed -> \t" << speed << "\n";
-	return ss.str();
-}
-
-///////////////////////////////
-////////////  BMS  ////////////
-///////////////////////////////
-std::string Bms::get_header(std::string separator)
-{
-	std::string header = "";
-	header += "timestamp" + separator;
-	header += "temperature" + separator;
-	header += "max_temperature" + separator;
-	header += "min_temperature" + separator;
-	header += "current" + separator;
-	header += "voltage" + separator;
-	header += "max_voltage" + separator;
-	header += "min_voltage" + separator;
-	header += "power" + separator;
-	return header;
-}
-std::string Bms::get_string(std::string separator)
-{
-	std::string str = "";
-	str += std::to_string(timestamp) + separator;
-	str += std::to_string(temperature) + separator;
-	str += std::to_string(max_temperature) + separator;
-	str += std::to_string(min_temperature) + separator;
-	str += std::to_string(current) + separator;
-	str += std::to_string(voltage) + separator;
-	str += std::to_string(max_voltage) + separator;
-	str += std::to_string(min_voltage) + separator;
-	str += std::to_string(power) + separator;
-	return str;
-}
-Document Bms::get_json()
-{
-	Document d;
-	d.SetObject();
-	Document::AllocatorType &alloc = d.GetAllocator();
-	d.AddMember("timestamp", timestamp, alloc);
-	d.AddMember("temperature", temperature, alloc);
-	d.AddMember("max_temperature", max_temperature, alloc);
-	d.AddMember("min_temperature", min_temperature, alloc);
-	d.AddMember("current", current, alloc);
-	d.AddMember("voltage", voltage, alloc);
-	d.AddMember("max_voltage", max_voltage, alloc);
-	d.AddMember("min_voltage", min_voltage, alloc);
-	d.AddMember("power", power, alloc);
-	return d;
-}
-void Bms::serialize(devices::Bms* bms)
-{
-	bms->set_timestamp(timestamp);
-	bms->set_temperature(temperature);
-	bms->set_max_temperature(max_temperature);
-	bms->set_min_temperature(min_temperature);
-	bms->set_current(current);
-	bms->set_voltage(voltage);
-	bms->set_max_voltage(max_voltage);
-	bms->set_min_voltage(min_voltage);
-	bms->set_power(power);
-}
-std::string Bms::get_readable()
-{
-	std::stringstream ss;
-	ss.precision(3);
-	ss << get_name() << "\n";
-	ss << "\ttimestamp -> \t" << timestamp << "\n";
-	ss << "\ttemperature -> \t" << temperature << "\n";
-	ss << "\tmax_temperature -> \t" << max_temperature << "\n";
-	ss << "\tmin_temperature -> \t" << min_temperature << "\n";
-	ss << "\tcurrent -> \t" << current << "\n";
-	ss << "\tvoltage -> \t" << voltage << "\n";
-	ss << "\tmax_voltage -> \t" << max_voltage << "\n";
-	ss << "\tmin_voltage -> \t" << min_voltage << "\n";
-	ss << "\tpower -> \t" << power << "\n";
-	return ss.str();
-}
-
-///////////////////////////////
-////////////  ECU  ////////////
+///////////  STATE  ///////////
 ///////////////////////////////
-std::string Ecu::get_header(std::string separator)
-{
-	std::string header = "";
-	header += "timestamp" + separator;
-	header += "power_request_left" + separator;
-	header += "power_request_right" + separator;
-	return header;
-}
-std::string Ecu::get_string(std::string separator)
-{
-	std::string str = "";
-	str += std::to_string(timestamp) + separator;
-	str += std::to_string(power_request_left) + separator;
-	str += std::to_string(power_request_right) + separator;
-	return str;
-}
-Document Ecu::get_json()
-{
-	Document d;
-	d.SetObject();
-	Document::AllocatorType &alloc = d.GetAllocator();
-	d.AddMember("timestamp", timestamp, alloc);
-	d.AddMember("power_request_left", power_request_left, alloc);
-	d.AddMember("power_request_right", power_request_right, alloc);
-	return d;
-}
-void Ecu::serialize(devices::Ecu* ecu)
-{
-	ecu->set_timestamp(timestamp);
-	ecu->set_power_request_left(power_request_left);
-	ecu->set_power_request_right(power_request_right);
-}
-std::string Ecu::get_readable()
-{
-	std::stringstream ss;
-	ss.precision(3);
-	ss << get_name() << "\n";
-	ss << "\ttimestamp -> \t" << timestamp << "\n";
-	ss << "\tpower_request_left -> \t" << power_request_left << "\n";
-	ss << "\tpower_request_right -> \t" << power_request_right << "\n";
-	return ss.str();
+std::string state_event_to_string(const State_Event_t& event)
+{
+	switch(event.code)
+	{
+	case EVENT_BMS_WARNING:
+		if(event.arg0 >= NUM_WARNINGS)
+			break;
+		return BMS_WARNINGS[event.arg0] + " -> " + std::to_string(event.arg1);
+	case EVENT_BMS_ERROR:
+		if(event.arg0 >= NUM_ERRORS)
+			break;
+		return BMS_ERRORS[event.arg0] + " -> " + std::to_string(event.arg1);
+	case EVENT_ECU_STATE:
+		if(event.arg0 >= NUM_STATES)
+			break;
+		return "STATE: " + ECU_STATES[event.arg0] + " Map: " + std::to_string(event.arg1);
+	default:
+		if(event.code >= NUM_EVENTS)
+			break;
+		return STATE_EVENTS[event.code];
+	}
+	return "UNKNOWN " + std::to_string(event.code) + " " + std::to_string(event.arg0) + " " + std::to_string(event.arg1);
 }
 
-///////////////////////////////
-///////////  STATE  ///////////
-///////////////////////////////
 std::string State::get_header(std::string separator)
 {
 	std::string header = "";
 	header += "timestamp" + separator;
-	header += "value" + separator;
+	header += "code" + separator;
+	header += "arg0" + separator;
+	header += "arg1" + separator;
+	header += "event" + separator;
 	return header;
 }
 std::string State::get_string(std::string separator)
 {
 	std::string str = "";
 	str += std::to_string(timestamp) + separator;
-	str += value + separator;
+	str += std::to_string(event.code) + separator;
+	str += std::to_string(event.arg0) + separator;
+	str += std::to_string(event.arg1) + separator;
+	str += (event.code < NUM_EVENTS ? STATE_EVENTS[event.code] : "") + separator;
 	return str;
 }
 Document State::get_json()
@@ -446,14 +100,20 @@ Document State::get_json()
 	Document d;
 	d.SetObject();
 	Document::AllocatorType &alloc = d.GetAllocator();
+	std::string value = get_value();
 	d.AddMember("timestamp", timestamp, alloc);
+	d.AddMember("code", event.code, alloc);
+	d.AddMember("arg0", event.arg0, alloc);
+	d.AddMember("arg1", event.arg1, alloc);
 	d.AddMember("value", Value().SetString(value.c_str(), value.size(), alloc), alloc);
 	return d;
 }
 void State::serialize(devices::State* state)
 {
 	state->set_timestamp(timestamp);
-	state->set_value(value);
+	state->set_code(event.code);
+	state->set_arg0(event.arg0);
+	state->set_arg1(event.arg1);
 }
 std::string State::get_readable()
 {
@@ -461,58 +121,7 @@ std::string State::get_readable()
 	ss.precision(3);
 	ss << get_name() << "\n";
 	ss << "\ttimestamp -> \t" << timestamp << "\n";
-	ss << "\tvalue -> \t" << value << "\n";
-	return ss.str();
-}
-
-/////////////////////////////////////
-///////////  TEMPERATURE  ///////////
-/////////////////////////////////////
-std::string Temperature::get_header(std::string separator)
-{
-	std::string header = "";
-	header += "timestamp" + separator;
-	for(int i = 0; i < 16; i++)
-		header += "channel_" + std::to_string(i) + separator;
-	return header;
-}
-std::string Temperature::get_string(std::string separator)
-{
-	std::string str = "";
-	str += std::to_string(timestamp) + separator;
-	for(int i = 0; i < 16; i++)
-		str += std::to_string(temps[i]) + separator;
-	return str;
-}
-Document Temperature::get_json()
-{
-	Document d;
-	d.SetObject();
-	Document::AllocatorType &alloc = d.GetAllocator();
-	d.AddMember("timestamp", timestamp, alloc);
-	Value v;
-	v.SetArray();
-	for(int i = 0; i < 16; i++)
-		v.PushBack(temps[i], alloc);
-	d.AddMember("value", v, alloc);
-	return d;
-}
-void Temperature::serialize(devices::Temperature* temperature)
-{
-	temperature->set_timestamp(timestamp);
-
-	temperature->clear_temps();
-	for(int i = 0; i < 16; i++)
-		temperature->add_temps(temps[i]);
-}
-std::string Temperature::get_readable()
-{
-	std::stringstream ss;
-	ss.precision(3);
-	ss << get_name() << "\n";
-	ss << "\ttimestamp -> \t" << timestamp << "\n";
-	for(int i = 0; i < 16; i++)
-		ss << "\tchannel_" << i << " -> \t" << temps[i] << "\n";
+	ss << "\tvalue -> \t" << get_value() << "\n";
 	return ss.str();
 }
 
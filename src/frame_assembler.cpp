@@ -0,0 +1,147 @@
+#include "frame_assembler.h"
+
+#include <stdio.h>
+#include <string.h>
+
+void FrameAssembler::configure(const Assembler_Config_t& config_, double* timestamp_, const vector<double*>& fields_, double* partial_)
+{
+  config = config_;
+  if(config.frames < 1)
+    config.frames = 1;
+  if(config.frames > ASSEMBLER_MAX_FRAMES)
+    config.frames = ASSEMBLER_MAX_FRAMES;
+
+  timestamp = timestamp_;
+  fields = fields_;
+  partial = partial_;
+
+  field_array = fields.size() > 0 ? fields[0] : nullptr;
+  for(size_t i = 1; i < fields.size(); i++)
+    if(fields[i] != fields[0] + i)
+      field_array = nullptr;
+
+  full = config.frames == 32 ? 0xFFFFFFFF : (1u << config.frames) - 1;
+  stage.assign(config.frames * config.frame_fields, 0.0);
+  stats = Assembler_Stats_t();
+  clear();
+}
+
+bool FrameAssembler::add(const int& index, const double& timestamp, const double* values)
+{
+  if(partial == nullptr || index < 0 || index >= config.frames)
+    return false;
+
+  if(config.mode == ASSEMBLER_GROUP)
+    return add_group(index, timestamp, values);
+  return add_frame(index, timestamp);
+}
+
+void FrameAssembler::clear()
+{
+  received = 0;
+  last_index = -1;
+  for(int i = 0; i < ASSEMBLER_MAX_FRAMES; i++)
+    received_at[i] = 0.0;
+}
+
+bool FrameAssembler::add_group(const int& index, const double& timestamp, const double* values)
+{
+  const uint32_t bit = 1u << index;
+  bool emitted = false;
+
+  // This sub-frame belongs to the next group, the current one is emitted as partial
+  if(received != 0)
+  {
+    bool close = true;
+    if(received & bit)
+      stats.duplicates ++;
+    else if(config.order == ASSEMBLER_IN_ORDER && index < last_index)
+      stats.out_of_order ++;
+    else if(timestamp - group_start > config.timeout)
+      stats.timeouts ++;
+    else
+      close = false;
+
+    if(close)
+    {
+      emit();
+      emitted = true;
+    }
+  }
+
+  if(received == 0)
+    group_start = timestamp;
+  // A few values, copied without a call to memcpy
+  if(values != nullptr)
+  {
+    double* staged = stage.data() + index * config.frame_fields;
+    for(int i = 0; i < config.frame_fields; i++)
+      staged[i] = values[i];
+  }
+  received |= bit;
+  last_index = index;
+  last_timestamp = timestamp;
+
+  if(received == full)
+  {
+    emit();
+    emitted = true;
+  }
+  return emitted;
+}
+
+bool FrameAssembler::add_frame(const int& index, const double& timestamp)
+{
+  received |= 1u << index;
+  received_at[index] = timestamp;
+
+  bool is_partial = received != full;
+  for(int i = 0; i < config.frames && !is_partial; i++)
+  {
+    if(timestamp - received_at[i] > config.timeout)
+    {
+      is_partial = true;
+      stats.timeouts ++;
+    }
+  }
+
+  *partial = is_partial ? 1.0 : 0.0;
+  if(is_partial)
+    stats.partial ++;
+  else
+    stats.complete ++;
+  return true;
+}
+
+void FrameAssembler::emit()
+{
+  // Sub-frames missing keep the values of the previous group
+  const size_t count = min(fields.size(), stage.size());
+  if(field_array != nullptr)
+    memcpy(field_array, stage.data(), count * sizeof(double));
+  else
+    for(size_t i = 0; i < count; i++)
+      *fields[i] = stage[i];
+  *timestamp = last_timestamp;
+
+  const bool is_partial = received != full;
+  *partial = is_partial ? 1.0 : 0.0;
+  if(is_partial)
+    stats.partial ++;
+  else
+    stats.complete ++;
+
+  received = 0;
+  last_index = -1;
+}
+
+string FrameAssembler::get_stats_string()
+{
+  char buffer[256];
+  const uint64_t rows = stats.complete + stats.partial;
+  snprintf(buffer, sizeof(buffer), "%lu complete, %lu partial (%.1f%%), %lu timeouts, %lu duplicates, %lu out of order",
+           (unsigned long)stats.complete, (unsigned long)stats.partial,
+           rows > 0 ? 100.0 * stats.complete / rows : 0.0,
+           (unsigned long)stats.timeouts, (unsigned long)stats.duplicates, (unsigned long)stats.out_of_order);
+  return buffer;
+}
@@ -16,6 +16,11 @@ GpsLogger::GpsLogger(int id_, string device)
   m_Thread = new thread(&GpsLogger::Run, this);
 }
 
+pthread_t GpsLogger::GetThreadHandle()
+{
+  return m_Thread->native_handle();
+}
+
 void GpsLogger::SetOutFName(const string& fname)
 {
   m_FName = fname;
@@ -25,6 +30,10 @@ void GpsLogger::SetMode(int mode)
 {
   m_Mode = mode;
 }
+void GpsLogger::SetWriter(AsyncWriter* writer)
+{
+  m_Writer = writer;
+}
 
 void GpsLogger::SetOutputFolder(const string& folder)
 {
@@ -51,10 +60,13 @@ void GpsLogger::StartLogging()
 
   CONSOLE.Log("GPS", id, "Start Logging");
 
-  m_GPS      = new std::ofstream(m_Folder + "/" + m_FName + ".log");
+  if(m_Writer != nullptr)
+    m_GPS    = new AsyncFile(m_Writer, m_Folder + "/" + m_FName + ".log");
+  else
+    m_GPS    = new std::ofstream(m_Folder + "/" + m_FName + ".log");
   m_StatFile = new std::ofstream(m_Folder + "/" + m_FName + ".json");
 
-  if(!m_GPS->is_open())
+  if(m_GPS->fail())
     CONSOLE.LogError("GPS", id, "Error opening .log file", m_Folder + "/" + m_FName + ".log");
   if(!m_StatFile->is_open())
     CONSOLE.LogError("GPS", id, "Error opening .json file", m_Folder + "/" + m_FName + ".json");
@@ -78,7 +90,7 @@ void GpsLogger::StopLogging()
 
   stat.delta_time = GetTimestamp() - stat.delta_time;
   m_StateChanged = false;
-  m_GPS->close();
+  // Closed by the destructor
   delete m_GPS;
   SaveStat();
   m_StatFile->close();
@@ -215,7 +227,7 @@ void GpsLogger::Run()
         try
         {
           line = "(" + to_string(GetTimestamp()) + ")" + "\t" + line + "\n";
-          if(m_GPS->is_open())
+          if(m_GPS->good())
             (*m_GPS) << line << flush;
         }
         catch(std::exception e)
@@ -49,175 +49,179 @@ show_description (HPDF_Page    page,
     HPDF_Page_EndText (page);
 }
 
-void Report::AddDeviceSample(Chimera* chim, Device* device)
+string Report::SensorName(Device* device)
 {
-  static int discard_distance_count = 0;
-  static int discard_voltage_count = 0;
-  if (device == chim->accel){
-    Imu* accel = (Imu*) device;
-    if(first_timestamp < 0.0)
-      first_timestamp = accel->timestamp;
-    auto tim = accel->timestamp - first_timestamp;
-    last_timestamp = max(last_timestamp, tim);
-    sensor_data["accel"]["timestamp"].push_back(tim);
-    sensor_data["accel"]["x"].push_back(accel->x);
-    sensor_data["accel"]["y"].push_back(accel->y);
-    sensor_data["accel"]["z"].push_back(accel->z);
-    max_g = max(max_g, max(fabs(accel->x), fabs(accel->y)));
-  }else if(device == chim->gyro){
-    Imu* gyro = (Imu*) device;
-    if(first_timestamp < 0.0)
-      first_timestamp = gyro->timestamp;
-    auto tim = gyro->timestamp - first_timestamp;
-    last_timestamp = max(last_timestamp, tim);
-    sensor_data["gyro"]["timestamp"].push_back(tim);
-    sensor_data["gyro"]["x"].push_back(gyro->x);
-    sensor_data["gyro"]["y"].push_back(gyro->y);
-    sensor_data["gyro"]["z"].push_back(gyro->z);
-  }else if(device == chim->encoder_left){
-    Encoder* enc = (Encoder*) device;
-    if(first_timestamp < 0.0)
-      first_timestamp = enc->timestamp;
-    auto tim = enc->timestamp - first_timestamp;
-    last_timestamp = max(last_timestamp, tim);
-    sensor_data["encoder_l"]["timestamp"].push_back(tim);
-    sensor_data["encoder_l"]["rads"].push_back(enc->rads);
-    sensor_data["encoder_l"]["km"].push_back(enc->km);
-    sensor_data["encoder_l"]["rotations"].push_back(enc->rotations);
-    sensor_data["encoder_l"]["kmh"].push_back((enc->rads* 0.395/2.0)*3.6);
-    max_speed = max(max_speed, fabs(enc->rads));
-    if(distance_travelled.setted)
+  // Devices plotted are found by their role in codegen/vehicles.json,
+  // a vehicle without some of them has empty plots
+  if(!device->has_fields())
+    return "";
+  return device->role;
+}
+
+void Report::AddStoredRows(Vehicle* vehicle, const int& reader)
+{
+  // Timestamps are relative to the oldest sample of the plotted devices
+  if(first_timestamp < 0.0)
+  {
+    for(auto device : vehicle->devices)
     {
-      distance_travelled.val1 = enc->km;
+      if(SensorName(device) == "")
+        continue;
+      double timestamp = vehicle->next_stored_timestamp(reader, device);
+      if(timestamp >= 0.0 && (first_timestamp < 0.0 || timestamp < first_timestamp))
+        first_timestamp = timestamp;
     }
-    else
+  }
+
+  // Only the devices changed since the last call have new rows
+  vehicle->for_each_device(vehicle->consume_changes(reader), [&](Device* device){
+    const string sensor = SensorName(device);
+    if(sensor == "")
     {
-      if(discard_distance_count >= 10)
-      {
-        distance_travelled.setted = true;
-        distance_travelled.val0 = enc->km;
-      }
-      else
-      {
-        discard_distance_count ++;
-      }
+      // Rows not plotted are skipped
+      vehicle->read_rows(reader, device, [](const Row_Batch_t&){});
+      return;
     }
-  }else if(device == chim->encoder_right){
-    Encoder* enc = (Encoder*) device;
-    if(first_timestamp < 0.0)
-      first_timestamp = enc->timestamp;
-    auto tim = enc->timestamp - first_timestamp;
-    last_timestamp = max(last_timestamp, tim);
-    sensor_data["encoder_r"]["timestamp"].push_back(tim);
-    sensor_data["encoder_r"]["rads"].push_back(enc->rads);
-    sensor_data["encoder_r"]["km"].push_back(enc->km);
-    sensor_data["encoder_r"]["rotations"].push_back(enc->rotations);
-    sensor_data["encoder_r"]["kmh"].push_back((enc->rads* 0.395/2.0)*3.6);
-    max_speed = max(max_speed, fabs(enc->rads));
-  }else if(device == chim->inverter_right){
-    Inverter* inv = (Inverter*) device;
-    if(first_timestamp < 0.0)
-      first_timestamp = inv->timestamp;
-    auto tim = inv->timestamp - first_timestamp;
-    last_timestamp = max(last_timestamp, tim);
-    sensor_data["inverter_r"]["timestamp"].push_back(tim);
-    sensor_data["inverter_r"]["temperature"].push_back(inv->temperature);
-    sensor_data["inverter_r"]["motor_temp"].push_back(inv->motor_temp);
-    sensor_data["inverter_r"]["torque"].push_back(inv->torque);
-    sensor_data["inverter_r"]["speed"].push_back(-inv->speed);
-  }else if(device == chim->inverter_left){
-    Inverter* inv = (Inverter*) device;
-    if(first_timestamp < 0.0)
-      first_timestamp = inv->timestamp;
-    auto tim = inv->timestamp - first_timestamp;
-    last_timestamp = max(last_timestamp, tim);
-    sensor_data["inverter_l"]["timestamp"].push_back(tim);
-    sensor_data["inverter_l"]["temperature"].push_back(inv->temperature);
-    sensor_data["inverter_l"]["motor_temp"].push_back(inv->motor_temp);
-    sensor_data["inverter_l"]["torque"].push_back(inv->torque);
-    sensor_data["inverter_l"]["speed"].push_back(inv->speed);
-  }else if(device == chim->bms_lv){
-    Bms* bms = (Bms*)device;
-    if(first_timestamp < 0.0)
-      first_timestamp = bms->timestamp;
-    auto tim = bms->timestamp - first_timestamp;
-    last_timestamp = max(last_timestamp, tim);
-    sensor_data["bms_lv"]["timestamp"].push_back(tim);
-    sensor_data["bms_lv"]["temperature"].push_back(bms->temperature);
-    sensor_data["bms_lv"]["max_temperature"].push_back(bms->max_temperature);
-    sensor_data["bms_lv"]["voltage"].push_back(bms->voltage);
-  }else if(device == chim->bms_hv){
-    Bms* bms = (Bms*)device;
-    if(first_timestamp < 0.0)
-      first_timestamp = bms->timestamp;
-    auto tim = bms->timestamp - first_timestamp;
+
+    // Vectors are looked up once for each device, not for each sample
+    auto& data = sensor_data[sensor];
+    Report_Columns_t columns;
+    columns.timestamp = &data["timestamp"];
+    for(auto& name : device->field_names)
+      columns.fields.push_back(IsPlotted(sensor, name) ? &data[name] : nullptr);
+    if(sensor == "encoder_l" || sensor == "encoder_r")
+      columns.kmh = &data["kmh"];
+
+    vehicle->read_rows(reader, device, [&](const Row_Batch_t& batch){
+      AddRows(sensor, columns, batch);
+    });
+  });
+}
+
+bool Report::IsPlotted(const string& sensor, const string& field)
+{
+  // Fields of the devices used in the report
+  if(sensor == "accel" || sensor == "gyro")
+    return field != "scale";
+  if(sensor == "bms_lv")
+    return field == "temperature" || field == "max_temperature" || field == "voltage";
+  return true;
+}
+
+void Report::AddRows(const string& sensor, Report_Columns_t& columns, const Row_Batch_t& batch)
+{
+  const size_t count = batch.count;
+
+  vector<double>& timestamps = *columns.timestamp;
+  for(size_t i = 0; i < count; i++)
+  {
+    double tim = batch.timestamp[i] - first_timestamp;
     last_timestamp = max(last_timestamp, tim);
-    sensor_data["bms_hv"]["timestamp"].push_back(tim);
-    sensor_data["bms_hv"]["temperature"].push_back(bms->temperature);
-    sensor_data["bms_hv"]["max_temperature"].push_back(bms->max_temperature);
-    sensor_data["bms_hv"]["min_temperature"].push_back(bms->min_temperature);
-    sensor_data["bms_hv"]["current"].push_back(bms->current);
-    sensor_data["bms_hv"]["voltage"].push_back(bms->voltage);
-    sensor_data["bms_hv"]["max_voltage"].push_back(bms->max_voltage);
-    sensor_data["bms_hv"]["min_voltage"].push_back(bms->min_voltage);
-    sensor_data["bms_hv"]["power"].push_back(bms->power);
-    if(min_voltage_drop.setted)
+    timestamps.push_back(tim);
+  }
+
+  // Contiguous values, copied as blocks
+  for(size_t j = 0; j < columns.fields.size(); j++)
+  {
+    if(columns.fields[j] != nullptr)
+      columns.fields[j]->insert(columns.fields[j]->end(), batch.fields[j], batch.fields[j] + count);
+  }
+
+  // Derived values
+  if(sensor == "accel")
+  {
+    const double* x = batch.fields[0];
+    const double* y = batch.fields[1];
+    for(size_t i = 0; i < count; i++)
+      max_g = max(max_g, max(fabs(x[i]), fabs(y[i])));
+  }
+  else if(sensor == "encoder_l" || sensor == "encoder_r")
+  {
+    const double* rads = batch.fields[0];
+    const double* km = batch.fields[1];
+    for(size_t i = 0; i < count; i++)
     {
-      min_voltage_drop.val1 = bms->min_voltage;
+      columns.kmh->push_back((rads[i]* 0.395/2.0)*3.6);
+      max_speed = max(max_speed, fabs(rads[i]));
     }
-    else
+    if(sensor == "encoder_l")
     {
-      if(discard_voltage_count >= 10)
+      for(size_t i = 0; i < count; i++)
       {
-        min_voltage_drop.setted = true;
-        min_voltage_drop.val0 = bms->min_voltage;
+        if(distance_travelled.setted)
+        {
+          distance_travelled.val1 = km[i];
+        }
+        else
+        {
+          if(discard_distance_count >= 10)
+          {
+            distance_travelled.setted = true;
+            distance_travelled.val0 = km[i];
+          }
+          else
+          {
+            discard_distance_count ++;
+          }
+        }
+      }
+    }
+  }
+  else if(sensor == "inverter_r")
+  {
+    // Right motor spins in the opposite direction
+    vector<double>& speed = *columns.fields[3];
+    for(size_t i = speed.size() - count; i < speed.size(); i++)
+      speed[i] = -speed[i];
+  }
+  else if(sensor == "bms_hv")
+  {
+    const double* voltage = batch.fields[4];
+    const double* min_voltage = batch.fields[6];
+    for(size_t i = 0; i < count; i++)
+    {
+      if(min_voltage_drop.setted)
+      {
+        min_voltage_drop.val1 = min_voltage[i];
       }
       else
       {
-        discard_voltage_count ++;
+        if(discard_voltage_count >= 10)
+        {
+          min_voltage_drop.setted = true;
+          min_voltage_drop.val0 = min_voltage[i];
+        }
+        else
+        {
+          discard_voltage_count ++;
+        }
       }
-    }
-    if(total_voltage_drop.setted)
-    {
-      total_voltage_drop.val1 = bms->voltage;
-    }
-    else
-    {
-      if(discard_voltage_count >= 10)
+      if(total_voltage_drop.setted)
+      {
+        total_voltage_drop.val1 = voltage[i];
+      }
+      else
       {
-        total_voltage_drop.setted = true;
-        total_voltage_drop.val0 = bms->voltage;
+        if(discard_voltage_count >= 10)
+        {
+          total_voltage_drop.setted = true;
+          total_voltage_drop.val0 = voltage[i];
+        }
       }
     }
-  }else if(device == chim->pedal){
-    Pedals* pedals = (Pedals*)device;
-    if(first_timestamp < 0.0)
-      first_timestamp = pedals->timestamp;
-    auto tim = pedals->timestamp - first_timestamp;
-    last_timestamp = max(last_timestamp, tim);
-    sensor_data["pedals"]["timestamp"].push_back(tim);
-    sensor_data["pedals"]["throttle1"].push_back(pedals->throttle1);
-    sensor_data["pedals"]["throttle2"].push_back(pedals->throttle2);
-    sensor_data["pedals"]["brake_front"].push_back(pedals->brake_front);
-    sensor_data["pedals"]["brake_rear"].push_back(pedals->brake_rear);
-    max_brake_pressure = max(max_brake_pressure, max(pedals->brake_front, pedals->brake_rear));
-  }else if(device == chim->steer){
-    Steer* steer = (Steer*)device;
-    if(first_timestamp < 0.0)
-      first_timestamp = steer->timestamp;
-    auto tim = steer->timestamp - first_timestamp;
-    last_timestamp = max(last_timestamp, tim);
-    sensor_data["steer"]["timestamp"].push_back(tim);
-    sensor_data["steer"]["angle"].push_back(steer->angle);
-  }else if(device == chim->ecu_state){
-    
-  }else if(device == chim->bms_hv_state){
-    
-  }else if(device == chim->steering_wheel_state){
-    
-  }else if(device == chim->ecu){
-    
-  }else if(device == chim->gps1){
+  }
+  else if(sensor == "pedals")
+  {
+    const double* brake_front = batch.fields[2];
+    const double* brake_rear = batch.fields[3];
+    for(size_t i = 0; i < count; i++)
+      max_brake_pressure = max(max_brake_pressure, max(brake_front[i], brake_rear[i]));
+  }
+}
+
+void Report::AddDeviceSample(Device* device)
+{
+  if(device->role == "gps1"){
     Gps* gps = (Gps*)device;
     if(gps->altitude != 0)
     {
@@ -254,7 +258,7 @@ void Report::AddDeviceSample(Chimera* chim, Device* device)
       sensor_data["gps1"]["kmh"].push_back(gps->speed_kmh);
     }
     
-  }else if(device == chim->gps2){
+  }else if(device->role == "gps2"){
     Gps* gps = (Gps*)device;
     if(gps->altitude != 0)
     {
@@ -295,6 +299,9 @@ void Report::AddDeviceSample(Chimera* chim, Device* device)
 
 void Report::Filter(const vector<double> &in, vector<double>* out, int window)
 {
+  // Devices missing in the vehicle have no samples
+  if((int)in.size() <= window)
+    return;
   double mean;
   out->reserve(in.size()-window);
   for(int i = 0; i < in.size()-window; i++)
@@ -1,40 +1,63 @@
 #include "utils.h"
 
+#include <linux/can.h>
 
+
+// Candump line: (timestamp) device ID#DATA
+// CAN FD: (timestamp) device ID##<flags>DATA
+// device is optional to read old logs
 bool parse_message(string str, message* msg){
-  size_t pos = str.find("can0");
-  if (pos != string::npos)
+  size_t open = str.find('(');
+  size_t close = str.find(')');
+  if(open == string::npos || close == string::npos || close < open)
+    return false;
+  msg->timestamp = parse_timestamp_ns(str.substr(open + 1, close - open - 1));
+
+  const char* spaces = " \t\r\n";
+  size_t start = str.find_first_not_of(spaces, close + 1);
+  if(start == string::npos)
+    return false;
+  size_t end = str.find_first_of(spaces, start);
+  string token = str.substr(start, end - start);
+
+  msg->device = "";
+  if(token.find('#') == string::npos)
   {
-      str.erase(pos-1, 4);
+    msg->device = token;
+    start = str.find_first_not_of(spaces, end);
+    if(start == string::npos)
+      return false;
+    end = str.find_first_of(spaces, start);
+    token = str.substr(start, end - start);
   }
-  string bff = "";
-  bool timestamp = false;
-  bool id = false;
+
+  size_t hash = token.find('#');
+  if(hash == string::npos || hash == 0)
+    return false;
+  // 8 digits are an extended id (as candump), kept with CAN_EFF_FLAG as in can_frame
+  uint32_t id = stoul(token.substr(0, hash), nullptr, 16);
+  if(hash == 8)
+    id |= CAN_EFF_FLAG;
+  msg->id = int(id);
+
+  size_t data_start = hash + 1;
+  msg->fd = false;
+  msg->flags = 0;
+  if(data_start < token.size() && token[data_start] == '#')
+  {
+    if(data_start + 1 >= token.size())
+      return false;
+    msg->fd = true;
+    msg->flags = (uint8_t)stoi(token.substr(data_start + 1, 1), nullptr, 16);
+    data_start += 2;
+  }
+
+  int max_size = msg->fd ? 64 : 8;
   msg->size = 0;
-  for(int i = 1; i < str.size(); i++){
-    if(str[i] == ')'){
-      msg->timestamp = stod(bff);
-      bff = "";
-      timestamp = true;
-      continue;
-    }
-    if(str[i] == ' ' || str[i] == '\t' || str[i] == '\n'){
-      continue;
-    }
-    if(str[i] == '#'){
-      msg->id = stoi(bff, nullptr, 16);
-      bff = "";
-      id = true;
-      continue;
-    }
-    bff += str[i];
-    if(timestamp && id){
-      if(bff.size() == 2){
-        msg->data[msg->size] = (uint8_t)(std::stoi(bff, nullptr, 16));
-        msg->size ++;
-        bff = "";
-      }
-    }
+  for(size_t i = data_start; i + 1 < token.size() && msg->size < max_size; i += 2)
+  {
+    msg->data[msg->size] = (uint8_t)(std::stoi(token.substr(i, 2), nullptr, 16));
+    msg->size ++;
   }
   return true;
 }
@@ -100,7 +123,28 @@ vector<string> get_gps_from_files(vector<string> files){
   return get_files_with_word(files, "gps");
 }
 vector<string> get_candump_from_files(vector<string> files){
-  return get_files_with_word(files, "dump.log");
+  // Text (candump.log), binary (candump.bin) and compressed (candump.zbin) logs,
+  // segmented ones by their manifest (segments are candump_0000.log, ...).
+  // Only exact names (not candump.manifest.json.tmp), one log per folder as
+  // the log of a folder is parsed into its Parsed folder, manifest first
+  const vector<string> names = {"candump.manifest.json", "candump.log", "candump.bin", "candump.zbin"};
+  map<string, pair<size_t, string>> folder_candump;
+  for(auto& file : files){
+    string name = std::filesystem::path(file).filename().string();
+    for(size_t rank = 0; rank < names.size(); rank++){
+      if(name != names[rank])
+        continue;
+      string folder = get_parent_dir(file);
+      auto found = folder_candump.find(folder);
+      if(found == folder_candump.end() || rank < found->second.first)
+        folder_candump[folder] = {rank, file};
+    }
+  }
+
+  vector<string> candumps;
+  for(auto& folder : folder_candump)
+    candumps.push_back(folder.second.second);
+  return candumps;
 }
 vector<string> get_files_with_word(vector<string> files, string word){
   vector<string> new_vec;
@@ -182,9 +226,134 @@ double get_timestamp()
 {
   return duration_cast<duration<double, milli>>(system_clock::now().time_since_epoch()).count() / 1000;
 }
+int64_t get_timestamp_ns()
+{
+  return duration_cast<nanoseconds>(system_clock::now().time_since_epoch()).count();
+}
+double ns_to_seconds(const int64_t& timestamp)
+{
+  return double(timestamp / 1000000000LL) + double(timestamp % 1000000000LL) / 1e9;
+}
+int64_t parse_timestamp_ns(const string& str)
+{
+  int64_t seconds = 0;
+  int64_t fraction = 0;
+  int fraction_digits = 0;
+  bool in_fraction = false;
+  for(char c : str)
+  {
+    if(c == '.')
+    {
+      in_fraction = true;
+      continue;
+    }
+    if(c < '0' || c > '9')
+      throw invalid_argument("parse_timestamp_ns: " + str);
+    if(!in_fraction)
+      seconds = seconds * 10 + (c - '0');
+    else if(fraction_digits < 9)
+    {
+      fraction = fraction * 10 + (c - '0');
+      fraction_digits ++;
+    }
+  }
+  for(; fraction_digits < 9; fraction_digits++)
+    fraction *= 10;
+  return seconds * 1000000000LL + fraction;
+}
+string timestamp_ns_to_string(const int64_t& timestamp)
+{
+  char bff[32];
+  snprintf(bff, sizeof(bff), "%lld.%06lld", (long long)(timestamp / 1000000000LL), (long long)((timestamp % 1000000000LL) / 1000));
+  return bff;
+}
 string get_hex(int num, int zeros)
 {
   stringstream ss;
   ss << setw(zeros) << uppercase << setfill('0') << hex << num;
   return ss.str();
-}
\ No newline at end of file
+}
+
+bool parse_cpu_list(const string& list, cpu_set_t* set)
+{
+  CPU_ZERO(set);
+  for(auto range : split(list, ','))
+  {
+    if(range.size() == 0)
+      continue;
+    size_t dash = range.find('-');
+    int first, last;
+    try
+    {
+      first = stoi(range.substr(0, dash));
+      last = dash == string::npos ? first : stoi(range.substr(dash + 1));
+    }
+    catch(exception e)
+    {
+      return false;
+    }
+    if(first < 0 || last < first || last >= CPU_SETSIZE)
+      return false;
+    for(int cpu = first; cpu <= last; cpu++)
+      CPU_SET(cpu, set);
+  }
+  return CPU_COUNT(set) > 0;
+}
+
+string cpu_list_str(const cpu_set_t& set)
+{
+  string out = "";
+  for(int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+  {
+    if(!CPU_ISSET(cpu, &set))
+      continue;
+    int last = cpu;
+    while(last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, &set))
+      last ++;
+    if(out.size() > 0)
+      out += ",";
+    out += to_string(cpu);
+    if(last > cpu)
+      out += "-" + to_string(last);
+    cpu = last;
+  }
+  return out;
+}
+
+int set_thread_affinity(pthread_t thread, const cpu_set_t& set)
+{
+  return pthread_setaffinity_np(thread, sizeof(cpu_set_t), &set);
+}
+
+int set_thread_priority(pthread_t thread, int priority)
+{
+  sched_param param;
+  memset(&param, 0, sizeof(param));
+  if(priority <= 0)
+    return pthread_setschedparam(thread, SCHED_OTHER, &param);
+  param.sched_priority = priority;
+  return pthread_setschedparam(thread, SCHED_FIFO, &param);
+}
+
+string thread_placement_str(pthread_t thread)
+{
+  string out = "cpus ";
+  cpu_set_t set;
+  if(pthread_getaffinity_np(thread, sizeof(set), &set) == 0)
+    out += cpu_list_str(set);
+  else
+    out += "?";
+
+  int policy;
+  sched_param param;
+  if(pthread_getschedparam(thread, &policy, &param) == 0)
+  {
+    if(policy == SCHED_FIFO)
+      out += " SCHED_FIFO " + to_string(param.sched_priority);
+    else if(policy == SCHED_RR)
+      out += " SCHED_RR " + to_string(param.sched_priority);
+    else
+      out += " SCHED_OTHER";
+  }
+  return out;
+}
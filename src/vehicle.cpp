@@ -1,145 +1,423 @@
 #include "vehicle.h"
+#include "vehicle_signals.h"
 
+//////////////////////// Decoders
+// Each one handles a frame (or a mux value of a frame) of parse_message
 
-Chimera::Chimera(){
-
-  // Device initialization
-  gyro  = new Imu("Gyro");
-  accel = new Imu("Accel");
-  encoder_left  = new Encoder("Encoder Left");
-  encoder_right = new Encoder("Encoder Right");
-  inverter_left  = new Inverter("Inverter Left");
-  inverter_right = new Inverter("Inverter Right");
-  bms_lv = new Bms("BMS LV");
-  bms_hv = new Bms("BMS HV");
-  pedal = new Pedals("Pedals");
-  steer = new Steer("Steer");
-  ecu_state = new State("State ECU");
-  bms_hv_state = new State("State BMS HV");
-  steering_wheel_state = new State("State Steering Wheel");
-  ecu = new Ecu("ECU");
-  temp_fl = new Temperature("Temperature FL");
-  temp_fr = new Temperature("Temperature FR");
-  temp_rl = new Temperature("Temperature RL");
-  temp_rr = new Temperature("Temperature RR");
-  gps1 = new Gps("GPS1");
-  gps2 = new Gps("GPS2");
-
-
-  // Device list
-  devices.push_back(gyro);
-  devices.push_back(accel);
-  devices.push_back(encoder_left);
-  devices.push_back(encoder_right);
-  devices.push_back(inverter_left);
-  devices.push_back(inverter_right);
-  devices.push_back(bms_lv);
-  devices.push_back(bms_hv);
-  devices.push_back(pedal);
-  devices.push_back(steer);
-  devices.push_back(ecu_state);
-  devices.push_back(bms_hv_state);
-  devices.push_back(steering_wheel_state);
-  devices.push_back(ecu);
-  devices.push_back(temp_fl);
-  devices.push_back(temp_fr);
-  devices.push_back(temp_rl);
-  devices.push_back(temp_rr);
-  devices.push_back(gps1);
-  devices.push_back(gps2);
-
-  // Protobuffer section
-
-  // Initializing chimera protobuffer
-  chimera_proto = new devices::Chimera();
-
-  // Initialize vector containing protobuffer (message) of each device
-  // Must be in the same order as the vector of devices
-  proto_messages.push_back(new devices::Imu());
-  proto_messages.push_back(new devices::Imu());
-  proto_messages.push_back(new devices::Encoder());
-  proto_messages.push_back(new devices::Encoder());
-  proto_messages.push_back(new devices::Inverter());
-  proto_messages.push_back(new devices::Inverter());
-  proto_messages.push_back(new devices::Bms());
-  proto_messages.push_back(new devices::Bms());
-  proto_messages.push_back(new devices::Pedals());
-  proto_messages.push_back(new devices::Steer());
-  proto_messages.push_back(new devices::State());
-  proto_messages.push_back(new devices::State());
-  proto_messages.push_back(new devices::State());
-  proto_messages.push_back(new devices::Ecu());
-  proto_messages.push_back(new devices::Temperature());
-  proto_messages.push_back(new devices::Temperature());
-  proto_messages.push_back(new devices::Temperature());
-  proto_messages.push_back(new devices::Temperature());
-  proto_messages.push_back(new devices::Gps());
-  proto_messages.push_back(new devices::Gps());
-
-  if(devices.size() != proto_messages.size()){
-    throw logic_error("Chimera initialization incorrect, vectors of devices and messages not of the same size");
+// arg is the scale
+static void decode_imu(Chimera*, const Decoder_t& d, const double& timestamp, const uint8_t data[], const int&, Device_Set_t& modified){
+  Imu* imu = (Imu*)d.device;
+  imu->scale = d.arg;
+  Imu_Frame::decode(data, imu->x, imu->y, imu->z);
+  imu->timestamp = timestamp;
+
+  modified.set(imu->index);
+}
+
+static void decode_throttle(Chimera*, const Decoder_t& d, const double& timestamp, const uint8_t data[], const int&, Device_Set_t& modified){
+  Pedals* pedal = (Pedals*)d.device;
+  Throttle_Frame::decode(data, pedal->throttle1, pedal->throttle2);
+
+  pedal->timestamp = timestamp;
+
+  modified.set(pedal->index);
+}
+
+static void decode_brake(Chimera*, const Decoder_t& d, const double& timestamp, const uint8_t data[], const int&, Device_Set_t& modified){
+  Pedals* pedal = (Pedals*)d.device;
+  pedal->timestamp = timestamp;
+
+  pedal->brake_front = double((Brake_Front_High::raw(data) << 8) + Brake_Front_Low::raw(data)) / 500.0;
+  pedal->brake_rear  = double((Brake_Rear_High::raw(data) << 8) + Brake_Rear_Low::raw(data)) / 500.0;
+
+  modified.set(pedal->index);
+}
+
+static void decode_steer(Chimera*, const Decoder_t& d, const double& timestamp, const uint8_t data[], const int&, Device_Set_t& modified){
+  Steer* steer = (Steer*)d.device;
+  steer->angle = Steer_Angle::value(data);
+
+  steer->timestamp = timestamp;
+
+  modified.set(steer->index);
+}
+
+// Both encoders are in the same frame
+static void decode_encoders_speed(Chimera* chimera, const Decoder_t&, const double& timestamp, const uint8_t data[], const int&, Device_Set_t& modified){
+  Encoder* encoder_left = chimera->encoder_left;
+  Encoder* encoder_right = chimera->encoder_right;
+
+  Encoders_Speed_Frame::decode(data, encoder_left->rads, encoder_right->rads);
+  if(Encoder_Left_Reverse::raw(data) == 1)
+    encoder_left->rads *= -1;
+  if(Encoder_Right_Reverse::raw(data) == 1)
+    encoder_right->rads *= -1;
+
+  encoder_left->timestamp = timestamp;
+  encoder_right->timestamp = timestamp;
+
+  modified.set(encoder_left->index);
+  modified.set(encoder_right->index);
+}
+
+static void decode_encoders_distance(Chimera* chimera, const Decoder_t&, const double& timestamp, const uint8_t data[], const int&, Device_Set_t&){
+  Encoder* encoder_left = chimera->encoder_left;
+  Encoder* encoder_right = chimera->encoder_right;
+
+  encoder_left->rotations = Encoder_Rotations::value(data);
+  encoder_left->km = Encoder_Km::value(data);
+  encoder_right->rotations = encoder_left->rotations;
+  encoder_right->km = encoder_left->km;
+  // error left data[6]
+  // error right data[6]
+
+  encoder_left->timestamp = timestamp;
+  encoder_right->timestamp = timestamp;
+
+  // modified.set(encoder_left->index);
+  // modified.set(encoder_right->index);
+}
+
+static void decode_bms_hv_voltage(Chimera*, const Decoder_t& d, const double& timestamp, const uint8_t data[], const int&, Device_Set_t& modified){
+  Bms* bms_hv = (Bms*)d.device;
+  Bms_Voltage_Frame::decode(data, bms_hv->voltage, bms_hv->max_voltage, bms_hv->min_voltage);
+  bms_hv->timestamp   =   timestamp;
+  bms_hv->assembler.add(BMS_HV_FRAME_VOLTAGE, timestamp);
+  modified.set(bms_hv->index);
+}
+
+static void decode_bms_hv_current(Chimera*, const Decoder_t& d, const double& timestamp, const uint8_t data[], const int&, Device_Set_t& modified){
+  Bms* bms_hv = (Bms*)d.device;
+  Bms_Current_Frame::decode(data, bms_hv->current, bms_hv->power);
+  bms_hv->timestamp = timestamp;
+  bms_hv->assembler.add(BMS_HV_FRAME_CURRENT, timestamp);
+  modified.set(bms_hv->index);
+}
+
+static void decode_bms_hv_temperature(Chimera*, const Decoder_t& d, const double& timestamp, const uint8_t data[], const int&, Device_Set_t& modified){
+  Bms* bms_hv = (Bms*)d.device;
+  Bms_Temperature_Frame::decode(data, bms_hv->temperature, bms_hv->max_temperature, bms_hv->min_temperature);
+  bms_hv->timestamp       =   timestamp;
+  bms_hv->assembler.add(BMS_HV_FRAME_TEMPERATURE, timestamp);
+  modified.set(bms_hv->index);
+}
+
+static void decode_bms_hv_warning(Chimera*, const Decoder_t& d, const double& timestamp, const uint8_t data[], const int&, Device_Set_t& modified){
+  State* bms_hv_state = (State*)d.device;
+  bms_hv_state->set_event(EVENT_BMS_WARNING, data[1], data[2]);
+  bms_hv_state->timestamp = timestamp;
+  modified.set(bms_hv_state->index);
+}
+
+static void decode_bms_hv_error(Chimera*, const Decoder_t& d, const double& timestamp, const uint8_t data[], const int&, Device_Set_t& modified){
+  State* bms_hv_state = (State*)d.device;
+  bms_hv_state->set_event(EVENT_BMS_ERROR, data[1], data[2]);
+  bms_hv_state->timestamp = timestamp;
+  modified.set(bms_hv_state->index);
+}
+
+// arg is the STATE_EVENT_T code
+static void decode_state(Chimera*, const Decoder_t& d, const double& timestamp, const uint8_t[], const int&, Device_Set_t& modified){
+  State* state = (State*)d.device;
+  state->set_event(d.arg);
+  state->timestamp = timestamp;
+  modified.set(state->index);
+}
+
+static void decode_ecu_state(Chimera*, const Decoder_t& d, const double& timestamp, const uint8_t data[], const int&, Device_Set_t& modified){
+  State* ecu_state = (State*)d.device;
+  // if(size < NUM_STATES)
+  //   break;
+  ecu_state->set_event(EVENT_ECU_STATE, data[4], data[3]);
+  ecu_state->timestamp = timestamp;
+  modified.set(ecu_state->index);
+}
+
+// Same mux, data[1] tells if it is caused by errors
+static void decode_ecu_ts_off(Chimera*, const Decoder_t& d, const double& timestamp, const uint8_t data[], const int&, Device_Set_t& modified){
+  State* ecu_state = (State*)d.device;
+  if(data[1] == 0x04)
+    ecu_state->set_event(EVENT_REQUEST_TS_OFF);
+  else if(data[1] == 0x08)
+    ecu_state->set_event(EVENT_REQUEST_TS_OFF_ERRORS);
+  else
+    return;
+  ecu_state->timestamp = timestamp;
+  modified.set(ecu_state->index);
+}
+
+static void decode_bms_lv(Chimera*, const Decoder_t& d, const double& timestamp, const uint8_t data[], const int&, Device_Set_t& modified){
+  Bms* bms_lv = (Bms*)d.device;
+  Bms_Lv_Frame::decode(data, bms_lv->voltage, bms_lv->temperature, bms_lv->max_temperature);
+  bms_lv->timestamp = timestamp;
+  modified.set(bms_lv->index);
+}
+
+static void decode_inverter_torque(Chimera*, const Decoder_t& d, const double& timestamp, const uint8_t data[], const int&, Device_Set_t& modified){
+  Inverter* inverter = (Inverter*)d.device;
+  inverter->torque = Inverter_Value::raw(data);
+  if(inverter->torque > 32767)
+    inverter->torque -= 65535;
+  inverter->timestamp = timestamp;
+  inverter->assembler.add(INVERTER_FRAME_TORQUE, timestamp);
+  modified.set(inverter->index);
+}
+
+static void decode_inverter_temperature(Chimera*, const Decoder_t& d, const double& timestamp, const uint8_t data[], const int&, Device_Set_t& modified){
+  Inverter* inverter = (Inverter*)d.device;
+  inverter->temperature = (Inverter_Value::raw(data) - 15797) / 112.1182;
+  inverter->timestamp = timestamp;
+  inverter->assembler.add(INVERTER_FRAME_TEMPERATURE, timestamp);
+  modified.set(inverter->index);
+}
+
+static void decode_inverter_motor_temp(Chimera*, const Decoder_t& d, const double& timestamp, const uint8_t data[], const int&, Device_Set_t& modified){
+  Inverter* inverter = (Inverter*)d.device;
+  inverter->motor_temp = (Inverter_Value::raw(data) - 9393.9)/55.1;
+  inverter->timestamp = timestamp;
+  inverter->assembler.add(INVERTER_FRAME_MOTOR_TEMP, timestamp);
+  modified.set(inverter->index);
+}
+
+// Speed filtered and unfiltered,
+// arg != 0 inverts the sign (unfiltered speed of the right inverter)
+static void decode_inverter_speed(Chimera*, const Decoder_t& d, const double& timestamp, const uint8_t data[], const int&, Device_Set_t& modified){
+  Inverter* inverter = (Inverter*)d.device;
+  inverter->speed = Inverter_Value::raw(data);
+  if(inverter->speed > 32767)
+    inverter->speed -= 65535;
+  if(d.arg != 0)
+    inverter->speed *= -1;
+
+  inverter->speed *= (7000.0/32767.0);
+  inverter->speed *= (6.28318/60.0);
+
+  // Motor reduction ratio
+  inverter->speed /= 3.47;
+
+  inverter->timestamp = timestamp;
+  inverter->assembler.add(INVERTER_FRAME_SPEED, timestamp);
+  modified.set(inverter->index);
+}
+
+static void decode_power_request_left(Chimera*, const Decoder_t& d, const double& timestamp, const uint8_t data[], const int&, Device_Set_t& modified){
+  Ecu* ecu = (Ecu*)d.device;
+  ecu->power_request_left = Inverter_Value::value(data);
+  ecu->timestamp = timestamp;
+  modified.set(ecu->index);
+}
+
+static void decode_power_request_right(Chimera*, const Decoder_t& d, const double& timestamp, const uint8_t data[], const int&, Device_Set_t& modified){
+  Ecu* ecu = (Ecu*)d.device;
+  ecu->power_request_right = Inverter_Value::value(data);
+  ecu->timestamp = timestamp;
+  modified.set(ecu->index);
+}
+
+// Each sensor sends 16 temperatures in 4 frames (ID, ID+1, ID+2, ID+3),
+// arg is the index of the frame.
+// CAN FD frames pack the following frames of the same sensor in 8 bytes blocks,
+// 0x5B0 with 32 bytes has all the 16 temps.
+// The assembler writes the 16 temps when the group is complete or closed (partial)
+static void decode_temperature(Chimera*, const Decoder_t& d, const double& timestamp, const uint8_t data[], const int& size, Device_Set_t& modified){
+  Temperature* temp = (Temperature*)d.device;
+  double values[4];
+  for(int block = d.arg, offset = 0; block < 4 && (offset == 0 || offset + 8 <= size); block++, offset += 8)
+  {
+    Temperature_Frame::decode_array(data + offset, values);
+    if(temp->assembler.add(block, timestamp, values))
+      modified.set(temp->index);
+  }
+}
+
+Chimera::Chimera(): VehicleImpl("Chimera", new devices::Chimera(), CHIMERA_SERIALIZERS){
+
+  // Device initialization, devices of Chimera in codegen/vehicles.json in order
+#define CHIMERA_NEW_DEVICE(type, member, name, role) member = new type(name); add_device(member, #member, role);
+  CHIMERA_DEVICES(CHIMERA_NEW_DEVICE)
+#undef CHIMERA_NEW_DEVICE
+
+  // Dispatch table
+  add_decoder<decode_imu>(0x4EC, gyro, 245, DECODE_BATCH_IMU);
+  add_decoder<decode_imu>(0x4ED, accel, 8, DECODE_BATCH_IMU);
+
+  add_mux_decoder<decode_throttle>(0xB0, 0x01, pedal);
+  add_mux_decoder<decode_brake>(0xB0, 0x02, pedal);
+  add_mux_decoder<decode_steer>(0xC0, 0x02, steer);
+
+  add_decoder<decode_encoders_speed>(0xD0, nullptr);
+  add_decoder<decode_encoders_distance>(0xD1, nullptr);
+
+  add_mux_decoder<decode_bms_hv_voltage>(0xAA, 0x01, bms_hv);
+  add_mux_decoder<decode_state>(0xAA, 0x03, bms_hv_state, EVENT_TS_ON);
+  add_mux_decoder<decode_state>(0xAA, 0x04, bms_hv_state, EVENT_TS_OFF);
+  add_mux_decoder<decode_bms_hv_warning>(0xAA, 0x09, bms_hv_state);
+  add_mux_decoder<decode_bms_hv_error>(0xAA, 0x08, bms_hv_state);
+  add_mux_decoder<decode_bms_hv_current>(0xAA, 0x05, bms_hv);
+  add_mux_decoder<decode_bms_hv_temperature>(0xAA, 0x0A, bms_hv);
+
+  add_decoder<decode_bms_lv>(0xFF, bms_lv);
+
+  add_mux_decoder<decode_inverter_torque>(0x181, 0xA0, inverter_left);
+  add_mux_decoder<decode_inverter_temperature>(0x181, 0x4A, inverter_left);
+  add_mux_decoder<decode_inverter_motor_temp>(0x181, 0x49, inverter_left);
+  add_mux_decoder<decode_inverter_speed>(0x181, 0xA8, inverter_left);
+  add_mux_decoder<decode_inverter_speed>(0x181, 0x30, inverter_left);
+  add_mux_decoder<decode_inverter_torque>(0x182, 0xA0, inverter_right);
+  add_mux_decoder<decode_inverter_temperature>(0x182, 0x4A, inverter_right);
+  add_mux_decoder<decode_inverter_motor_temp>(0x182, 0x49, inverter_right);
+  add_mux_decoder<decode_inverter_speed>(0x182, 0xA8, inverter_right);
+  add_mux_decoder<decode_inverter_speed>(0x182, 0x30, inverter_right, 1);
+
+  add_mux_decoder<decode_state>(0xA0, 0x03, steering_wheel_state, EVENT_REQUEST_TS_ON);
+  add_mux_decoder<decode_state>(0xA0, 0x04, steering_wheel_state, EVENT_REQUEST_TO_IDLE);
+  add_mux_decoder<decode_state>(0xA0, 0x05, steering_wheel_state, EVENT_REQUEST_TO_RUN);
+  add_mux_decoder<decode_state>(0xA0, 0x06, steering_wheel_state, EVENT_REQUEST_TO_SETUP);
+  add_mux_decoder<decode_state>(0xA0, 0x08, steering_wheel_state, EVENT_REQUEST_INVERTER_LEFT_ON);
+  add_mux_decoder<decode_state>(0xA0, 0x09, steering_wheel_state, EVENT_REQUEST_INVERTER_RIGHT_ON);
+
+  add_mux_decoder<decode_ecu_state>(0x55, 0x01, ecu_state);
+  add_mux_decoder<decode_ecu_ts_off>(0x55, 0x0B, ecu_state);
+  add_mux_decoder<decode_state>(0x55, 0x0A, ecu_state, EVENT_REQUEST_TS_ON);
+
+  add_mux_decoder<decode_power_request_left>(0x201, 0x90, ecu);
+  add_mux_decoder<decode_power_request_right>(0x202, 0x90, ecu);
+
+  Temperature* temps[] = {temp_fl, temp_fr, temp_rl, temp_rr};
+  for(int i = 0; i < 16; i++)
+    add_decoder<decode_temperature>(0x5B0 + i, temps[i / 4], i % 4, DECODE_BATCH_TEMPERATURE);
+
+  // Devices sent in more frames
+  Assembler_Config_t bms_hv_frames;
+  bms_hv_frames.frames = BMS_HV_FRAME_COUNT;
+  bms_hv_frames.timeout = BMS_HV_FRAMES_TIMEOUT;
+  bms_hv->assembler.configure(bms_hv_frames, &bms_hv->timestamp, {}, &bms_hv->partial);
+
+  Assembler_Config_t inverter_frames;
+  inverter_frames.frames = INVERTER_FRAME_COUNT;
+  inverter_frames.timeout = INVERTER_FRAMES_TIMEOUT;
+  inverter_left->assembler.configure(inverter_frames, &inverter_left->timestamp, {}, &inverter_left->partial);
+  inverter_right->assembler.configure(inverter_frames, &inverter_right->timestamp, {}, &inverter_right->partial);
+
+  Assembler_Config_t temperature_group;
+  temperature_group.frames = 4;
+  temperature_group.mode = ASSEMBLER_GROUP;
+  temperature_group.timeout = TEMPERATURE_GROUP_TIMEOUT;
+  temperature_group.frame_fields = 4;
+  for(auto temp : temps)
+  {
+    vector<double*> channels;
+    for(int i = 0; i < 16; i++)
+      channels.push_back(&temp->temps[i]);
+    temp->assembler.configure(temperature_group, &temp->timestamp, channels, &temp->partial);
   }
+}
 
-  // Get all names of the chimera message
-  auto descriptor = chimera_proto->GetDescriptor();
-  string separator = ";";
-  for(int i = 0; i < descriptor->field_count(); i++){
-    string field = descriptor->field(i)->json_name();
-    auto descriptor = proto_messages[i]->GetDescriptor();
+Fenice::Fenice(): VehicleImpl("Fenice", new devices::Fenice(), FENICE_SERIALIZERS){
 
-    proto_names.push_back(field);
-    device_headers.insert({field, Device::get_header(descriptor, separator)});
+  // Device initialization, devices of Fenice in codegen/vehicles.json in order
+#define FENICE_NEW_DEVICE(type, member, name, role) member = new type(name); add_device(member, #member, role);
+  FENICE_DEVICES(FENICE_NEW_DEVICE)
+#undef FENICE_NEW_DEVICE
+
+  // Dispatch table, empty until the frames of Fenice are defined.
+  // Frames of its other buses are added after set_decoder_bus
+}
+
+Vehicle* new_vehicle(const string& name){
+  if(name == "chimera")
+    return new Chimera();
+  if(name == "fenice")
+    return new Fenice();
+  return nullptr;
+}
+
+//////////////////////// Vehicle
+
+Vehicle::Vehicle(const string& name_, Message* proto, const Serialize_Device_Fn* serializers_): store(VEHICLE_STORE_CHUNKS){
+  name = name_;
+  vehicle_proto = proto;
+  serializers = serializers_;
+}
+
+void Vehicle::add_device(Device* device, const string& field_name, const string& role){
+  device->index = devices.size();
+  device->role = role;
+  devices.push_back(device);
+
+  // Message of each device, same order of the vector of devices
+  const string separator = ";";
+  const FieldDescriptor* field = vehicle_proto->GetDescriptor()->FindFieldByName(field_name);
+  const Descriptor* message = field->message_type();
+  proto_fields.push_back(field);
+  proto_messages.push_back(MessageFactory::generated_factory()->GetPrototype(message)->New());
+  proto_names.push_back(field->json_name());
+  device_headers.insert({field->json_name(), Device::get_header(message, separator)});
+
+  // Message field of each numeric field of the device, after the timestamp.
+  // A repeated field takes the fields not used by the scalar ones (Temperature)
+  vector<const FieldDescriptor*> columns;
+  if(device->has_fields())
+  {
+    int scalars = 0;
+    for(int j = 1; j < message->field_count(); j++)
+      if(!message->field(j)->is_repeated())
+        scalars ++;
+    const int repeated = int(device->fields.size()) - scalars;
+    for(int j = 1; j < message->field_count(); j++)
+      for(int k = 0; k < (message->field(j)->is_repeated() ? repeated : 1); k++)
+        columns.push_back(message->field(j));
   }
+  proto_columns.push_back(columns);
+
+  // Sample store, one column for each numeric field
+  for(auto& column : device->field_names)
+    device->columns.push_back(store.add_column(device->get_name() + "." + column));
+}
+
+Device* Vehicle::find_device(const string& role){
+  for(auto device : devices)
+    if(role != "" && device->role == role)
+      return device;
+  return nullptr;
 }
 
-Chimera::~Chimera(){
-  delete chimera_proto;
+Vehicle::~Vehicle(){
+  delete vehicle_proto;
+  for(auto message : proto_messages)
+    delete message;
 
-  delete accel;
-  delete gyro;
-  delete encoder_left;
-  delete encoder_right;
-  delete bms_lv;
-  delete bms_hv;
-  delete inverter_left;
-  delete inverter_right;
-  delete pedal;
-  delete steer;
-  delete ecu_state;
-  delete bms_hv_state;
-  delete steering_wheel_state;
-  delete ecu;
-  delete temp_fl;
-  delete temp_fr;
-  delete temp_rl;
-  delete temp_rr;
-  delete gps1;
-  delete gps2;
+  for(auto device : devices)
+    delete device;
 
-  
+  for(auto table : mux_tables)
+    delete[] table;
 }
 
 
-void Chimera::add_filenames(string base_path, string extension){
+void Vehicle::add_filenames(string base_path, string extension){
   for(auto device : devices){
     device->filenames.push_back(base_path + "/" + device->get_name() + extension);
   }
 }
 
-void Chimera::open_all_files(){
+void Vehicle::open_all_files(){
   for(auto device : devices)
     for(auto filename : device->filenames)
-      device->files.push_back(new std::fstream(filename, std::fstream::out));
+    {
+      if(writer != nullptr)
+        device->files.push_back(new AsyncFile(writer, filename));
+      else
+        device->files.push_back(new std::fstream(filename, std::fstream::out));
+    }
 }
 
-void Chimera::close_all_files(){
+void Vehicle::close_all_files(){
   for(Device* device : devices){
     for(auto file : device->files){
+      // Closed by the destructor
       if(file != nullptr)
-      {
-        file->close();
         delete file;
-      }
     }
 
     device->files.clear();
@@ -147,548 +425,172 @@ void Chimera::close_all_files(){
   }
 }
 
-void Chimera::close_files(int index){
+void Vehicle::close_files(int index){
   for(auto device : devices){
-    device->files[index]->close();
+    delete device->files[index];
     device->files.erase(device->files.begin() + index);
     device->filenames.erase(device->filenames.begin() + index);
   }
 }
 
-void Chimera::write_all_headers(int index){
+void Vehicle::write_all_headers(int index){
   for(auto device : devices)
     *device->files[index] << device->get_header(",") << "\n" << flush;
 }
 
-void Chimera::parse_message(const double& timestamp, const int &id, const uint8_t data[], const int &size, vector<Device *>& modifiedDevices){
-  modifiedDevices.clear();
-
-  switch (id) {
-    case 0x4EC:
-      gyro->scale = 245;
-      gyro->x = (data[0] << 8) + data[1];
-      gyro->y = (data[2] << 8) + data[3];
-      gyro->z = (data[4] << 8) + data[5];
-
-      if(gyro->x > 32767)
-        gyro->x -= 65536;
-      if(gyro->y > 32767)
-        gyro->y -= 65536;
-      if(gyro->z > 32767)
-        gyro->z -= 65536;
-
-      gyro->x /= 100.0f;
-      gyro->y /= 100.0f;
-      gyro->z /= 100.0f;
-
-      gyro->timestamp = timestamp;
-
-      modifiedDevices.push_back(gyro);
-    break;
-    case 0x4ED:
-      accel->scale = 8;
-      accel->x = (data[0] << 8) + data[1];
-      accel->y = (data[2] << 8) + data[3];
-      accel->z = (data[4] << 8) + data[5];
-
-      if(accel->x > 32767)
-        accel->x -= 65536;
-      if(accel->y > 32767)
-        accel->y -= 65536;
-      if(accel->z > 32767)
-        accel->z -= 65536;
-
-      accel->x /= 100.0f;
-      accel->y /= 100.0f;
-      accel->z /= 100.0f;
-
-      accel->timestamp = timestamp;
-
-      modifiedDevices.push_back(accel);
-    break;
-    case 0xB0: // Pedals
-      if(data[0] == 0x01){
-        pedal->throttle1 = data[1];
-        pedal->throttle2 = data[2];
-
-        pedal->timestamp = timestamp;
-
-        modifiedDevices.push_back(pedal);
-      }
-      else if(data[0] == 0x02){
-        pedal->timestamp = timestamp;
-
-        pedal->brake_front = (data[2] << 8) + data[4];
-        pedal->brake_rear  = (data[5] << 8) + data[7];
-
-        pedal->brake_front /= 500.0f;
-        pedal->brake_rear /= 500.0f;
+int Vehicle::add_store_reader(){
+  reader_cursors.push_back(vector<uint64_t>(devices.size(), 0));
+  serialized_timestamps.push_back(vector<double>(devices.size(), 0.0));
+  lost_rows.push_back(0);
+  reader_changes.push_back(Device_Set_t());
+  return reader_cursors.size() - 1;
+}
 
-        modifiedDevices.push_back(pedal);
-      }
-    break;
-    case 0xC0:
-      if(data[0] == 0x02){
-        steer->angle = (data[1] << 8) + data[2];
+void Vehicle::skip_stored(const int& reader){
+  lost_rows[reader] = 0;
+  reader_changes[reader].reset();
+  for(auto device : devices)
+    if(device->has_fields())
+      reader_cursors[reader][device->index] = store.end(device->columns[0]);
+}
 
-        steer->angle /= 100.0f;
+void Vehicle::store_rows(Device* device, const Row_Batch_t& batch){
+  if(batch.count == 0 || !device->has_fields())
+    return;
 
-        steer->timestamp = timestamp;
+  for(size_t i = 0; i < device->columns.size(); i++)
+    store.append(device->columns[i], batch.timestamp, batch.fields[i], batch.count);
 
-        modifiedDevices.push_back(steer);
-      }
-    break;
-    case 0xD0:
-      encoder_left->rads =  (data[0] << 16) + (data[1] << 8) + data[2];
-      encoder_right->rads = (data[3] << 16) + (data[4] << 8) + data[5];
-
-      encoder_left->rads /= 10000.0f;
-      encoder_right->rads /= 10000.0f;
-      if(data[6] == 1)
-        encoder_left->rads *= -1;
-      if(data[7] == 1)
-        encoder_right->rads *= -1;
-
-      encoder_left->timestamp = timestamp;
-      encoder_right->timestamp = timestamp;
-
-      modifiedDevices.push_back(encoder_left);
-      modifiedDevices.push_back(encoder_right);
-      break;
-    case 0xD1:
-      encoder_left->rotations =  (data[0] << 16) + (data[1] << 8) + data[2];
-      encoder_left->km = (data[3] << 16) + (data[4] << 8) + data[5];
-      encoder_right->rotations =  (data[0] << 16) + (data[1] << 8) + data[2];
-      encoder_right->km = (data[3] << 16) + (data[4] << 8) + data[5];
-      // error left data[6]
-      // error right data[6]
-
-      encoder_left->timestamp = timestamp;
-      encoder_right->timestamp = timestamp;
-
-      // modifiedDevices.push_back(encoder_left);
-      // modifiedDevices.push_back(encoder_right);
-      break;
-    case 0xAA:
-      if(data[0] == 0x01){
-        bms_hv->voltage     = ((data[1] << 16) + (data[2] << 8) + data[3])/10000.0f;
-        bms_hv->max_voltage = ((data[4] << 8)  +  data[5]) / 10000.0f;
-        bms_hv->min_voltage = ((data[6] << 8)  +  data[7]) / 10000.0f;
-        bms_hv->timestamp   =   timestamp;
-        modifiedDevices.push_back(bms_hv);
-      }else if(data[0] == 0x03){
-        bms_hv_state->value = "TS ON";
-        bms_hv_state->timestamp = timestamp;
-        modifiedDevices.push_back(bms_hv_state);
-      }else if(data[0] == 0x04){
-        bms_hv_state->value = "TS OFF";
-        bms_hv_state->timestamp = timestamp;
-        modifiedDevices.push_back(bms_hv_state);
-      }else if(data[0] == 0x09){
-        bms_hv_state->value = BMS_WARNINGS[data[1]] + " -> " + to_string(data[2]);
-        bms_hv_state->timestamp = timestamp;
-        modifiedDevices.push_back(bms_hv_state);
-      }else if(data[0] == 0x08){
-        bms_hv_state->value = BMS_ERRORS[data[1]] + " -> " + to_string(data[2]);
-        bms_hv_state->timestamp = timestamp;
-        modifiedDevices.push_back(bms_hv_state);
-      }else if(data[0] == 0x05){
-        bms_hv->current = ((data[1] << 8) + data[2])/10.0f;
-        bms_hv->power   =  (data[3] << 8) + data[4];
-        bms_hv->timestamp = timestamp;
-        modifiedDevices.push_back(bms_hv);
-      }else if(data[0] == 0x0A){
-        bms_hv->temperature     = ((data[1] << 8) + (data[2])) / 100.0f;
-        bms_hv->max_temperature = ((data[3] << 8) + (data[4])) / 100.0f;
-        bms_hv->min_temperature = ((data[5] << 8) + (data[6])) / 100.0f;
-        bms_hv->timestamp       =   timestamp;
-        modifiedDevices.push_back(bms_hv);
-      }
-    break;
-    case 0xFF:
-      bms_lv->voltage = data[0]/10.0f;
-      bms_lv->temperature = data[2]/5.0f;
-      bms_lv->max_temperature = data[3]/5.0f;
-      bms_lv->timestamp = timestamp;
-      modifiedDevices.push_back(bms_lv);
-    break;
-    case 0x181:
-      if(data[0] == 0xA0){
-        inverter_left->torque = (data[2] << 8) + data[1];
-        if(inverter_left->torque > 32767)
-          inverter_left->torque -= 65535;
-        inverter_left->timestamp = timestamp;
-        modifiedDevices.push_back(inverter_left);
-      }
-      else if(data[0] == 0x4A){
-        inverter_left->temperature = ((data[2] << 8) + data[1] - 15797) / 112.1182;
-        inverter_left->timestamp = timestamp;
-        modifiedDevices.push_back(inverter_left);
-      }
-      else if(data[0] == 0x49){
-        inverter_left->motor_temp = ((data[2] << 8) + data[1] - 9393.9)/55.1;
-        inverter_left->timestamp = timestamp;
-        modifiedDevices.push_back(inverter_left);
-      }
-      // Speed filtered
-      else if(data[0] == 0xA8){
-        inverter_left->speed = (data[2] << 8) + data[1];
-        if(inverter_left->speed > 32767)
-          inverter_left->speed -= 65535;
+  // Same state as if the last row was decoded by parse_message
+  const size_t last = batch.count - 1;
+  *device->sample_timestamp = batch.timestamp[last];
+  for(size_t i = 0; i < device->fields.size(); i++)
+    *device->fields[i] = batch.fields[i][last];
 
-        inverter_left->speed *= (7000.0/32767.0);
-        inverter_left->speed *= (6.28318/60.0);
+  device->sequence += batch.count;
+  for(auto& changes : reader_changes)
+    changes.set(device->index);
+}
 
-        // Motor reduction ratio
-        inverter_left->speed /= 3.47;
+double Vehicle::next_stored_timestamp(const int& reader, Device* device){
+  if(!device->has_fields())
+    return -1.0;
+  const int& column = device->columns[0];
+  const uint64_t next = max(reader_cursors[reader][device->index], store.first(column));
+  const double* timestamp;
+  const double* value;
+  if(store.span(column, next, &timestamp, &value) == 0)
+    return -1.0;
+  return *timestamp;
+}
 
-        inverter_left->timestamp = timestamp;
-        modifiedDevices.push_back(inverter_left);
-      }
-      // Speed unfiltered
-      else if(data[0] == 0x30){
-        inverter_left->speed = (data[2] << 8) + data[1];
-        if(inverter_left->speed > 32767)
-          inverter_left->speed -= 65535;
+void Vehicle::write_stored_rows(const int& reader, int index){
+  // Same format of to_string, the whole batch is written at once
+  char value[512];
+  string rows;
+  for_each_device(consume_changes(reader), [&](Device* device){
+    if(!device->has_fields() || (int)device->files.size() <= index || device->files[index] == nullptr)
+      return;
+
+    const size_t fields = device->fields.size();
+    rows.clear();
+    read_rows(reader, device, [&](const Row_Batch_t& batch){
+      for(size_t i = 0; i < batch.count; i++)
+      {
+        rows.append(value, snprintf(value, sizeof(value), "%f,", batch.timestamp[i]));
+        for(size_t j = 0; j < fields; j++)
+          rows.append(value, snprintf(value, sizeof(value), "%f,", batch.fields[j][i]));
+        rows += '\n';
+      }
+    });
+    if(rows.size() > 0)
+      device->files[index]->write(rows.data(), rows.size());
+  });
+}
 
-        inverter_left->speed *= (7000.0/32767.0);
-        inverter_left->speed *= (6.28318/60.0);
+void Vehicle::serialize_stored(const int& reader, const double& min_period){
+  const Reflection* reflection = vehicle_proto->GetReflection();
+  for_each_device(consume_changes(reader), [&](Device* device){
+    if(!device->has_fields())
+      return;
+
+    const FieldDescriptor* field = proto_fields[device->index];
+    const vector<const FieldDescriptor*>& columns = proto_columns[device->index];
+    const size_t fields = device->fields.size();
+    double& last = serialized_timestamps[reader][device->index];
+    read_rows(reader, device, [&](const Row_Batch_t& batch){
+      for(size_t i = 0; i < batch.count; i++)
+      {
+        if(min_period > 0.0 && batch.timestamp[i] - last <= min_period)
+          continue;
+        last = batch.timestamp[i];
+
+        // Message fields are timestamp and then the device fields
+        Message* row = reflection->AddMessage(vehicle_proto, field);
+        const Reflection* row_reflection = row->GetReflection();
+        row_reflection->SetDouble(row, row->GetDescriptor()->field(0), batch.timestamp[i]);
+        for(size_t j = 0; j < fields; j++)
+        {
+          if(columns[j]->is_repeated())
+            row_reflection->AddDouble(row, columns[j], batch.fields[j][i]);
+          else
+            row_reflection->SetDouble(row, columns[j], batch.fields[j][i]);
+        }
+      }
+    });
+  });
+}
 
-        // Motor reduction ratio
-        inverter_left->speed /= 3.47;
+void Vehicle::add_decoder(const int& id, Decode_Fn decode, Device* device, int arg, Decode_Batch_t batch){
+  Decoder_t& decoder = dispatch[decoder_bus][id].frame;
+  decoder.decode = decode;
+  decoder.device = device;
+  decoder.arg = arg;
+  decoder.batch = batch;
+  known_ids[decoder_bus].set(id);
+}
 
-        inverter_left->timestamp = timestamp;
-        modifiedDevices.push_back(inverter_left);
-      }
-    break;
-    case 0x182:
-      if(data[0] == 0xA0){
-        inverter_right->torque = (data[2] << 8) + data[1];
-        if(inverter_right->torque > 32767)
-          inverter_right->torque -= 65535;
-        inverter_right->timestamp = timestamp;
-        modifiedDevices.push_back(inverter_right);
-      }
-      else if(data[0] == 0x4A){
-        inverter_right->temperature = ((data[2] << 8) + data[1] - 15797) / 112.1182;
-        inverter_right->timestamp = timestamp;
-        modifiedDevices.push_back(inverter_right);
-      }
-      else if(data[0] == 0x49){
-        inverter_right->motor_temp = ((data[2] << 8) + data[1] - 9393.9)/55.1;
-        inverter_right->timestamp = timestamp;
-        modifiedDevices.push_back(inverter_right);
-      }
-      // Speed filtered
-      else if(data[0] == 0xA8){
-        inverter_right->speed = (data[2] << 8) + data[1];
-        if(inverter_right->speed > 32767)
-          inverter_right->speed -= 65535;
-        inverter_right->speed *= (7000.0/32767.0);
-        inverter_right->speed *= (6.28318/60.0);
-
-        // Motor reduction ratio
-        inverter_right->speed /= 3.47;
-
-        inverter_right->timestamp = timestamp;
-        modifiedDevices.push_back(inverter_right);
-      }
-      // Speed unfiltered
-      else if(data[0] == 0x30){
-        inverter_right->speed = (data[2] << 8) + data[1];
-        if(inverter_right->speed > 32767)
-          inverter_right->speed -= 65535;
-        inverter_right->speed *= -1;
-        inverter_right->speed *= (7000.0/32767.0);
-        inverter_right->speed *= (6.28318/60.0);
-
-        // Motor reduction ratio
-        inverter_right->speed /= 3.47;
-
-        inverter_right->timestamp = timestamp;
-        modifiedDevices.push_back(inverter_right);
-      }
-    break;
-    case 0xA0:
-      if(data[0] == 0x03){
-        steering_wheel_state->value = "REQUEST TS ON";
-        steering_wheel_state->timestamp = timestamp;
-        modifiedDevices.push_back(steering_wheel_state);
-      }else if(data[0] == 0x04){
-        steering_wheel_state->value = "REQUEST TO IDLE";
-        steering_wheel_state->timestamp = timestamp;
-        modifiedDevices.push_back(steering_wheel_state);
-      }else if(data[0] == 0x05){
-        steering_wheel_state->value = "REQUEST TO RUN";
-        steering_wheel_state->timestamp = timestamp;
-        modifiedDevices.push_back(steering_wheel_state);
-      }else if(data[0] == 0x06){
-        steering_wheel_state->value = "REQUEST TO SETUP";
-        steering_wheel_state->timestamp = timestamp;
-        modifiedDevices.push_back(steering_wheel_state);
-      }else if(data[0] == 0x08){
-        steering_wheel_state->value = "REQUEST INVERTER LEFT ON";
-        steering_wheel_state->timestamp = timestamp;
-        modifiedDevices.push_back(steering_wheel_state);
-      }else if(data[0] == 0x09){
-        steering_wheel_state->value = "REQUEST INVERTER RIGHT ON";
-        steering_wheel_state->timestamp = timestamp;
-        modifiedDevices.push_back(steering_wheel_state);
-      }
-    break;
-    case 0x55:
-      if(data[0] == 0x01){
-        // if(size < NUM_STATES)
-        //   break;
-        ecu_state->value = "STATE: " + ECU_STATES[data[4]] + " Map: " + to_string(data[3]);
-        ecu_state->timestamp = timestamp;
-        modifiedDevices.push_back(ecu_state);
-      }else if(data[0] == 0x0B && data[1] == 0x04){
-        ecu_state->value = "REQUEST TS OFF";
-        ecu_state->timestamp = timestamp;
-        modifiedDevices.push_back(ecu_state);
-      }else if(data[0] == 0x0B && data[1] == 0x08){
-        ecu_state->value = "REQUEST TS OFF ERRORS";
-        ecu_state->timestamp = timestamp;
-        modifiedDevices.push_back(ecu_state);
-      }else if(data[0] == 0x0A){
-        ecu_state->value = "REQUEST TS ON";
-        ecu_state->timestamp = timestamp;
-        modifiedDevices.push_back(ecu_state);
-      }
-    break;
-    case 0x201:
-      if(data[0] == 0x90){
-        ecu->power_request_left = (data[2] << 8) + data[1];
-        ecu->timestamp = timestamp;
-        modifiedDevices.push_back(ecu);
-      }
-    break;
-    case 0x202:
-      if(data[0] == 0x90){
-        ecu->power_request_right = (data[2] << 8) + data[1];
-        ecu->timestamp = timestamp;
-        modifiedDevices.push_back(ecu);
-      }
-    break;
-    //////////////////////// Temp 1
-    case 0x5B0:
-      temp_fl->temps[ 0] = (((data[0] << 8) + data[1]) * 0.1) - 100;
-      temp_fl->temps[ 1] = (((data[2] << 8) + data[3]) * 0.1) - 100;
-      temp_fl->temps[ 2] = (((data[4] << 8) + data[5]) * 0.1) - 100;
-      temp_fl->temps[ 3] = (((data[6] << 8) + data[7]) * 0.1) - 100;
-      temp_fl->timestamp = timestamp;
-      temp_fl->msg_count ++;
-      if(temp_fl->msg_count == 4)
-      {
-        modifiedDevices.push_back(temp_fl);
-        temp_fl->msg_count = 0;
-      }
-    break;
-    case 0x5B1:
-      temp_fl->temps[ 4] = (((data[0] << 8) + data[1]) * 0.1) - 100;
-      temp_fl->temps[ 5] = (((data[2] << 8) + data[3]) * 0.1) - 100;
-      temp_fl->temps[ 6] = (((data[4] << 8) + data[5]) * 0.1) - 100;
-      temp_fl->temps[ 7] = (((data[6] << 8) + data[7]) * 0.1) - 100;
-      temp_fl->timestamp = timestamp;
-      temp_fl->msg_count ++;
-      if(temp_fl->msg_count == 4)
-      {
-        modifiedDevices.push_back(temp_fl);
-        temp_fl->msg_count = 0;
-      }
-    break;
-    case 0x5B2:
-      temp_fl->temps[ 8] = (((data[0] << 8) + data[1]) * 0.1) - 100;
-      temp_fl->temps[ 9] = (((data[2] << 8) + data[3]) * 0.1) - 100;
-      temp_fl->temps[10] = (((data[4] << 8) + data[5]) * 0.1) - 100;
-      temp_fl->temps[11] = (((data[6] << 8) + data[7]) * 0.1) - 100;
-      temp_fl->timestamp = timestamp;
-      temp_fl->msg_count ++;
-      if(temp_fl->msg_count == 4)
-      {
-        modifiedDevices.push_back(temp_fl);
-        temp_fl->msg_count = 0;
-      }
-    break;
-    case 0x5B3:
-      temp_fl->temps[12] = (((data[0] << 8) + data[1]) * 0.1) - 100;
-      temp_fl->temps[13] = (((data[2] << 8) + data[3]) * 0.1) - 100;
-      temp_fl->temps[14] = (((data[4] << 8) + data[5]) * 0.1) - 100;
-      temp_fl->temps[15] = (((data[6] << 8) + data[7]) * 0.1) - 100;
-      temp_fl->timestamp = timestamp;
-      temp_fl->msg_count ++;
-      if(temp_fl->msg_count == 4)
-      {
-        modifiedDevices.push_back(temp_fl);
-        temp_fl->msg_count = 0;
-      }
-    break;
-    //////////////////////// Temp 2
-    case 0x5B4:
-      temp_fr->temps[ 0] = (((data[0] << 8) + data[1]) * 0.1) - 100;
-      temp_fr->temps[ 1] = (((data[2] << 8) + data[3]) * 0.1) - 100;
-      temp_fr->temps[ 2] = (((data[4] << 8) + data[5]) * 0.1) - 100;
-      temp_fr->temps[ 3] = (((data[6] << 8) + data[7]) * 0.1) - 100;
-      temp_fr->timestamp = timestamp;
-      temp_fr->msg_count ++;
-      if(temp_fr->msg_count == 4)
-      {
-        modifiedDevices.push_back(temp_fr);
-        temp_fr->msg_count = 0;
-      }
-    break;
-    case 0x5B5:
-      temp_fr->temps[ 4] = (((data[0] << 8) + data[1]) * 0.1) - 100;
-      temp_fr->temps[ 5] = (((data[2] << 8) + data[3]) * 0.1) - 100;
-      temp_fr->temps[ 6] = (((data[4] << 8) + data[5]) * 0.1) - 100;
-      temp_fr->temps[ 7] = (((data[6] << 8) + data[7]) * 0.1) - 100;
-      temp_fr->timestamp = timestamp;
-      temp_fr->msg_count ++;
-      if(temp_fr->msg_count == 4)
-      {
-        modifiedDevices.push_back(temp_fr);
-        temp_fr->msg_count = 0;
-      }
-    break;
-    case 0x5B6:
-      temp_fr->temps[ 8] = (((data[0] << 8) + data[1]) * 0.1) - 100;
-      temp_fr->temps[ 9] = (((data[2] << 8) + data[3]) * 0.1) - 100;
-      temp_fr->temps[10] = (((data[4] << 8) + data[5]) * 0.1) - 100;
-      temp_fr->temps[11] = (((data[6] << 8) + data[7]) * 0.1) - 100;
-      temp_fr->timestamp = timestamp;
-      temp_fr->msg_count ++;
-      if(temp_fr->msg_count == 4)
-      {
-        modifiedDevices.push_back(temp_fr);
-        temp_fr->msg_count = 0;
-      }
-    break;
-    case 0x5B7:
-      temp_fr->temps[12] = (((data[0] << 8) + data[1]) * 0.1) - 100;
-      temp_fr->temps[13] = (((data[2] << 8) + data[3]) * 0.1) - 100;
-      temp_fr->temps[14] = (((data[4] << 8) + data[5]) * 0.1) - 100;
-      temp_fr->temps[15] = (((data[6] << 8) + data[7]) * 0.1) - 100;
-      temp_fr->timestamp = timestamp;
-      temp_fr->msg_count ++;
-      if(temp_fr->msg_count == 4)
-      {
-        modifiedDevices.push_back(temp_fr);
-        temp_fr->msg_count = 0;
-      }
-    break;
-    //////////////////////// Temp 3
-    case 0x5B8:
-      temp_rl->temps[ 0] = (((data[0] << 8) + data[1]) * 0.1) - 100;
-      temp_rl->temps[ 1] = (((data[2] << 8) + data[3]) * 0.1) - 100;
-      temp_rl->temps[ 2] = (((data[4] << 8) + data[5]) * 0.1) - 100;
-      temp_rl->temps[ 3] = (((data[6] << 8) + data[7]) * 0.1) - 100;
-      temp_rl->timestamp = timestamp;
-      temp_rl->msg_count ++;
-      if(temp_rl->msg_count == 4)
-      {
-        modifiedDevices.push_back(temp_rl);
-        temp_rl->msg_count = 0;
-      }
-    break;
-    case 0x5B9:
-      temp_rl->temps[ 4] = (((data[0] << 8) + data[1]) * 0.1) - 100;
-      temp_rl->temps[ 5] = (((data[2] << 8) + data[3]) * 0.1) - 100;
-      temp_rl->temps[ 6] = (((data[4] << 8) + data[5]) * 0.1) - 100;
-      temp_rl->temps[ 7] = (((data[6] << 8) + data[7]) * 0.1) - 100;
-      temp_rl->timestamp = timestamp;
-      temp_rl->msg_count ++;
-      if(temp_rl->msg_count == 4)
-      {
-        modifiedDevices.push_back(temp_rl);
-        temp_rl->msg_count = 0;
-      }
-    break;
-    case 0x5BA:
-      temp_rl->temps[ 8] = (((data[0] << 8) + data[1]) * 0.1) - 100;
-      temp_rl->temps[ 9] = (((data[2] << 8) + data[3]) * 0.1) - 100;
-      temp_rl->temps[10] = (((data[4] << 8) + data[5]) * 0.1) - 100;
-      temp_rl->temps[11] = (((data[6] << 8) + data[7]) * 0.1) - 100;
-      temp_rl->timestamp = timestamp;
-      temp_rl->msg_count ++;
-      if(temp_rl->msg_count == 4)
-      {
-        modifiedDevices.push_back(temp_rl);
-        temp_rl->msg_count = 0;
-      }
-    break;
-    case 0x5BB:
-      temp_rl->temps[12] = (((data[0] << 8) + data[1]) * 0.1) - 100;
-      temp_rl->temps[13] = (((data[2] << 8) + data[3]) * 0.1) - 100;
-      temp_rl->temps[14] = (((data[4] << 8) + data[5]) * 0.1) - 100;
-      temp_rl->temps[15] = (((data[6] << 8) + data[7]) * 0.1) - 100;
-      temp_rl->timestamp = timestamp;
-      temp_rl->msg_count ++;
-      if(temp_rl->msg_count == 4)
-      {
-        modifiedDevices.push_back(temp_rl);
-        temp_rl->msg_count = 0;
-      }
-    break;
-    //////////////////////// Temp 4
-    case 0x5BC:
-      temp_rr->temps[ 0] = (((data[0] << 8) + data[1]) * 0.1) - 100;
-      temp_rr->temps[ 1] = (((data[2] << 8) + data[3]) * 0.1) - 100;
-      temp_rr->temps[ 2] = (((data[4] << 8) + data[5]) * 0.1) - 100;
-      temp_rr->temps[ 3] = (((data[6] << 8) + data[7]) * 0.1) - 100;
-      temp_rr->timestamp = timestamp;
-      temp_rr->msg_count ++;
-      if(temp_rr->msg_count == 4)
-      {
-        modifiedDevices.push_back(temp_rr);
-        temp_rr->msg_count = 0;
-      }
-    break;
-    case 0x5BD:
-      temp_rr->temps[ 4] = (((data[0] << 8) + data[1]) * 0.1) - 100;
-      temp_rr->temps[ 5] = (((data[2] << 8) + data[3]) * 0.1) - 100;
-      temp_rr->temps[ 6] = (((data[4] << 8) + data[5]) * 0.1) - 100;
-      temp_rr->temps[ 7] = (((data[6] << 8) + data[7]) * 0.1) - 100;
-      temp_rr->timestamp = timestamp;
-      temp_rr->msg_count ++;
-      if(temp_rr->msg_count == 4)
-      {
-        modifiedDevices.push_back(temp_rr);
-        temp_rr->msg_count = 0;
-      }
-    break;
-    case 0x5BE:
-      temp_rr->temps[ 8] = (((data[0] << 8) + data[1]) * 0.1) - 100;
-      temp_rr->temps[ 9] = (((data[2] << 8) + data[3]) * 0.1) - 100;
-      temp_rr->temps[10] = (((data[4] << 8) + data[5]) * 0.1) - 100;
-      temp_rr->temps[11] = (((data[6] << 8) + data[7]) * 0.1) - 100;
-      temp_rr->timestamp = timestamp;
-      temp_rr->msg_count ++;
-      if(temp_rr->msg_count == 4)
-      {
-        modifiedDevices.push_back(temp_rr);
-        temp_rr->msg_count = 0;
-      }
-    break;
-    case 0x5BF:
-      temp_rr->temps[12] = (((data[0] << 8) + data[1]) * 0.1) - 100;
-      temp_rr->temps[13] = (((data[2] << 8) + data[3]) * 0.1) - 100;
-      temp_rr->temps[14] = (((data[4] << 8) + data[5]) * 0.1) - 100;
-      temp_rr->temps[15] = (((data[6] << 8) + data[7]) * 0.1) - 100;
-      temp_rr->timestamp = timestamp;
-      temp_rr->msg_count ++;
-      if(temp_rr->msg_count == 4)
-      {
-        modifiedDevices.push_back(temp_rr);
-        temp_rr->msg_count = 0;
-      }
-    break;
-    default:
-    break;
+void Vehicle::add_mux_decoder(const int& id, const uint8_t& mux, Decode_Fn decode, Device* device, int arg){
+  Dispatch_Entry_t& entry = dispatch[decoder_bus][id];
+  if(entry.mux == nullptr)
+  {
+    entry.mux = new Decoder_t[CAN_MUX_COUNT];
+    mux_tables.push_back(entry.mux);
   }
+  Decoder_t& decoder = entry.mux[mux];
+  decoder.decode = decode;
+  decoder.device = device;
+  decoder.arg = arg;
+  known_ids[decoder_bus].set(id);
 }
 
-int Chimera::parse_gps(Gps* gps_, const double& timestamp, string& line)
+const Device_Set_t& Vehicle::parse_message(const int64_t& timestamp_ns, const uint8_t& bus, const int &id, const uint8_t data[], const int &size){
+  modified_devices.reset();
+
+  if(bus >= VEHICLE_MAX_BUSES || id < 0 || id >= CAN_STD_ID_COUNT)
+    return modified_devices;
+
+  // One load for the id, one more for multiplexed ids,
+  // no compare chains on the id or on the mux byte
+  const Dispatch_Entry_t& entry = dispatch[bus][id];
+  const Decoder_t& decoder = entry.mux != nullptr ? entry.mux[data[0]] : entry.frame;
+  if(decoder.decode == nullptr)
+    return modified_devices;
+
+  // Devices store seconds
+  decoder.decode(this, decoder, ns_to_seconds(timestamp_ns), data, size, modified_devices);
+  if(modified_devices.none())
+    return modified_devices;
+
+  for_each_device(modified_devices, [](Device* device){
+    device->sequence ++;
+  });
+  for(auto& changes : reader_changes)
+    changes |= modified_devices;
+  return modified_devices;
+}
+
+int Vehicle::parse_gps(Gps* gps_, const double& timestamp, string& line)
 {
 
 
@@ -804,116 +706,13 @@ int Chimera::parse_gps(Gps* gps_, const double& timestamp, string& line)
   return 0;
 }
 
-void Chimera::serialize(){
-  this->accel->serialize(chimera_proto->add_accel());
-  this->gyro->serialize(chimera_proto->add_gyro());
-
-  this->encoder_left->serialize(chimera_proto->add_encoder_left());
-  this->encoder_right->serialize(chimera_proto->add_encoder_right());
-
-  this->bms_lv->serialize(chimera_proto->add_bms_lv());
-  this->bms_hv->serialize(chimera_proto->add_bms_hv());
-
-  this->inverter_left->serialize(chimera_proto->add_inverter_left());
-  this->inverter_right->serialize(chimera_proto->add_inverter_right());
-
-  this->pedal->serialize(chimera_proto->add_pedal());
-  this->steer->serialize(chimera_proto->add_steer());
-
-  this->ecu_state->serialize(chimera_proto->add_ecu_state());
-  this->bms_hv_state->serialize(chimera_proto->add_bms_hv_state());
-  this->steering_wheel_state->serialize(chimera_proto->add_steering_wheel_state());
-
-  this->ecu->serialize(chimera_proto->add_ecu());
-
-  this->temp_fl->serialize(chimera_proto->add_temp_fl());
-  this->temp_fr->serialize(chimera_proto->add_temp_fr());
-  this->temp_rl->serialize(chimera_proto->add_temp_rl());
-  this->temp_rr->serialize(chimera_proto->add_temp_rr());
-
-  this->gps1->serialize(chimera_proto->add_gps1());
-  this->gps2->serialize(chimera_proto->add_gps2());
+void Vehicle::serialize(){
+  for(auto device : devices)
+    serialize_device(device);
 }
 
-
-void Chimera::serialize_device(Device* device){
-  if (device == accel){
-    this->accel->serialize(chimera_proto->add_accel());
-  }
-  else if(device == gyro)
-  {
-    this->gyro->serialize(chimera_proto->add_gyro());
-  }
-  else if(device == encoder_left)
-  {
-    this->encoder_left->serialize(chimera_proto->add_encoder_left());
-  }
-  else if(device == encoder_right)
-  {
-    this->encoder_right->serialize(chimera_proto->add_encoder_right());
-  }
-  else if(device == inverter_right)
-  {
-    this->inverter_right->serialize(chimera_proto->add_inverter_right());
-  }
-  else if(device == inverter_left)
-  {
-    this->inverter_left->serialize(chimera_proto->add_inverter_left());
-  }
-  else if(device == bms_lv)
-  {
-    this->bms_lv->serialize(chimera_proto->add_bms_lv());
-  }
-  else if(device == bms_hv)
-  {
-    this->bms_hv->serialize(chimera_proto->add_bms_hv());
-  }
-  else if(device == pedal)
-  {
-    this->pedal->serialize(chimera_proto->add_pedal());
-  }
-  else if(device == steer)
-  {
-    this->steer->serialize(chimera_proto->add_steer());
-  }
-  else if(device == ecu_state)
-  {
-    this->ecu_state->serialize(chimera_proto->add_ecu_state());
-  }
-  else if(device == bms_hv_state)
-  {
-    this->bms_hv_state->serialize(chimera_proto->add_bms_hv_state());
-  }
-  else if(device == steering_wheel_state)
-  {
-    this->steering_wheel_state->serialize(chimera_proto->add_steering_wheel_state());
-  }
-  else if(device == ecu)
-  {
-    this->ecu->serialize(chimera_proto->add_ecu());
-  }
-  else if(device == temp_fl)
-  {
-    this->temp_fl->serialize(chimera_proto->add_temp_fl());
-  }
-  else if(device == temp_fr)
-  {
-    this->temp_fr->serialize(chimera_proto->add_temp_fr());
-  }
-  else if(device == temp_rl)
-  {
-    this->temp_rl->serialize(chimera_proto->add_temp_rl());
-  }
-  else if(device == temp_rr)
-  {
-    this->temp_rr->serialize(chimera_proto->add_temp_rr());
-  }
-  else if(device == gps1)
-  {
-    this->gps1->serialize(chimera_proto->add_gps1());
-  }
-  else if(device == gps2)
-  {
-    this->gps2->serialize(chimera_proto->add_gps2());
-  }
+void Vehicle::serialize_device(Device* device){
+  if(device->index < 0 || device->index >= (int)devices.size())
+    return;
+  serializers[device->index](device, vehicle_proto);
 }